@@ -17,11 +17,125 @@ window.onload = function() {
   document.getElementById('statusMessage').classList.remove('hidden');
   document.getElementById('configSection').classList.add('hidden');
   
-  fetchCurrentConfig();
-  loadAvailableOptions();
-  loadPDOProfiles();
+  bootstrap();
 };
 
+// One request for everything the page shows (api/snapshot); api/events is
+// then polled from the version it returned rather than sending the whole
+// state again
+async function bootstrap() {
+  let version = '';
+  try {
+    applySnapshot(await fetchStateJSON('api/snapshot'));
+    version = stateCache['api/snapshot'] ? stateCache['api/snapshot'].etag : '';
+  } catch (error) {
+    console.error('Error loading snapshot:', error);
+    // Older firmware or a failed request: the capability table on its own;
+    // the first api/events answer brings the state
+    await loadAvailableOptions();
+  }
+  startLiveUpdates(version);
+}
+
+let capabilitiesShown = false;
+
+// Show an api/snapshot body; capabilities only once, they never change
+function applySnapshot(snapshot) {
+  if (!snapshot.success) {
+    throw new Error(snapshot.error || snapshot.message || 'No snapshot');
+  }
+  if (!capabilitiesShown) {
+    showCapabilities(snapshot.capabilities);
+  }
+  renderStatus(snapshot.status);
+  renderPDOProfiles(snapshot.profiles);
+}
+
+// Live state from api/events, polled with the id of the state last shown:
+// each answer holds only the parts that changed since, and nothing but the
+// id while nothing did. If api/events fails, api/snapshot is polled with
+// conditional requests instead.
+const EVENTS_INTERVAL_MS = 2000;
+const POLL_INTERVAL_MS = 5000;
+let liveUpdates = false;
+let pollTimer = null;
+
+function startLiveUpdates(version) {
+  pollEvents(version);
+}
+
+async function pollEvents(since) {
+  const url = since ? 'api/events?since=' + encodeURIComponent(since)
+                    : 'api/events';
+  try {
+    const response = typeof AuthUtils.fetch === 'function'
+      ? await AuthUtils.fetch(url, { cache: 'no-store' })
+      : await fetch(url, { cache: 'no-store', credentials: 'same-origin' });
+    if (!response.ok) {
+      throw new Error('HTTP ' + response.status);
+    }
+    const delta = await response.json();
+    liveUpdates = true;
+    if (delta.status) {
+      renderStatus(delta.status);
+    }
+    if (delta.profiles) {
+      renderPDOProfiles(delta.profiles);
+    }
+    since = delta.id;
+  } catch (error) {
+    console.error('Error polling events:', error);
+    liveUpdates = false;
+    startPolling();
+    return;
+  }
+  setTimeout(function() { pollEvents(since); }, EVENTS_INTERVAL_MS);
+}
+
+function startPolling() {
+  refreshSnapshot();
+  if (!pollTimer) {
+    pollTimer = setInterval(refreshSnapshot, POLL_INTERVAL_MS);
+  }
+}
+
+// Status and profiles in one conditional request (polling, retry)
+async function refreshSnapshot() {
+  try {
+    applySnapshot(await fetchStateJSON('api/snapshot'));
+  } catch (error) {
+    console.error('Error fetching snapshot:', error);
+    refreshStatus();
+    loadPDOProfiles();
+  }
+}
+
+// Last body and ETag per state URL. Requests carry If-None-Match, so while
+// the device state is unchanged it answers 304 and this copy is reused.
+const stateCache = {};
+
+async function fetchStateJSON(url) {
+  const cached = stateCache[url];
+  const options = {
+    cache: 'no-store', // Revalidation is done here, not by the browser
+    headers: cached ? { 'If-None-Match': cached.etag } : {}
+  };
+  const response = typeof AuthUtils.fetch === 'function'
+    ? await AuthUtils.fetch(url, options)
+    : await fetch(url, Object.assign({ credentials: 'same-origin' }, options));
+  if (response.status === 304 && cached) {
+    return cached.data;
+  }
+  const data = await response.json();
+  const etag = response.headers.get('ETag');
+  if (etag && response.ok) {
+    stateCache[url] = { etag: etag, data: data };
+  } else {
+    delete stateCache[url];
+  }
+  return data;
+}
+
 async function fetchCurrentConfig() {
   // Show loading state
   document.getElementById('currentVoltage').innerText = 'Loading...';
@@ -32,45 +146,13 @@ async function fetchCurrentConfig() {
   document.getElementById('statusMessage').classList.remove('hidden');
   document.getElementById('retryContainer').classList.add('hidden');
   
+  await refreshStatus();
+}
+
+// Fetch the status without the loading placeholders (polling)
+async function refreshStatus() {
   try {
-    const data = await AuthUtils.fetchJSON('api/status');
-    if (data.success) {
-      // Success case - PD board connected and values read
-      document.getElementById('currentVoltage').innerText = data.voltage;
-      document.getElementById('currentCurrent').innerText = data.current;
-      document.getElementById('currentPower').innerText = (data.voltage * data.current).toFixed(2);
-      
-      // Pre-select the current values in dropdowns
-      selectOptionByValue('voltageSelect', data.voltage);
-      selectOptionByValue('currentSelect', data.current);
-      
-      // Show success status and enable form
-      document.getElementById('statusMessage').className = 'status-message success';
-      document.getElementById('statusMessage').innerText = 'Device connected and ready';
-      document.getElementById('configSection').classList.remove('hidden');
-      document.getElementById('retryContainer').classList.add('hidden');
-      setFormEnabled(true);
-      
-    } else {
-      // Error case - PD board not connected or values not read
-      document.getElementById('currentVoltage').innerText = 'N/A';
-      document.getElementById('currentCurrent').innerText = 'N/A';
-      document.getElementById('currentPower').innerText = 'N/A';
-      
-      // Show error status and disable form
-      document.getElementById('statusMessage').className = 'status-message error';
-      document.getElementById('statusMessage').innerText = data.message;
-      document.getElementById('retryContainer').classList.remove('hidden');
-      
-      if (data.connected) {
-        // Board is connected but values not read - still show form
-        document.getElementById('configSection').classList.remove('hidden');
-        setFormEnabled(false);
-      } else {
-        // Board not connected - hide form completely
-        document.getElementById('configSection').classList.add('hidden');
-      }
-    }
+    renderStatus(await fetchStateJSON('api/status'));
   } catch (error) {
     console.error('Error fetching status:', error);
     document.getElementById('currentVoltage').innerText = 'Error';
@@ -85,60 +167,100 @@ async function fetchCurrentConfig() {
   }
 }
 
-async function loadAvailableOptions() {
-  try {
-    // Load voltage options
-    const voltageResponse = await AuthUtils.fetchJSON('api/voltages');
-    const voltageSelect = document.getElementById('voltageSelect');
-    voltageSelect.innerHTML = '<option value="">Select voltage...</option>';
+// Show an api/status body (fetched or from a state event)
+function renderStatus(data) {
+  if (data.success) {
+    // Success case - PD board connected and values read
+    document.getElementById('currentVoltage').innerText = data.voltage;
+    document.getElementById('currentCurrent').innerText = data.current;
+    document.getElementById('currentPower').innerText = (data.voltage * data.current).toFixed(2);
     
-    if (voltageResponse.voltages && Array.isArray(voltageResponse.voltages)) {
-      voltageResponse.voltages.forEach(voltage => {
-        const option = document.createElement('option');
-        option.value = voltage;
-        option.text = voltage + ' V';
-        voltageSelect.appendChild(option);
-      });
-    }
+    // Pre-select the current values in dropdowns
+    selectOptionByValue('voltageSelect', data.voltage);
+    selectOptionByValue('currentSelect', data.current);
     
-    // Add event listener for voltage changes to filter currents  
-    voltageSelect.addEventListener('change', function() {
-      updateCurrentOptions();
-    });
+    // Show success status and enable form
+    document.getElementById('statusMessage').className = 'status-message success';
+    document.getElementById('statusMessage').innerText = 'Device connected and ready';
+    document.getElementById('configSection').classList.remove('hidden');
+    document.getElementById('retryContainer').classList.add('hidden');
+    setFormEnabled(true);
     
-    updateApplyButtonState();
-  } catch (error) {
-    console.error('Error loading voltages:', error);
-  }
-  
-  try {
-    // Load current options
-    const currentResponse = await AuthUtils.fetchJSON('api/currents');
-    const currentSelect = document.getElementById('currentSelect');
-    currentSelect.innerHTML = '<option value="">Select current...</option>';
+  } else {
+    // Error case - PD board not connected or values not read
+    document.getElementById('currentVoltage').innerText = 'N/A';
+    document.getElementById('currentCurrent').innerText = 'N/A';
+    document.getElementById('currentPower').innerText = 'N/A';
     
-    if (currentResponse.currents && Array.isArray(currentResponse.currents)) {
-      currentResponse.currents.forEach(current => {
-        const option = document.createElement('option');
-        option.value = current;
-        option.text = current + ' A';
-        currentSelect.appendChild(option);
-      });
-    }
+    // Show error status and disable form
+    document.getElementById('statusMessage').className = 'status-message error';
+    document.getElementById('statusMessage').innerText = data.message;
+    document.getElementById('retryContainer').classList.remove('hidden');
     
-    // Add event listener for current changes to filter voltages
-    if (currentSelect) {
-      currentSelect.addEventListener('change', function() {
-        updateVoltageOptions();
-      });
+    if (data.connected) {
+      // Board is connected but values not read - still show form
+      document.getElementById('configSection').classList.remove('hidden');
+      setFormEnabled(false);
+    } else {
+      // Board not connected - hide form completely
+      document.getElementById('configSection').classList.add('hidden');
     }
-    
-    updateApplyButtonState();
+  }
+}
+
+// Voltage/current table from the device (api/capabilities); the firmware
+// generates it from the same table that validates /api/configure
+let pdCapabilities = { voltages: [], currents: [] };
+
+// Highest current offered at a voltage, or 0 if the voltage is not offered
+function maxCurrentFor(voltage) {
+  const entry = pdCapabilities.voltages.find(v => Math.abs(v.voltage - voltage) < 0.01);
+  return entry ? entry.maxCurrent : 0;
+}
+
+function fillSelect(select, placeholder, values, unit) {
+  select.innerHTML = '<option value="">' + placeholder + '</option>';
+  values.forEach(value => {
+    const option = document.createElement('option');
+    option.value = value;
+    option.text = value + ' ' + unit;
+    select.appendChild(option);
+  });
+}
+
+async function loadAvailableOptions() {
+  let caps = null;
+  try {
+    caps = await AuthUtils.fetchJSON('api/capabilities');
   } catch (error) {
-    console.error('Error loading currents:', error);
+    console.error('Error loading capabilities:', error);
+  }
+  showCapabilities(caps);
+}
+
+// Fill the selects from a capability table (api/capabilities body)
+function showCapabilities(caps) {
+  if (caps && Array.isArray(caps.voltages) && Array.isArray(caps.currents)) {
+    pdCapabilities = caps;
+    capabilitiesShown = true;
   }
+
+  const voltageSelect = document.getElementById('voltageSelect');
+  const currentSelect = document.getElementById('currentSelect');
+  fillSelect(voltageSelect, 'Select voltage...',
+             pdCapabilities.voltages.map(v => v.voltage), 'V');
+  fillSelect(currentSelect, 'Select current...', pdCapabilities.currents, 'A');
+  updateApplyButtonState();
 }
 
+// Each selection narrows the other list to what the voltage can supply
+document.addEventListener('DOMContentLoaded', function() {
+  const voltageSelect = document.getElementById('voltageSelect');
+  const currentSelect = document.getElementById('currentSelect');
+  if (voltageSelect) voltageSelect.addEventListener('change', updateCurrentOptions);
+  if (currentSelect) currentSelect.addEventListener('change', updateVoltageOptions);
+});
+
 function updateCurrentOptions() {
   const voltageSelect = document.getElementById('voltageSelect');
   const currentSelect = document.getElementById('currentSelect');
@@ -147,55 +269,11 @@ function updateCurrentOptions() {
   // Save current selection
   const currentValue = currentSelect.value;
   
-  if (!selectedVoltage || isNaN(selectedVoltage)) {
-    // If no voltage selected, show all currents
-    currentSelect.innerHTML = '<option value="">Select current...</option>';
-    const allCurrents = [0.5, 1.0, 1.33, 1.5, 1.67, 2.0, 2.25, 2.5, 3.0];
-    allCurrents.forEach(current => {
-      const option = document.createElement('option');
-      option.value = current;
-      option.text = current + ' A';
-      currentSelect.appendChild(option);
-    });
-    
-    // Restore selection if it was valid
-    if (currentValue) {
-      currentSelect.value = currentValue;
-    }
-    
-    updateApplyButtonState();
-    return;
-  }
-  
-  // Clear and repopulate based on voltage
-  currentSelect.innerHTML = '<option value="">Select current...</option>';
-  
-  // Define realistic current limits based on common PD profiles
-  let maxCurrent = 3.0; // Default max
-  
-  if (selectedVoltage === 5.0) {
-    maxCurrent = 3.0;  // USB-C can do 5V@3A
-  } else if (selectedVoltage === 9.0) {
-    maxCurrent = 2.25; // Common 9V profile is 2.25A (20W)
-  } else if (selectedVoltage === 12.0) {
-    maxCurrent = 1.67; // Common 12V profile is 1.67A (20W)
-  } else if (selectedVoltage === 15.0) {
-    maxCurrent = 1.33; // 15V@1.33A = 20W
-  } else if (selectedVoltage === 20.0) {
-    maxCurrent = 1.0;  // 20V@1A = 20W
-  }
-  
-  // Standard current options
-  const allCurrents = [0.5, 1.0, 1.33, 1.5, 1.67, 2.0, 2.25, 2.5, 3.0];
-  
-  allCurrents.forEach(current => {
-    if (current <= maxCurrent + 0.01) { // Small tolerance
-      const option = document.createElement('option');
-      option.value = current;
-      option.text = current + ' A';
-      currentSelect.appendChild(option);
-    }
-  });
+  // No voltage selected: every current
+  const maxCurrent = !selectedVoltage || isNaN(selectedVoltage)
+    ? Infinity : maxCurrentFor(selectedVoltage);
+  const currents = pdCapabilities.currents.filter(c => c <= maxCurrent + 0.01); // Small tolerance
+  fillSelect(currentSelect, 'Select current...', currents, 'A');
   
   // Restore selection if still valid
   if (currentValue && parseFloat(currentValue) <= maxCurrent + 0.01) {
@@ -213,49 +291,15 @@ function updateVoltageOptions() {
   // Save current voltage selection
   const voltageValue = voltageSelect.value;
   
-  if (!selectedCurrent || isNaN(selectedCurrent)) {
-    // If no current selected, show all voltages
-    voltageSelect.innerHTML = '<option value="">Select voltage...</option>';
-    const allVoltages = [5.0, 9.0, 12.0, 15.0, 20.0];
-    allVoltages.forEach(voltage => {
-      const option = document.createElement('option');
-      option.value = voltage;
-      option.text = voltage + ' V';
-      voltageSelect.appendChild(option);
-    });
-    
-    // Restore selection if it was valid
-    if (voltageValue) {
-      voltageSelect.value = voltageValue;
-    }
-    
-    updateApplyButtonState();
-    return;
-  }
-  
-  // Clear and repopulate based on current
-  voltageSelect.innerHTML = '<option value="">Select voltage...</option>';
-  
-  // Define which voltages can support the selected current
-  const voltageCurrentLimits = {
-    5.0: 3.0,   // 5V can do up to 3A
-    9.0: 2.25,  // 9V can do up to 2.25A
-    12.0: 1.67, // 12V can do up to 1.67A
-    15.0: 1.33, // 15V can do up to 1.33A
-    20.0: 1.0   // 20V can do up to 1A
-  };
-  
-  Object.entries(voltageCurrentLimits).forEach(([voltage, maxCurrent]) => {
-    if (selectedCurrent <= maxCurrent + 0.01) { // Small tolerance
-      const option = document.createElement('option');
-      option.value = parseFloat(voltage);
-      option.text = voltage + ' V';
-      voltageSelect.appendChild(option);
-    }
-  });
+  // No current selected: every voltage
+  const current = !selectedCurrent || isNaN(selectedCurrent) ? 0 : selectedCurrent;
+  const voltages = pdCapabilities.voltages
+    .filter(v => current <= v.maxCurrent + 0.01) // Small tolerance
+    .map(v => v.voltage);
+  fillSelect(voltageSelect, 'Select voltage...', voltages, 'V');
   
   // Restore selection if still valid
-  if (voltageValue && voltageCurrentLimits[voltageValue] && selectedCurrent <= voltageCurrentLimits[voltageValue] + 0.01) {
+  if (voltageValue && current <= maxCurrentFor(parseFloat(voltageValue)) + 0.01) {
     voltageSelect.value = voltageValue;
   }
   
@@ -316,7 +360,7 @@ document.addEventListener('DOMContentLoaded', function() {
       document.getElementById('statusMessage').classList.remove('hidden');
       
       try {
-        const data = await AuthUtils.fetchJSON('api/configure', {
+        const queued = await AuthUtils.fetchJSON('api/configure', {
           method: 'POST',
           body: JSON.stringify({
             voltage: parseFloat(voltage),
@@ -324,21 +368,31 @@ document.addEventListener('DOMContentLoaded', function() {
           })
         });
         
+        // Configuration runs in the background; wait for the job to finish
+        const data = queued.success ? await waitForConfigJob(queued.jobId) : queued;
+        
         if (data.success) {
           // Update displayed values
           document.getElementById('currentVoltage').innerText = data.voltage;
           document.getElementById('currentCurrent').innerText = data.current;
           document.getElementById('currentPower').innerText = (data.voltage * data.current).toFixed(2);
           
-          // Display success message
+          // Display success message, with the real negotiation time when the
+          // source confirmed the new contract
+          const contract = data.contract || {};
           document.getElementById('statusMessage').className = 'status-message success';
-          document.getElementById('statusMessage').innerText = 'Settings applied successfully';
+          document.getElementById('statusMessage').innerText = contract.established
+            ? 'Settings applied successfully (negotiated in ' + contract.negotiationMs + ' ms)'
+            : 'Settings applied; source did not confirm a new contract';
           
           // Show success notification using UIUtils
           UIUtils.showAlert('Success', 'USB PD settings applied successfully', 'success');
           
-          // Refresh PDO profiles to show the new active PDO
-          setTimeout(loadPDOProfiles, 1000);
+          // The job only finishes once negotiation has, so refresh right away
+          // unless the next api/events poll delivers the new profiles anyway
+          if (!liveUpdates) {
+            loadPDOProfiles();
+          }
           
           // Hide success message after 3 seconds
           setTimeout(function() {
@@ -359,7 +413,7 @@ document.addEventListener('DOMContentLoaded', function() {
           }
           
           // Refresh the current status
-          setTimeout(fetchCurrentConfig, 3000);
+          fetchCurrentConfig();
         }
         setFormEnabled(true);
         updateApplyButtonState(); // Re-check button state after re-enabling
@@ -374,8 +428,8 @@ document.addEventListener('DOMContentLoaded', function() {
         // Show error notification using UIUtils
         UIUtils.showAlert('Error', 'Failed to apply configuration', 'error');
         
-        // Refresh the current status after a delay
-        setTimeout(fetchCurrentConfig, 3000);
+        // Refresh the current status
+        fetchCurrentConfig();
       }
     });
   }
@@ -392,8 +446,7 @@ document.addEventListener('DOMContentLoaded', function() {
   const retryBtn = document.getElementById('retryBtn');
   if (retryBtn) {
     retryBtn.addEventListener('click', function() {
-      fetchCurrentConfig(); // Try to reconnect and get status
-      loadPDOProfiles();
+      refreshSnapshot(); // Try to reconnect and get status and profiles
     });
   }
   
@@ -406,6 +459,19 @@ document.addEventListener('DOMContentLoaded', function() {
   }
 });
 
+// Poll an asynchronous configure job until it succeeds, fails or times out
+async function waitForConfigJob(jobId, timeoutMs = 10000) {
+  const started = Date.now();
+  while (Date.now() - started < timeoutMs) {
+    const job = await AuthUtils.fetchJSON('api/configure/' + jobId);
+    if (job.state === 'succeeded' || job.state === 'failed' || job.error) {
+      return Object.assign({ message: job.error }, job);
+    }
+    await new Promise(resolve => setTimeout(resolve, 100));
+  }
+  return { success: false, message: 'Timed out waiting for configuration' };
+}
+
 function setFormEnabled(enabled) {
   document.getElementById('voltageSelect').disabled = !enabled;
   document.getElementById('currentSelect').disabled = !enabled;
@@ -423,49 +489,53 @@ function setFormEnabled(enabled) {
 // Load PDO profiles
 async function loadPDOProfiles() {
   try {
-    const data = await AuthUtils.fetchJSON('api/profiles');
-    const container = document.getElementById('pdoProfiles');
-    
-    if (data.error) {
-      container.innerHTML = '<div class="info-message">' + data.error + '</div>';
-      return;
-    }
-    
-    // Check if pdos array exists and is not empty
-    if (!data.pdos || !Array.isArray(data.pdos) || data.pdos.length === 0) {
-      container.innerHTML = '<div class="info-message">No PDO profiles available. Device may be disconnected.</div>';
-      return;
-    }
-    
-    let html = '';
-    
-    data.pdos.forEach(pdo => {
-      const cardClass = pdo.active ? 'pdo-card active' : (pdo.fixed ? 'pdo-card fixed' : 'pdo-card');
-      const badgeClass = pdo.active ? 'pdo-badge active' : (pdo.fixed ? 'pdo-badge fixed' : 'pdo-badge');
-      const badgeText = pdo.active ? 'ACTIVE' : (pdo.fixed ? 'FIXED' : 'CONFIGURED');
-      
-      html += `
-        <div class="${cardClass}">
-          <div class="pdo-header">
-            PDO${pdo.number}
-            <span class="${badgeClass}">${badgeText}</span>
-          </div>
-          <div class="pdo-details">
-            <div><strong>${pdo.voltage}V</strong> @ <strong>${pdo.current}A</strong></div>
-            <div>Max Power: <strong>${pdo.power.toFixed(1)}W</strong></div>
-            ${pdo.fixed ? '<div><em>Fixed 5V USB-C standard</em></div>' : ''}
-          </div>
-        </div>
-      `;
-    });
-    
-    container.innerHTML = html;
+    renderPDOProfiles(await fetchStateJSON('api/profiles'));
   } catch (error) {
     console.error('Error loading PDO profiles:', error);
     document.getElementById('pdoProfiles').innerHTML = 
       '<div class="error-message">Failed to load PDO profiles: ' + error.message + '</div>';
   }
 }
+
+// Show an api/profiles body (fetched or from a state event)
+function renderPDOProfiles(data) {
+  const container = document.getElementById('pdoProfiles');
+  
+  if (data.error) {
+    container.innerHTML = '<div class="info-message">' + data.error + '</div>';
+    return;
+  }
+  
+  // Check if pdos array exists and is not empty
+  if (!data.pdos || !Array.isArray(data.pdos) || data.pdos.length === 0) {
+    container.innerHTML = '<div class="info-message">No PDO profiles available. Device may be disconnected.</div>';
+    return;
+  }
+  
+  let html = '';
+  
+  data.pdos.forEach(pdo => {
+    const cardClass = pdo.active ? 'pdo-card active' : (pdo.fixed ? 'pdo-card fixed' : 'pdo-card');
+    const badgeClass = pdo.active ? 'pdo-badge active' : (pdo.fixed ? 'pdo-badge fixed' : 'pdo-badge');
+    const badgeText = pdo.active ? 'ACTIVE' : (pdo.fixed ? 'FIXED' : 'CONFIGURED');
+    
+    html += `
+      <div class="${cardClass}">
+        <div class="pdo-header">
+          PDO${pdo.number}
+          <span class="${badgeClass}">${badgeText}</span>
+        </div>
+        <div class="pdo-details">
+          <div><strong>${pdo.voltage}V</strong> @ <strong>${pdo.current}A</strong></div>
+          <div>Max Power: <strong>${pdo.power.toFixed(1)}W</strong></div>
+          ${pdo.fixed ? '<div><em>Fixed 5V USB-C standard</em></div>' : ''}
+        </div>
+      </div>
+    `;
+  });
+  
+  container.innerHTML = html;
+}
 )rawliteral";
 
 #endif // USB_PD_JS_H
\ No newline at end of file
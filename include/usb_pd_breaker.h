@@ -0,0 +1,92 @@
+#ifndef USB_PD_BREAKER_H
+#define USB_PD_BREAKER_H
+
+#include <atomic>
+#include <stdint.h>
+
+// Consecutive failed chip transactions that open the breaker (0 disables it)
+#ifndef USB_PD_BREAKER_FAILURES
+#define USB_PD_BREAKER_FAILURES 3
+#endif
+
+// Wait before the first trial once open; doubled after every failed trial
+#ifndef USB_PD_BREAKER_BACKOFF_MS
+#define USB_PD_BREAKER_BACKOFF_MS 1000UL
+#endif
+
+#ifndef USB_PD_BREAKER_MAX_BACKOFF_MS
+#define USB_PD_BREAKER_MAX_BACKOFF_MS 60000UL
+#endif
+
+enum class PdBreakerState : uint8_t {
+  Closed,  // Chip answering; transactions go to the bus
+  Open,    // Chip failing; transactions are refused until the backoff ends
+  HalfOpen // Backoff over; the next transaction is a trial
+};
+
+// Name used in JSON (closed/open/half_open)
+const char *pdBreakerStateName(PdBreakerState state);
+
+// Circuit breaker in front of the chip: opens after a run of failed
+// transactions, then lets one trial through per (doubling) backoff.
+// Transitions must be serialized by the caller; getters are lock-free.
+class PdCircuitBreaker {
+public:
+  PdCircuitBreaker() = default;
+
+  void configure(uint32_t failures, uint32_t backoffMs, uint32_t maxBackoffMs);
+
+  // Whether a transaction may go to the bus at nowMs. An Open breaker whose
+  // backoff has passed turns HalfOpen and lets it through; refusals are
+  // counted.
+  bool allow(uint32_t nowMs);
+
+  // Outcome of a transaction that went to the bus. A failure while Open,
+  // from work that bypasses the breaker, is counted but leaves the backoff
+  // alone.
+  void succeeded();
+  void failed(uint32_t nowMs);
+
+  // Open with the backoff still running, i.e. allow() would refuse
+  bool isOpen(uint32_t nowMs) const {
+    return state.load(std::memory_order_relaxed) == PdBreakerState::Open &&
+           (int32_t)(nowMs - retryAtMs.load(std::memory_order_relaxed)) < 0;
+  }
+
+  // Milliseconds until the next trial (0 unless open)
+  uint32_t msUntilRetry(uint32_t nowMs) const {
+    return isOpen(nowMs) ? retryAtMs.load(std::memory_order_relaxed) - nowMs
+                         : 0;
+  }
+
+  PdBreakerState getState() const {
+    return state.load(std::memory_order_relaxed);
+  }
+  uint32_t getTrips() const { return trips.load(std::memory_order_relaxed); }
+  uint32_t getRejected() const {
+    return rejected.load(std::memory_order_relaxed);
+  }
+  uint32_t getConsecutiveFailures() const {
+    return consecutiveFailures.load(std::memory_order_relaxed);
+  }
+  uint32_t getBackoffMs() const {
+    return backoffMs.load(std::memory_order_relaxed);
+  }
+  uint32_t getFailureThreshold() const { return failureThreshold; }
+  uint32_t getBaseBackoffMs() const { return baseBackoffMs; }
+  uint32_t getMaxBackoffMs() const { return maxBackoffMs; }
+
+private:
+  uint32_t failureThreshold = USB_PD_BREAKER_FAILURES;
+  uint32_t baseBackoffMs = USB_PD_BREAKER_BACKOFF_MS;
+  uint32_t maxBackoffMs = USB_PD_BREAKER_MAX_BACKOFF_MS;
+
+  std::atomic<PdBreakerState> state{PdBreakerState::Closed};
+  std::atomic<uint32_t> consecutiveFailures{0};
+  std::atomic<uint32_t> trips{0};    // Closed -> Open transitions
+  std::atomic<uint32_t> rejected{0}; // Transactions refused while open
+  std::atomic<uint32_t> backoffMs{0};
+  std::atomic<uint32_t> retryAtMs{0};
+};
+
+#endif // USB_PD_BREAKER_H
@@ -0,0 +1,219 @@
+#ifndef USB_PD_CAPABILITIES_H
+#define USB_PD_CAPABILITIES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Voltages and currents the controller offers (mV/mA); the single source
+// for the capability routes, configure validation and the web UI
+struct PdVoltageCapability {
+  uint32_t millivolts;
+  uint32_t maxMilliamps; // Highest current offered at this voltage
+};
+
+constexpr PdVoltageCapability USB_PD_VOLTAGE_CAPABILITIES[] = {
+    {5000, 3000},  // USB-C can do 5V@3A
+    {9000, 2250},  // Common 9V profile is 2.25A (20W)
+    {12000, 1670}, // Common 12V profile is 1.67A (20W)
+    {15000, 1330}, // 15V@1.33A = 20W
+    {20000, 1000}, // 20V@1A = 20W
+};
+
+constexpr uint32_t USB_PD_CURRENT_CAPABILITIES[] = {
+    500, 1000, 1330, 1500, 1670, 2000, 2250, 2500, 3000};
+
+constexpr size_t USB_PD_VOLTAGE_COUNT = sizeof(USB_PD_VOLTAGE_CAPABILITIES) /
+                                        sizeof(USB_PD_VOLTAGE_CAPABILITIES[0]);
+constexpr size_t USB_PD_CURRENT_COUNT = sizeof(USB_PD_CURRENT_CAPABILITIES) /
+                                        sizeof(USB_PD_CURRENT_CAPABILITIES[0]);
+
+namespace usb_pd_caps {
+
+constexpr uint32_t minVoltage() {
+  uint32_t v = USB_PD_VOLTAGE_CAPABILITIES[0].millivolts;
+  for (const PdVoltageCapability &cap : USB_PD_VOLTAGE_CAPABILITIES) {
+    v = cap.millivolts < v ? cap.millivolts : v;
+  }
+  return v;
+}
+
+constexpr uint32_t maxVoltage() {
+  uint32_t v = 0;
+  for (const PdVoltageCapability &cap : USB_PD_VOLTAGE_CAPABILITIES) {
+    v = cap.millivolts > v ? cap.millivolts : v;
+  }
+  return v;
+}
+
+constexpr uint32_t minCurrent() {
+  uint32_t c = USB_PD_CURRENT_CAPABILITIES[0];
+  for (uint32_t ma : USB_PD_CURRENT_CAPABILITIES) {
+    c = ma < c ? ma : c;
+  }
+  return c;
+}
+
+constexpr uint32_t maxCurrent() {
+  uint32_t c = 0;
+  for (uint32_t ma : USB_PD_CURRENT_CAPABILITIES) {
+    c = ma > c ? ma : c;
+  }
+  return c;
+}
+
+// Fixed-size text built by a constexpr function; N includes the '\0'
+template <size_t N> struct StaticText {
+  char text[N] = {};
+  static constexpr size_t length = N - 1;
+};
+
+// Appends text, or only counts it when out is null
+struct TextBuilder {
+  char *out;
+  size_t pos;
+
+  constexpr void put(char c) {
+    if (out) {
+      out[pos] = c;
+    }
+    ++pos;
+  }
+
+  constexpr void put(const char *s) {
+    while (*s) {
+      put(*s++);
+    }
+  }
+
+  constexpr void number(uint32_t v) {
+    char digits[10] = {};
+    size_t n = 0;
+    do {
+      digits[n++] = (char)('0' + v % 10);
+      v /= 10;
+    } while (v > 0);
+    while (n > 0) {
+      put(digits[--n]);
+    }
+  }
+
+  // Thousandths as a JSON number without trailing zeros: 1330 -> 1.33
+  constexpr void milli(uint32_t v) {
+    number(v / 1000);
+    uint32_t frac = v % 1000;
+    if (frac == 0) {
+      return;
+    }
+    put('.');
+    for (uint32_t digit = 100; frac > 0; digit /= 10) {
+      put((char)('0' + frac / digit));
+      frac %= digit;
+    }
+  }
+};
+
+// {"voltages":[5,9,...]}
+constexpr size_t voltagesJson(char *out) {
+  TextBuilder b{out, 0};
+  b.put("{\"voltages\":[");
+  for (size_t i = 0; i < USB_PD_VOLTAGE_COUNT; ++i) {
+    if (i > 0) {
+      b.put(',');
+    }
+    b.milli(USB_PD_VOLTAGE_CAPABILITIES[i].millivolts);
+  }
+  b.put("]}");
+  return b.pos;
+}
+
+// {"currents":[0.5,1,...]}
+constexpr size_t currentsJson(char *out) {
+  TextBuilder b{out, 0};
+  b.put("{\"currents\":[");
+  for (size_t i = 0; i < USB_PD_CURRENT_COUNT; ++i) {
+    if (i > 0) {
+      b.put(',');
+    }
+    b.milli(USB_PD_CURRENT_CAPABILITIES[i]);
+  }
+  b.put("]}");
+  return b.pos;
+}
+
+// {"voltages":[{"voltage":5,"maxCurrent":3},...],"currents":[...]}
+constexpr size_t capabilitiesJson(char *out) {
+  TextBuilder b{out, 0};
+  b.put("{\"voltages\":[");
+  for (size_t i = 0; i < USB_PD_VOLTAGE_COUNT; ++i) {
+    if (i > 0) {
+      b.put(',');
+    }
+    b.put("{\"voltage\":");
+    b.milli(USB_PD_VOLTAGE_CAPABILITIES[i].millivolts);
+    b.put(",\"maxCurrent\":");
+    b.milli(USB_PD_VOLTAGE_CAPABILITIES[i].maxMilliamps);
+    b.put('}');
+  }
+  b.put("],\"currents\":[");
+  for (size_t i = 0; i < USB_PD_CURRENT_COUNT; ++i) {
+    if (i > 0) {
+      b.put(',');
+    }
+    b.milli(USB_PD_CURRENT_CAPABILITIES[i]);
+  }
+  b.put("]}");
+  return b.pos;
+}
+
+template <size_t (*Render)(char *)>
+constexpr StaticText<Render(nullptr) + 1> renderText() {
+  StaticText<Render(nullptr) + 1> t;
+  Render(t.text);
+  return t;
+}
+
+// Strong validator for a body: quoted FNV-1a hash, e.g. "\"1a2b3c4d\""
+constexpr uint32_t fnv1a(const char *s) {
+  uint32_t hash = 2166136261u;
+  while (*s) {
+    hash = (hash ^ (uint8_t)*s++) * 16777619u;
+  }
+  return hash;
+}
+
+constexpr StaticText<11> etagFor(const char *body) {
+  StaticText<11> t;
+  uint32_t hash = fnv1a(body);
+  t.text[0] = '"';
+  for (int i = 0; i < 8; ++i) {
+    uint32_t nibble = (hash >> (28 - 4 * i)) & 0xF;
+    t.text[1 + i] = (char)(nibble < 10 ? '0' + nibble : 'a' + nibble - 10);
+  }
+  t.text[9] = '"';
+  return t;
+}
+
+} // namespace usb_pd_caps
+
+// Bodies and validators, generated by the compiler into read-only data
+// (flash on ESP32)
+inline constexpr auto USB_PD_VOLTAGES_JSON =
+    usb_pd_caps::renderText<usb_pd_caps::voltagesJson>();
+inline constexpr auto USB_PD_CURRENTS_JSON =
+    usb_pd_caps::renderText<usb_pd_caps::currentsJson>();
+inline constexpr auto USB_PD_CAPABILITIES_JSON =
+    usb_pd_caps::renderText<usb_pd_caps::capabilitiesJson>();
+inline constexpr auto USB_PD_VOLTAGES_ETAG =
+    usb_pd_caps::etagFor(USB_PD_VOLTAGES_JSON.text);
+inline constexpr auto USB_PD_CURRENTS_ETAG =
+    usb_pd_caps::etagFor(USB_PD_CURRENTS_JSON.text);
+inline constexpr auto USB_PD_CAPABILITIES_ETAG =
+    usb_pd_caps::etagFor(USB_PD_CAPABILITIES_JSON.text);
+
+// Static capability bodies may be cached this long; the ETag revalidates
+// them after a firmware update
+#ifndef USB_PD_CAPABILITIES_CACHE_CONTROL
+#define USB_PD_CAPABILITIES_CACHE_CONTROL "public, max-age=86400"
+#endif
+
+#endif // USB_PD_CAPABILITIES_H
@@ -2,6 +2,58 @@
 #define USB_PD_CHIP_H
 
 #include <stdint.h>
+#include <string.h>
+
+// How a configuration is applied to the chip
+enum class PdWriteMode : uint8_t {
+  Persistent, // Commit to NVM (survives power cycles, slow, wears NVM)
+  Volatile    // Runtime registers only; lost on power cycle
+};
+
+// Power Delivery contract state as reported by the device
+enum class PdContractState : uint8_t {
+  Unknown,     // Status could not be read
+  Detached,    // No source attached
+  Negotiating, // Attached, no explicit contract (yet)
+  Ready        // Explicit contract in place
+};
+
+struct PdContract {
+  PdContractState state = PdContractState::Unknown;
+  int pdoNumber = 0; // Sink PDO the source accepted (valid when Ready)
+  uint32_t rdo = 0;  // Raw request data object, 0 if the chip has none
+};
+
+// All three sink PDOs and the active PDO number, moved in one call by
+// IUsbPdChip::readPdoSet()/writePdoSet(). Indexed 1..3 to match the
+// per-field API (index 0 unused).
+struct PdoSet {
+  int activePdo = 0;
+  float voltage[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  float current[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+};
+
+// Longest register image a chip reads back for IUsbPdChip::readRegisterImage()
+#ifndef USB_PD_REGISTER_IMAGE_LEN
+#define USB_PD_REGISTER_IMAGE_LEN 40
+#endif
+
+// Raw bytes of a fixed set of device registers. While nothing is written
+// they read back the same at every bus clock the device can keep up with.
+struct PdRegisterImage {
+  uint8_t length = 0;
+  uint8_t bytes[USB_PD_REGISTER_IMAGE_LEN] = {};
+};
+
+inline bool operator==(const PdoSet &a, const PdoSet &b) {
+  return a.activePdo == b.activePdo &&
+         memcmp(a.voltage, b.voltage, sizeof(a.voltage)) == 0 &&
+         memcmp(a.current, b.current, sizeof(a.current)) == 0;
+}
+
+inline bool operator==(const PdRegisterImage &a, const PdRegisterImage &b) {
+  return a.length == b.length && memcmp(a.bytes, b.bytes, a.length) == 0;
+}
 
 // Minimal abstraction for a USB-PD controller chip (e.g., STUSB4500)
 // This allows native tests to use a fake implementation while ESP32 uses
@@ -10,6 +62,15 @@ class IUsbPdChip {
 public:
   virtual ~IUsbPdChip() = default;
 
+  // Select the I2C bus (controller index) the device sits on; false if the
+  // platform has no such bus. Called before probe().
+  virtual bool selectBus(uint8_t bus) { return bus == 0; }
+
+  // Bus arbiter client the device's own grants are booked to: the
+  // controller's client for this port, set after selectBus(). Chips that do
+  // not take grants ignore it.
+  virtual void setI2cClient(int client) { (void)client; }
+
   // Probe for device presence on the I2C bus at the given address
   virtual bool probe(uint8_t i2cAddress) = 0;
 
@@ -29,9 +90,66 @@ public:
   virtual void setCurrent(int pdoIndex, float amps) = 0;
   virtual void setPdoNumber(int pdoIndex) = 0;
 
+  // Bulk equivalent of read() followed by every getter; false if the device
+  // could not be read
+  virtual bool readPdoSet(PdoSet &out) {
+    read();
+    out.activePdo = getPdoNumber();
+    for (int i = 1; i <= 3; ++i) {
+      out.voltage[i] = getVoltage(i);
+      out.current[i] = getCurrent(i);
+    }
+    return true;
+  }
+
+  // Bulk equivalent of every setter; commit with write() or writeVolatile()
+  virtual void writePdoSet(const PdoSet &set) {
+    setPdoNumber(set.activePdo);
+    for (int i = 1; i <= 3; ++i) {
+      setVoltage(i, set.voltage[i]);
+      setCurrent(i, set.current[i]);
+    }
+  }
+
   // Persist configuration and apply immediately
   virtual void write() = 0;
   virtual void softReset() = 0;
+
+  // Apply the configured PDOs to the runtime registers only, without an NVM
+  // commit; softReset() then renegotiates with them
+  virtual void writeVolatile() = 0;
+
+  // Read the negotiated contract straight from the device status registers
+  virtual PdContract readContract() = 0;
+
+  // Drive the ALERT line on source attach/detach; false if unsupported
+  virtual bool enableAttachAlert() { return false; }
+
+  // Acknowledge pending alerts so the ALERT line is released
+  virtual void clearAlerts() {}
+
+  // Run the device's I2C bus at hz; false if the platform cannot. Applies
+  // to every device on that bus.
+  virtual bool setBusClock(uint32_t hz) {
+    (void)hz;
+    return false;
+  }
+
+  // Read the register image straight from the device, never from a cache,
+  // to check the bus delivers it intact; false if the device did not answer
+  // or the chip cannot (the bus then stays at its slowest clock)
+  virtual bool readRegisterImage(PdRegisterImage &out) {
+    (void)out;
+    return false;
+  }
+
+  // Free a bus a device holds SDA low on and restart it on sda/scl; false
+  // if SDA is still low or the platform cannot
+  virtual bool recoverBus(int sda, int scl) {
+    (void)sda;
+    (void)scl;
+    return false;
+  }
 };
 
 #endif // USB_PD_CHIP_H
@@ -0,0 +1,79 @@
+#ifndef USB_PD_CONFIG_JOB_H
+#define USB_PD_CONFIG_JOB_H
+
+#include <stdint.h>
+#include <usb_pd_core.h>
+
+// Lifecycle of an asynchronous /api/configure request
+enum class PdConfigJobState : uint8_t {
+  Empty, // Slot never used
+  Pending,
+  Running,
+  Succeeded,
+  Failed
+};
+
+inline const char *pdConfigJobStateName(PdConfigJobState state) {
+  switch (state) {
+  case PdConfigJobState::Pending:
+    return "pending";
+  case PdConfigJobState::Running:
+    return "running";
+  case PdConfigJobState::Succeeded:
+    return "succeeded";
+  case PdConfigJobState::Failed:
+    return "failed";
+  default:
+    return "unknown";
+  }
+}
+
+// What a job does to its port
+enum class PdConfigJobKind : uint8_t {
+  Configure, // Apply voltage and current through the PDO strategy
+  Recover,   // Unstick the I2C bus and reinitialize the chip
+  Restore    // Write back the PDOs the chip lost in a brown-out
+};
+
+inline const char *pdConfigJobKindName(PdConfigJobKind kind) {
+  switch (kind) {
+  case PdConfigJobKind::Recover:
+    return "recover";
+  case PdConfigJobKind::Restore:
+    return "restore";
+  default:
+    return "configure";
+  }
+}
+
+// A queued or recently finished configure, addressable by id
+struct PdConfigJob {
+  uint32_t id = 0;
+  PdConfigJobState state = PdConfigJobState::Empty;
+  PdConfigJobKind kind = PdConfigJobKind::Configure;
+
+  // Requested values
+  float voltage = 0.0f;
+  float current = 0.0f;
+  PdWriteMode mode = PdWriteMode::Persistent;
+  uint8_t port = 0; // Controller port it configures
+  PdoSet pdos;      // Restore: the PDOs to write back
+
+  // Values read back after the configure (valid when Succeeded)
+  float resultVoltage = 0.0f;
+  float resultCurrent = 0.0f;
+  PdNegotiation negotiation;
+
+  uint32_t submittedMs = 0;
+  uint32_t startedMs = 0;
+  uint32_t finishedMs = 0;
+
+  const char *error = nullptr; // Static string, set when Failed
+
+  bool isFinished() const {
+    return state == PdConfigJobState::Succeeded ||
+           state == PdConfigJobState::Failed;
+  }
+};
+
+#endif // USB_PD_CONFIG_JOB_H
@@ -10,8 +10,26 @@
 #include <interface/openapi_types.h>
 #include <interface/utils/route_variant.h>
 #include <interface/web_module_interface.h>
+#include <usb_pd_breaker.h>
+#include <usb_pd_capabilities.h>
 #include <usb_pd_chip.h>
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <usb_pd_config_job.h>
 #include <usb_pd_core.h>
+#include <usb_pd_etag.h>
+#include <usb_pd_i2c_bus.h>
+#include <usb_pd_metrics.h>
+#include <usb_pd_poll_scheduler.h>
+#include <usb_pd_poller.h>
+#include <usb_pd_rendered_body.h>
+#include <usb_pd_snapshot.h>
+#include <usb_pd_series.h>
+#include <usb_pd_telemetry.h>
+#include <usb_pd_trace.h>
 #include <utility>
 #include <web_platform_interface.h>
 #include "version_autogen.h"
@@ -24,10 +42,212 @@
 // DEFAULT macro conflict handling not needed now that SparkFun headers are
 // isolated behind an adapter
 
-class USBPDController : public IWebModule {
+// Background sampling interval (0 disables the poller task and falls back to
+// sampling from handle()). Native builds default to 0 so tests stay
+// single-threaded unless they opt in.
+#ifndef USB_PD_POLL_INTERVAL_MS
+#if defined(ARDUINO) || defined(ESP_PLATFORM)
+#define USB_PD_POLL_INTERVAL_MS 1000UL
+#else
+#define USB_PD_POLL_INTERVAL_MS 0UL
+#endif
+#endif
+
+// Sampling ceiling when handle() samples itself (no poller); tests override
+#ifndef USB_PD_HANDLE_INTERVAL_MS
+#define USB_PD_HANDLE_INTERVAL_MS 30000UL
+#endif
+
+// Safety-net poll interval once attach/detach is reported through the ALERT
+// pin (used unless pollIntervalMs is configured explicitly)
+#ifndef USB_PD_ALERT_POLL_INTERVAL_MS
+#define USB_PD_ALERT_POLL_INTERVAL_MS 30000UL
+#endif
+
+// Quiet period after a volatile configure before it is committed to NVM
+// (0 keeps volatile configurations out of NVM until asked otherwise)
+#ifndef USB_PD_NVM_COMMIT_DELAY_MS
+#define USB_PD_NVM_COMMIT_DELAY_MS 0UL
+#endif
+
+// Queued plus recently finished configure jobs kept for /api/configure/{id}
+#ifndef USB_PD_CONFIG_JOB_HISTORY
+#define USB_PD_CONFIG_JOB_HISTORY 4
+#endif
+
+// Most STUSB4500 ports one controller manages: four addresses (0x28-0x2B) on
+// each of two I2C buses
+#ifndef USB_PD_MAX_PORTS
+#define USB_PD_MAX_PORTS 8
+#endif
+
+// I2C clock used unless i2cClockHz says otherwise. USB_PD_I2C_CLOCK_AUTO
+// starts at 100 kHz and steps up while the chip reads back intact.
+#define USB_PD_I2C_CLOCK_AUTO 0UL
+#ifndef USB_PD_I2C_CLOCK_HZ
+#define USB_PD_I2C_CLOCK_HZ 100000UL
+#endif
+
+// Register image reads that must match at a clock before auto mode keeps it
+#ifndef USB_PD_I2C_CLOCK_CHECKS
+#define USB_PD_I2C_CLOCK_CHECKS 4
+#endif
+
+// Consecutive failed chip transactions after which the bus is treated as
+// stuck and recovered (0 disables recovery); retried every as many failures
+#ifndef USB_PD_I2C_RECOVERY_FAILURES
+#define USB_PD_I2C_RECOVERY_FAILURES 3
+#endif
+
+// Room for the pre-rendered /api/status body
+#ifndef USB_PD_STATUS_JSON_LEN
+#define USB_PD_STATUS_JSON_LEN 128
+#endif
+
+// Window /api/history covers when no "from" is given
+#ifndef USB_PD_HISTORY_DEFAULT_WINDOW_MS
+#define USB_PD_HISTORY_DEFAULT_WINDOW_MS 3600000UL
+#endif
+
+// Room for one /api/events body: both state bodies plus the state id
+#define USB_PD_EVENT_FRAME_LEN                                                 \
+  (USB_PD_STATUS_JSON_LEN + USB_PD_PROFILES_JSON_LEN + 96)
+
+// Room for the /api/snapshot body: both state bodies, the capability
+// table and the version
+#define USB_PD_SNAPSHOT_JSON_LEN                                               \
+  (USB_PD_STATUS_JSON_LEN + USB_PD_PROFILES_JSON_LEN +                         \
+   USB_PD_CAPABILITIES_JSON.length + 80)
+
+// Room for a port's board type, terminator included
+#ifndef USB_PD_BOARD_TYPE_LEN
+#define USB_PD_BOARD_TYPE_LEN 16
+#endif
+
+// How a port is wired and sampled; set from config before begin()
+struct PdPortSettings {
+  // I2C configuration; bus selects Wire (0) or Wire1 (1)
+  uint8_t i2cAddress = 0x28;
+  uint8_t i2cBus = 0;
+  int sdaPin = 4;
+  int sclPin = 5;
+  uint32_t i2cBudgetUs = 0; // Bus time per second for periodic samples
+  uint32_t i2cClockHz = USB_PD_I2C_CLOCK_HZ; // As configured
+  uint32_t i2cRecoveryFailures = USB_PD_I2C_RECOVERY_FAILURES;
+  char boardType[USB_PD_BOARD_TYPE_LEN] = "sparkfun";
+
+  // STUSB4500 ALERT line (-1 = not wired, attach/detach found by polling)
+  int alertPin = -1;
+
+  // Adaptive sampling; pollIntervalMs is the ceiling
+  uint32_t pollIntervalMs = USB_PD_POLL_INTERVAL_MS;
+  uint32_t pollFastMs = USB_PD_POLL_FAST_MS;
+  uint32_t pollBurstMs = USB_PD_POLL_BURST_MS;
+
+  // Quiet time before volatile configures are committed to NVM
+  uint32_t nvmCommitDelayMs = USB_PD_NVM_COMMIT_DELAY_MS;
+};
+
+// Counters a port only reports (diagnostics and /metrics)
+struct PdPortStats {
+  uint32_t i2cReadUs = 0;
+  uint32_t i2cClockFallbacks = 0; // Auto steps whose read-back failed
+  uint32_t i2cRecoveryAttempts = 0;
+  uint32_t i2cRecoveries = 0;
+  uint32_t lastRecoveryMs = 0;
+  uint32_t totalRecoveryMs = 0;
+  uint32_t alertsServiced = 0;
+  uint32_t volatileApplies = 0;
+  uint32_t deferredCommits = 0;
+
+  uint32_t nvmWritesAvoided() const {
+    return volatileApplies - deferredCommits;
+  }
+  uint32_t meanRecoveryMs() const {
+    return i2cRecoveries ? totalRecoveryMs / i2cRecoveries : 0;
+  }
+};
+
+// One USB-C port of a controller; chip state is guarded by chipMutex, hot
+// sample state first
+template <typename Chip> struct BasicUSBPDPort {
+  // Port on a chip owned elsewhere (port 0), or on one it owns (extra ports)
+  explicit BasicUSBPDPort(Chip &chip,
+                          const PdChipMetrics *chipMetrics = nullptr)
+      : chip(chip), core(chip), chipMetrics(chipMetrics) {
+    core.setClock([]() -> uint32_t { return millis(); },
+                  [](uint32_t ms) { delay(ms); });
+  }
+  BasicUSBPDPort(std::unique_ptr<Chip> owned, const PdChipMetrics *chipMetrics)
+      : BasicUSBPDPort(*owned, chipMetrics) {
+    ownedChip = std::move(owned);
+  }
+
+  std::unique_ptr<Chip> ownedChip; // Declared first: destroyed after core
+  Chip &chip;
+  BasicUSBPDCore<Chip> core;
+  size_t index = 0; // Port number in the controller
+
+  // Serializes chip access between the poller task and request handlers
+  mutable std::recursive_mutex chipMutex;
+  PdCircuitBreaker breaker; // Transitions under chipMutex
+  PdPollScheduler pollSchedule; // Guarded by chipMutex
+  PdSnapshotStore snapshotStore;
+  uint32_t lastPublishMs = 0;
+  std::atomic<bool> alertPending{false};
+
+  // Version of the published state (see getStateVersion()); a configure
+  // bumps it even when the sample after it reads the same values
+  std::atomic<uint32_t> stateVersion{1};
+  bool configureRan = false;
+
+  // Set while a configure job is between its first and last step on this
+  // port, so sampling does not reload the register image under it
+  std::atomic<bool> configuring{false};
+  std::atomic<bool> recoveryQueued{false}; // A Recover job is pending
+
+  // Last values read back
+  float currentVoltage = 0.0f;
+  float currentCurrent = 0.0f;
+  bool pdBoardConnected = false;
+
+  // Bus arbiter and the clock begin() applied
+  PdI2cBus *i2cArbiter = nullptr;
+  int i2cClient = -1;
+  uint32_t i2cClockSetHz = 0;
+  uint32_t failingSinceMs = 0; // First failure of the current run
+
+  // Volatile configures awaiting a deferred NVM commit
+  bool nvmCommitPending = false;
+  unsigned long lastVolatileApplyMs = 0;
+  float volatileVoltage = 0.0f;
+  float volatileCurrent = 0.0f;
+
+  // PDOs read back after the last configure, put back after a brown-out
+  PdoSet appliedSet;
+  PdWriteMode appliedMode = PdWriteMode::Persistent;
+  bool applied = false;
+
+  PdPortSettings settings;
+  PdPortStats stats;
+
+  // /metrics sources: bus timings (owned by the instrumented chip, if any)
+  // and negotiations
+  const PdChipMetrics *chipMetrics = nullptr;
+  PdNegotiationMetrics negotiationMetrics;
+};
+
+// Web module driving one or more USB-PD sink chips (Chip bound at compile
+// time; only USBPDController is compiled)
+template <typename Chip> class BasicUSBPDController : public IWebModule {
 public:
-  // Initialize the PD controller with a chip implementation
-  explicit USBPDController(IUsbPdChip &chip);
+  using Port = BasicUSBPDPort<Chip>;
+
+  // Initialize the PD controller with a chip implementation. chipMetrics
+  // are the bus timings /metrics exports for it, when the chip sits on an
+  // InstrumentedUsbPdChip (hardware builds do this for their STUSB4500s).
+  explicit BasicUSBPDController(Chip &chip,
+                                const PdChipMetrics *chipMetrics = nullptr);
 
   // Module lifecycle methods (IWebModule interface)
   void begin() override;
@@ -46,33 +266,263 @@ public:
   // Check if PD board is connected
   bool isPDBoardConnected();
 
-  // Read current PD configuration
-  bool readPDConfig();
+  // Read current PD configuration of a port
+  bool readPDConfig(size_t port = 0);
 
-  // Set new PD configuration
-  bool setPDConfig(float voltage, float current);
+  // Set new PD configuration (blocking; HTTP requests use submitPDConfig)
+  bool setPDConfig(float voltage, float current,
+                   PdWriteMode mode = PdWriteMode::Persistent,
+                   size_t port = 0);
 
-  // Get all PDO profiles as JSON string
+  // Queue a configuration that handle() applies one bus step per call. One
+  // queue serves every port. Returns the job id, or 0 when the queue is full
+  // or there is no such port.
+  uint32_t submitPDConfig(float voltage, float current,
+                          PdWriteMode mode = PdWriteMode::Persistent,
+                          size_t port = 0);
+
+  // Copy out a queued or recently finished job; false if unknown or evicted
+  bool getConfigJob(uint32_t id, PdConfigJob &out) const;
+
+  // Invoked from handle() whenever a configure job finishes
+  using ConfigJobCallback = std::function<void(const PdConfigJob &)>;
+  void setConfigJobCallback(ConfigJobCallback callback) {
+    configJobCallback = std::move(callback);
+  }
+
+  // Multi-port mode: creates the chip for each extra entry of the "ports"
+  // config (port 0 is this controller's own chip). Set before begin(config);
+  // hardware builds default to an STUSB4500 behind a register shadow.
+  using PortChipFactory = std::function<std::unique_ptr<Chip>(size_t port)>;
+  void setPortChipFactory(PortChipFactory factory) {
+    portChipFactory = std::move(factory);
+    defaultPortChips = false;
+  }
+
+  // Bus timings /metrics exports for a port (see the constructor), e.g. for
+  // ports built by a custom factory
+  void setChipMetrics(const PdChipMetrics *metrics, size_t port = 0);
+
+  // Arbiter of the bus a port's chip sits on, held for every chip
+  // transaction
+  void setI2cBus(PdI2cBus *bus, size_t port = 0);
+  PdI2cBus *getI2cArbiter() const { return mainPort.i2cArbiter; }
+
+  // Bus clock begin() applies: 100000, 400000, 1000000, or
+  // USB_PD_I2C_CLOCK_AUTO for the fastest of those the chip reads back
+  // intact at (the i2cClockHz setting)
+  void setI2cClockHz(uint32_t hz) { mainPort.settings.i2cClockHz = hz; }
+
+  // Consecutive failures that trigger bus recovery (the i2cRecoveryFailures
+  // setting; 0 disables it)
+  void setI2cRecoveryFailures(uint32_t failures) {
+    mainPort.settings.i2cRecoveryFailures = failures;
+  }
+
+  // Ports managed by this controller (1 unless "ports" is configured)
+  size_t getPortCount() const { return 1 + extraPortCount; }
+
+  // Port n (0 is this controller's own chip); nullptr when out of range
+  const Port *getPort(size_t n) const;
+
+  // Get all PDO profiles as JSON string (served from the latest snapshot)
   String getAllPDOProfiles();
 
+  // Probe and read a port's chip once and publish a fresh snapshot. This is
+  // what the background poller runs; handle() calls it when no poller is
+  // active.
+  void sampleNow(size_t port = 0);
+
+  // Latest published chip state; never touches the bus
+  PdSnapshot getSnapshot() const { return mainPort.snapshotStore.read(); }
+
+  // Bumped whenever what /api/status or /api/profiles report changes:
+  // connect, disconnect, a configure, or a different PDO set. Samples that
+  // find nothing new leave it alone.
+  uint32_t getStateVersion() const {
+    return mainPort.stateVersion.load(std::memory_order_acquire);
+  }
+
+  // ETag those routes carry for the current state version (at most
+  // USB_PD_STATE_ETAG_LEN with the '\0'); returns its length
+  size_t getStateEtag(char *buf, size_t len) const;
+
+  // What /api/events sends a client that last saw state since ("" for a new
+  // one): the current state id alone, the change since that version, or the
+  // full state. Rendered once per state change; each client gets a copy.
+  String getEventFrame(const char *since) const;
+
+  // Port 0 history of tier in [fromMs, toMs], oldest first; returns the
+  // points in the window, which may exceed maxPoints
+  size_t queryHistory(PdTelemetryTier tier, uint32_t fromMs, uint32_t toMs,
+                      PdTelemetryPoint *out, size_t maxPoints) const;
+
+  // Tier /api/history answers from when no resolution is asked for
+  PdTelemetryTier pickHistoryTier(uint32_t fromMs, uint32_t toMs) const;
+
+  // Append sealed 1 s series blocks to log from handle(); begin()s the log,
+  // which must outlive the controller
+  void attachHistoryLog(PdSeriesLog &log);
+
+  // Per-second means of this boot in [fromMs, toMs], oldest first: what
+  // only the log still holds, then RAM. Returns how many fn was called
+  // with.
+  template <typename Fn>
+  size_t forEachHistorySecond(uint32_t fromMs, uint32_t toMs, Fn fn) {
+    size_t n = 0;
+    uint32_t ramFrom = fromMs;
+    bool inRam;
+    {
+      std::lock_guard<std::mutex> lock(telemetryMutex);
+      inRam = series.oldestMs(ramFrom);
+    }
+    if (historyLog && (!inRam || (int32_t)(ramFrom - fromMs) > 0)) {
+      std::lock_guard<std::mutex> lock(historyLogMutex);
+      PdSeriesBlock scratch;
+      uint32_t logTo =
+          inRam && (int32_t)(toMs - ramFrom) >= 0 ? ramFrom - 1 : toMs;
+      n += historyLog->forEachSample(historyLog->bootId(), fromMs, logTo,
+                                     scratch, fn);
+    }
+    std::lock_guard<std::mutex> lock(telemetryMutex);
+    return n + series.forEachSample(fromMs, toMs, fn);
+  }
+
+  // Wraps a route handler so /metrics reports its latency and errors per
+  // route (a literal) and method; a span too with USB_PD_TRACE
+  template <typename Fn>
+  auto instrumentRoute(const char *route, Fn handler,
+                       WebModule::Method method = WebModule::WM_GET) {
+    if (!routeMetrics) {
+      routeMetrics.reset(new PdRouteMetrics());
+    }
+    PdRouteMetrics::Slot *slot =
+        routeMetrics->slot(route, httpMethodName(method));
+    return [slot, handler](RequestT &req, ResponseT &res) {
+      uint32_t start = micros();
+      handler(req, res);
+      uint32_t end = micros();
+      if (slot) {
+        slot->record(end - start, res.getStatus());
+        USB_PD_TRACE_RECORD(slot->route, start, end);
+      }
+    };
+  }
+
+  // Soft reset to contract of every configure port 0 completed
+  const PdNegotiationMetrics &getNegotiationMetrics() const {
+    return mainPort.negotiationMetrics;
+  }
+
+  // Milliseconds until handle() next has work (a due sample, a queued job,
+  // a pending NVM commit), so the host loop can sleep tick-less
+  uint32_t nextWakeMs() const;
+
+  // Called from the ALERT pin interrupt; handle() samples on its next call.
+  // Only sets a flag, so it is safe from ISR context.
+  void notifyAlert() {
+    mainPort.alertPending.store(true, std::memory_order_relaxed);
+  }
+
   // RequestT/ResponseT are provided by <interface/request_response_types.h>
 
-  // Route handler methods (unified signatures)
+  // Route handler methods (unified signatures); the /api/... ones answer for
+  // port 0
+  using RouteHandler = void (BasicUSBPDController::*)(RequestT &, ResponseT &);
   void mainPageHandler(RequestT &req, ResponseT &res);
   void pdStatusHandler(RequestT &req, ResponseT &res);
   void availableVoltagesHandler(RequestT &req, ResponseT &res);
   void availableCurrentsHandler(RequestT &req, ResponseT &res);
+  void capabilitiesHandler(RequestT &req, ResponseT &res);
   void pdoProfilesHandler(RequestT &req, ResponseT &res);
+  void eventsHandler(RequestT &req, ResponseT &res);
+  void snapshotHandler(RequestT &req, ResponseT &res);
+  void historyHandler(RequestT &req, ResponseT &res);
   void setPDConfigHandler(RequestT &req, ResponseT &res);
+  void configJobStatusHandler(RequestT &req, ResponseT &res);
+  void diagnosticsHandler(RequestT &req, ResponseT &res);
+  void portsHandler(RequestT &req, ResponseT &res);
+  void metricsHandler(RequestT &req, ResponseT &res);
+#if USB_PD_TRACE
+  void traceHandler(RequestT &req, ResponseT &res);
+#endif
+
+  // The same for any port. Port 0 answers from the bodies rendered at
+  // publish; extra ports render theirs per request from their snapshot.
+  void statusResponse(Port &port, RequestT &req, ResponseT &res);
+  void profilesResponse(Port &port, RequestT &req, ResponseT &res);
+  void snapshotResponse(Port &port, RequestT &req, ResponseT &res);
+  void eventsResponse(Port &port, RequestT &req, ResponseT &res);
+  void configureResponse(Port &port, RequestT &req, ResponseT &res);
+  void configJobStatusResponse(Port &port, RequestT &req, ResponseT &res);
+  void diagnosticsResponse(Port &port, RequestT &req, ResponseT &res);
 
-  // Lightweight accessors for testing and diagnostics
-  float getCurrentVoltage() const { return currentVoltage; }
-  float getCurrentCurrent() const { return currentCurrent; }
-  bool isPdBoardConnected() const { return pdBoardConnected; }
-  int getSdaPin() const { return sdaPin; }
-  int getSclPin() const { return sclPin; }
-  const String &getBoardType() const { return boardType; }
-  uint8_t getI2cAddress() const { return i2cAddress; }
+  // Writes the status of job id to res (404 if unknown, or if it configures
+  // another port than port)
+  void configJobResponse(uint32_t id, ResponseT &res, size_t port = 0);
+
+  // Runs handler on port n for the /api/ports/{port}/... routes (404 if
+  // there is no such port)
+  using PortHandler = void (BasicUSBPDController::*)(Port &, RequestT &,
+                                                     ResponseT &);
+  void portResponse(long port, PortHandler handler, RequestT &req,
+                    ResponseT &res);
+
+  // Lightweight accessors for testing and diagnostics (port 0; getPort()
+  // has the others)
+  float getCurrentVoltage() const { return mainPort.currentVoltage; }
+  float getCurrentCurrent() const { return mainPort.currentCurrent; }
+  const PdNegotiation &getLastNegotiation() const {
+    return mainPort.core.negotiation();
+  }
+  bool isPdBoardConnected() const { return mainPort.pdBoardConnected; }
+  int getSdaPin() const { return mainPort.settings.sdaPin; }
+  int getSclPin() const { return mainPort.settings.sclPin; }
+  const char *getBoardType() const { return mainPort.settings.boardType; }
+  uint8_t getI2cAddress() const { return mainPort.settings.i2cAddress; }
+  uint8_t getI2cBus() const { return mainPort.settings.i2cBus; }
+  uint32_t getRequestedI2cClockHz() const {
+    return mainPort.settings.i2cClockHz;
+  }
+  // Clock the bus runs at (the slowest any port on it settled on) and the
+  // time one register image read took at it
+  uint32_t getI2cClockHz() const { return busClockHz(mainPort); }
+  uint32_t getI2cReadUs() const { return mainPort.stats.i2cReadUs; }
+  uint32_t getI2cClockFallbacks() const {
+    return mainPort.stats.i2cClockFallbacks;
+  }
+  // True when a fixed i2cClockHz is above the clock the bus runs at, because
+  // a slower device on it holds the bus down
+  bool hasI2cClockConflict() const { return clockConflict(mainPort); }
+  // Bus recoveries tried and the ones that got the chip back, with the time
+  // from the first failure to recovery of the last and on average
+  uint32_t getI2cRecoveryFailures() const {
+    return mainPort.settings.i2cRecoveryFailures;
+  }
+  uint32_t getI2cRecoveryAttempts() const {
+    return mainPort.stats.i2cRecoveryAttempts;
+  }
+  uint32_t getI2cRecoveries() const { return mainPort.stats.i2cRecoveries; }
+  uint32_t getLastRecoveryMs() const { return mainPort.stats.lastRecoveryMs; }
+  uint32_t getMeanRecoveryMs() const { return mainPort.stats.meanRecoveryMs(); }
+  // Breaker in front of the chip: samples and reconnects skip the bus while
+  // it is open
+  const PdCircuitBreaker &getBreaker() const { return mainPort.breaker; }
+  uint32_t getPollIntervalMs() const {
+    return mainPort.settings.pollIntervalMs;
+  }
+  uint32_t getPollFastMs() const { return mainPort.settings.pollFastMs; }
+  uint32_t getPollBurstMs() const { return mainPort.settings.pollBurstMs; }
+  int getAlertPin() const { return mainPort.settings.alertPin; }
+  uint32_t getAlertsServiced() const { return mainPort.stats.alertsServiced; }
+  uint32_t getNvmCommitDelayMs() const {
+    return mainPort.settings.nvmCommitDelayMs;
+  }
+  bool isNvmCommitPending() const { return mainPort.nvmCommitPending; }
+  uint32_t getNvmWritesAvoided() const {
+    return mainPort.stats.nvmWritesAvoided();
+  }
+  bool isPollerRunning() const { return poller.isRunning(); }
 
 #if defined(NATIVE_PLATFORM)
   // Test-only helper to apply configuration without initializing hardware
@@ -80,25 +530,211 @@ public:
 #endif
 
 private:
-  IUsbPdChip &pdController;
-  USBPDCore core;
+  // Port 0, on the chip given to the constructor
+  Port mainPort;
 
-  // Current PD settings
-  float currentVoltage = 0.0;
-  float currentCurrent = 0.0;
-  bool pdBoardConnected = false;
-  unsigned long lastCheckTime = 0;
-  uint8_t i2cAddress = 0x28;
+  // GET bodies of port 0 rendered from each published snapshot, so
+  // /api/status and /api/profiles answer with one copy and no JSON building
+  PdRenderedBody<USB_PD_STATUS_JSON_LEN> statusBody;
+  PdRenderedBody<USB_PD_PROFILES_JSON_LEN> profilesBody;
 
-  // I2C configuration
-  int sdaPin = 4;
-  int sclPin = 5;
-  String boardType = "sparkfun";
+  // /api/events bodies for the current version: the full state, and the
+  // parts that changed since the previous version
+  PdRenderedBody<USB_PD_EVENT_FRAME_LEN> fullEvent;
+  PdRenderedBody<USB_PD_EVENT_FRAME_LEN> deltaEvent;
+  bool statusChanged = false;   // Since the last renderEvents()
+  bool profilesChanged = false;
+
+  // /api/snapshot body: everything the dashboard loads, for one version
+  PdRenderedBody<USB_PD_SNAPSHOT_JSON_LEN> snapshotBody;
+
+  // Extra ports render on request into this buffer, one handler at a time,
+  // and copy the result into the response
+  std::mutex portBodyMutex;
+  char portBody[USB_PD_SNAPSHOT_JSON_LEN > USB_PD_EVENT_FRAME_LEN
+                    ? USB_PD_SNAPSHOT_JSON_LEN
+                    : USB_PD_EVENT_FRAME_LEN];
+
+  // Fed by publishSnapshot() for port 0, read by /api/history
+  mutable std::mutex telemetryMutex;
+  PdTelemetryStore telemetry;
+  PdSeriesRing series; // Closed 1 s buckets, also under telemetryMutex
+
+  // Sealed series blocks go to historyLog from handle()
+  std::mutex historyLogMutex;
+  PdSeriesLog *historyLog = nullptr;
+  uint32_t seriesLogged = 0; // Sealed blocks handed to the log
+  uint32_t historyLogErrors = 0;
+
+  // Route latencies for /metrics, created with the routes
+  std::unique_ptr<PdRouteMetrics> routeMetrics;
+
+  // Async configure queue for every port; slot = id %
+  // USB_PD_CONFIG_JOB_HISTORY. One job runs at a time.
+  mutable std::mutex jobMutex;
+  PdConfigJob configJobs[USB_PD_CONFIG_JOB_HISTORY];
+  uint32_t nextJobId = 1;
+  uint32_t nextRunJobId = 1;
+  uint32_t activeJobId = 0;
+  ConfigJobCallback configJobCallback;
+
+  // Multi-port mode: the ports after port 0, created from the "ports"
+  // config. This controller's poller and handle() drive all of them.
+  std::unique_ptr<Port> extraPorts[USB_PD_MAX_PORTS - 1];
+  size_t extraPortCount = 0;
+  PortChipFactory portChipFactory;
+  bool defaultPortChips = true; // portChipFactory is PortChips<Chip>::create
+
+  // Declared last so the task is stopped before the state it samples goes
+  USBPDPoller poller;
+
+  // Port n, nullptr when out of range
+  Port *port(size_t n);
 
   // Initialize I2C and hardware with configuration
-  void initializeHardware();
+  void initializeHardware(Port &p);
   void parseConfig(const JsonVariant &config);
 
+  // Settings of a single port; shared settings inherited by extra ports skip
+  // the port-specific ALERT pin
+  void parseSettings(Port &p, const JsonVariant &config, bool shared = false);
+
+  // Build the extra ports from the "ports" array
+  void parsePorts(const JsonVariant &config);
+  void attachAlertInterrupt(Port &p);
+
+  // Register p with bus as a client (with its i2cBudgetUs)
+  void attachI2cBus(Port &p, PdI2cBus *bus);
+
+  // Unmask attach/detach alerts after the chip is (re)initialized
+  void armAlert(Port &p);
+
+  // Set the bus clock from i2cClockHz, negotiating it in auto mode, and
+  // time a register read at it (caller holds chipMutex and the bus)
+  void applyI2cClock(Port &p);
+  bool readsBackIntact(Port &p, const PdRegisterImage &reference);
+
+  // Clock p's bus runs at: the arbiter's when shared, else what p applied
+  uint32_t busClockHz(const Port &p) const;
+  bool clockConflict(const Port &p) const;
+
+  // Record a failed chip transaction with the breaker. Every
+  // i2cRecoveryFailures in a row, queue a Recover job (caller holds
+  // chipMutex).
+  void chipFailed(Port &p);
+
+  // Recover job: unstick the bus, restart it at the current clock,
+  // reinitialize the chip and queue a Restore job if it lost the PDOs last
+  // applied (takes chipMutex, not held during the bus reset)
+  void recoverBus(Port &p);
+
+  // Queue job (id, state and submit time are filled in); 0 when full
+  uint32_t submitJob(PdConfigJob job);
+
+  // Probe p's chip at its address
+  bool probe(Port &p);
+
+  // Reconnect if needed, read and publish (takes chipMutex)
+  bool readConfig(Port &p);
+
+  // Read the active config through the core (caller holds chipMutex)
+  bool refreshConfig(Port &p);
+
+  // Publish the chip's current state (caller holds chipMutex); port 0 also
+  // renders its bodies and records history
+  void publishSnapshot(Port &p, bool connected, bool valid);
+  void renderBodies(const PdSnapshot &snapshot);
+  void renderEvents(const PdSnapshot &snapshot, uint32_t version);
+  void renderSnapshot(const PdSnapshot &snapshot, uint32_t version);
+
+  // Schedule the next sample after one just published (caller holds
+  // chipMutex); a state change starts a fast burst
+  void configurePollSchedule(Port &p);
+  void reschedulePoll(Port &p, bool stateChanged);
+
+  // Sample every port whose poll is due and sleep until the next deadline
+  // (poller task)
+  void pollPorts();
+
+  // sampleNow() holding the bus at the given priority
+  void sample(Port &p, PdI2cPriority priority);
+
+  // A due periodic sample; skipped until the next poll when the bus budget
+  // is used up
+  void samplePeriodic(Port &p);
+
+  // handle() and nextWakeMs() for one port, jobs aside
+  void servicePort(Port &p);
+  uint32_t portWakeMs(const Port &p) const;
+
+  // Advance the active configure job by at most one step
+  void serviceConfigJobs();
+  void finishConfigJob(Port *p, bool ok, const char *error);
+
+  // Track volatile vs persistent applies for the deferred NVM commit, and
+  // remember the PDOs applied for a restore
+  void noteConfigApplied(Port &p, float voltage, float current,
+                         PdWriteMode mode);
+
+  // Add the negotiation of a completed configure to the port's metrics
+  void recordNegotiation(Port &p);
+  void serviceNvmCommit(Port &p);
+
+  // Append series blocks sealed since the last call to the history log
+  void serviceHistoryLog();
+
+  // Serve a constant JSON body from flash with its strong ETag and cache
+  // headers; a matching If-None-Match gets 304 without a body
+  void serveStaticJson(RequestT &req, ResponseT &res, const char *body,
+                       const char *etag);
+
+  // Serve a body rendered from the published state, tagged with the state
+  // version; clients revalidate every time and get 304 while it is current
+  template <size_t N>
+  void serveStateJson(RequestT &req, ResponseT &res,
+                      const PdRenderedBody<N> &body);
+
+  // The same for an extra port: render(buf, len, snapshot) writes the body
+  // into portBody (len bytes), only when the client's copy is stale
+  template <typename Fn>
+  void servePortJson(const Port &p, RequestT &req, ResponseT &res, size_t len,
+                     Fn render);
+
+  // Sets the ETag header; answers 304 and returns true when If-None-Match
+  // names it
+  bool notModified(RequestT &req, ResponseT &res, const char *etag);
+
+  // Method label of a route's metrics
+  static const char *httpMethodName(WebModule::Method method) {
+    switch (method) {
+    case WebModule::WM_POST:
+      return "POST";
+    case WebModule::WM_PUT:
+      return "PUT";
+    case WebModule::WM_DELETE:
+      return "DELETE";
+    case WebModule::WM_PATCH:
+      return "PATCH";
+    default:
+      return "GET";
+    }
+  }
+
+  // Routes whose handler instrumentRoute() wraps under the route's own path
+  // (a literal) and method
+  template <typename Fn>
+  WebRoute webRoute(const char *path, WebModule::Method method, Fn handler,
+                    std::initializer_list<AuthType> auth) {
+    return WebRoute(path, method, instrumentRoute(path, handler, method),
+                    auth);
+  }
+  template <typename Fn, typename Doc>
+  ApiRoute apiRoute(const char *path, WebModule::Method method, Fn handler,
+                    std::initializer_list<AuthType> auth, Doc &&doc) {
+    return ApiRoute(path, method, instrumentRoute(path, handler, method),
+                    auth, std::forward<Doc>(doc));
+  }
+
   // Helper to reduce platform lookup duplication when creating JSON responses
   template <typename Fn>
   inline void respondJson(ResponseT &res, Fn &&fn) {
@@ -107,6 +743,10 @@ private:
   }
 };
 
+using USBPDController = BasicUSBPDController<IUsbPdChip>;
+using USBPDPort = BasicUSBPDPort<IUsbPdChip>;
+extern template class BasicUSBPDController<IUsbPdChip>;
+
 // Global instance
 extern USBPDController usbPDController;
 
@@ -3,32 +3,174 @@
 
 #include <interface/string_compat.h>
 #include <usb_pd_chip.h>
+#include <usb_pd_json_writer.h>
+
+// Upper bound on waiting for the source to accept a new configuration
+#ifndef USB_PD_CONTRACT_TIMEOUT_MS
+#define USB_PD_CONTRACT_TIMEOUT_MS 1000UL
+#endif
+
+// Sleep between contract status polls in the blocking waitForContract()
+#ifndef USB_PD_CONTRACT_POLL_MS
+#define USB_PD_CONTRACT_POLL_MS 5UL
+#endif
+
+// A contract identical to the one before the soft reset (same PDO, same
+// RDO) is only taken as the new one after this long. Requesting another
+// voltage on the same PDO (e.g. 9 V -> 12 V on PDO2) can produce it.
+#ifndef USB_PD_CONTRACT_SETTLE_MS
+#define USB_PD_CONTRACT_SETTLE_MS 250UL
+#endif
+
+// Outcome of waiting for the source to accept a configuration
+struct PdNegotiation {
+  bool established = false; // New explicit contract observed
+  bool timedOut = false;    // Gave up after USB_PD_CONTRACT_TIMEOUT_MS
+  int pdoNumber = 0;        // PDO in the contract (0 if none)
+  uint32_t elapsedMs = 0;   // Soft reset to contract (or timeout)
+};
+
+// Platform time source for contract waits; the core itself stays
+// Arduino-free
+typedef uint32_t (*PdClockFn)();
+typedef void (*PdSleepFn)(uint32_t ms);
+
+// Stages of a configure, performed one per USBPDCore::stepConfig() call
+enum class PdConfigStep : uint8_t {
+  Idle,
+  Read,          // Load the current register image
+  Apply,         // Update PDOs using the fallback strategy
+  Write,         // Commit to the device (NVM or runtime registers)
+  SoftReset,     // Trigger renegotiation
+  AwaitContract, // Poll contract status until the new contract is in place
+  ReadBack,      // Verify the new active PDO
+  Done,
+  Failed
+};
+
+// Buffer that always holds PDO profiles JSON for three PDOs: each PDO
+// object is at most 112 characters (numbers at most 13), plus 36 for the
+// wrapper and the active PDO
+#ifndef USB_PD_PROFILES_JSON_LEN
+#define USB_PD_PROFILES_JSON_LEN 384
+#endif
+
+// Stream the PDO profiles object for PDOs 1..count (arrays indexed 1..count,
+// index 0 unused) into json. The single serializer behind the helpers below
+// and /api/profiles; count covers chips with more than three PDOs.
+void writePdoProfilesJson(PdJsonWriter &json, int activePdo,
+                          const float *voltages, const float *currents,
+                          int count = 3);
+
+// Format PDO profiles JSON from already-sampled values (index 1..3)
+String formatPdoProfilesJson(int activePdo, const float *voltages,
+                             const float *currents);
+
+// Same, into buf without allocating. Returns the full JSON length like
+// snprintf; when that is not below len, buf is left empty rather than
+// holding truncated JSON.
+size_t formatPdoProfilesJson(char *buf, size_t len, int activePdo,
+                             const float *voltages, const float *currents);
 
 // Core, Arduino-free logic for configuring a USB-PD chip.
 // This can be tested in native builds with a fake IUsbPdChip.
-class USBPDCore {
+// Chip is bound at compile time; members are in usb_pd_core_impl.h.
+template <typename Chip> class BasicUSBPDCore {
 public:
-  explicit USBPDCore(IUsbPdChip &chip) : chip(chip) {}
+  explicit BasicUSBPDCore(Chip &chip) : chip(chip) {}
+
+  // Without a clock, contract waits poll once and never time out or sleep
+  void setClock(PdClockFn nowMs, PdSleepFn sleepMs) {
+    clockFn = nowMs;
+    sleepFn = sleepMs;
+  }
 
   // Reads current configuration from the chip
   bool readConfig(float &voltageOut, float &currentOut, int &activePdoOut);
 
   // Set target voltage/current with fallback PDO strategy, commits to device
-  bool setConfig(float voltage, float current);
+  // (NVM for Persistent, runtime registers only for Volatile)
+  bool setConfig(float voltage, float current,
+                 PdWriteMode mode = PdWriteMode::Persistent);
+
+  // Commit a configuration previously applied with PdWriteMode::Volatile to
+  // NVM without renegotiating
+  void commitConfig(float voltage, float current);
+
+  // Staged setConfig(): beginConfig() does no I/O and each stepConfig()
+  // performs at most one bus step, returning the step now pending
+  void beginConfig(float voltage, float current,
+                   PdWriteMode mode = PdWriteMode::Persistent);
+  // Same steps, writing set as it is instead of applying the PDO strategy
+  void beginRestore(const PdoSet &set, PdWriteMode mode);
+  PdConfigStep stepConfig();
+  PdConfigStep configStep() const { return step; }
+  bool isConfiguring() const {
+    return step != PdConfigStep::Idle && step != PdConfigStep::Done &&
+           step != PdConfigStep::Failed;
+  }
+
+  // Read contract status once; true when the contract requested by the last
+  // configure is in place. Only meaningful after the soft reset.
+  bool pollContract();
+
+  // Block until pollContract() succeeds or timeoutMs elapses
+  bool waitForContract(uint32_t timeoutMs);
+
+  // Result of the last contract wait
+  const PdNegotiation &negotiation() const { return lastNegotiation; }
 
   // Build a compact JSON string describing all 3 PDOs and active PDO
   String buildPdoProfilesJson() const;
 
+  static String formatPdoProfilesJson(int activePdo, const float *voltages,
+                                      const float *currents) {
+    return ::formatPdoProfilesJson(activePdo, voltages, currents);
+  }
+
   // Update cached readings (must call readConfig first or setConfig success)
   float currentVoltage() const { return cachedVoltage; }
   float currentCurrent() const { return cachedCurrent; }
   int activePdo() const { return cachedPdo; }
 
+  // All PDOs as of the last readConfig() that reached the device
+  const PdoSet &pdoSet() const { return lastSet; }
+
+  // Whether the device failed to answer a read during the last readConfig(),
+  // commitConfig(), pollContract() or stepConfig() call
+  bool readFailed() const { return deviceUnread; }
+
 private:
-  IUsbPdChip &chip;
+  Chip &chip;
   float cachedVoltage = 0.0f;
   float cachedCurrent = 0.0f;
   int cachedPdo = 0;
+  PdoSet lastSet;
+  bool deviceUnread = false;
+
+  // Staged configure state
+  PdConfigStep step = PdConfigStep::Idle;
+  float targetVoltage = 0.0f;
+  float targetCurrent = 0.0f;
+  PdWriteMode targetMode = PdWriteMode::Persistent;
+  bool restoring = false; // pending is written as given
+  PdoSet pending; // Loaded by Read, updated by Apply
+
+  // Contract wait state
+  PdClockFn clockFn = nullptr;
+  PdSleepFn sleepFn = nullptr;
+  int expectedPdo = 0;
+  bool sawRenegotiation = false;
+  PdContract contractBefore; // As read just before the soft reset
+  uint32_t contractStartMs = 0;
+  PdNegotiation lastNegotiation;
+
+  static void applyPdoStrategy(PdoSet &set, float voltage, float current);
+  void startContractWait();
+  uint32_t nowMs() const { return clockFn ? clockFn() : 0; }
 };
 
+using USBPDCore = BasicUSBPDCore<IUsbPdChip>;
+extern template class BasicUSBPDCore<IUsbPdChip>;
+
 #endif // USB_PD_CORE_H
@@ -0,0 +1,236 @@
+#ifndef USB_PD_CORE_IMPL_H
+#define USB_PD_CORE_IMPL_H
+
+// Member definitions of BasicUSBPDCore. Include this only where a core is
+// instantiated for a chip type other than IUsbPdChip.
+#include <usb_pd_core.h>
+#include <usb_pd_trace.h>
+
+template <typename Chip>
+bool BasicUSBPDCore<Chip>::readConfig(float &voltageOut, float &currentOut,
+                                      int &activePdoOut) {
+  USB_PD_TRACE_SCOPE("core.read_config");
+  PdoSet set;
+  deviceUnread = !chip.readPdoSet(set);
+  if (deviceUnread) {
+    return false;
+  }
+  lastSet = set;
+  int pdo = set.activePdo;
+  if (pdo < 1 || pdo > 3) {
+    return false;
+  }
+  float v = set.voltage[pdo];
+  float c = set.current[pdo];
+  if (v <= 0 || c <= 0) {
+    return false;
+  }
+  cachedPdo = pdo;
+  cachedVoltage = v;
+  cachedCurrent = c;
+  voltageOut = v;
+  currentOut = c;
+  activePdoOut = pdo;
+  return true;
+}
+
+template <typename Chip>
+bool BasicUSBPDCore<Chip>::setConfig(float voltage, float current,
+                                     PdWriteMode mode) {
+  USB_PD_TRACE_SCOPE("core.set_config");
+  beginConfig(voltage, current, mode);
+  while (isConfiguring()) {
+    if (step == PdConfigStep::AwaitContract) {
+      // Read back whether or not the source confirmed in time
+      waitForContract(USB_PD_CONTRACT_TIMEOUT_MS);
+      step = PdConfigStep::ReadBack;
+    }
+    stepConfig();
+  }
+  return step == PdConfigStep::Done;
+}
+
+template <typename Chip>
+void BasicUSBPDCore<Chip>::commitConfig(float voltage, float current) {
+  USB_PD_TRACE_SCOPE("core.commit_config");
+  // Re-apply on top of a fresh read so the NVM image matches the runtime
+  // registers even if the register image was reloaded in between
+  PdoSet set;
+  deviceUnread = !chip.readPdoSet(set);
+  if (deviceUnread) {
+    return;
+  }
+  applyPdoStrategy(set, voltage, current);
+  chip.writePdoSet(set);
+  chip.write();
+}
+
+template <typename Chip>
+void BasicUSBPDCore<Chip>::beginConfig(float voltage, float current,
+                                       PdWriteMode mode) {
+  targetVoltage = voltage;
+  targetCurrent = current;
+  targetMode = mode;
+  restoring = false;
+  step = PdConfigStep::Read;
+}
+
+template <typename Chip>
+void BasicUSBPDCore<Chip>::beginRestore(const PdoSet &set, PdWriteMode mode) {
+  pending = set;
+  targetMode = mode;
+  restoring = true;
+  step = PdConfigStep::Apply;
+}
+
+template <typename Chip>
+PdConfigStep BasicUSBPDCore<Chip>::stepConfig() {
+  deviceUnread = false;
+  switch (step) {
+  case PdConfigStep::Read: {
+    USB_PD_TRACE_SCOPE("core.step.read");
+    // Start from the device's PDOs so untouched fields are written back as-is
+    deviceUnread = !chip.readPdoSet(pending);
+    step = deviceUnread ? PdConfigStep::Failed : PdConfigStep::Apply;
+    break;
+  }
+  case PdConfigStep::Apply: {
+    USB_PD_TRACE_SCOPE("core.step.apply");
+    if (!restoring) {
+      applyPdoStrategy(pending, targetVoltage, targetCurrent);
+    }
+    chip.writePdoSet(pending);
+    expectedPdo = pending.activePdo;
+    step = PdConfigStep::Write;
+    break;
+  }
+  case PdConfigStep::Write: {
+    USB_PD_TRACE_SCOPE("core.step.write");
+    if (targetMode == PdWriteMode::Volatile) {
+      chip.writeVolatile();
+    } else {
+      chip.write();
+    }
+    step = PdConfigStep::SoftReset;
+    break;
+  }
+  case PdConfigStep::SoftReset: {
+    USB_PD_TRACE_SCOPE("core.step.soft_reset");
+    // Remember the old contract so it is not mistaken for the new one
+    contractBefore = chip.readContract();
+    deviceUnread = contractBefore.state == PdContractState::Unknown;
+    chip.softReset();
+    startContractWait();
+    step = PdConfigStep::AwaitContract;
+    break;
+  }
+  case PdConfigStep::AwaitContract: {
+    USB_PD_TRACE_SCOPE("core.step.await_contract");
+    if (pollContract() || (clockFn && nowMs() - contractStartMs >=
+                                          USB_PD_CONTRACT_TIMEOUT_MS)) {
+      lastNegotiation.timedOut = !lastNegotiation.established;
+      step = PdConfigStep::ReadBack;
+    }
+    break;
+  }
+  case PdConfigStep::ReadBack: {
+    USB_PD_TRACE_SCOPE("core.step.read_back");
+    float v, c;
+    int p;
+    step = readConfig(v, c, p) ? PdConfigStep::Done : PdConfigStep::Failed;
+    break;
+  }
+  default:
+    break;
+  }
+  return step;
+}
+
+template <typename Chip>
+void BasicUSBPDCore<Chip>::startContractWait() {
+  sawRenegotiation = false;
+  contractStartMs = nowMs();
+  lastNegotiation = PdNegotiation();
+}
+
+template <typename Chip>
+bool BasicUSBPDCore<Chip>::pollContract() {
+  PdContract contract = chip.readContract();
+  deviceUnread = contract.state == PdContractState::Unknown;
+  lastNegotiation.elapsedMs = nowMs() - contractStartMs;
+  lastNegotiation.pdoNumber = contract.pdoNumber;
+
+  if (contract.state != PdContractState::Ready) {
+    // The soft reset has dropped the old contract; whatever comes next is new
+    sawRenegotiation = sawRenegotiation ||
+                       contract.state == PdContractState::Negotiating;
+    return false;
+  }
+
+  // The chip may still report the pre-reset contract: a contract is new
+  // once the old one dropped or changed, or after USB_PD_CONTRACT_SETTLE_MS
+  bool changed = sawRenegotiation ||
+                 contractBefore.state != PdContractState::Ready ||
+                 contract.pdoNumber != contractBefore.pdoNumber ||
+                 contract.rdo != contractBefore.rdo;
+  bool settled = !clockFn || lastNegotiation.elapsedMs >=
+                                 USB_PD_CONTRACT_SETTLE_MS;
+  lastNegotiation.established =
+      changed || (contract.pdoNumber == expectedPdo && settled);
+  return lastNegotiation.established;
+}
+
+template <typename Chip>
+bool BasicUSBPDCore<Chip>::waitForContract(uint32_t timeoutMs) {
+  USB_PD_TRACE_SCOPE("core.wait_contract");
+  if (step != PdConfigStep::AwaitContract) {
+    // Standalone wait, e.g. after an external renegotiation
+    expectedPdo = chip.getPdoNumber();
+    contractBefore = PdContract();
+    startContractWait();
+  }
+  while (!pollContract()) {
+    if (!clockFn || nowMs() - contractStartMs >= timeoutMs) {
+      lastNegotiation.timedOut = true;
+      return false;
+    }
+    if (sleepFn) {
+      sleepFn(USB_PD_CONTRACT_POLL_MS);
+    }
+  }
+  return true;
+}
+
+template <typename Chip>
+void BasicUSBPDCore<Chip>::applyPdoStrategy(PdoSet &set, float voltage,
+                                            float current) {
+  if (voltage == 5.0f) {
+    set.current[1] = current;
+    set.activePdo = 1;
+  } else if (voltage <= 12.0f) {
+    set.voltage[2] = voltage;
+    set.current[2] = current;
+    set.current[1] = current; // fallback PDO1
+    set.activePdo = 2;
+  } else {
+    set.voltage[3] = voltage;
+    set.current[3] = current;
+    set.voltage[2] = 12.0f; // middle fallback
+    set.current[2] = current;
+    set.current[1] = current; // final fallback
+    set.activePdo = 3;
+  }
+}
+
+template <typename Chip>
+String BasicUSBPDCore<Chip>::buildPdoProfilesJson() const {
+  float voltages[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  float currents[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  for (int i = 1; i <= 3; ++i) {
+    voltages[i] = chip.getVoltage(i);
+    currents[i] = chip.getCurrent(i);
+  }
+  return formatPdoProfilesJson(chip.getPdoNumber(), voltages, currents);
+}
+
+#endif // USB_PD_CORE_IMPL_H
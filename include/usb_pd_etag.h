@@ -0,0 +1,78 @@
+#ifndef USB_PD_ETAG_H
+#define USB_PD_ETAG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Room for the longest formatStateEtag() result, e.g. "\"1a2b3c4d-4294967295\""
+#define USB_PD_STATE_ETAG_LEN 24
+
+// Validator for bodies rendered from the PD state. The version restarts at
+// every boot, so a per-boot id keeps tags cached before a reboot from
+// matching afterwards. Returns the length written.
+inline size_t formatStateEtag(char *buf, size_t len, uint32_t bootId,
+                              uint32_t version) {
+  int n = snprintf(buf, len, "\"%08lx-%lu\"", (unsigned long)bootId,
+                   (unsigned long)version);
+  return n < 0 ? 0 : (size_t)n;
+}
+
+// The same tag without its quotes, as /api/events carries it in JSON
+inline size_t formatStateId(char *buf, size_t len, uint32_t bootId,
+                            uint32_t version) {
+  int n = snprintf(buf, len, "%08lx-%lu", (unsigned long)bootId,
+                   (unsigned long)version);
+  return n < 0 ? 0 : (size_t)n;
+}
+
+// True when a since= value names the state id: the id itself or its ETag
+// (quoted)
+inline bool stateIdMatches(const char *since, const char *id) {
+  size_t len = strlen(id);
+  if (*since == '"') {
+    return strncmp(since + 1, id, len) == 0 && since[len + 1] == '"' &&
+           since[len + 2] == '\0';
+  }
+  return strcmp(since, id) == 0;
+}
+
+// True when an If-None-Match value names etag: "*", or one entry of a
+// comma-separated list. Compared weakly (a W/ prefix is ignored), which is
+// what If-None-Match calls for.
+inline bool etagMatches(const char *ifNoneMatch, const char *etag) {
+  size_t etagLen = strlen(etag);
+  const char *p = ifNoneMatch;
+  while (*p) {
+    while (*p == ' ' || *p == '\t' || *p == ',') {
+      ++p;
+    }
+    if (*p == '*') {
+      return true;
+    }
+    if (p[0] == 'W' && p[1] == '/') {
+      p += 2;
+    }
+    const char *start = p;
+    if (*p == '"') {
+      // Quoted tags may contain commas
+      ++p;
+      while (*p && *p != '"') {
+        ++p;
+      }
+      if (*p) {
+        ++p;
+      }
+    }
+    if ((size_t)(p - start) == etagLen && strncmp(start, etag, etagLen) == 0) {
+      return true;
+    }
+    while (*p && *p != ',') {
+      ++p;
+    }
+  }
+  return false;
+}
+
+#endif // USB_PD_ETAG_H
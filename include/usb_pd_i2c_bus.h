@@ -0,0 +1,156 @@
+#ifndef USB_PD_I2C_BUS_H
+#define USB_PD_I2C_BUS_H
+
+#include <condition_variable>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+
+// Clients that can share one bus; addClient() fails past this
+#ifndef USB_PD_I2C_MAX_CLIENTS
+#define USB_PD_I2C_MAX_CLIENTS 8
+#endif
+
+// Longest client name kept, terminator included; longer names are cut
+#ifndef USB_PD_I2C_CLIENT_NAME_LEN
+#define USB_PD_I2C_CLIENT_NAME_LEN 16
+#endif
+
+// Window over which a client's bus time is held to its budget
+#ifndef USB_PD_I2C_BUDGET_WINDOW_US
+#define USB_PD_I2C_BUDGET_WINDOW_US 1000000UL
+#endif
+
+// Prefix of this module's client names; port n registers as "usb_pd.<n>"
+static const char *const USB_PD_I2C_CLIENT = "usb_pd";
+
+// Why a client wants the bus. When the bus is released, the waiter with the
+// highest priority goes next and waiters of the same priority go in order.
+enum class PdI2cPriority : uint8_t {
+  Status,    // Periodic sampling; the only work a budget can defer
+  Alert,     // Servicing an ALERT or other interrupt
+  Configure, // Writing a configuration the user asked for
+  Count
+};
+
+// Per-client counters, as of the last release
+struct PdI2cClientStats {
+  const char *name = nullptr;
+  uint32_t budgetUs = 0;  // Bus time per window for Status work; 0 = none
+  uint32_t grants = 0;    // Acquires that waited for or took the bus
+  uint32_t joined = 0;    // Acquires that joined a grant already held
+  uint32_t deferred = 0;  // admit() calls refused for being over budget
+  uint32_t waitUs = 0;    // Total time spent queued
+  uint32_t maxWaitUs = 0; // Longest single wait
+  uint32_t busyUs = 0;    // Total time holding the bus
+  uint32_t clockHz = 0;   // Slowest clock it asked for; 0 = none
+};
+
+// Arbiter for one I2C bus shared by several modules; a grant covers a whole
+// transaction and nests within the holding task. Thread-safe.
+class PdI2cBus {
+public:
+  typedef uint32_t (*ClockFn)();
+
+  // nowUs is the microsecond clock (micros() on hardware); without one
+  // waits and budgets are not measured
+  explicit PdI2cBus(ClockFn nowUs = nullptr) : clockFn(nowUs) {}
+
+  PdI2cBus(const PdI2cBus &) = delete;
+  PdI2cBus &operator=(const PdI2cBus &) = delete;
+
+  // Client id for name, registering it on first use; modules share a client
+  // by using the same name (copied). A nonzero budgetUs replaces the
+  // client's budget. -1 when USB_PD_I2C_MAX_CLIENTS are registered.
+  int addClient(const char *name, uint32_t budgetUs = 0);
+
+  // False when client has used its budget in the current window; counted
+  // as deferred
+  bool admit(int client);
+
+  // Block until the bus is granted to client, or join the grant the
+  // calling task already holds
+  void acquire(int client, PdI2cPriority priority);
+  void release();
+
+  // Holds the bus for its lifetime; does nothing without a bus
+  class Grant {
+  public:
+    Grant(PdI2cBus *bus, int client, PdI2cPriority priority) : bus(bus) {
+      if (bus) {
+        bus->acquire(client, priority);
+      }
+    }
+    ~Grant() {
+      if (bus) {
+        bus->release();
+      }
+    }
+    Grant(const Grant &) = delete;
+    Grant &operator=(const Grant &) = delete;
+
+  private:
+    PdI2cBus *bus;
+  };
+
+  // Clock client can run the bus at. The bus runs at the slowest clock any
+  // client asked for, so a faster request never raises it; returns the
+  // clock the bus runs at afterwards. Unknown clients are not counted.
+  uint32_t setClockHz(int client, uint32_t hz);
+  // Clock the bus runs at, so every port on it can see what the others
+  // settled on; 0 until a client sets one
+  uint32_t clockHz() const;
+
+  size_t queueDepth() const;
+  size_t maxQueueDepth() const;
+  size_t clientCount() const;
+  PdI2cClientStats clientStats(int client) const;
+
+private:
+  struct Client {
+    char name[USB_PD_I2C_CLIENT_NAME_LEN] = {};
+    PdI2cClientStats stats;
+    uint32_t windowStartUs = 0;
+    uint32_t windowUsedUs = 0;
+  };
+
+  ClockFn clockFn;
+  mutable std::mutex mutex;
+  std::condition_variable released;
+
+  Client clients[USB_PD_I2C_MAX_CLIENTS];
+  size_t clientsUsed = 0;
+
+  // One ticket queue per priority
+  uint32_t nextTicket[(size_t)PdI2cPriority::Count] = {};
+  uint32_t serving[(size_t)PdI2cPriority::Count] = {};
+  size_t waiting = 0;
+  size_t maxWaiting = 0;
+
+  bool held = false;
+  uintptr_t holderTask = 0;
+  int holderClient = -1;
+  uint32_t depth = 0; // Nested acquires of the holder
+  uint32_t grantedAtUs = 0;
+
+  uint32_t now() const { return clockFn ? clockFn() : 0; }
+  bool queuedAbove(size_t priority) const;
+  uint32_t slowestClockHz() const;
+  void rollWindow(Client &c, uint32_t nowUs);
+};
+
+#if defined(ARDUINO) || defined(ESP_PLATFORM)
+class TwoWire;
+
+// The Wire instance of I2C bus n (Wire, and Wire1 where the SoC has a second
+// controller) and its arbiter; nullptr for buses that do not exist. Every
+// module on the bus should reach it through these.
+TwoWire *pdI2cWire(uint8_t bus);
+PdI2cBus *pdI2cBus(uint8_t bus);
+
+// Free a bus a device holds SDA low on (nine SCL pulses, STOP, restart);
+// call holding the arbiter. False if a line is still low.
+bool pdI2cRecoverBus(TwoWire &wire, int sda, int scl);
+#endif
+
+#endif // USB_PD_I2C_BUS_H
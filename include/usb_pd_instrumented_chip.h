@@ -0,0 +1,70 @@
+#ifndef USB_PD_INSTRUMENTED_CHIP_H
+#define USB_PD_INSTRUMENTED_CHIP_H
+
+#include <usb_pd_chip.h>
+#include <usb_pd_core.h>
+#include <usb_pd_metrics.h>
+
+// Decorator that times device operations of another IUsbPdChip and counts
+// failures; goes directly around the adapter, under any shadow
+class InstrumentedUsbPdChip : public IUsbPdChip {
+public:
+  InstrumentedUsbPdChip(IUsbPdChip &inner, PdChipMetrics &metrics,
+                        PdClockFn nowUs)
+      : inner(inner), metrics(metrics), nowUs(nowUs) {}
+
+  bool selectBus(uint8_t bus) override { return inner.selectBus(bus); }
+  void setI2cClient(int client) override { inner.setI2cClient(client); }
+  bool probe(uint8_t i2cAddress) override;
+  bool begin() override;
+  void read() override;
+
+  int getPdoNumber() const override { return inner.getPdoNumber(); }
+  float getVoltage(int pdoIndex) const override {
+    return inner.getVoltage(pdoIndex);
+  }
+  float getCurrent(int pdoIndex) const override {
+    return inner.getCurrent(pdoIndex);
+  }
+
+  void setVoltage(int pdoIndex, float volts) override {
+    inner.setVoltage(pdoIndex, volts);
+  }
+  void setCurrent(int pdoIndex, float amps) override {
+    inner.setCurrent(pdoIndex, amps);
+  }
+  void setPdoNumber(int pdoIndex) override { inner.setPdoNumber(pdoIndex); }
+
+  bool readPdoSet(PdoSet &out) override;
+  void writePdoSet(const PdoSet &set) override { inner.writePdoSet(set); }
+
+  void write() override;
+  void softReset() override;
+  void writeVolatile() override;
+
+  PdContract readContract() override;
+  bool enableAttachAlert() override;
+  void clearAlerts() override;
+  bool setBusClock(uint32_t hz) override { return inner.setBusClock(hz); }
+  bool readRegisterImage(PdRegisterImage &out) override;
+  bool recoverBus(int sda, int scl) override;
+
+private:
+  IUsbPdChip &inner;
+  PdChipMetrics &metrics;
+  PdClockFn nowUs;
+
+  // Runs fn, records its duration under op and a failure when it returns
+  // false
+  template <typename Fn> bool timed(PdChipOp op, Fn fn) {
+    uint32_t start = nowUs();
+    bool ok = fn();
+    metrics.of(op).observe(nowUs() - start);
+    if (!ok) {
+      metrics.failuresOf(op).add();
+    }
+    return ok;
+  }
+};
+
+#endif // USB_PD_INSTRUMENTED_CHIP_H
@@ -0,0 +1,124 @@
+#ifndef USB_PD_JSON_WRITER_H
+#define USB_PD_JSON_WRITER_H
+
+#include <interface/string_compat.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+// Bytes the writer gathers before handing them to its sink
+#ifndef USB_PD_JSON_CHUNK_LEN
+#define USB_PD_JSON_CHUNK_LEN 64
+#endif
+
+// Receives JSON text from PdJsonWriter one chunk at a time. data[len] is
+// always '\0', so sinks may treat a chunk as a C string.
+class PdJsonSink {
+public:
+  virtual ~PdJsonSink() = default;
+
+  // Returns false if the chunk was not taken; the writer then stops
+  virtual bool write(const char *data, size_t len) = 0;
+};
+
+// Fills a caller-owned buffer. Output that does not fit is never cut short:
+// the buffer is emptied instead and needed() still reports the full length.
+class PdBufferSink : public PdJsonSink {
+public:
+  PdBufferSink(char *buf, size_t len);
+
+  bool write(const char *data, size_t len) override;
+
+  bool overflowed() const { return overflow; }
+  size_t length() const { return used; }
+  size_t needed() const { return total; } // Output length with a large buffer
+
+private:
+  char *buf;
+  size_t capacity;
+  size_t used = 0;
+  size_t total = 0;
+  bool overflow = false;
+};
+
+// Appends to a String, which grows as needed
+class PdStringSink : public PdJsonSink {
+public:
+  explicit PdStringSink(String &out) : out(out) {}
+
+  bool write(const char *data, size_t len) override {
+    out += data;
+    return true;
+  }
+
+private:
+  String &out;
+};
+
+// Streaming JSON encoder: no document tree and no intermediate copy, text
+// goes to the sink in USB_PD_JSON_CHUNK_LEN pieces as it is produced.
+// Commas are inserted automatically; nesting is limited to 32 levels.
+class PdJsonWriter {
+public:
+  explicit PdJsonWriter(PdJsonSink &sink) : sink(sink) {}
+  ~PdJsonWriter() { flush(); }
+
+  PdJsonWriter(const PdJsonWriter &) = delete;
+  PdJsonWriter &operator=(const PdJsonWriter &) = delete;
+
+  PdJsonWriter &beginObject();
+  PdJsonWriter &endObject();
+  PdJsonWriter &beginArray();
+  PdJsonWriter &endArray();
+
+  // Object member name; the next value or container belongs to it
+  PdJsonWriter &key(const char *name);
+
+  PdJsonWriter &value(bool v);
+  PdJsonWriter &value(float v); // NaN and infinities are written as null
+  PdJsonWriter &value(double v);
+  PdJsonWriter &value(const char *v);
+  PdJsonWriter &null();
+
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value &&
+                              !std::is_same<T, bool>::value,
+                          PdJsonWriter &>::type
+  value(T v) {
+    return std::is_signed<T>::value ? integer((long long)v)
+                                    : unsignedInteger((unsigned long long)v);
+  }
+
+  template <typename T> PdJsonWriter &member(const char *name, T v) {
+    return key(name).value(v);
+  }
+
+  // Hand buffered text to the sink; false once the sink refused a chunk
+  bool flush();
+  bool ok() const { return !failed; }
+
+  // Bytes produced so far, whether or not the sink took them
+  size_t length() const { return produced; }
+
+private:
+  PdJsonSink &sink;
+  char chunk[USB_PD_JSON_CHUNK_LEN + 1];
+  size_t used = 0;
+  size_t produced = 0;
+  bool failed = false;
+
+  uint32_t nonEmpty = 0; // Bit per nesting level: container has an element
+  uint8_t depth = 0;
+  bool afterKey = false;
+
+  void separate();
+  void open(char c);
+  void close(char c);
+  void put(char c);
+  void put(const char *s, size_t len);
+  void putString(const char *s);
+  PdJsonWriter &integer(long long v);
+  PdJsonWriter &unsignedInteger(unsigned long long v);
+};
+
+#endif // USB_PD_JSON_WRITER_H
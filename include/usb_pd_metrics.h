@@ -0,0 +1,141 @@
+#ifndef USB_PD_METRICS_H
+#define USB_PD_METRICS_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <usb_pd_json_writer.h>
+
+// Routes /metrics can report on; registrations past this are not timed
+#ifndef USB_PD_METRICS_MAX_ROUTES
+#define USB_PD_METRICS_MAX_ROUTES 32
+#endif
+
+// Latency bucket upper bounds in microseconds, from a short register read
+// to an NVM write or a renegotiation. Exported in seconds; a last +Inf
+// bucket catches the rest.
+#define USB_PD_METRICS_BUCKETS 12
+
+// Fixed-bucket latency histogram. observe() is a bucket search and two
+// relaxed atomic adds, so it is safe from any task and costs well under a
+// microsecond; readers may see an observation's bucket before its sum.
+class PdHistogram {
+public:
+  static const uint32_t boundsUs[USB_PD_METRICS_BUCKETS];
+
+  void observe(uint32_t micros);
+
+  // Observations in bucket i (not cumulative); i == USB_PD_METRICS_BUCKETS
+  // is the +Inf bucket
+  uint32_t bucket(size_t i) const {
+    return buckets[i].load(std::memory_order_relaxed);
+  }
+  uint32_t count() const;
+
+  // Total observed time; wraps after about 71 minutes of it, which
+  // Prometheus treats as a counter reset
+  uint32_t sumMicros() const { return sumUs.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint32_t> buckets[USB_PD_METRICS_BUCKETS + 1] = {};
+  std::atomic<uint32_t> sumUs{0};
+};
+
+// A monotonically increasing count
+class PdCounter {
+public:
+  void add(uint32_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+  uint32_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint32_t> value{0};
+};
+
+// Chip operations that reach the device; getters and setters only touch
+// the adapter's register image and are not timed
+enum class PdChipOp : uint8_t {
+  Probe,
+  Begin,
+  Read,
+  ReadPdoSet,
+  Write,
+  WriteVolatile,
+  SoftReset,
+  ReadContract,
+  EnableAttachAlert,
+  ClearAlerts,
+  ReadRegisterImage,
+  RecoverBus,
+  Count
+};
+
+// Label /metrics uses for op
+const char *chipOpName(PdChipOp op);
+
+// Per-port bus timings, filled by InstrumentedUsbPdChip
+struct PdChipMetrics {
+  PdHistogram latency[(size_t)PdChipOp::Count];
+  PdCounter failures[(size_t)PdChipOp::Count];
+
+  PdHistogram &of(PdChipOp op) { return latency[(size_t)op]; }
+  PdCounter &failuresOf(PdChipOp op) { return failures[(size_t)op]; }
+};
+
+// Soft reset to new contract, recorded by the controller per configure
+struct PdNegotiationMetrics {
+  PdHistogram latency;
+  PdCounter timeouts;
+};
+
+// Latency and error responses per route and method. Slots are claimed when
+// the routes are built and never released, so a handler keeps a plain
+// pointer to its slot and records without locking.
+class PdRouteMetrics {
+public:
+  struct Slot {
+    const char *route = nullptr;  // Must outlive the metrics (a literal)
+    const char *method = nullptr; // "GET", "POST", ... (a literal)
+    PdHistogram latency;
+    PdCounter errors; // Responses with a 4xx/5xx status
+
+    void record(uint32_t micros, int status) {
+      latency.observe(micros);
+      if (status >= 400) {
+        errors.add();
+      }
+    }
+  };
+
+  // The slot for route and method, claimed on first use and shared by every
+  // server the route is built for; nullptr once all are taken. Not for
+  // concurrent use with itself (routes are built at startup).
+  Slot *slot(const char *route, const char *method = "GET");
+
+  size_t size() const { return used.load(std::memory_order_acquire); }
+  const Slot &at(size_t i) const { return slots[i]; }
+
+private:
+  Slot slots[USB_PD_METRICS_MAX_ROUTES];
+  std::atomic<size_t> used{0};
+};
+
+// Writes the Prometheus text exposition format (version 0.0.4) to a text
+// sink, one line at a time. labels is the inner text of a label set, e.g.
+// port="0",op="probe", and may be empty.
+class PdPrometheusWriter {
+public:
+  explicit PdPrometheusWriter(PdJsonSink &sink) : sink(sink) {}
+
+  // # HELP and # TYPE lines, once per metric name before its samples
+  void family(const char *name, const char *type, const char *help);
+
+  void histogram(const char *name, const char *labels, const PdHistogram &h);
+  void counter(const char *name, const char *labels, uint32_t value);
+
+private:
+  PdJsonSink &sink;
+
+  void line(const char *format, ...);
+};
+
+#endif // USB_PD_METRICS_H
@@ -0,0 +1,60 @@
+#ifndef USB_PD_POLL_SCHEDULER_H
+#define USB_PD_POLL_SCHEDULER_H
+
+#include <stdint.h>
+
+// Fast interval used for a window after a connect, disconnect or configure
+#ifndef USB_PD_POLL_FAST_MS
+#define USB_PD_POLL_FAST_MS 250UL
+#endif
+
+#ifndef USB_PD_POLL_BURST_MS
+#define USB_PD_POLL_BURST_MS 5000UL
+#endif
+
+// Decides when the chip is next sampled: fast after a change, backing off
+// while quiet. Not thread-safe.
+class PdPollScheduler {
+public:
+  PdPollScheduler() = default;
+
+  // Starts out at the ceiling with the first poll due after one interval
+  void configure(uint32_t fastMs, uint32_t burstMs, uint32_t ceilingMs);
+
+  // A state change at nowMs: poll every fastMs for the next burstMs
+  void burst(uint32_t nowMs);
+
+  // A poll finished at nowMs; schedules the next one
+  void polled(uint32_t nowMs);
+
+  bool isDue(uint32_t nowMs) const {
+    return (int32_t)(nowMs - deadlineMs) >= 0;
+  }
+
+  // Milliseconds until the next poll is due (0 if overdue)
+  uint32_t msUntilDue(uint32_t nowMs) const {
+    return isDue(nowMs) ? 0 : deadlineMs - nowMs;
+  }
+
+  bool inBurst(uint32_t nowMs) const {
+    return bursting && (int32_t)(burstUntilMs - nowMs) > 0;
+  }
+
+  uint32_t getIntervalMs() const { return intervalMs; }
+  uint32_t getDeadlineMs() const { return deadlineMs; }
+  uint32_t getFastMs() const { return fastMs; }
+  uint32_t getBurstMs() const { return burstMs; }
+  uint32_t getCeilingMs() const { return ceilingMs; }
+
+private:
+  uint32_t fastMs = USB_PD_POLL_FAST_MS;
+  uint32_t burstMs = USB_PD_POLL_BURST_MS;
+  uint32_t ceilingMs = USB_PD_POLL_FAST_MS;
+
+  uint32_t intervalMs = USB_PD_POLL_FAST_MS;
+  uint32_t deadlineMs = USB_PD_POLL_FAST_MS;
+  uint32_t burstUntilMs = 0;
+  bool bursting = false;
+};
+
+#endif // USB_PD_POLL_SCHEDULER_H
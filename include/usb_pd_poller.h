@@ -0,0 +1,70 @@
+#ifndef USB_PD_POLLER_H
+#define USB_PD_POLLER_H
+
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+
+#if !defined(ESP_PLATFORM)
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+// Runs a sampling task at a fixed interval in the background.
+// ESP32 uses a dedicated FreeRTOS task, native builds use a std::thread.
+// The task itself is responsible for its own locking around the chip.
+class USBPDPoller {
+public:
+  using Task = std::function<void()>;
+
+  USBPDPoller() = default;
+  USBPDPoller(const USBPDPoller &) = delete;
+  USBPDPoller &operator=(const USBPDPoller &) = delete;
+  ~USBPDPoller() { stop(); }
+
+  // Start calling task every intervalMs; returns false if already running
+  // or the interval is zero
+  bool start(uint32_t intervalMs, Task task);
+
+  // Stop the background task and wait for the current iteration to finish
+  void stop();
+
+  // Run the task now instead of at the end of the current sleep
+  void wake();
+
+  // Sleep used after the next iteration; the task may call this itself
+  void setIntervalMs(uint32_t ms) { intervalMs.store(ms > 0 ? ms : 1); }
+
+  bool isRunning() const { return running.load(); }
+  uint32_t getIntervalMs() const { return intervalMs.load(); }
+
+  // Number of completed task iterations (diagnostics)
+  uint32_t getIterations() const { return iterations.load(); }
+
+private:
+  Task task;
+  std::atomic<uint32_t> intervalMs{0};
+  std::atomic<bool> running{false};
+  std::atomic<bool> stopRequested{false};
+  std::atomic<bool> wakeRequested{false};
+  std::atomic<uint32_t> iterations{0};
+
+  void run();
+
+#if defined(ESP_PLATFORM)
+  void *taskHandle = nullptr; // TaskHandle_t, kept opaque to avoid FreeRTOS
+                              // headers here
+  static void taskEntry(void *arg);
+#else
+  std::thread worker;
+  std::mutex wakeMutex;
+  std::condition_variable wakeSignal;
+#endif
+};
+
+// Identifies the calling FreeRTOS task (native: thread), e.g. to tell
+// whether it already holds a resource
+uintptr_t usbPdCurrentTask();
+
+#endif // USB_PD_POLLER_H
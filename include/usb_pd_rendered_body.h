@@ -0,0 +1,73 @@
+#ifndef USB_PD_RENDERED_BODY_H
+#define USB_PD_RENDERED_BODY_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Response body rendered by a single writer and copied out by any number
+// of readers, through seqlocked slots
+template <size_t N, size_t Slots = 2> class PdRenderedBody {
+  static_assert(Slots >= 2, "need a slot to render into");
+
+public:
+  static constexpr size_t capacity = N;
+
+  PdRenderedBody() {
+    for (size_t i = 0; i < Slots; ++i) {
+      slots[i][0] = '\0';
+      writes[i].store(0);
+    }
+  }
+
+  // Publish body (NUL-terminated, shorter than N); returns false if it
+  // matched the current body
+  bool publish(const char *body) {
+    uint8_t current = active.load(std::memory_order_relaxed);
+    if (strcmp(slots[current], body) == 0) {
+      return false;
+    }
+    uint8_t next = (uint8_t)((current + 1) % Slots);
+    uint32_t seq = writes[next].load(std::memory_order_relaxed);
+    writes[next].store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    strncpy(slots[next], body, N - 1);
+    slots[next][N - 1] = '\0';
+
+    writes[next].store(seq + 2, std::memory_order_release);
+    active.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Copy the current body into out (an Arduino String), for a response that
+  // is sent after the handler returns. One allocation unless out already
+  // has room.
+  template <typename Out> void copyTo(Out &out) const {
+    for (;;) {
+      uint8_t slot = active.load(std::memory_order_acquire);
+      uint32_t before = writes[slot].load(std::memory_order_acquire);
+      if ((before & 1u) != 0) {
+        continue;
+      }
+      out = "";
+      out.reserve(strnlen(slots[slot], N));
+      out += slots[slot];
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (writes[slot].load(std::memory_order_relaxed) == before) {
+        return;
+      }
+    }
+  }
+
+  // Current body, for the writer itself (nothing rewrites it meanwhile)
+  const char *get() const { return slots[active.load()]; }
+
+private:
+  char slots[Slots][N];
+  std::atomic<uint8_t> active{0};
+  std::atomic<uint32_t> writes[Slots]; // Odd while the slot is rewritten
+};
+
+#endif // USB_PD_RENDERED_BODY_H
@@ -0,0 +1,257 @@
+#ifndef USB_PD_SERIES_H
+#define USB_PD_SERIES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <usb_pd_telemetry.h>
+
+// Size of one compressed block, header included. Blocks are also the unit
+// written to flash, so keep this a divisor of the flash page size.
+#ifndef USB_PD_SERIES_BLOCK_LEN
+#define USB_PD_SERIES_BLOCK_LEN 256
+#endif
+
+// Sealed blocks kept in RAM per port (USB_PD_SERIES_BLOCK_LEN bytes each)
+#ifndef USB_PD_SERIES_RAM_BLOCKS
+#define USB_PD_SERIES_RAM_BLOCKS 8
+#endif
+
+// Blocks per log segment. The log keeps two segments, so flash use is
+// twice this times USB_PD_SERIES_BLOCK_LEN, and the RAM index 12 bytes
+// per block.
+#ifndef USB_PD_SERIES_SEGMENT_BLOCKS
+#define USB_PD_SERIES_SEGMENT_BLOCKS 128
+#endif
+
+#define USB_PD_SERIES_MAGIC 0x5354 // "TS"
+#define USB_PD_SERIES_HEADER_LEN 24
+
+// A run of samples compressed Gorilla-style (delta-of-delta time, zigzag
+// mV/mA deltas); plain data, written to flash as is
+struct PdSeriesBlock {
+  uint16_t magic = 0;
+  uint16_t count = 0; // Samples in the block
+  uint32_t seq = 0;   // Position in the log, assigned on append
+  uint32_t boot = 0;  // Boot that recorded it; times restart at every boot
+  uint32_t firstMs = 0;
+  uint32_t lastMs = 0;
+  uint16_t bits = 0; // Payload bits used
+  uint16_t reserved = 0;
+  uint8_t data[USB_PD_SERIES_BLOCK_LEN - USB_PD_SERIES_HEADER_LEN];
+
+  bool valid() const { return magic == USB_PD_SERIES_MAGIC && count > 0; }
+};
+
+static_assert(sizeof(PdSeriesBlock) == USB_PD_SERIES_BLOCK_LEN,
+              "PdSeriesBlock must pack to USB_PD_SERIES_BLOCK_LEN");
+
+// Appends samples to a block until it is full
+class PdSeriesEncoder {
+public:
+  // Starts an empty block
+  void reset(PdSeriesBlock &block);
+
+  // false (and nothing written) when the sample does not fit; the block
+  // is then complete. Samples must not go back in time.
+  bool append(const PdTelemetrySample &sample);
+
+  PdSeriesBlock *block() const { return target; }
+
+private:
+  PdSeriesBlock *target = nullptr;
+  uint32_t prevMs = 0;
+  int32_t prevDelta = 0;
+  uint16_t prevMillivolts = 0;
+  uint16_t prevMilliamps = 0;
+
+  void put(uint32_t value, uint8_t bits);
+};
+
+// Streams the samples back out of a block, oldest first
+class PdSeriesDecoder {
+public:
+  explicit PdSeriesDecoder(const PdSeriesBlock &block) : block(block) {}
+
+  // false once every sample has been returned
+  bool next(PdTelemetrySample &out);
+
+private:
+  const PdSeriesBlock &block;
+  uint32_t pos = 0;
+  uint16_t decoded = 0;
+  uint32_t prevMs = 0;
+  int32_t prevDelta = 0;
+  uint16_t prevMillivolts = 0;
+  uint16_t prevMilliamps = 0;
+
+  uint32_t take(uint8_t bits);
+};
+
+// Compressed samples in RAM: a ring of sealed blocks plus the open block
+// being filled. Not thread-safe, callers serialize access.
+class PdSeriesRing {
+public:
+  PdSeriesRing();
+
+  void append(const PdTelemetrySample &sample);
+  void clear();
+
+  // Blocks sealed since the last clear(); each one's seq is its position
+  // in that count, so a reader can tell which it has already seen
+  uint32_t sealedTotal() const { return sealedCount; }
+
+  // A sealed block by seq, or nullptr once it has been overwritten
+  const PdSeriesBlock *sealed(uint32_t seq) const;
+
+  // The block still filling (may hold no samples)
+  const PdSeriesBlock &open() const { return blocks[openSlot()]; }
+
+  // Time of the oldest sample still held; false if there is none
+  bool oldestMs(uint32_t &ms) const;
+
+  // Calls fn(sample) for every sample in [fromMs, toMs], oldest first,
+  // returns how many matched
+  template <typename Fn>
+  size_t forEachSample(uint32_t fromMs, uint32_t toMs, Fn fn) const;
+
+private:
+  PdSeriesBlock blocks[USB_PD_SERIES_RAM_BLOCKS + 1];
+  PdSeriesEncoder encoder;
+  uint32_t sealedCount = 0;
+
+  size_t openSlot() const {
+    return sealedCount % (USB_PD_SERIES_RAM_BLOCKS + 1);
+  }
+};
+
+// Decodes the samples of block inside [fromMs, toMs], oldest first
+template <typename Fn>
+size_t forEachBlockSample(const PdSeriesBlock &block, uint32_t fromMs,
+                          uint32_t toMs, Fn fn) {
+  size_t n = 0;
+  PdSeriesDecoder decoder(block);
+  PdTelemetrySample sample;
+  while (decoder.next(sample)) {
+    if ((int32_t)(sample.ms - fromMs) < 0) {
+      continue;
+    }
+    if ((int32_t)(toMs - sample.ms) < 0) {
+      break;
+    }
+    fn(sample);
+    ++n;
+  }
+  return n;
+}
+
+// Whether block has samples in [fromMs, toMs], from its header alone
+inline bool blockOverlaps(const PdSeriesBlock &block, uint32_t fromMs,
+                          uint32_t toMs) {
+  return block.count > 0 && (int32_t)(block.lastMs - fromMs) >= 0 &&
+         (int32_t)(toMs - block.firstMs) >= 0;
+}
+
+template <typename Fn>
+size_t PdSeriesRing::forEachSample(uint32_t fromMs, uint32_t toMs,
+                                   Fn fn) const {
+  size_t n = 0;
+  uint32_t oldest = sealedCount > USB_PD_SERIES_RAM_BLOCKS
+                        ? sealedCount - USB_PD_SERIES_RAM_BLOCKS
+                        : 0;
+  for (uint32_t seq = oldest; seq < sealedCount; ++seq) {
+    const PdSeriesBlock *block = sealed(seq);
+    if (blockOverlaps(*block, fromMs, toMs)) {
+      n += forEachBlockSample(*block, fromMs, toMs, fn);
+    }
+  }
+  if (blockOverlaps(open(), fromMs, toMs)) {
+    n += forEachBlockSample(open(), fromMs, toMs, fn);
+  }
+  return n;
+}
+
+// Append-only files the series log writes to, one per segment. Keeps the
+// log independent of the filesystem; see LittleFsSeriesStorage.
+class IPdSeriesStorage {
+public:
+  virtual ~IPdSeriesStorage() = default;
+
+  // Bytes in segment (0 if it does not exist)
+  virtual size_t size(uint8_t segment) = 0;
+
+  virtual bool read(uint8_t segment, size_t offset, void *buf,
+                    size_t len) = 0;
+  virtual bool append(uint8_t segment, const void *buf, size_t len) = 0;
+
+  // Removes segment, so the next append starts it afresh
+  virtual bool erase(uint8_t segment) = 0;
+};
+
+// Sealed blocks in an append-only log of two segments, with a RAM index
+// for range reads
+class PdSeriesLog {
+public:
+  explicit PdSeriesLog(IPdSeriesStorage &storage) : storage(storage) {}
+
+  // Rebuilds the index from the segments; blocks appended later are
+  // tagged with boot. A torn block at the end of a segment (power lost
+  // mid-write) ends that segment. Returns the blocks found.
+  size_t begin(uint32_t boot);
+
+  // Appends a copy of block, stamped with the next seq and this boot.
+  // false if the storage refused the write.
+  bool append(const PdSeriesBlock &block);
+
+  size_t blockCount() const { return counts[0] + counts[1]; }
+  uint32_t nextSeq() const { return seq; }
+  uint32_t bootId() const { return boot; }
+
+  // Reads the blocks of boot overlapping [fromMs, toMs] into scratch and
+  // calls fn(sample) for their samples in the range, oldest first.
+  // Returns the samples visited.
+  template <typename Fn>
+  size_t forEachSample(uint32_t bootId, uint32_t fromMs, uint32_t toMs,
+                       PdSeriesBlock &scratch, Fn fn);
+
+private:
+  struct IndexEntry {
+    uint32_t boot;
+    uint32_t firstMs;
+    uint32_t lastMs;
+  };
+
+  IPdSeriesStorage &storage;
+  IndexEntry index[2][USB_PD_SERIES_SEGMENT_BLOCKS];
+  uint16_t counts[2] = {0, 0};
+  uint8_t active = 0;
+  bool sealedActive = false; // Active segment ends in a torn block
+  uint32_t seq = 0;
+  uint32_t boot = 0;
+
+  // Indexes the good blocks of segment; false if anything follows them
+  bool scan(uint8_t segment, uint32_t &lastSeq);
+  bool readBlock(uint8_t segment, size_t i, PdSeriesBlock &out);
+};
+
+template <typename Fn>
+size_t PdSeriesLog::forEachSample(uint32_t bootId, uint32_t fromMs,
+                                  uint32_t toMs, PdSeriesBlock &scratch,
+                                  Fn fn) {
+  size_t n = 0;
+  uint8_t order[2] = {(uint8_t)(1 - active), active};
+  for (uint8_t segment : order) {
+    for (size_t i = 0; i < counts[segment]; ++i) {
+      const IndexEntry &e = index[segment][i];
+      if (e.boot != bootId || (int32_t)(e.lastMs - fromMs) < 0 ||
+          (int32_t)(toMs - e.firstMs) < 0) {
+        continue;
+      }
+      if (readBlock(segment, i, scratch)) {
+        n += forEachBlockSample(scratch, fromMs, toMs, fn);
+      }
+    }
+  }
+  return n;
+}
+
+#endif // USB_PD_SERIES_H
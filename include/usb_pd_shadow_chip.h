@@ -0,0 +1,100 @@
+#ifndef USB_PD_SHADOW_CHIP_H
+#define USB_PD_SHADOW_CHIP_H
+
+#include <stdint.h>
+#include <usb_pd_chip.h>
+
+// Decorator that shadows the PDO registers of another IUsbPdChip to skip
+// redundant writes; reads always reach the device
+class ShadowedUsbPdChip : public IUsbPdChip {
+public:
+  explicit ShadowedUsbPdChip(IUsbPdChip &inner) : inner(inner) {}
+
+  bool selectBus(uint8_t bus) override;
+  void setI2cClient(int client) override { inner.setI2cClient(client); }
+  bool probe(uint8_t i2cAddress) override;
+  bool begin() override;
+  void read() override;
+
+  int getPdoNumber() const override;
+  float getVoltage(int pdoIndex) const override;
+  float getCurrent(int pdoIndex) const override;
+
+  void setVoltage(int pdoIndex, float volts) override;
+  void setCurrent(int pdoIndex, float amps) override;
+  void setPdoNumber(int pdoIndex) override;
+
+  bool readPdoSet(PdoSet &out) override;
+  void writePdoSet(const PdoSet &set) override;
+
+  void write() override;
+  void softReset() override;
+  void writeVolatile() override;
+
+  // Status and alert registers are live; always forwarded
+  PdContract readContract() override { return inner.readContract(); }
+  bool enableAttachAlert() override { return inner.enableAttachAlert(); }
+  void clearAlerts() override { inner.clearAlerts(); }
+  bool setBusClock(uint32_t hz) override { return inner.setBusClock(hz); }
+  bool readRegisterImage(PdRegisterImage &out) override {
+    return inner.readRegisterImage(out);
+  }
+  // The device may have been reset underneath; the shadow is dropped
+  bool recoverBus(int sda, int scl) override;
+
+  // Drop the shadow and any staged changes
+  void invalidate();
+
+  // Reload the shadow from the device now; false if it could not be read
+  bool refresh();
+
+  bool isLoaded() const { return loaded; }
+  bool isDirty() const { return dirty != 0; }
+
+  // True when runtime registers hold changes not yet committed to NVM
+  bool hasUncommittedChanges() const {
+    return (dirty & (uint8_t)~runtimeDirty) != 0;
+  }
+
+  // Diagnostics: operations answered without touching the device
+  uint32_t getWritesSkipped() const { return writesSkipped; }
+  uint32_t getResetsSkipped() const { return resetsSkipped; }
+
+private:
+  // Dirty bits: PDO number, then voltage and current for PDO 1..3
+  static constexpr uint8_t DIRTY_PDO_NUMBER = 1u << 0;
+  static constexpr uint8_t dirtyVoltageBit(int pdoIndex) {
+    return (uint8_t)(1u << pdoIndex);
+  }
+  static constexpr uint8_t dirtyCurrentBit(int pdoIndex) {
+    return (uint8_t)(1u << (pdoIndex + 3));
+  }
+  static bool validIndex(int pdoIndex) { return pdoIndex >= 1 && pdoIndex <= 3; }
+
+  IUsbPdChip &inner;
+  bool loaded = false;
+  bool resetPending = false;
+  uint8_t dirty = 0;        // Fields changed since the last NVM write
+  uint8_t runtimeDirty = 0; // Fields changed since the last runtime apply
+
+  // Values as decoded by the device (after its own rounding)
+  int pdoNumber = 0;
+  float voltage[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  float current[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+  // Last values requested through the setters; a repeat request of the same
+  // value is a no-op even if the device rounded it when stored
+  float requestedVoltage[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  float requestedCurrent[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+  uint32_t writesSkipped = 0;
+  uint32_t resetsSkipped = 0;
+
+  bool reload();
+  void ensureLoaded();
+  void capture(const PdoSet &set);
+  void forwardFields(uint8_t fields);
+  void captureRounding();
+};
+
+#endif // USB_PD_SHADOW_CHIP_H
@@ -0,0 +1,81 @@
+#ifndef USB_PD_SNAPSHOT_H
+#define USB_PD_SNAPSHOT_H
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+
+// Point-in-time view of the PD chip as last sampled from the bus.
+// Kept trivially copyable so it can be published through PdSnapshotStore.
+struct PdSnapshot {
+  uint32_t version = 0;     // Assigned by PdSnapshotStore on publish
+  uint32_t sampledAtMs = 0; // millis() at the time of sampling
+  bool connected = false;   // Chip answered the I2C probe
+  bool initialized = false; // Chip begin() succeeded
+  bool valid = false;       // Active PDO voltage/current read back > 0
+  int activePdo = 0;
+  float voltage = 0.0f; // Active PDO voltage
+  float current = 0.0f; // Active PDO current
+
+  // Per-PDO values, indexed 1..3 to match the chip API (index 0 unused)
+  float pdoVoltage[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  float pdoCurrent[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+};
+
+// True when a and b report the same chip state; sample time and version
+// are not compared
+inline bool sameState(const PdSnapshot &a, const PdSnapshot &b) {
+  if (a.connected != b.connected || a.initialized != b.initialized ||
+      a.valid != b.valid || a.activePdo != b.activePdo ||
+      a.voltage != b.voltage || a.current != b.current) {
+    return false;
+  }
+  for (int i = 1; i <= 3; ++i) {
+    if (a.pdoVoltage[i] != b.pdoVoltage[i] ||
+        a.pdoCurrent[i] != b.pdoCurrent[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Single-writer, multi-reader seqlock around a PdSnapshot.
+// The writer (whoever holds the chip lock) publishes complete snapshots;
+// readers never block and retry only if they raced a publish.
+class PdSnapshotStore {
+public:
+  void publish(const PdSnapshot &snapshot) {
+    uint32_t seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy(&data, &snapshot, sizeof(data));
+    data.version = (seq >> 1) + 1;
+
+    sequence.store(seq + 2, std::memory_order_release);
+  }
+
+  PdSnapshot read() const {
+    PdSnapshot out;
+    uint32_t before;
+    uint32_t after;
+    do {
+      before = sequence.load(std::memory_order_acquire);
+      memcpy(&out, &data, sizeof(out));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = sequence.load(std::memory_order_relaxed);
+    } while ((before & 1u) != 0 || before != after);
+    return out;
+  }
+
+  // Number of snapshots published so far (0 until the first sample)
+  uint32_t version() const {
+    return sequence.load(std::memory_order_acquire) >> 1;
+  }
+
+private:
+  std::atomic<uint32_t> sequence{0};
+  PdSnapshot data;
+};
+
+#endif // USB_PD_SNAPSHOT_H
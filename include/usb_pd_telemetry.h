@@ -0,0 +1,163 @@
+#ifndef USB_PD_TELEMETRY_H
+#define USB_PD_TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Capacity of each tier. Memory is fixed at compile time: 8 bytes per raw
+// sample and 24 per rollup bucket (under 8 KB per port with the
+// defaults). Keep each in the hundreds at most, queries walk a whole tier.
+#ifndef USB_PD_TELEMETRY_RAW_SAMPLES
+#define USB_PD_TELEMETRY_RAW_SAMPLES 120
+#endif
+
+#ifndef USB_PD_TELEMETRY_SECONDS
+#define USB_PD_TELEMETRY_SECONDS 120 // 2 minutes of 1 s buckets
+#endif
+
+#ifndef USB_PD_TELEMETRY_MINUTES
+#define USB_PD_TELEMETRY_MINUTES 120 // 2 hours of 1 min buckets
+#endif
+
+#ifndef USB_PD_TELEMETRY_HOURS
+#define USB_PD_TELEMETRY_HOURS 48 // 2 days of 1 h buckets
+#endif
+
+// Most points a query returns
+#ifndef USB_PD_HISTORY_MAX_POINTS
+#define USB_PD_HISTORY_MAX_POINTS 120
+#endif
+
+// Raw sample, in mV and mA to keep it at 8 bytes
+struct PdTelemetrySample {
+  uint32_t ms = 0;
+  uint16_t millivolts = 0;
+  uint16_t milliamps = 0;
+};
+
+// Samples that fell into [startMs, startMs + tier width)
+struct PdTelemetryBucket {
+  uint32_t startMs = 0;
+  uint32_t count = 0;
+  uint32_t millivoltSum = 0;
+  uint32_t milliampSum = 0;
+  uint16_t minMillivolts = 0;
+  uint16_t maxMillivolts = 0;
+  uint16_t minMilliamps = 0;
+  uint16_t maxMilliamps = 0;
+
+  void add(uint16_t millivolts, uint16_t milliamps);
+  void merge(const PdTelemetryBucket &other);
+
+  uint16_t meanMillivolts() const {
+    return count ? (uint16_t)((millivoltSum + count / 2) / count) : 0;
+  }
+  uint16_t meanMilliamps() const {
+    return count ? (uint16_t)((milliampSum + count / 2) / count) : 0;
+  }
+};
+
+// Fixed-capacity ring that overwrites its oldest entry when full
+template <typename T, size_t N> class PdRing {
+public:
+  static constexpr size_t capacity = N;
+
+  void push(const T &value) {
+    items[head] = value;
+    head = (head + 1) % N;
+    if (count < N) {
+      ++count;
+    }
+  }
+
+  void clear() { head = count = 0; }
+  size_t size() const { return count; }
+  bool full() const { return count == N; }
+
+  // age 0 is the newest entry, size() - 1 the oldest
+  const T &newest(size_t age) const { return items[(head + N - 1 - age) % N]; }
+
+private:
+  T items[N];
+  size_t head = 0;
+  size_t count = 0;
+};
+
+enum class PdTelemetryTier : uint8_t { Raw, Seconds, Minutes, Hours };
+
+// Name used by /api/history ("raw", "1s", "1m", "1h")
+const char *telemetryTierName(PdTelemetryTier tier);
+
+// Parses a tier name; false (tier untouched) for anything else
+bool parseTelemetryTier(const char *name, PdTelemetryTier &tier);
+
+// One point of a query: a raw sample (count 1, min = mean = max) or a
+// rollup bucket
+struct PdTelemetryPoint {
+  uint32_t ms;
+  uint32_t count;
+  uint16_t minMillivolts, meanMillivolts, maxMillivolts;
+  uint16_t minMilliamps, meanMilliamps, maxMilliamps;
+};
+
+// Voltage/current history in fixed memory: raw samples plus 1 s, 1 min and
+// 1 h rollups, O(1) per record(). Not thread-safe.
+class PdTelemetryStore {
+public:
+  // Returns the 1 s bucket this sample closed, if it closed one (valid
+  // until the next record())
+  const PdTelemetryBucket *record(uint32_t ms, float voltage, float current);
+  void clear();
+
+  // Samples recorded since the last clear()
+  uint32_t recorded() const { return samples; }
+
+  // Bucket width in ms (0 for raw samples)
+  static uint32_t widthMs(PdTelemetryTier tier);
+
+  // Finest tier that still holds data back to fromMs and has at most
+  // maxPoints points in [fromMs, toMs]; the hour tier if none does
+  PdTelemetryTier pickTier(uint32_t fromMs, uint32_t toMs,
+                           size_t maxPoints) const;
+
+  // Points of tier overlapping [fromMs, toMs], oldest first, with the
+  // still-open bucket last. At most maxPoints, the newest ones when there
+  // are more; returns how many were written to out.
+  size_t query(PdTelemetryTier tier, uint32_t fromMs, uint32_t toMs,
+               PdTelemetryPoint *out, size_t maxPoints) const;
+
+  // Points query() would find before the maxPoints cut (at most a tier)
+  size_t countPoints(PdTelemetryTier tier, uint32_t fromMs,
+                     uint32_t toMs) const;
+
+private:
+  PdRing<PdTelemetrySample, USB_PD_TELEMETRY_RAW_SAMPLES> raw;
+  PdRing<PdTelemetryBucket, USB_PD_TELEMETRY_SECONDS> seconds;
+  PdRing<PdTelemetryBucket, USB_PD_TELEMETRY_MINUTES> minutes;
+  PdRing<PdTelemetryBucket, USB_PD_TELEMETRY_HOURS> hours;
+
+  // Buckets still filling, one per rollup tier
+  PdTelemetryBucket openSecond;
+  PdTelemetryBucket openMinute;
+  PdTelemetryBucket openHour;
+
+  uint32_t firstMs = 0;
+  uint32_t lastMs = 0;
+  uint32_t samples = 0;
+
+  void closeSecond();
+  void closeMinute();
+  void closeHour();
+
+  // Open bucket of tier with the finer open buckets folded in
+  PdTelemetryBucket openBucket(PdTelemetryTier tier) const;
+
+  // Closed entries of tier and the point for one of them (age 0 = newest)
+  size_t closedCount(PdTelemetryTier tier) const;
+  PdTelemetryPoint closedPoint(PdTelemetryTier tier, size_t age) const;
+
+  // Whether tier still holds everything from fromMs on
+  bool reachesBack(PdTelemetryTier tier, uint32_t fromMs) const;
+};
+
+#endif // USB_PD_TELEMETRY_H
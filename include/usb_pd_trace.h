@@ -0,0 +1,114 @@
+#ifndef USB_PD_TRACE_H
+#define USB_PD_TRACE_H
+
+// Compile-time switch for span tracing of configure steps, sampling and
+// route handlers. Off by default: the macros below expand to nothing and
+// /api/trace is not registered.
+#ifndef USB_PD_TRACE
+#define USB_PD_TRACE 0
+#endif
+
+// Spans kept in the ring; older ones are overwritten. 20 bytes each.
+#ifndef USB_PD_TRACE_EVENTS
+#define USB_PD_TRACE_EVENTS 256
+#endif
+
+#if USB_PD_TRACE
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <usb_pd_json_writer.h>
+
+// Fixed lock-free ring of completed spans; timestamps are microseconds and
+// wrap after about 71 minutes
+class PdTraceRecorder {
+public:
+  typedef uint32_t (*ClockFn)();
+
+  void setClock(ClockFn nowUs) { clockFn = nowUs; }
+  uint32_t now() const { return clockFn ? clockFn() : 0; }
+
+  // name must outlive the recorder, e.g. a string literal
+  void record(const char *name, uint32_t startUs, uint32_t endUs);
+
+  // Spans recorded since boot or the last clear(), including overwritten
+  // ones
+  uint32_t recorded() const {
+    return head.load(std::memory_order_relaxed) -
+           base.load(std::memory_order_relaxed);
+  }
+  void clear() {
+    base.store(head.load(std::memory_order_relaxed),
+               std::memory_order_relaxed);
+  }
+
+  // Chrome trace-event JSON ("X" events), oldest span first; loads in
+  // chrome://tracing and Perfetto. With clearWritten, the written spans are
+  // dropped afterwards; any recorded meanwhile are kept.
+  void writeChromeTrace(PdJsonWriter &json, bool clearWritten = false);
+
+private:
+  struct Slot {
+    std::atomic<uint32_t> seq{0}; // Span number + 1 once written, 0 while busy
+    std::atomic<const char *> name{nullptr};
+    std::atomic<uint32_t> startUs{0};
+    std::atomic<uint32_t> durUs{0};
+    std::atomic<uint32_t> tid{0};
+  };
+
+  Slot slots[USB_PD_TRACE_EVENTS];
+  std::atomic<uint32_t> head{0};
+  std::atomic<uint32_t> base{0};
+  ClockFn clockFn = nullptr;
+};
+
+extern PdTraceRecorder pdTrace;
+
+// Span from construction to end() or destruction, whichever comes first
+class PdTraceSpan {
+public:
+  explicit PdTraceSpan(const char *name) : name(name), startUs(pdTrace.now()) {}
+  ~PdTraceSpan() { end(); }
+
+  PdTraceSpan(const PdTraceSpan &) = delete;
+  PdTraceSpan &operator=(const PdTraceSpan &) = delete;
+
+  void end() {
+    if (name) {
+      pdTrace.record(name, startUs, pdTrace.now());
+      name = nullptr;
+    }
+  }
+
+private:
+  const char *name;
+  uint32_t startUs;
+};
+
+#define USB_PD_TRACE_CAT2(a, b) a##b
+#define USB_PD_TRACE_CAT(a, b) USB_PD_TRACE_CAT2(a, b)
+
+// Open a span held in the local variable span; USB_PD_TRACE_END(span) or
+// the end of the scope closes it
+#define USB_PD_TRACE_BEGIN(span, name) PdTraceSpan span(name)
+#define USB_PD_TRACE_END(span) span.end()
+
+// Span covering the rest of the enclosing scope
+#define USB_PD_TRACE_SCOPE(name)                                               \
+  USB_PD_TRACE_BEGIN(USB_PD_TRACE_CAT(pdTraceSpan_, __LINE__), name)
+
+// Span timed by the caller with the trace clock
+#define USB_PD_TRACE_RECORD(name, startUs, endUs)                              \
+  pdTrace.record(name, startUs, endUs)
+
+#else
+
+#define USB_PD_TRACE_BEGIN(span, name)
+#define USB_PD_TRACE_END(span)
+#define USB_PD_TRACE_SCOPE(name)
+#define USB_PD_TRACE_RECORD(name, startUs, endUs)
+
+#endif // USB_PD_TRACE
+
+#endif // USB_PD_TRACE_H
@@ -0,0 +1,148 @@
+"""Compare bench_native results against the committed baseline.
+
+Reads the JSON lines printed by the bench_native program (other lines are
+ignored) and checks every benchmark against test/bench/baseline.json.
+Latency may exceed the baseline by the relative ns_per_op tolerance;
+allocations, bytes per op and the heap peak may not exceed it by more than
+their absolute tolerances.
+
+The heap metrics are deterministic, so --update records them on any host
+and a benchmark without them (null) fails the check. ns_per_op depends on
+the host; --update only records it with --latency, which belongs on the
+reference machine. A null ns_per_op is reported, not checked, unless
+--latency is given there too.
+
+Usage:
+    pio run -e bench_native -t exec | tee bench_output.txt
+    python scripts/bench_compare.py bench_output.txt
+    python scripts/bench_compare.py --update bench_output.txt
+    python scripts/bench_compare.py --update --latency bench_output.txt
+
+Exits with 1 when a benchmark regressed, disappeared or has no baseline for
+a checked metric (a new benchmark has none).
+"""
+
+import argparse
+import json
+import os
+import sys
+
+METRICS = ("ns_per_op", "allocs_per_op", "bytes_per_op", "peak_bytes")
+HEAP_METRICS = METRICS[1:]
+DEFAULT_BASELINE = os.path.join("test", "bench", "baseline.json")
+
+
+def load_results(path):
+    results = {}
+    with open(path, "r", encoding="utf-8") as f:
+        for line in f:
+            line = line.strip()
+            if not line.startswith("{"):
+                continue
+            try:
+                entry = json.loads(line)
+            except ValueError:
+                continue
+            if "name" in entry:
+                results[entry["name"]] = entry
+    return results
+
+
+def exceeds(metric, base, now, tolerance):
+    if metric == "ns_per_op":
+        return now > base * (1.0 + tolerance)
+    return now > base + tolerance
+
+
+def compare(baseline, results, latency=False):
+    tolerance = baseline.get("tolerance", {})
+    required = METRICS if latency else HEAP_METRICS
+    rows = []
+    failed = False
+    for name, base in sorted(baseline.get("benchmarks", {}).items()):
+        now = results.get(name)
+        if now is None:
+            rows.append((name, base, None, "missing"))
+            failed = True
+            continue
+        unrecorded = [m for m in required if base.get(m) is None]
+        if unrecorded:
+            rows.append((name, base, now, "NO BASELINE " + ",".join(unrecorded)))
+            failed = True
+            continue
+        checked = [m for m in METRICS if base.get(m) is not None]
+        worse = [
+            m
+            for m in checked
+            if exceeds(m, base[m], now[m], tolerance.get(m, 0.0))
+        ]
+        rows.append((name, base, now, "REGRESSED " + ",".join(worse) if worse else "ok"))
+        failed = failed or bool(worse)
+    for name in sorted(set(results) - set(baseline.get("benchmarks", {}))):
+        rows.append((name, None, results[name], "NO BASELINE (new)"))
+        failed = True
+    return rows, failed
+
+
+def fmt(entry, metric):
+    if entry is None or entry.get(metric) is None:
+        return "-"
+    return f"{entry[metric]:.1f}" if metric == "ns_per_op" else f"{entry[metric]:.2f}"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("results", nargs="?", default="bench_output.txt")
+    parser.add_argument("--baseline", default=DEFAULT_BASELINE)
+    parser.add_argument(
+        "--update", action="store_true", help="record these results as the baseline"
+    )
+    parser.add_argument(
+        "--latency",
+        action="store_true",
+        help="record ns_per_op with --update, require it otherwise "
+        "(reference machine only)",
+    )
+    args = parser.parse_args()
+
+    try:
+        results = load_results(args.results)
+        with open(args.baseline, "r", encoding="utf-8") as f:
+            baseline = json.load(f)
+    except (OSError, ValueError) as e:
+        print(f"[bench_compare] ERROR: {e}", file=sys.stderr)
+        return 1
+    if not results:
+        print(f"[bench_compare] ERROR: no results in {args.results}", file=sys.stderr)
+        return 1
+
+    if args.update:
+        previous = baseline.get("benchmarks", {})
+        recorded = {}
+        for name, entry in sorted(results.items()):
+            recorded[name] = {m: entry[m] for m in METRICS}
+            if not args.latency:
+                recorded[name]["ns_per_op"] = previous.get(name, {}).get("ns_per_op")
+        baseline["benchmarks"] = recorded
+        with open(args.baseline, "w", encoding="utf-8") as f:
+            json.dump(baseline, f, indent=2)
+            f.write("\n")
+        print(f"[bench_compare] Recorded {len(results)} benchmarks in {args.baseline}")
+        return 0
+
+    rows, failed = compare(baseline, results, args.latency)
+    print(
+        f"{'benchmark':<30} {'ns/op':>17} {'allocs/op':>13} {'bytes/op':>15} "
+        f"{'peak':>15}  status"
+    )
+    for name, base, now, status in rows:
+        cells = [f"{fmt(base, m)} -> {fmt(now, m)}" for m in METRICS]
+        print(
+            f"{name:<30} {cells[0]:>17} {cells[1]:>13} {cells[2]:>15} "
+            f"{cells[3]:>15}  {status}"
+        )
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
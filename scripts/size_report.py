@@ -0,0 +1,104 @@
+"""Flash size of the USBPDCore / USBPDController chip bindings.
+
+Sums the code of every BasicUSBPDCore<Chip> and BasicUSBPDController<Chip>
+member per chip type, so the virtual (IUsbPdChip) and statically bound
+variants can be compared. Works on a linked program or on a single object
+file; the latter also counts instantiations the linker would drop.
+
+Usage:
+    python scripts/size_report.py .pio/build/test_native/program
+    python scripts/size_report.py --nm xtensa-esp32s3-elf-nm \\
+        .pio/build/test_esp32/src/usb_pd_controller.cpp.o
+
+RAM per variant is the object size printed by the native static dispatch
+test (sizeof of the core and controller).
+"""
+
+import argparse
+import json
+import re
+import subprocess
+import sys
+
+TEMPLATES = ("BasicUSBPDCore", "BasicUSBPDController")
+CODE_TYPES = set("tTwW")
+
+
+def chip_argument(name, template):
+    """Template argument following template< in a demangled name."""
+    start = name.find(template + "<")
+    if start < 0:
+        return None
+    i = start + len(template) + 1
+    depth = 1
+    for j in range(i, len(name)):
+        if name[j] == "<":
+            depth += 1
+        elif name[j] == ">":
+            depth -= 1
+            if depth == 0:
+                return name[i:j]
+    return None
+
+
+def collect(nm, path):
+    out = subprocess.run(
+        [nm, "-C", "-S", "--size-sort", path],
+        check=True,
+        capture_output=True,
+        text=True,
+    ).stdout
+    sizes = {}
+    for line in out.splitlines():
+        match = re.match(r"^[0-9a-fA-F]+ ([0-9a-fA-F]+) (\w) (.*)$", line)
+        if not match or match.group(2) not in CODE_TYPES:
+            continue
+        size, name = int(match.group(1), 16), match.group(3)
+        for template in TEMPLATES:
+            # Members and the lambdas defined in them; library internals
+            # instantiated for them (std::function thunks) are not counted
+            if not name.startswith(template + "<"):
+                continue
+            chip = chip_argument(name, template)
+            if chip is None:
+                continue
+            entry = sizes.setdefault((template, chip), {"bytes": 0, "symbols": 0})
+            entry["bytes"] += size
+            entry["symbols"] += 1
+            break
+    return sizes
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("binary", help="linked program or object file")
+    parser.add_argument("--nm", default="nm", help="nm for the target toolchain")
+    parser.add_argument("--json", action="store_true", help="machine-readable output")
+    args = parser.parse_args()
+
+    try:
+        sizes = collect(args.nm, args.binary)
+    except (OSError, subprocess.CalledProcessError) as e:
+        print(f"[size_report] ERROR: {e}", file=sys.stderr)
+        return 1
+
+    rows = [
+        {"template": t, "chip": c, "bytes": v["bytes"], "symbols": v["symbols"]}
+        for (t, c), v in sorted(sizes.items())
+    ]
+    if args.json:
+        print(json.dumps(rows, indent=2))
+    elif not rows:
+        print("[size_report] No BasicUSBPDCore/BasicUSBPDController code found")
+    else:
+        print(f"{'class':<24} {'chip':<20} {'flash':>8} {'symbols':>8}")
+        for row in rows:
+            print(
+                f"{row['template']:<24} {row['chip']:<20} "
+                f"{row['bytes']:>8} {row['symbols']:>8}"
+            )
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -4,48 +4,350 @@
 
 #include <SparkFun_STUSB4500.h>
 #include <Wire.h>
+#include <new>
+#include <usb_pd_i2c_bus.h>
 
-class STUSB4500Chip::Impl {
-public:
-  STUSB4500 chip;
-};
+// Runtime (volatile) sink PDO registers, see STUSB4500 register map.
+// DPM_PDO_NUMB through the last sink PDO is read as one block.
+static const uint8_t REG_DPM_PDO_NUMB = 0x70;
+static const uint8_t REG_DPM_SNK_PDO1 = 0x85; // 3 x 32-bit, little endian
+static const uint8_t PDO_WORDS_LEN = 12;
+static const uint8_t PDO_BLOCK_LEN =
+    REG_DPM_SNK_PDO1 + PDO_WORDS_LEN - REG_DPM_PDO_NUMB;
 
-STUSB4500Chip::STUSB4500Chip() : impl(new Impl()) {}
+// Alert registers; ALERT_STATUS_1, its mask and PORT_STATUS_0 are
+// consecutive so one burst read acknowledges an attach/detach alert
+static const uint8_t REG_ALERT_STATUS_1 = 0x0B;
+static const uint8_t REG_ALERT_STATUS_1_MASK = 0x0C; // 1 = source masked
+static const uint8_t ALERT_CC_DETECTION = 0x40;
+
+// Contract status registers
+static const uint8_t REG_PORT_STATUS_1 = 0x0E; // Bit 0: source attached
+static const uint8_t REG_RDO_STATUS = 0x91;    // 32-bit RDO, little endian
+
+// Fixed identification register, read back with the PDO block to verify
+// the bus
+static const uint8_t REG_DEVICE_ID = 0x2F;
+static_assert(1 + PDO_BLOCK_LEN <= USB_PD_REGISTER_IMAGE_LEN,
+              "USB_PD_REGISTER_IMAGE_LEN too small for the STUSB4500 image");
+
+// Sink fixed PDO fields: voltage in 50 mV units at [19:10], operational
+// current in 10 mA units at [9:0]. Upper flag bits are preserved.
+static const uint32_t PDO_VOLTAGE_CURRENT_MASK = 0x000FFFFFUL;
+
+static uint32_t loadWord(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+static void storeWord(uint8_t *p, uint32_t word) {
+  p[0] = (uint8_t)word;
+  p[1] = (uint8_t)(word >> 8);
+  p[2] = (uint8_t)(word >> 16);
+  p[3] = (uint8_t)(word >> 24);
+}
+
+static bool validPdo(int pdoIndex) { return pdoIndex >= 1 && pdoIndex <= 3; }
+
+static bool readRegisters(TwoWire &wire, uint8_t address, uint8_t reg,
+                          uint8_t *buf, uint8_t len) {
+  wire.beginTransmission(address);
+  wire.write(reg);
+  if (wire.endTransmission(false) != 0) {
+    return false;
+  }
+  if (wire.requestFrom(address, len) != len) {
+    return false;
+  }
+  for (uint8_t i = 0; i < len; ++i) {
+    buf[i] = wire.read();
+  }
+  return true;
+}
+
+static bool writeRegisters(TwoWire &wire, uint8_t address, uint8_t reg,
+                           const uint8_t *buf, uint8_t len) {
+  wire.beginTransmission(address);
+  wire.write(reg);
+  wire.write(buf, len);
+  return wire.endTransmission() == 0;
+}
+
+// Holds the bus for the rest of an operation. Callers that already hold it
+// for a batch or a higher priority (the controller) are joined.
+#define STUSB4500_BUS_GRANT()                                                  \
+  PdI2cBus::Grant grant(bus, busClient, PdI2cPriority::Status)
+
+STUSB4500Chip::STUSB4500Chip() : wire(pdI2cWire(0)), bus(pdI2cBus(0)) {
+  static_assert(sizeof(STUSB4500) <= DRIVER_STORAGE,
+                "STUSB4500Chip::DRIVER_STORAGE too small for the driver");
+  static_assert(alignof(STUSB4500) <= alignof(void *),
+                "STUSB4500Chip::driverStorage under-aligned for the driver");
+  new (driverStorage) STUSB4500();
+}
+
+STUSB4500Chip::~STUSB4500Chip() { driver().~STUSB4500(); }
+
+STUSB4500 &STUSB4500Chip::driver() {
+  return *reinterpret_cast<STUSB4500 *>(driverStorage);
+}
+
+bool STUSB4500Chip::selectBus(uint8_t n) {
+  TwoWire *selected = pdI2cWire(n);
+  if (!selected) {
+    return false;
+  }
+  wire = selected;
+  bus = pdI2cBus(n);
+  // Client ids are per bus; the controller hands over its own next
+  busClient = -1;
+  return true;
+}
 
 bool STUSB4500Chip::probe(uint8_t i2cAddress) {
-  Wire.beginTransmission(i2cAddress);
-  uint8_t err = Wire.endTransmission();
+  STUSB4500_BUS_GRANT();
+  address = i2cAddress;
+  wire->beginTransmission(i2cAddress);
+  uint8_t err = wire->endTransmission();
   return err == 0;
 }
 
-bool STUSB4500Chip::begin() { return impl->chip.begin(); }
+bool STUSB4500Chip::begin() {
+  STUSB4500_BUS_GRANT();
+  rawLoaded = false;
+  staged = 0;
+  return driver().begin(address, *wire);
+}
+
+void STUSB4500Chip::read() {
+  PdoSet set;
+  readPdoSet(set);
+}
 
-void STUSB4500Chip::read() { impl->chip.read(); }
+bool STUSB4500Chip::readPdoSet(PdoSet &out) {
+  STUSB4500_BUS_GRANT();
+  // One burst from DPM_PDO_NUMB to the end of the sink PDOs
+  uint8_t block[PDO_BLOCK_LEN];
+  if (!readRegisters(*wire, address, REG_DPM_PDO_NUMB, block, sizeof(block))) {
+    return false;
+  }
 
-int STUSB4500Chip::getPdoNumber() const { return impl->chip.getPdoNumber(); }
+  image.activePdo = block[0] & 0x07;
+  const uint8_t *words = block + (REG_DPM_SNK_PDO1 - REG_DPM_PDO_NUMB);
+  for (int i = 0; i < 3; ++i) {
+    uint32_t pdo = loadWord(words + i * 4);
+    rawPdo[i] = pdo;
+    image.voltage[i + 1] = ((pdo >> 10) & 0x3FF) * 0.05f;
+    image.current[i + 1] = (pdo & 0x3FF) * 0.01f;
+  }
+  rawLoaded = true;
+  staged = 0;
+  out = image;
+  return true;
+}
+
+void STUSB4500Chip::writePdoSet(const PdoSet &set) {
+  setPdoNumber(set.activePdo);
+  for (int i = 1; i <= 3; ++i) {
+    setVoltage(i, set.voltage[i]);
+    setCurrent(i, set.current[i]);
+  }
+}
+
+int STUSB4500Chip::getPdoNumber() const { return image.activePdo; }
 
 float STUSB4500Chip::getVoltage(int pdoIndex) const {
-  return impl->chip.getVoltage(pdoIndex);
+  return validPdo(pdoIndex) ? image.voltage[pdoIndex] : 0.0f;
 }
 
 float STUSB4500Chip::getCurrent(int pdoIndex) const {
-  return impl->chip.getCurrent(pdoIndex);
+  return validPdo(pdoIndex) ? image.current[pdoIndex] : 0.0f;
 }
 
+// Setters round to the register resolution (50 mV, 10 mA) so the getters
+// report what the device will store, and stage only values that change
+
 void STUSB4500Chip::setVoltage(int pdoIndex, float volts) {
-  impl->chip.setVoltage(pdoIndex, volts);
+  // PDO1 is fixed at 5 V by the USB PD specification
+  if (pdoIndex < 2 || pdoIndex > 3) {
+    return;
+  }
+  float rounded = (uint32_t)(volts * 20.0f + 0.5f) * 0.05f;
+  if (rounded != image.voltage[pdoIndex]) {
+    image.voltage[pdoIndex] = rounded;
+    staged |= (uint8_t)(1u << pdoIndex);
+  }
 }
 
 void STUSB4500Chip::setCurrent(int pdoIndex, float amps) {
-  impl->chip.setCurrent(pdoIndex, amps);
+  if (!validPdo(pdoIndex)) {
+    return;
+  }
+  float rounded = (uint32_t)(amps * 100.0f + 0.5f) * 0.01f;
+  if (rounded != image.current[pdoIndex]) {
+    image.current[pdoIndex] = rounded;
+    staged |= (uint8_t)(1u << pdoIndex);
+  }
 }
 
 void STUSB4500Chip::setPdoNumber(int pdoIndex) {
-  impl->chip.setPdoNumber(pdoIndex);
+  if (validPdo(pdoIndex) && pdoIndex != image.activePdo) {
+    image.activePdo = pdoIndex;
+    staged |= STAGED_PDO_NUMBER;
+  }
+}
+
+void STUSB4500Chip::write() {
+  STUSB4500_BUS_GRANT();
+  // The library programs whole NVM sectors, so load them before patching in
+  // the staged PDOs
+  driver().read();
+  driver().setPdoNumber(image.activePdo);
+  for (int i = 1; i <= 3; ++i) {
+    driver().setVoltage(i, image.voltage[i]);
+    driver().setCurrent(i, image.current[i]);
+  }
+  driver().write();
+
+  // NVM is only loaded at power-up; mirror the changed PDOs into the runtime
+  // registers so the renegotiation and readPdoSet() see them straight away
+  writeVolatile();
+}
+
+void STUSB4500Chip::softReset() {
+  STUSB4500_BUS_GRANT();
+  driver().softReset();
 }
 
-void STUSB4500Chip::write() { impl->chip.write(); }
+bool STUSB4500Chip::loadRawPdos() {
+  STUSB4500_BUS_GRANT();
+  uint8_t words[PDO_WORDS_LEN];
+  if (!readRegisters(*wire, address, REG_DPM_SNK_PDO1, words, sizeof(words))) {
+    return false;
+  }
+  for (int i = 0; i < 3; ++i) {
+    rawPdo[i] = loadWord(words + i * 4);
+  }
+  rawLoaded = true;
+  return true;
+}
+
+void STUSB4500Chip::writeVolatile() {
+  if (staged == 0) {
+    return;
+  }
+  STUSB4500_BUS_GRANT();
+  // Keep the per-PDO flag bits set from NVM; they were captured by the last
+  // burst read, so this is normally write-only
+  if (!rawLoaded && !loadRawPdos()) {
+    return;
+  }
+
+  uint8_t words[PDO_WORDS_LEN];
+  for (int i = 0; i < 3; ++i) {
+    if (!(staged & (1u << (i + 1)))) {
+      continue;
+    }
+    uint32_t millivolts = (uint32_t)(image.voltage[i + 1] * 1000.0f + 0.5f);
+    uint32_t milliamps = (uint32_t)(image.current[i + 1] * 1000.0f + 0.5f);
+    uint32_t pdo = rawPdo[i] & ~PDO_VOLTAGE_CURRENT_MASK;
+    pdo |= ((millivolts / 50) & 0x3FF) << 10;
+    pdo |= (milliamps / 10) & 0x3FF;
+    rawPdo[i] = pdo;
+    storeWord(words + i * 4, pdo);
+  }
+
+  // One burst per run of adjacent changed words; failed words stay staged
+  for (int first = 0; first < 3; ++first) {
+    if (!(staged & (1u << (first + 1)))) {
+      continue;
+    }
+    int last = first;
+    while (last < 2 && (staged & (1u << (last + 2)))) {
+      ++last;
+    }
+    uint8_t offset = (uint8_t)(first * 4);
+    uint8_t len = (uint8_t)((last - first + 1) * 4);
+    if (!writeRegisters(*wire, address, REG_DPM_SNK_PDO1 + offset,
+                        words + offset, len)) {
+      rawLoaded = false;
+      return;
+    }
+    for (int i = first; i <= last; ++i) {
+      staged &= (uint8_t)~(1u << (i + 1));
+    }
+    first = last;
+  }
+
+  if (staged & STAGED_PDO_NUMBER) {
+    uint8_t pdoNumber = (uint8_t)(image.activePdo & 0x03);
+    if (writeRegisters(*wire, address, REG_DPM_PDO_NUMB, &pdoNumber, 1)) {
+      staged &= (uint8_t)~STAGED_PDO_NUMBER;
+    }
+  }
+}
 
-void STUSB4500Chip::softReset() { impl->chip.softReset(); }
+PdContract STUSB4500Chip::readContract() {
+  STUSB4500_BUS_GRANT();
+  PdContract contract;
+  uint8_t portStatus;
+  if (!readRegisters(*wire, address, REG_PORT_STATUS_1, &portStatus, 1)) {
+    return contract;
+  }
+  if ((portStatus & 0x01) == 0) {
+    contract.state = PdContractState::Detached;
+    return contract;
+  }
+
+  // The RDO object position (bits [30:28]) is zero until the source has
+  // accepted a request, and is cleared again by a soft reset
+  uint8_t rdo[4];
+  if (!readRegisters(*wire, address, REG_RDO_STATUS, rdo, sizeof(rdo))) {
+    return contract;
+  }
+  int position = (rdo[3] >> 4) & 0x07;
+  contract.state =
+      position ? PdContractState::Ready : PdContractState::Negotiating;
+  contract.pdoNumber = position;
+  contract.rdo = loadWord(rdo);
+  return contract;
+}
+
+bool STUSB4500Chip::enableAttachAlert() {
+  STUSB4500_BUS_GRANT();
+  uint8_t mask = (uint8_t)~ALERT_CC_DETECTION;
+  return writeRegisters(*wire, address, REG_ALERT_STATUS_1_MASK, &mask, 1);
+}
+
+void STUSB4500Chip::clearAlerts() {
+  STUSB4500_BUS_GRANT();
+  // Reading PORT_STATUS_0 clears the attach transition and with it the alert
+  uint8_t status[3];
+  readRegisters(*wire, address, REG_ALERT_STATUS_1, status, sizeof(status));
+}
+
+bool STUSB4500Chip::setBusClock(uint32_t hz) {
+  // Waits for any transfer in flight before retiming the bus
+  STUSB4500_BUS_GRANT();
+  wire->setClock(hz);
+  return true;
+}
+
+bool STUSB4500Chip::readRegisterImage(PdRegisterImage &out) {
+  STUSB4500_BUS_GRANT();
+  // DEVICE_ID and the runtime PDO block, two bursts like the ones every
+  // sample and configure uses
+  out.length = 1 + PDO_BLOCK_LEN;
+  return readRegisters(*wire, address, REG_DEVICE_ID, out.bytes, 1) &&
+         readRegisters(*wire, address, REG_DPM_PDO_NUMB, out.bytes + 1,
+                       PDO_BLOCK_LEN);
+}
+
+bool STUSB4500Chip::recoverBus(int sda, int scl) {
+  STUSB4500_BUS_GRANT();
+  // The device may have been reset too; reload the PDO flag bits
+  rawLoaded = false;
+  return pdI2cRecoverBus(*wire, sda, scl);
+}
 
 #endif // ARDUINO || ESP_PLATFORM
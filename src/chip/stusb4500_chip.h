@@ -1,15 +1,31 @@
 #ifndef STUSB4500_CHIP_ADAPTER_H
 #define STUSB4500_CHIP_ADAPTER_H
 
+#include <stddef.h>
 #include <usb_pd_chip.h>
 
+class PdI2cBus;
+class TwoWire;
+class STUSB4500;
+
 // Adapter around SparkFun STUSB4500 library.
 // Only compiled for Arduino/ESP32 targets.
-class STUSB4500Chip : public IUsbPdChip {
+//
+// PDOs are read from the runtime registers in one burst, and only the words
+// the setters changed are written back; the library is only used for its
+// NVM and reset sequences. Every operation that touches the device holds
+// the bus arbiter, which also covers the library's own Wire traffic.
+//
+// Final so that BasicUSBPDCore<STUSB4500Chip> binds the calls statically.
+class STUSB4500Chip final : public IUsbPdChip {
 public:
   STUSB4500Chip();
-  ~STUSB4500Chip() override = default;
+  ~STUSB4500Chip() override;
+  STUSB4500Chip(const STUSB4500Chip &) = delete;
+  STUSB4500Chip &operator=(const STUSB4500Chip &) = delete;
 
+  bool selectBus(uint8_t bus) override;
+  void setI2cClient(int client) override { busClient = client; }
   bool probe(uint8_t i2cAddress) override;
   bool begin() override;
   void read() override;
@@ -22,13 +38,44 @@ public:
   void setCurrent(int pdoIndex, float amps) override;
   void setPdoNumber(int pdoIndex) override;
 
+  bool readPdoSet(PdoSet &out) override;
+  void writePdoSet(const PdoSet &set) override;
+
   void write() override;
   void softReset() override;
+  void writeVolatile() override;
+  PdContract readContract() override;
+  bool enableAttachAlert() override;
+  void clearAlerts() override;
+  bool setBusClock(uint32_t hz) override;
+  bool readRegisterImage(PdRegisterImage &out) override;
+  bool recoverBus(int sda, int scl) override;
 
 private:
-  // Forward-declared in cpp to avoid leaking Arduino headers here
-  class Impl;
-  Impl *impl; // PIMPL to keep headers Arduino-free
+  TwoWire *wire;          // Bus the device sits on (Wire unless selected)
+  PdI2cBus *bus;          // Its arbiter
+  int busClient = -1;     // The controller's client for this port
+  uint8_t address = 0x28; // Last probed address, used for direct register I/O
+
+  // Register image: PDOs as last read or staged by the setters, and the raw
+  // PDO words whose flag bits a runtime write must preserve
+  PdoSet image;
+  uint32_t rawPdo[3] = {0, 0, 0};
+  bool rawLoaded = false;
+
+  // Runtime registers changed by the setters and not yet written: bit 0 is
+  // DPM_PDO_NUMB, bits 1..3 the sink PDO words
+  static constexpr uint8_t STAGED_PDO_NUMBER = 1u << 0;
+  uint8_t staged = 0;
+
+  bool loadRawPdos();
+
+  // SparkFun driver, constructed in place so there is no heap allocation
+  // while its header (and the Arduino headers it pulls in) stays out of this
+  // one. The cpp checks that it fits.
+  static constexpr size_t DRIVER_STORAGE = 64;
+  alignas(void *) unsigned char driverStorage[DRIVER_STORAGE];
+  STUSB4500 &driver();
 };
 
 #endif // STUSB4500_CHIP_ADAPTER_H
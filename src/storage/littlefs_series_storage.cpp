@@ -0,0 +1,66 @@
+#if defined(ARDUINO) || defined(ESP_PLATFORM)
+
+#include "littlefs_series_storage.h"
+
+#include <FS.h>
+#include <stdio.h>
+
+bool LittleFsSeriesStorage::path(uint8_t segment, char (&out)[PATH_LEN]) const {
+  int n = snprintf(out, sizeof(out), "%s%u.bin", prefix, (unsigned)segment);
+  return n > 0 && (size_t)n < sizeof(out);
+}
+
+size_t LittleFsSeriesStorage::size(uint8_t segment) {
+  char name[PATH_LEN];
+  if (!path(segment, name) || !fs.exists(name)) {
+    return 0;
+  }
+  fs::File file = fs.open(name, "r");
+  if (!file) {
+    return 0;
+  }
+  size_t bytes = file.size();
+  file.close();
+  return bytes;
+}
+
+bool LittleFsSeriesStorage::read(uint8_t segment, size_t offset, void *buf,
+                                 size_t len) {
+  char name[PATH_LEN];
+  if (!path(segment, name)) {
+    return false;
+  }
+  fs::File file = fs.open(name, "r");
+  if (!file) {
+    return false;
+  }
+  bool ok = file.seek(offset) &&
+            file.read(static_cast<uint8_t *>(buf), len) == len;
+  file.close();
+  return ok;
+}
+
+bool LittleFsSeriesStorage::append(uint8_t segment, const void *buf,
+                                   size_t len) {
+  char name[PATH_LEN];
+  if (!path(segment, name)) {
+    return false;
+  }
+  fs::File file = fs.open(name, "a");
+  if (!file) {
+    return false;
+  }
+  bool ok = file.write(static_cast<const uint8_t *>(buf), len) == len;
+  file.close();
+  return ok;
+}
+
+bool LittleFsSeriesStorage::erase(uint8_t segment) {
+  char name[PATH_LEN];
+  if (!path(segment, name)) {
+    return false;
+  }
+  return !fs.exists(name) || fs.remove(name);
+}
+
+#endif // ARDUINO || ESP_PLATFORM
@@ -0,0 +1,37 @@
+#ifndef LITTLEFS_SERIES_STORAGE_H
+#define LITTLEFS_SERIES_STORAGE_H
+
+#include <stddef.h>
+#include <usb_pd_series.h>
+
+namespace fs {
+class FS;
+}
+
+// History log segments as files on a mounted LittleFS (or any fs::FS),
+// named <prefix>0.bin and <prefix>1.bin. Only compiled for Arduino/ESP32
+// targets.
+//
+// Each call opens and closes its file, so an append is on flash when it
+// returns and nothing stays open between the few writes an hour.
+class LittleFsSeriesStorage final : public IPdSeriesStorage {
+public:
+  // prefix must outlive the storage, e.g. "/usb_pd_p0_"
+  LittleFsSeriesStorage(fs::FS &fs, const char *prefix)
+      : fs(fs), prefix(prefix) {}
+
+  size_t size(uint8_t segment) override;
+  bool read(uint8_t segment, size_t offset, void *buf, size_t len) override;
+  bool append(uint8_t segment, const void *buf, size_t len) override;
+  bool erase(uint8_t segment) override;
+
+private:
+  fs::FS &fs;
+  const char *prefix;
+
+  // Room for a prefix of up to 20 characters plus "N.bin"
+  static constexpr size_t PATH_LEN = 32;
+  bool path(uint8_t segment, char (&out)[PATH_LEN]) const;
+};
+
+#endif // LITTLEFS_SERIES_STORAGE_H
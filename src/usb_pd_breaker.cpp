@@ -0,0 +1,72 @@
+#include "../include/usb_pd_breaker.h"
+
+const char *pdBreakerStateName(PdBreakerState state) {
+  switch (state) {
+  case PdBreakerState::Closed:
+    return "closed";
+  case PdBreakerState::Open:
+    return "open";
+  case PdBreakerState::HalfOpen:
+    return "half_open";
+  }
+  return "unknown";
+}
+
+void PdCircuitBreaker::configure(uint32_t failures, uint32_t backoff,
+                                 uint32_t maxBackoff) {
+  failureThreshold = failures;
+  baseBackoffMs = backoff > 0 ? backoff : 1;
+  maxBackoffMs = maxBackoff > baseBackoffMs ? maxBackoff : baseBackoffMs;
+  if (failureThreshold == 0) {
+    succeeded(); // Disabled; never stays open
+  }
+}
+
+bool PdCircuitBreaker::allow(uint32_t nowMs) {
+  if (state.load(std::memory_order_relaxed) != PdBreakerState::Open) {
+    return true;
+  }
+  if (isOpen(nowMs)) {
+    rejected.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  state.store(PdBreakerState::HalfOpen, std::memory_order_relaxed);
+  return true;
+}
+
+void PdCircuitBreaker::succeeded() {
+  consecutiveFailures.store(0, std::memory_order_relaxed);
+  backoffMs.store(0, std::memory_order_relaxed);
+  state.store(PdBreakerState::Closed, std::memory_order_relaxed);
+}
+
+void PdCircuitBreaker::failed(uint32_t nowMs) {
+  uint32_t failures =
+      consecutiveFailures.fetch_add(1, std::memory_order_relaxed) + 1;
+  if (failureThreshold == 0) {
+    return;
+  }
+
+  PdBreakerState current = state.load(std::memory_order_relaxed);
+  if (current == PdBreakerState::Open) {
+    // Not a trial but work let past the breaker (an ALERT sample): counted,
+    // but only a failed trial pushes the next one back
+    return;
+  }
+
+  uint32_t backoff;
+  if (current == PdBreakerState::Closed) {
+    if (failures < failureThreshold) {
+      return;
+    }
+    trips.fetch_add(1, std::memory_order_relaxed);
+    backoff = baseBackoffMs;
+  } else {
+    // A failed trial: wait twice as long before the next one
+    uint32_t last = backoffMs.load(std::memory_order_relaxed);
+    backoff = last > maxBackoffMs / 2 ? maxBackoffMs : last * 2;
+  }
+  backoffMs.store(backoff, std::memory_order_relaxed);
+  retryAtMs.store(nowMs + backoff, std::memory_order_relaxed);
+  state.store(PdBreakerState::Open, std::memory_order_relaxed);
+}
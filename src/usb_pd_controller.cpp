@@ -2,109 +2,908 @@
 #include "../assets/usb_pd_html.h"
 #include "../assets/usb_pd_js.h"
 
-// Allow tests to override the periodic handle interval (default 30s)
-#ifndef USB_PD_HANDLE_INTERVAL_MS
-#define USB_PD_HANDLE_INTERVAL_MS 30000UL
-#endif
-
 #if defined(ARDUINO) || defined(ESP_PLATFORM)
 #include "chip/stusb4500_chip.h"
+#include <usb_pd_instrumented_chip.h>
+#include <usb_pd_shadow_chip.h>
+
+static uint32_t microsClock() { return micros(); }
+
+// Bus timings of port 0's adapter; extra ports' chips carry their own
+static PdChipMetrics g_stusb4500Metrics;
 
 // Create global instance of USBPDController with real STUSB4500 adapter
-// Only available on Arduino/ESP32 platforms; native tests create their own
-// instances
+// behind a register shadow so unchanged configures cost no I2C or NVM writes.
+// The adapter is timed below the shadow, so /metrics only counts operations
+// that reached the bus. Only available on Arduino/ESP32 platforms; native
+// tests create their own instances
 static STUSB4500Chip g_stusb4500Adapter;
-USBPDController usbPDController(g_stusb4500Adapter);
+static InstrumentedUsbPdChip g_stusb4500Timed(g_stusb4500Adapter,
+                                              g_stusb4500Metrics,
+                                              microsClock);
+static ShadowedUsbPdChip g_stusb4500Shadow(g_stusb4500Timed);
+USBPDController usbPDController(g_stusb4500Shadow, &g_stusb4500Metrics);
+
+// Same as notifyAlert(); takes the flag so one handler serves every port
+static void IRAM_ATTR onUsbPdAlert(void *arg) {
+  static_cast<std::atomic<bool> *>(arg)->store(true, std::memory_order_relaxed);
+}
+
+// Timed adapter plus register shadow for an extra port in multi-port mode,
+// with the port's bus timings, so only configured ports pay for them. The
+// shadow only stores the reference, so handing it the member is safe.
+class STUSB4500PortChip : public ShadowedUsbPdChip {
+public:
+  STUSB4500PortChip()
+      : ShadowedUsbPdChip(timed), timed(adapter, metrics, microsClock) {}
+
+  const PdChipMetrics &getMetrics() const { return metrics; }
+
+private:
+  STUSB4500Chip adapter;
+  PdChipMetrics metrics;
+  InstrumentedUsbPdChip timed;
+};
+#endif
+
+// Chips created for extra ports unless setPortChipFactory() says otherwise,
+// and the bus timings a chip create() made records; none by default, so
+// native builds must provide a factory
+template <typename Chip> struct PortChips {
+  static constexpr std::unique_ptr<Chip> (*create)(size_t) = nullptr;
+  static const PdChipMetrics *metrics(const Chip &) { return nullptr; }
+};
+
+#if defined(ARDUINO) || defined(ESP_PLATFORM)
+template <> struct PortChips<IUsbPdChip> {
+  static std::unique_ptr<IUsbPdChip> create(size_t) {
+    return std::unique_ptr<IUsbPdChip>(new STUSB4500PortChip());
+  }
+  static const PdChipMetrics *metrics(const IUsbPdChip &chip) {
+    return &static_cast<const STUSB4500PortChip &>(chip).getMetrics();
+  }
+};
+#endif
+
+// Constant GET bodies, served straight from flash. The capability bodies
+// are generated from the table in usb_pd_capabilities.h.
+static const char USB_PD_EMPTY_BODY[] PROGMEM = "";
+static const char USB_PD_PROFILES_UNAVAILABLE_JSON[] PROGMEM =
+    "{\"success\":false,\"error\":\"PD board not connected\",\"pdos\":[]}";
+
+// /api/status body for a snapshot
+static void formatStatusJson(char *buf, size_t len,
+                             const PdSnapshot &snapshot) {
+  if (snapshot.valid) {
+    snprintf(buf, len,
+             "{\"success\":true,\"connected\":%s,\"voltage\":%g,"
+             "\"current\":%g}",
+             snapshot.connected ? "true" : "false", snapshot.voltage,
+             snapshot.current);
+  } else {
+    snprintf(buf, len,
+             "{\"success\":false,\"connected\":%s,\"message\":\"%s\"}",
+             snapshot.connected ? "true" : "false",
+             snapshot.connected ? "Board initialized but values not read"
+                                : "PD board not connected");
+  }
+}
+
+// /api/events body: the state id plus the pre-rendered status and profiles
+// bodies; either is left out when null.
+static void formatStateEvent(char *buf, size_t len, const char *id,
+                             const char *status, const char *profiles) {
+  int n = snprintf(buf, len, "{\"id\":\"%s\"", id);
+  size_t pos = n < 0 ? 0 : (size_t)n;
+  if (status && pos < len) {
+    n = snprintf(buf + pos, len - pos, ",\"status\":%s", status);
+    pos += n < 0 ? 0 : (size_t)n;
+  }
+  if (profiles && pos < len) {
+    n = snprintf(buf + pos, len - pos, ",\"profiles\":%s", profiles);
+    pos += n < 0 ? 0 : (size_t)n;
+  }
+  if (pos < len) {
+    snprintf(buf + pos, len - pos, "}");
+  }
+}
+
+// /api/snapshot body: the state bodies of one version plus the capability
+// table, so the dashboard needs one request to start
+static void formatSnapshotJson(char *buf, size_t len, uint32_t version,
+                               const char *status, const char *profiles) {
+  snprintf(buf, len,
+           "{\"success\":true,\"version\":%lu,\"status\":%s,"
+           "\"profiles\":%s,\"capabilities\":%s}",
+           (unsigned long)version, status, profiles,
+           USB_PD_CAPABILITIES_JSON.text);
+}
+
+// A from/to parameter of /api/history: millis() of the device, or relative
+// to nowMs when negative; fallback when absent
+static uint32_t parseHistoryTime(const String &param, uint32_t nowMs,
+                                 uint32_t fallback) {
+  const char *text = param.c_str();
+  if (!*text) {
+    return fallback;
+  }
+  if (*text == '-') {
+    return nowMs - (uint32_t)strtoul(text + 1, nullptr, 10);
+  }
+  return (uint32_t)strtoul(text, nullptr, 10);
+}
+
+// Distinguishes state ETags across reboots, when the version starts over
+static uint32_t bootId() {
+#if defined(ARDUINO) || defined(ESP_PLATFORM)
+  static const uint32_t id = esp_random();
+  return id;
+#else
+  return 0;
+#endif
+}
+
+// The configure error message quotes these limits
+static_assert(usb_pd_caps::minVoltage() == 5000 &&
+                  usb_pd_caps::maxVoltage() == 20000 &&
+                  usb_pd_caps::minCurrent() == 500 &&
+                  usb_pd_caps::maxCurrent() == 3000,
+              "Update the /api/configure validation message");
+
+// Profiles part of a body rendered for an extra port
+static void formatProfilesBody(char *buf, size_t len,
+                               const PdSnapshot &snapshot) {
+  if (!snapshot.initialized ||
+      formatPdoProfilesJson(buf, len, snapshot.activePdo, snapshot.pdoVoltage,
+                            snapshot.pdoCurrent) >= len) {
+    snprintf(buf, len, "%s", USB_PD_PROFILES_UNAVAILABLE_JSON);
+  }
+}
+
+// BasicUSBPDController implementation
+template <typename Chip>
+BasicUSBPDController<Chip>::BasicUSBPDController(
+    Chip &chip, const PdChipMetrics *chipMetrics)
+    : mainPort(chip, chipMetrics) {
+#if USB_PD_TRACE
+  pdTrace.setClock([]() -> uint32_t { return micros(); });
 #endif
+  configurePollSchedule(mainPort);
+  portChipFactory = PortChips<Chip>::create;
+  renderBodies(PdSnapshot());
+  renderEvents(PdSnapshot(), getStateVersion());
+  renderSnapshot(PdSnapshot(), getStateVersion());
+}
+
+template <typename Chip>
+typename BasicUSBPDController<Chip>::Port *
+BasicUSBPDController<Chip>::port(size_t n) {
+  if (n == 0) {
+    return &mainPort;
+  }
+  return n <= extraPortCount ? extraPorts[n - 1].get() : nullptr;
+}
+
+template <typename Chip>
+const typename BasicUSBPDController<Chip>::Port *
+BasicUSBPDController<Chip>::getPort(size_t n) const {
+  return const_cast<BasicUSBPDController *>(this)->port(n);
+}
 
-// USBPDController implementation
-USBPDController::USBPDController(IUsbPdChip &chip)
-    : pdController(chip), core(pdController) {}
+template <typename Chip>
+void BasicUSBPDController<Chip>::setI2cBus(PdI2cBus *bus, size_t n) {
+  if (Port *p = port(n)) {
+    attachI2cBus(*p, bus);
+  }
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::attachI2cBus(Port &p, PdI2cBus *bus) {
+  p.i2cArbiter = bus;
+  p.i2cClient = -1;
+  if (bus) {
+    // One client per port, so each has its own budget, clock and counters
+    char name[USB_PD_I2C_CLIENT_NAME_LEN];
+    snprintf(name, sizeof(name), "%s.%u", USB_PD_I2C_CLIENT,
+             (unsigned)p.index);
+    p.i2cClient = bus->addClient(name, p.settings.i2cBudgetUs);
+  }
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::setChipMetrics(const PdChipMetrics *metrics,
+                                                size_t n) {
+  if (Port *p = port(n)) {
+    p->chipMetrics = metrics;
+  }
+}
 
-void USBPDController::begin() {
+template <typename Chip>
+void BasicUSBPDController<Chip>::begin() {
   // Use debug macro to avoid direct Serial dependency in native tests
   DEBUG_PRINTLN("USB PD Controller module initialized");
-  initializeHardware();
+  for (size_t i = 0; i < getPortCount(); ++i) {
+    initializeHardware(*port(i));
+  }
+
+  // Hand periodic sampling to the background task so request handlers only
+  // ever read the published snapshot. One task serves every port.
+  if (mainPort.settings.pollIntervalMs > 0 && !poller.isRunning()) {
+    bool started = poller.start(mainPort.settings.pollIntervalMs,
+                                [this]() { pollPorts(); });
+    if (started) {
+      DEBUG_PRINTF("USB PD Controller: Background poller, %lu-%lu ms, "
+                   "%u port(s)\n",
+                   (unsigned long)mainPort.pollSchedule.getFastMs(),
+                   (unsigned long)mainPort.settings.pollIntervalMs,
+                   (unsigned)getPortCount());
+    } else {
+      DEBUG_PRINTLN("USB PD Controller: Failed to start background poller");
+    }
+  }
 }
 
-void USBPDController::begin(const JsonVariant &config) {
+template <typename Chip>
+void BasicUSBPDController<Chip>::begin(const JsonVariant &config) {
   parseConfig(config);
   begin(); // Call the parameterless version
 }
 
-void USBPDController::initializeHardware() {
-  DEBUG_PRINTLN("Initializing USB PD Controller hardware...");
+template <typename Chip>
+void BasicUSBPDController<Chip>::initializeHardware(Port &p) {
+  DEBUG_PRINTF("Initializing USB PD Controller hardware (port %u)...\n",
+               (unsigned)p.index);
   DEBUG_PRINT("Using I2C address: 0x");
-  DEBUG_PRINTLN(String(i2cAddress, HEX));
-  DEBUG_PRINTF("I2C pins: SDA=%d, SCL=%d\n", sdaPin, sclPin);
-  DEBUG_PRINTF("Board type: %s\n", boardType.c_str());
+  DEBUG_PRINTLN(String(p.settings.i2cAddress, HEX));
+  DEBUG_PRINTF("I2C bus %u, pins: SDA=%d, SCL=%d\n",
+               (unsigned)p.settings.i2cBus, p.settings.sdaPin,
+               p.settings.sclPin);
+  DEBUG_PRINTF("Board type: %s\n", p.settings.boardType);
 
-// Initialize I2C with configured pins
+// Initialize I2C with configured pins (ports sharing a bus begin it again
+// with the same pins, which is a no-op)
 #if defined(ARDUINO) || defined(ESP_PLATFORM)
-  Wire.begin(sdaPin, sclPin);
+  if (TwoWire *wire = pdI2cWire(p.settings.i2cBus)) {
+    wire->begin(p.settings.sdaPin, p.settings.sclPin);
+  }
+  attachI2cBus(p, pdI2cBus(p.settings.i2cBus));
 #else
   Wire.begin(); // ArduinoFake doesn't support 2-param version
 #endif
+  if (!p.chip.selectBus(p.settings.i2cBus)) {
+    DEBUG_PRINTF("USB PD Controller: I2C bus %u not available\n",
+                 (unsigned)p.settings.i2cBus);
+  }
+  p.chip.setI2cClient(p.i2cClient);
+  attachAlertInterrupt(p);
+
+  std::lock_guard<std::recursive_mutex> lock(p.chipMutex);
+  PdI2cBus::Grant grant(p.i2cArbiter, p.i2cClient, PdI2cPriority::Configure);
 
   // Check if PD board is connected
-  pdBoardConnected = isPDBoardConnected();
+  p.pdBoardConnected = probe(p);
 
   // Initialize USB-PD controller if board is connected
-  if (pdBoardConnected) {
-    pdBoardConnected = pdController.begin();
-    if (pdBoardConnected) {
-      DEBUG_PRINTLN("STUSB4500 initialized successfully");
-      readPDConfig();
-    } else {
-      DEBUG_PRINTLN("Failed to initialize STUSB4500");
-    }
+  bool detected = p.pdBoardConnected;
+  if (detected) {
+    p.pdBoardConnected = p.chip.begin();
+  }
+  if (!p.pdBoardConnected) {
+    chipFailed(p); // May queue a bus recovery
+  }
+  applyI2cClock(p);
+
+  if (p.pdBoardConnected) {
+    DEBUG_PRINTLN("STUSB4500 initialized successfully");
+    armAlert(p);
+    readConfig(p);
+    reschedulePoll(p, true);
+  } else if (detected) {
+    DEBUG_PRINTLN("Failed to initialize STUSB4500");
+    publishSnapshot(p, true, false);
   } else {
     DEBUG_PRINTLN("STUSB4500 not detected on I2C bus");
+    publishSnapshot(p, false, false);
   }
 
   DEBUG_PRINTLN("USB PD Controller hardware initialized");
 }
 
-void USBPDController::handle() {
-  // Check if it's time to check PD board status (every 30 seconds to reduce I2C
-  // spam)
-  if (millis() - lastCheckTime <= USB_PD_HANDLE_INTERVAL_MS) {
+template <typename Chip>
+void BasicUSBPDController<Chip>::handle() {
+  // Advance any queued configure first; each call does at most one bus step
+  serviceConfigJobs();
+  for (size_t i = 0; i < getPortCount(); ++i) {
+    servicePort(*port(i));
+  }
+  serviceHistoryLog();
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::servicePort(Port &p) {
+  serviceNvmCommit(p);
+
+  // An ALERT edge means attach/detach: sample now rather than at the next
+  // poll. Left pending while a configure owns the register image.
+  if (!p.configuring.load() && p.alertPending.exchange(false)) {
+    ++p.stats.alertsServiced;
+    sample(p, PdI2cPriority::Alert);
+    return;
+  }
+
+  // The background poller owns sampling while it is running
+  if (poller.isRunning()) {
+    return;
+  }
+
+  // Fast right after a change, backing off to USB_PD_HANDLE_INTERVAL_MS while
+  // nothing happens, to keep idle I2C traffic down
+  {
+    std::lock_guard<std::recursive_mutex> lock(p.chipMutex);
+    if (!p.pollSchedule.isDue(millis())) {
+      return;
+    }
+  }
+  samplePeriodic(p);
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::sampleNow(size_t n) {
+  if (Port *p = port(n)) {
+    sample(*p, PdI2cPriority::Status);
+  }
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::samplePeriodic(Port &p) {
+  if (p.i2cArbiter && !p.i2cArbiter->admit(p.i2cClient)) {
+    std::lock_guard<std::recursive_mutex> lock(p.chipMutex);
+    p.pollSchedule.polled(millis());
     return;
   }
+  sample(p, PdI2cPriority::Status);
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::sample(Port &p, PdI2cPriority priority) {
+  std::lock_guard<std::recursive_mutex> lock(p.chipMutex);
+  USB_PD_TRACE_SCOPE("controller.sample");
 
-  lastCheckTime = millis();
-  bool connected = isPDBoardConnected();
+  // A read() mid-configure would discard the staged PDO changes
+  if (p.configuring.load()) {
+    return;
+  }
 
-  // No change in connection status
-  if (connected == pdBoardConnected) {
+  // While the breaker is open the last published state stands and the bus
+  // is left alone. An ALERT edge comes from a live chip, so it always gets
+  // through.
+  if (priority != PdI2cPriority::Alert && !p.breaker.allow(millis())) {
+    p.pollSchedule.polled(millis());
     return;
   }
 
-  // Handle disconnection
+  // Probe, read and alert acknowledge as one bus transaction
+  PdI2cBus::Grant grant(p.i2cArbiter, p.i2cClient, priority);
+  bool connected = probe(p);
+
+  // Handle disconnection; a stuck bus is recovered by a queued job, not here
   if (!connected) {
-    DEBUG_PRINTLN("PD board disconnected");
-    pdBoardConnected = false;
+    chipFailed(p);
+    bool changed = p.pdBoardConnected;
+    if (changed) {
+      DEBUG_PRINTF("PD board disconnected (port %u)\n", (unsigned)p.index);
+    }
+    p.pdBoardConnected = false;
+    // Runtime registers do not survive losing power
+    p.nvmCommitPending = false;
+    publishSnapshot(p, false, false);
+    reschedulePoll(p, changed);
     return;
   }
 
   // Handle connection
-  DEBUG_PRINTLN("PD board connected");
-  pdBoardConnected = pdController.begin();
-  if (pdBoardConnected) {
-    readPDConfig();
+  bool changed = !p.pdBoardConnected;
+  if (changed) {
+    DEBUG_PRINTF("PD board connected (port %u)\n", (unsigned)p.index);
+    p.pdBoardConnected = p.chip.begin();
+    if (p.pdBoardConnected) {
+      armAlert(p);
+    }
+  } else if (!changed && p.settings.alertPin >= 0) {
+    // Release the ALERT line so the next attach/detach edge is seen
+    p.chip.clearAlerts();
+  }
+  if (!p.pdBoardConnected) {
+    chipFailed(p);
+  }
+
+  // The register read settles the breaker: a chip that probes but does not
+  // answer reads is failing too
+  bool valid = p.pdBoardConnected && refreshConfig(p);
+  publishSnapshot(p, true, valid);
+  reschedulePoll(p, changed);
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::pollPorts() {
+  // Due ports are sampled back to back in one wake-up, then the task sleeps
+  // until the earliest deadline of any port
+  uint32_t wait = UINT32_MAX;
+  for (size_t i = 0; i < getPortCount(); ++i) {
+    Port &p = *port(i);
+    bool due;
+    {
+      std::lock_guard<std::recursive_mutex> lock(p.chipMutex);
+      due = p.pollSchedule.isDue(millis());
+    }
+    if (due) {
+      samplePeriodic(p);
+    }
+    std::lock_guard<std::recursive_mutex> lock(p.chipMutex);
+    uint32_t portWait = p.pollSchedule.msUntilDue(millis());
+    wait = portWait < wait ? portWait : wait;
+  }
+  poller.setIntervalMs(wait);
+}
+
+template <typename Chip>
+uint32_t BasicUSBPDController<Chip>::nextWakeMs() const {
+  {
+    std::lock_guard<std::mutex> lock(jobMutex);
+    if (activeJobId != 0 || nextRunJobId != nextJobId) {
+      return 0; // A job waiting for handle()
+    }
+  }
+  uint32_t wait = portWakeMs(mainPort);
+  for (size_t i = 0; i < extraPortCount && wait > 0; ++i) {
+    uint32_t portWait = portWakeMs(*extraPorts[i]);
+    wait = portWait < wait ? portWait : wait;
+  }
+  return wait;
+}
+
+template <typename Chip>
+uint32_t BasicUSBPDController<Chip>::portWakeMs(const Port &p) const {
+  if (p.alertPending.load()) {
+    return 0;
+  }
+
+  uint32_t now = millis();
+  std::lock_guard<std::recursive_mutex> lock(p.chipMutex);
+  uint32_t wait = p.pollSchedule.msUntilDue(now);
+  uint32_t delayMs = p.settings.nvmCommitDelayMs;
+  if (p.nvmCommitPending && delayMs > 0) {
+    uint32_t elapsed = now - p.lastVolatileApplyMs;
+    uint32_t commitIn = elapsed >= delayMs ? 0 : delayMs - elapsed;
+    wait = commitIn < wait ? commitIn : wait;
+  }
+  return wait;
+}
+
+template <typename Chip>
+uint32_t BasicUSBPDController<Chip>::submitPDConfig(float voltage,
+                                                    float current,
+                                                    PdWriteMode mode,
+                                                    size_t n) {
+  if (!port(n)) {
+    return 0;
+  }
+  PdConfigJob job;
+  job.voltage = voltage;
+  job.current = current;
+  job.mode = mode;
+  job.port = (uint8_t)n;
+  return submitJob(job);
+}
+
+template <typename Chip>
+uint32_t BasicUSBPDController<Chip>::submitJob(PdConfigJob job) {
+  std::lock_guard<std::mutex> lock(jobMutex);
+  PdConfigJob &slot = configJobs[nextJobId % USB_PD_CONFIG_JOB_HISTORY];
+  if (slot.state == PdConfigJobState::Pending ||
+      slot.state == PdConfigJobState::Running) {
+    return 0; // Queue full; oldest slot has not run yet
+  }
+
+  job.id = nextJobId++;
+  job.state = PdConfigJobState::Pending;
+  job.submittedMs = millis();
+  slot = job;
+  return slot.id;
+}
+
+template <typename Chip>
+bool BasicUSBPDController<Chip>::getConfigJob(uint32_t id,
+                                              PdConfigJob &out) const {
+  std::lock_guard<std::mutex> lock(jobMutex);
+  const PdConfigJob &slot = configJobs[id % USB_PD_CONFIG_JOB_HISTORY];
+  if (id == 0 || slot.id != id) {
+    return false;
+  }
+  out = slot;
+  return true;
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::serviceConfigJobs() {
+  PdConfigJob job;
+  bool starting = false;
+  {
+    std::lock_guard<std::mutex> lock(jobMutex);
+    if (activeJobId == 0) {
+      if (nextRunJobId == nextJobId) {
+        return; // Nothing queued
+      }
+      PdConfigJob &slot = configJobs[nextRunJobId % USB_PD_CONFIG_JOB_HISTORY];
+      slot.state = PdConfigJobState::Running;
+      slot.startedMs = millis();
+      activeJobId = nextRunJobId++;
+      starting = true;
+    }
+    job = configJobs[activeJobId % USB_PD_CONFIG_JOB_HISTORY];
+  }
+
+  // Ports are rebuilt by a new "ports" config
+  Port *target = port(job.port);
+  if (!target) {
+    finishConfigJob(nullptr, false, "Unknown port");
+    return;
+  }
+  Port &p = *target;
+  if (job.kind == PdConfigJobKind::Recover) {
+    recoverBus(p); // A single step
+    return;
+  }
+
+  std::lock_guard<std::recursive_mutex> lock(p.chipMutex);
+  USB_PD_TRACE_SCOPE("controller.config_job");
+  // Per step, so other modules get the bus between steps and during the
+  // contract wait
+  PdI2cBus::Grant grant(p.i2cArbiter, p.i2cClient, PdI2cPriority::Configure);
+  if (starting) {
+    if (!p.pdBoardConnected) {
+      finishConfigJob(&p, false, "PD board not connected");
+      return;
+    }
+    p.configuring.store(true);
+    if (job.kind == PdConfigJobKind::Restore) {
+      p.core.beginRestore(job.pdos, job.mode);
+    } else {
+      p.core.beginConfig(job.voltage, job.current, job.mode);
+    }
+  }
+
+  // While awaiting the new contract each call is a single status read
+  PdConfigStep step = p.core.stepConfig();
+  if (p.core.readFailed()) {
+    chipFailed(p);
+  }
+  if (step == PdConfigStep::Done) {
+    p.breaker.succeeded();
+    noteConfigApplied(p, job.voltage, job.current, job.mode);
+    recordNegotiation(p);
+    finishConfigJob(&p, true, nullptr);
+  } else if (step == PdConfigStep::Failed) {
+    finishConfigJob(&p, false, "Failed to set configuration");
+  }
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::finishConfigJob(Port *p, bool ok,
+                                                 const char *error) {
+  if (p && p->configuring.load()) {
+    if (ok) {
+      p->currentVoltage = p->core.currentVoltage();
+      p->currentCurrent = p->core.currentCurrent();
+      DEBUG_PRINTLN("PD configuration updated successfully");
+    } else {
+      DEBUG_PRINTLN("Failed to read back PD configuration");
+    }
+    p->configureRan = true;
+    publishSnapshot(*p, p->pdBoardConnected, ok);
+    p->configuring.store(false);
+
+    // Watch the renegotiated port closely for a while
+    reschedulePoll(*p, true);
+    poller.wake();
+  }
+
+  PdConfigJob finished;
+  {
+    std::lock_guard<std::mutex> lock(jobMutex);
+    PdConfigJob &slot = configJobs[activeJobId % USB_PD_CONFIG_JOB_HISTORY];
+    slot.state = ok ? PdConfigJobState::Succeeded : PdConfigJobState::Failed;
+    slot.finishedMs = millis();
+    slot.error = error;
+    if (ok && p) {
+      slot.resultVoltage = p->currentVoltage;
+      slot.resultCurrent = p->currentCurrent;
+      slot.negotiation = p->core.negotiation();
+    }
+    finished = slot;
+    activeJobId = 0;
+  }
+
+  if (configJobCallback) {
+    configJobCallback(finished);
+  }
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::noteConfigApplied(Port &p, float voltage,
+                                                   float current,
+                                                   PdWriteMode mode) {
+  p.appliedSet = p.core.pdoSet();
+  p.appliedMode = mode;
+  p.applied = true;
+  if (mode == PdWriteMode::Persistent) {
+    // NVM now matches what is running; nothing left to commit
+    p.nvmCommitPending = false;
+    return;
+  }
+
+  ++p.stats.volatileApplies;
+  p.volatileVoltage = voltage;
+  p.volatileCurrent = current;
+  p.lastVolatileApplyMs = millis();
+  p.nvmCommitPending = true;
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::recordNegotiation(Port &p) {
+  // A timeout still reaches read back; it lands in the top buckets
+  const PdNegotiation &negotiation = p.core.negotiation();
+  p.negotiationMetrics.latency.observe(negotiation.elapsedMs * 1000UL);
+  if (negotiation.timedOut) {
+    p.negotiationMetrics.timeouts.add();
+  }
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::serviceNvmCommit(Port &p) {
+  if (!p.nvmCommitPending || p.settings.nvmCommitDelayMs == 0 ||
+      p.configuring.load()) {
+    return;
+  }
+  // Restart the quiet period on every volatile apply so a burst of fast
+  // switches costs a single NVM write
+  if (millis() - p.lastVolatileApplyMs < p.settings.nvmCommitDelayMs) {
+    return;
+  }
+
+  std::lock_guard<std::recursive_mutex> lock(p.chipMutex);
+  if (!p.pdBoardConnected) {
+    p.nvmCommitPending = false;
+    return;
+  }
+  USB_PD_TRACE_SCOPE("controller.nvm_commit");
+  PdI2cBus::Grant grant(p.i2cArbiter, p.i2cClient, PdI2cPriority::Configure);
+
+  p.core.commitConfig(p.volatileVoltage, p.volatileCurrent);
+  if (p.core.readFailed()) {
+    // Try again after another quiet period
+    chipFailed(p);
+    p.lastVolatileApplyMs = millis();
+    return;
+  }
+  p.nvmCommitPending = false;
+  ++p.stats.deferredCommits;
+  DEBUG_PRINTLN("USB PD Controller: Committed volatile configuration to NVM");
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::attachAlertInterrupt(Port &p) {
+  if (p.settings.alertPin < 0) {
+    return;
+  }
+#if defined(ARDUINO) || defined(ESP_PLATFORM)
+  // ALERT is open drain, active low
+  pinMode(p.settings.alertPin, INPUT_PULLUP);
+  attachInterruptArg(digitalPinToInterrupt(p.settings.alertPin), onUsbPdAlert,
+                     &p.alertPending, FALLING);
+#endif
+  DEBUG_PRINTF("USB PD Controller: ALERT interrupt on GPIO %d\n",
+               p.settings.alertPin);
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::armAlert(Port &p) {
+  if (p.settings.alertPin < 0) {
+    return;
+  }
+  if (!p.chip.enableAttachAlert()) {
+    DEBUG_PRINTLN("USB PD Controller: Failed to enable attach alert");
+  }
+  p.chip.clearAlerts();
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::applyI2cClock(Port &p) {
+  static const uint32_t clocks[] = {100000, 400000, 1000000};
+  // Never above what another port or module on this bus already settled on
+  uint32_t shared = p.i2cArbiter ? p.i2cArbiter->clockHz() : 0;
+  if (p.settings.i2cClockHz != USB_PD_I2C_CLOCK_AUTO) {
+    p.i2cClockSetHz = p.settings.i2cClockHz;
+    if (shared && shared < p.settings.i2cClockHz) {
+      DEBUG_PRINTF("USB PD Controller: WARNING - i2cClockHz %lu is above the "
+                   "%lu Hz the bus runs at, using %lu\n",
+                   (unsigned long)p.settings.i2cClockHz, (unsigned long)shared,
+                   (unsigned long)shared);
+      p.i2cClockSetHz = shared;
+    }
+    p.chip.setBusClock(p.i2cClockSetHz);
+  } else {
+    uint32_t ceiling = shared ? shared : clocks[2];
+    p.i2cClockSetHz = clocks[0];
+    p.chip.setBusClock(p.i2cClockSetHz);
+    PdRegisterImage reference;
+    if (p.pdBoardConnected && p.chip.readRegisterImage(reference)) {
+      for (uint32_t hz : clocks) {
+        if (hz <= p.i2cClockSetHz || hz > ceiling) {
+          continue;
+        }
+        p.chip.setBusClock(hz);
+        if (!readsBackIntact(p, reference)) {
+          // Back to the last clock that read back intact
+          ++p.stats.i2cClockFallbacks;
+          p.chip.setBusClock(p.i2cClockSetHz);
+          break;
+        }
+        p.i2cClockSetHz = hz;
+      }
+    }
+  }
+  if (p.i2cArbiter) {
+    p.i2cArbiter->setClockHz(p.i2cClient, p.i2cClockSetHz);
+    if (shared > p.i2cClockSetHz) {
+      DEBUG_PRINTF("USB PD Controller: WARNING - I2C bus %u slowed from %lu "
+                   "to %lu Hz for this port\n",
+                   (unsigned)p.settings.i2cBus, (unsigned long)shared,
+                   (unsigned long)p.i2cClockSetHz);
+    }
+  }
+
+  p.stats.i2cReadUs = 0;
+  PdRegisterImage image;
+  uint32_t start = micros();
+  if (p.pdBoardConnected && p.chip.readRegisterImage(image)) {
+    p.stats.i2cReadUs = micros() - start;
+  }
+  DEBUG_PRINTF("USB PD Controller: I2C at %lu Hz%s, register read %lu us\n",
+               (unsigned long)p.i2cClockSetHz,
+               p.settings.i2cClockHz == USB_PD_I2C_CLOCK_AUTO ? " (auto)" : "",
+               (unsigned long)p.stats.i2cReadUs);
+}
+
+template <typename Chip>
+bool BasicUSBPDController<Chip>::readsBackIntact(
+    Port &p, const PdRegisterImage &reference) {
+  for (int i = 0; i < USB_PD_I2C_CLOCK_CHECKS; ++i) {
+    PdRegisterImage image;
+    if (!p.chip.readRegisterImage(image) || !(image == reference)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::chipFailed(Port &p) {
+  uint32_t now = millis();
+  p.breaker.failed(now);
+  uint32_t failures = p.breaker.getConsecutiveFailures();
+  if (failures == 1) {
+    p.failingSinceMs = now;
+  }
+  uint32_t every = p.settings.i2cRecoveryFailures;
+  if (every == 0 || failures % every != 0 || p.recoveryQueued.load()) {
+    return;
+  }
+  PdConfigJob job;
+  job.kind = PdConfigJobKind::Recover;
+  job.port = (uint8_t)p.index;
+  if (submitJob(job)) {
+    p.recoveryQueued.store(true);
+  } else {
+    DEBUG_PRINTLN("USB PD Controller: Job queue full, recovery put off");
+  }
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::recoverBus(Port &p) {
+  USB_PD_TRACE_SCOPE("controller.recover_bus");
+  {
+    std::lock_guard<std::recursive_mutex> lock(p.chipMutex);
+    p.configuring.store(true);
+    ++p.stats.i2cRecoveryAttempts;
+    DEBUG_PRINTF("USB PD Controller: %lu failures in a row, recovering I2C "
+                 "bus %u\n",
+                 (unsigned long)p.breaker.getConsecutiveFailures(),
+                 (unsigned)p.settings.i2cBus);
+  }
+
+  // configuring keeps samples, ALERTs and commits off the chip, so the port
+  // stays unlocked while SCL is clocked by hand; only the bus is held
+  bool released;
+  {
+    PdI2cBus::Grant grant(p.i2cArbiter, p.i2cClient,
+                          PdI2cPriority::Configure);
+    released = p.chip.recoverBus(p.settings.sdaPin, p.settings.sclPin);
+  }
+
+  std::lock_guard<std::recursive_mutex> lock(p.chipMutex);
+  PdI2cBus::Grant grant(p.i2cArbiter, p.i2cClient, PdI2cPriority::Configure);
+  p.recoveryQueued.store(false);
+  if (!released) {
+    DEBUG_PRINTLN("USB PD Controller: I2C bus still held low");
+    finishConfigJob(&p, false, "I2C bus still held low");
+    return;
+  }
+  // At the clock the bus runs at, which another port sharing it may have
+  // brought below the one this port applied
+  if (uint32_t hz = busClockHz(p)) {
+    p.chip.setBusClock(hz);
+  }
+  p.pdBoardConnected = probe(p) && p.chip.begin();
+  if (!p.pdBoardConnected) {
+    finishConfigJob(&p, false, "PD board not responding");
+    return;
+  }
+  p.breaker.succeeded();
+  armAlert(p);
+  ++p.stats.i2cRecoveries;
+  p.stats.lastRecoveryMs = millis() - p.failingSinceMs;
+  p.stats.totalRecoveryMs += p.stats.lastRecoveryMs;
+  DEBUG_PRINTF("USB PD Controller: I2C bus recovered after %lu ms\n",
+               (unsigned long)p.stats.lastRecoveryMs);
+
+  // A brown-out reloads the PDOs from NVM, losing any volatile configure.
+  // Put back every PDO last applied, in the mode it was applied in, as a
+  // job of its own so handle() runs the renegotiation a step at a time.
+  bool valid = refreshConfig(p);
+  if (valid && p.applied && !(p.core.pdoSet() == p.appliedSet)) {
+    PdConfigJob restore;
+    restore.kind = PdConfigJobKind::Restore;
+    restore.port = (uint8_t)p.index;
+    restore.pdos = p.appliedSet;
+    restore.mode = p.appliedMode;
+    restore.voltage = p.appliedSet.voltage[p.appliedSet.activePdo];
+    restore.current = p.appliedSet.current[p.appliedSet.activePdo];
+    DEBUG_PRINTF("USB PD Controller: Restoring PDOs (%.2fV %.2fA active)\n",
+                 restore.voltage, restore.current);
+    if (!submitJob(restore)) {
+      DEBUG_PRINTLN("USB PD Controller: Job queue full, PDOs not restored");
+    }
   }
+  finishConfigJob(&p, valid,
+                  valid ? nullptr : "Failed to read back PD configuration");
+}
+
+template <typename Chip>
+uint32_t BasicUSBPDController<Chip>::busClockHz(const Port &p) const {
+  return p.i2cArbiter && p.i2cArbiter->clockHz() ? p.i2cArbiter->clockHz()
+                                                 : p.i2cClockSetHz;
+}
+
+template <typename Chip>
+bool BasicUSBPDController<Chip>::clockConflict(const Port &p) const {
+  // A fixed clock the bus runs below because of another device on it
+  return p.settings.i2cClockHz != USB_PD_I2C_CLOCK_AUTO &&
+         busClockHz(p) < p.settings.i2cClockHz;
 }
 
-std::vector<RouteVariant> USBPDController::getHttpRoutes() {
-  return {// Main page route - local access only for security
-          WebRoute("/", WebModule::WM_GET,
+template <typename Chip>
+std::vector<RouteVariant> BasicUSBPDController<Chip>::getHttpRoutes() {
+  std::vector<RouteVariant> routes = {
+          // Main page route - local access only for security
+          webRoute("/", WebModule::WM_GET,
                    [this](RequestT &req, ResponseT &res) {
                      mainPageHandler(req, res);
                    },
                    {AuthType::NONE}),
 
           // JavaScript assets - local access only
-          WebRoute("/assets/usb-pd-controller.js", WebModule::WM_GET,
+          webRoute("/assets/usb-pd-controller.js", WebModule::WM_GET,
                    [](RequestT &req, ResponseT &res) {
                      res.setProgmemContent(USB_PD_JS, "application/javascript");
                      res.setHeader("Cache-Control", "public, max-age=3600");
@@ -113,7 +912,7 @@ std::vector<RouteVariant> USBPDController::getHttpRoutes() {
 
           // API endpoints - authentication required for control, local access
           // for monitoring
-          ApiRoute(
+          apiRoute(
               "/api/status", WebModule::WM_GET,
               [this](RequestT &req, ResponseT &res) {
                 pdStatusHandler(req, res);
@@ -124,7 +923,7 @@ std::vector<RouteVariant> USBPDController::getHttpRoutes() {
                       "voltage/current readings",
                       "getPDStatus", {"power delivery"})),
 
-          ApiRoute(
+          apiRoute(
               "/api/voltages", WebModule::WM_GET,
               [this](RequestT &req, ResponseT &res) {
                 availableVoltagesHandler(req, res);
@@ -134,7 +933,7 @@ std::vector<RouteVariant> USBPDController::getHttpRoutes() {
                       "Returns list of supported voltage levels",
                       "getAvailableVoltages", {"power delivery"})),
 
-          ApiRoute(
+          apiRoute(
               "/api/currents", WebModule::WM_GET,
               [this](RequestT &req, ResponseT &res) {
                 availableCurrentsHandler(req, res);
@@ -144,7 +943,18 @@ std::vector<RouteVariant> USBPDController::getHttpRoutes() {
                       "Returns list of supported current levels",
                       "getAvailableCurrents", {"power delivery"})),
 
-          ApiRoute(
+          apiRoute(
+              "/api/capabilities", WebModule::WM_GET,
+              [this](RequestT &req, ResponseT &res) {
+                capabilitiesHandler(req, res);
+              },
+              {AuthType::SESSION, AuthType::PAGE_TOKEN, AuthType::TOKEN},
+              API_DOC("Get PD capabilities",
+                      "Returns supported voltages with the highest current "
+                      "offered at each, and all supported current levels",
+                      "getCapabilities", {"power delivery"})),
+
+          apiRoute(
               "/api/profiles", WebModule::WM_GET,
               [this](RequestT &req, ResponseT &res) {
                 pdoProfilesHandler(req, res);
@@ -155,7 +965,81 @@ std::vector<RouteVariant> USBPDController::getHttpRoutes() {
                       "current and power specifications",
                       "getPDOProfiles", {"power delivery"})),
 
-          ApiRoute(
+          apiRoute(
+              "/api/snapshot", WebModule::WM_GET,
+              [this](RequestT &req, ResponseT &res) {
+                snapshotHandler(req, res);
+              },
+              {AuthType::SESSION, AuthType::PAGE_TOKEN, AuthType::TOKEN},
+              API_DOC("Get PD state snapshot",
+                      "Returns status, PDO profiles and capabilities from one "
+                      "published sample with the state version, for clients "
+                      "that need all of them at once; revalidate with the "
+                      "ETag",
+                      "getPDSnapshot", {"power delivery"})
+                  .withResponseExample(R"({
+          "success": true,
+          "version": 7,
+          "status": {
+            "success": true,
+            "connected": true,
+            "voltage": 12.0,
+            "current": 2.0
+          },
+          "profiles": {
+            "pdos": [],
+            "activePDO": 2
+          },
+          "capabilities": {
+            "voltages": [{"voltage": 5, "maxCurrent": 3}],
+            "currents": [0.5, 1]
+          }
+        })")),
+
+          apiRoute(
+              "/api/events", WebModule::WM_GET,
+              [this](RequestT &req, ResponseT &res) {
+                eventsHandler(req, res);
+              },
+              {AuthType::SESSION, AuthType::PAGE_TOKEN, AuthType::TOKEN},
+              API_DOC("Poll PD state changes",
+                      "Returns {id, status, profiles}, with status and "
+                      "profiles as /api/status and /api/profiles return them. "
+                      "With since=<id> (or the state ETag), only the parts "
+                      "that changed since that state; an up-to-date client "
+                      "gets {id} alone. Answers at once; poll it",
+                      "getPDEvents", {"power delivery"})
+                  .withResponseExample(R"({
+          "id": "3f9a01c2-8",
+          "status": {"success": true, "connected": true, "voltage": 15,
+                     "current": 2}
+        })")),
+
+          apiRoute(
+              "/api/history", WebModule::WM_GET,
+              [this](RequestT &req, ResponseT &res) {
+                historyHandler(req, res);
+              },
+              {AuthType::SESSION, AuthType::PAGE_TOKEN, AuthType::TOKEN},
+              API_DOC("Get voltage/current history",
+                      "Min/mean/max per point over [from, to] (device "
+                      "millis(), negative = relative to now; default the "
+                      "last hour). resolution is raw, 1s, 1m, 1h or auto, "
+                      "which picks the finest tier that covers the window "
+                      "within the point limit (120 by default)",
+                      "getPDHistory", {"power delivery"})
+                  .withResponseExample(R"({
+          "success": true,
+          "resolution": "1m",
+          "now": 5400000,
+          "from": 1800000,
+          "to": 5400000,
+          "truncated": false,
+          "columns": ["t", "count", "vMin", "vMean", "vMax", "iMin", "iMean", "iMax"],
+          "points": [[1800000, 60, 12, 12, 12, 1.98, 2, 2.01]]
+        })")),
+
+          apiRoute(
               "/api/configure", WebModule::WM_POST,
               [this](RequestT &req, ResponseT &res) {
                 setPDConfigHandler(req, res);
@@ -163,7 +1047,8 @@ std::vector<RouteVariant> USBPDController::getHttpRoutes() {
               {AuthType::SESSION, AuthType::PAGE_TOKEN,
                AuthType::TOKEN}, // Require authentication for control
               API_DOC("Set Power Delivery configuration",
-                      "Updates the USB-C PD voltage and current settings",
+                      "Queues a USB-C PD voltage and current change and "
+                      "returns 202 with a job id to poll",
                       "setPDConfig", {"power delivery"})
                   .withRequestBody(R"({
           "required": true,
@@ -185,6 +1070,12 @@ std::vector<RouteVariant> USBPDController::getHttpRoutes() {
                     "minimum": 0.5,
                     "maximum": 3.0,
                     "description": "Target current in amperes"
+                  },
+                  "mode": {
+                    "type": "string",
+                    "enum": ["persistent", "volatile"],
+                    "default": "persistent",
+                    "description": "persistent writes NVM; volatile only updates runtime registers, committed to NVM after nvmCommitDelayMs when set"
                   }
                 }
               }
@@ -197,176 +1088,819 @@ std::vector<RouteVariant> USBPDController::getHttpRoutes() {
         })")
                   .withResponseExample(R"({
           "success": true,
+          "jobId": 7,
+          "state": "pending"
+        })")),
+
+          apiRoute(
+              "/api/configure/{id}", WebModule::WM_GET,
+              [this](RequestT &req, ResponseT &res) {
+                configJobStatusHandler(req, res);
+              },
+              {AuthType::SESSION, AuthType::PAGE_TOKEN, AuthType::TOKEN},
+              API_DOC("Get configuration job status",
+                      "Returns the state of an asynchronous configuration "
+                      "request and the values read back once it completes",
+                      "getPDConfigJob", {"power delivery"})
+                  .withResponseExample(R"({
+          "success": true,
+          "jobId": 7,
+          "state": "succeeded",
+          "kind": "configure",
           "voltage": 12.0,
-          "current": 2.0
-        })"))};
-}
+          "current": 2.0,
+          "contract": {
+            "established": true,
+            "pdo": 2,
+            "negotiationMs": 38
+          },
+          "elapsedMs": 61
+        })")),
 
-std::vector<RouteVariant> USBPDController::getHttpsRoutes() {
+          apiRoute(
+              "/api/diagnostics", WebModule::WM_GET,
+              [this](RequestT &req, ResponseT &res) {
+                diagnosticsHandler(req, res);
+              },
+              {AuthType::SESSION, AuthType::PAGE_TOKEN, AuthType::TOKEN},
+              API_DOC("Get controller diagnostics",
+                      "Returns NVM write accounting for volatile "
+                      "configuration changes, ALERT interrupt counters, "
+                      "history block counts, the chip circuit breaker and "
+                      "I2C bus and recovery statistics",
+                      "getPDDiagnostics", {"power delivery"})
+                  .withResponseExample(R"({
+          "success": true,
+          "nvm": {
+            "writesAvoided": 3,
+            "commitPending": true,
+            "commitDelayMs": 10000
+          },
+          "alert": {
+            "pin": 7,
+            "serviced": 12
+          },
+          "history": {
+            "sealedBlocks": 41,
+            "logged": true,
+            "logBlocks": 160,
+            "logErrors": 0
+          },
+          "breaker": {
+            "state": "closed",
+            "trips": 2,
+            "rejected": 57,
+            "consecutiveFailures": 0,
+            "backoffMs": 0,
+            "retryInMs": 0
+          },
+          "i2c": {
+            "bus": 0,
+            "clockHz": 400000,
+            "clockMode": "auto",
+            "clockFallbacks": 1,
+            "readUs": 412,
+            "recovery": {
+              "failures": 3,
+              "attempts": 2,
+              "recovered": 1,
+              "lastMs": 512,
+              "meanMs": 512
+            },
+            "queueDepth": 0,
+            "maxQueueDepth": 2,
+            "clients": [{
+              "name": "usb_pd",
+              "budgetUs": 0,
+              "grants": 812,
+              "joined": 1630,
+              "deferred": 0,
+              "waitUs": 2310,
+              "maxWaitUs": 480,
+              "busyUs": 391200
+            }]
+          }
+        })")),
+
+          // Prometheus scrape target: plain text, so kept out of the API docs
+          webRoute("/metrics", WebModule::WM_GET,
+                   [this](RequestT &req, ResponseT &res) {
+                     metricsHandler(req, res);
+                   },
+                   {AuthType::SESSION, AuthType::PAGE_TOKEN, AuthType::TOKEN}),
+
+          // Multi-port routes; the routes above address port 0
+          apiRoute(
+              "/api/ports", WebModule::WM_GET,
+              [this](RequestT &req, ResponseT &res) {
+                portsHandler(req, res);
+              },
+              {AuthType::SESSION, AuthType::PAGE_TOKEN, AuthType::TOKEN},
+              API_DOC("List USB-C ports",
+                      "Returns the bus, address and last sampled state of "
+                      "every port managed by this controller",
+                      "getPDPorts", {"power delivery"})
+                  .withResponseExample(R"({
+          "success": true,
+          "ports": [
+            {
+              "port": 0,
+              "bus": 0,
+              "address": 40,
+              "connected": true,
+              "valid": true,
+              "voltage": 12.0,
+              "current": 2.0,
+              "activePDO": 2
+            }
+          ]
+        })"))};
+
+  // Per-port twins of the single-port API, served by the same handlers
+  struct PortRoute {
+    const char *path;
+    WebModule::Method method;
+    PortHandler handler;
+    const char *summary;
+    const char *description;
+    const char *operationId;
+  };
+  static const PortRoute portRoutes[] = {
+      {"/api/ports/{port}/status", WebModule::WM_GET,
+       &BasicUSBPDController::statusResponse, "Get port status",
+       "Same as /api/status for the given port", "getPDPortStatus"},
+      {"/api/ports/{port}/profiles", WebModule::WM_GET,
+       &BasicUSBPDController::profilesResponse, "Get port PDO profiles",
+       "Same as /api/profiles for the given port", "getPDPortProfiles"},
+      {"/api/ports/{port}/snapshot", WebModule::WM_GET,
+       &BasicUSBPDController::snapshotResponse, "Get port PD state snapshot",
+       "Same as /api/snapshot for the given port", "getPDPortSnapshot"},
+      {"/api/ports/{port}/events", WebModule::WM_GET,
+       &BasicUSBPDController::eventsResponse, "Poll port PD state changes",
+       "Same as /api/events for the given port", "getPDPortEvents"},
+      {"/api/ports/{port}/configure", WebModule::WM_POST,
+       &BasicUSBPDController::configureResponse, "Set port configuration",
+       "Same as /api/configure for the given port; job ids are shared by "
+       "all ports",
+       "setPDPortConfig"},
+      {"/api/ports/{port}/configure/{id}", WebModule::WM_GET,
+       &BasicUSBPDController::configJobStatusResponse,
+       "Get port configuration job status",
+       "Same as /api/configure/{id} for the given port",
+       "getPDPortConfigJob"},
+      {"/api/ports/{port}/diagnostics", WebModule::WM_GET,
+       &BasicUSBPDController::diagnosticsResponse, "Get port diagnostics",
+       "Same as /api/diagnostics for the given port",
+       "getPDPortDiagnostics"},
+  };
+  for (const PortRoute &r : portRoutes) {
+    PortHandler handler = r.handler;
+    routes.push_back(apiRoute(
+        r.path, r.method,
+        [this, handler](RequestT &req, ResponseT &res) {
+          portResponse(req.getRouteParameter("port").toInt(), handler, req,
+                       res);
+        },
+        {AuthType::SESSION, AuthType::PAGE_TOKEN, AuthType::TOKEN},
+        API_DOC(r.summary, r.description, r.operationId,
+                {"power delivery"})));
+  }
+
+#if USB_PD_TRACE
+  routes.push_back(apiRoute(
+      "/api/trace", WebModule::WM_GET,
+      [this](RequestT &req, ResponseT &res) {
+        traceHandler(req, res);
+      },
+      {AuthType::SESSION, AuthType::PAGE_TOKEN, AuthType::TOKEN},
+      API_DOC("Get recorded trace spans",
+              "Chrome trace-event JSON of the newest configure, sampling "
+              "and route spans (microseconds); clear=1 empties the ring "
+              "after the dump",
+              "getPDTrace", {"power delivery"})));
+#endif
+  return routes;
+}
+
+template <typename Chip>
+std::vector<RouteVariant> BasicUSBPDController<Chip>::getHttpsRoutes() {
   // For now, use same routes for HTTPS as HTTP
   return getHttpRoutes();
 }
 
-bool USBPDController::isPDBoardConnected() {
+template <typename Chip>
+bool BasicUSBPDController<Chip>::isPDBoardConnected() {
+  return probe(mainPort);
+}
+
+template <typename Chip> bool BasicUSBPDController<Chip>::probe(Port &p) {
   // Rely solely on the chip's probe, which performs the necessary I2C check
-  return pdController.probe(i2cAddress);
+  return p.chip.probe(p.settings.i2cAddress);
+}
+
+template <typename Chip>
+bool BasicUSBPDController<Chip>::readPDConfig(size_t n) {
+  Port *p = port(n);
+  return p && readConfig(*p);
 }
 
-bool USBPDController::readPDConfig() {
-  if (!pdBoardConnected) {
-    // Try to reconnect
-    pdBoardConnected = pdController.begin();
-    if (!pdBoardConnected) {
+template <typename Chip>
+bool BasicUSBPDController<Chip>::readConfig(Port &p) {
+  std::lock_guard<std::recursive_mutex> lock(p.chipMutex);
+  if (!p.pdBoardConnected) {
+    // Try to reconnect, unless the board has been failing lately
+    if (!p.breaker.allow(millis())) {
+      return false;
+    }
+    p.pdBoardConnected = p.chip.begin();
+    if (p.pdBoardConnected) {
+      armAlert(p);
+    } else {
+      chipFailed(p);
+      publishSnapshot(p, false, false);
       return false;
     }
   }
 
+  bool valid = refreshConfig(p);
+  publishSnapshot(p, true, valid);
+  return valid;
+}
+
+template <typename Chip>
+bool BasicUSBPDController<Chip>::refreshConfig(Port &p) {
   // Read current configuration
   float v, c;
-  int p;
-  if (!core.readConfig(v, c, p)) {
+  int pdo;
+  bool ok = p.core.readConfig(v, c, pdo);
+  if (p.core.readFailed()) {
+    chipFailed(p);
+    return false;
+  }
+  p.breaker.succeeded();
+  if (!ok) {
     return false;
   }
-  currentVoltage = v;
-  currentCurrent = c;
+  p.currentVoltage = v;
+  p.currentCurrent = c;
 
   return true;
 }
 
-bool USBPDController::setPDConfig(float voltage, float current) {
-  if (!pdBoardConnected) {
+template <typename Chip>
+void BasicUSBPDController<Chip>::publishSnapshot(Port &p, bool connected,
+                                                 bool valid) {
+  USB_PD_TRACE_SCOPE("controller.publish");
+  PdSnapshot previous = p.snapshotStore.read();
+  PdSnapshot snapshot;
+  snapshot.sampledAtMs = p.lastPublishMs = millis();
+  snapshot.connected = connected;
+  snapshot.initialized = p.pdBoardConnected;
+  snapshot.valid = p.pdBoardConnected && valid;
+
+  // PDOs as decoded by the last bulk read; no bus access here
+  if (p.pdBoardConnected) {
+    const PdoSet &set = p.core.pdoSet();
+    snapshot.activePdo = set.activePdo;
+    for (int i = 1; i <= 3; ++i) {
+      snapshot.pdoVoltage[i] = set.voltage[i];
+      snapshot.pdoCurrent[i] = set.current[i];
+    }
+  }
+  if (snapshot.valid) {
+    snapshot.voltage = p.currentVoltage;
+    snapshot.current = p.currentCurrent;
+  }
+
+  p.snapshotStore.publish(snapshot);
+  if (&p != &mainPort) {
+    // Extra ports render per request from the snapshot; only the version
+    // their ETags and events carry moves here
+    if (p.configureRan || !sameState(previous, snapshot)) {
+      p.configureRan = false;
+      p.stateVersion.fetch_add(1, std::memory_order_release);
+    }
+    return;
+  }
+
+  renderBodies(snapshot);
+  if (snapshot.valid) {
+    std::lock_guard<std::mutex> lock(telemetryMutex);
+    const PdTelemetryBucket *second = telemetry.record(
+        snapshot.sampledAtMs, snapshot.voltage, snapshot.current);
+    if (second) {
+      PdTelemetrySample mean;
+      mean.ms = second->startMs;
+      mean.millivolts = second->meanMillivolts();
+      mean.milliamps = second->meanMilliamps();
+      series.append(mean);
+    }
+  }
+
+  // After the bodies, so a handler that sees the new version also sees them
+  if (p.configureRan || !sameState(previous, snapshot)) {
+    p.configureRan = false;
+    profilesChanged |= previous.initialized != snapshot.initialized;
+    uint32_t version = p.stateVersion.load(std::memory_order_relaxed) + 1;
+    renderEvents(snapshot, version);
+    renderSnapshot(snapshot, version);
+    p.stateVersion.store(version, std::memory_order_release);
+  }
+}
+
+template <typename Chip>
+size_t BasicUSBPDController<Chip>::getStateEtag(char *buf, size_t len) const {
+  return formatStateEtag(buf, len, bootId(), getStateVersion());
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::renderBodies(const PdSnapshot &snapshot) {
+  // Rendered on the stack; the bodies only change when the text does
+  char buf[USB_PD_STATUS_JSON_LEN > USB_PD_PROFILES_JSON_LEN
+               ? USB_PD_STATUS_JSON_LEN
+               : USB_PD_PROFILES_JSON_LEN];
+  formatStatusJson(buf, USB_PD_STATUS_JSON_LEN, snapshot);
+  statusChanged |= statusBody.publish(buf);
+  if (snapshot.initialized) {
+    size_t len =
+        formatPdoProfilesJson(buf, USB_PD_PROFILES_JSON_LEN, snapshot.activePdo,
+                              snapshot.pdoVoltage, snapshot.pdoCurrent);
+    if (len < USB_PD_PROFILES_JSON_LEN) {
+      profilesChanged |= profilesBody.publish(buf);
+    }
+  }
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::renderEvents(const PdSnapshot &snapshot,
+                                              uint32_t version) {
+  // Serialized once here, whatever the number of subscribers
+  char id[USB_PD_STATE_ETAG_LEN];
+  formatStateId(id, sizeof(id), bootId(), version);
+  const char *profiles = snapshot.initialized
+                             ? profilesBody.get()
+                             : USB_PD_PROFILES_UNAVAILABLE_JSON;
+  char buf[USB_PD_EVENT_FRAME_LEN];
+  formatStateEvent(buf, sizeof(buf), id, statusBody.get(), profiles);
+  fullEvent.publish(buf);
+  formatStateEvent(buf, sizeof(buf), id,
+                   statusChanged ? statusBody.get() : nullptr,
+                   profilesChanged ? profiles : nullptr);
+  deltaEvent.publish(buf);
+  statusChanged = profilesChanged = false;
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::renderSnapshot(const PdSnapshot &snapshot,
+                                                uint32_t version) {
+  char buf[USB_PD_SNAPSHOT_JSON_LEN];
+  formatSnapshotJson(buf, sizeof(buf), version, statusBody.get(),
+                     snapshot.initialized ? profilesBody.get()
+                                          : USB_PD_PROFILES_UNAVAILABLE_JSON);
+  snapshotBody.publish(buf);
+}
+
+template <typename Chip>
+String BasicUSBPDController<Chip>::getEventFrame(const char *since) const {
+  // As for the ETag: version first, bodies after
+  uint32_t version = getStateVersion();
+  String frame;
+  if (!*since) {
+    fullEvent.copyTo(frame);
+    return frame;
+  }
+  char id[USB_PD_STATE_ETAG_LEN];
+  size_t len = formatStateId(id, sizeof(id), bootId(), version);
+  if (stateIdMatches(since, id)) {
+    char idle[USB_PD_STATE_ETAG_LEN + 8];
+    formatStateEvent(idle, sizeof(idle), id, nullptr, nullptr);
+    return idle;
+  }
+  // One version behind gets the delta, if the delta still is the one for
+  // this version (its own id says so); anyone else gets the full state
+  char previous[USB_PD_STATE_ETAG_LEN];
+  formatStateId(previous, sizeof(previous), bootId(), version - 1);
+  if (stateIdMatches(since, previous)) {
+    deltaEvent.copyTo(frame);
+    const char *delta = frame.c_str() + strlen("{\"id\":\"");
+    if (strncmp(delta, id, len) == 0 && delta[len] == '"') {
+      return frame;
+    }
+  }
+  fullEvent.copyTo(frame);
+  return frame;
+}
+
+template <typename Chip>
+bool BasicUSBPDController<Chip>::setPDConfig(float voltage, float current,
+                                             PdWriteMode mode, size_t n) {
+  Port *target = port(n);
+  if (!target) {
+    return false;
+  }
+  Port &p = *target;
+  std::lock_guard<std::recursive_mutex> lock(p.chipMutex);
+  if (!p.pdBoardConnected) {
     DEBUG_PRINTLN("Cannot set PD config: board not connected");
     return false;
   }
+  USB_PD_TRACE_SCOPE("controller.set_config");
 
-  bool ok = core.setConfig(voltage, current);
-  // Add a small delay to allow negotiation
-  delay(100);
+  // Returns as soon as the source accepts the new contract. The bus is held
+  // throughout; submitPDConfig() leaves it free during the wait.
+  bool ok;
+  {
+    PdI2cBus::Grant grant(p.i2cArbiter, p.i2cClient,
+                          PdI2cPriority::Configure);
+    ok = p.core.setConfig(voltage, current, mode);
+  }
+  if (p.core.readFailed()) {
+    chipFailed(p);
+  } else if (ok) {
+    p.breaker.succeeded();
+  }
+  p.configureRan = true;
   if (ok) {
-    currentVoltage = core.currentVoltage();
-    currentCurrent = core.currentCurrent();
+    noteConfigApplied(p, voltage, current, mode);
+    recordNegotiation(p);
+    p.currentVoltage = p.core.currentVoltage();
+    p.currentCurrent = p.core.currentCurrent();
     DEBUG_PRINTLN("PD configuration updated successfully");
   } else {
     DEBUG_PRINTLN("Failed to read back PD configuration");
   }
+  publishSnapshot(p, true, ok);
+  reschedulePoll(p, true);
+  poller.wake();
   return ok;
 }
 
-String USBPDController::getAllPDOProfiles() {
-  if (!pdBoardConnected) {
+template <typename Chip>
+void BasicUSBPDController<Chip>::configurePollSchedule(Port &p) {
+  std::lock_guard<std::recursive_mutex> lock(p.chipMutex);
+  const PdPortSettings &s = p.settings;
+  p.pollSchedule.configure(s.pollFastMs, s.pollBurstMs,
+                           s.pollIntervalMs > 0 ? s.pollIntervalMs
+                                                : USB_PD_HANDLE_INTERVAL_MS);
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::reschedulePoll(Port &p, bool stateChanged) {
+  if (stateChanged) {
+    p.pollSchedule.burst(p.lastPublishMs);
+  } else {
+    p.pollSchedule.polled(p.lastPublishMs);
+  }
+}
+
+template <typename Chip>
+String BasicUSBPDController<Chip>::getAllPDOProfiles() {
+  if (!mainPort.snapshotStore.read().initialized) {
     return R"({\"error\":\"PD board not connected\"})";
   }
 
-  return core.buildPdoProfilesJson();
+  String body;
+  profilesBody.copyTo(body);
+  return body;
 }
 
 // Route handler implementations
-void USBPDController::mainPageHandler(RequestT &req,
-                                      ResponseT &res) {
+template <typename Chip>
+void BasicUSBPDController<Chip>::mainPageHandler(RequestT &req,
+                                                 ResponseT &res) {
   // Use PROGMEM content for memory efficiency
   res.setProgmemContent(USB_PD_HTML, "text/html");
 }
 
-void USBPDController::pdStatusHandler(RequestT &req,
-                                      ResponseT &res) {
-  respondJson(res, [&](JsonObject &json) {
-    // Check if PD board is connected
-    bool connected = isPDBoardConnected();
-
-    // Try to read fresh values if connected
-    if (connected && !pdBoardConnected) {
-      pdBoardConnected = pdController.begin();
-      if (pdBoardConnected) {
-        readPDConfig();
-      }
-    } else if (connected && pdBoardConnected) {
-      // Refresh values if already connected
-      readPDConfig();
-    } else {
-      pdBoardConnected = false;
-    }
+template <typename Chip>
+void BasicUSBPDController<Chip>::pdStatusHandler(RequestT &req,
+                                                 ResponseT &res) {
+  statusResponse(mainPort, req, res);
+}
 
-    json["success"] = pdBoardConnected && currentVoltage > 0;
-    json["connected"] = connected;
-    if (pdBoardConnected && currentVoltage > 0) {
-      json["voltage"] = currentVoltage;
-      json["current"] = currentCurrent;
-    } else {
-      json["message"] = connected ? "Board initialized but values not read"
-                                  : "PD board not connected";
-    }
-  });
+template <typename Chip>
+void BasicUSBPDController<Chip>::statusResponse(Port &p, RequestT &req,
+                                                ResponseT &res) {
+  // Answer from the last published sample; no bus traffic on this path and
+  // for port 0 the body was rendered when the sample was published
+  if (&p == &mainPort) {
+    serveStateJson(req, res, statusBody);
+    return;
+  }
+  servePortJson(p, req, res, USB_PD_STATUS_JSON_LEN,
+                [](char *buf, size_t len, const PdSnapshot &snapshot,
+                   uint32_t) { formatStatusJson(buf, len, snapshot); });
 }
 
-void USBPDController::availableVoltagesHandler(RequestT &req,
-                                               ResponseT &res) {
-  respondJson(res, [&](JsonObject &json) {
-    JsonArray voltages = json["voltages"].to<JsonArray>();
-    voltages.add(5.0);
-    voltages.add(9.0);
-    voltages.add(12.0);
-    voltages.add(15.0);
-    voltages.add(20.0);
-  });
+template <typename Chip>
+bool BasicUSBPDController<Chip>::notModified(RequestT &req, ResponseT &res,
+                                             const char *etag) {
+  res.setHeader("ETag", etag);
+  if (!etagMatches(req.getHeader("If-None-Match").c_str(), etag)) {
+    return false;
+  }
+  res.setStatus(304); // Not modified
+  res.setProgmemContent(USB_PD_EMPTY_BODY, "application/json");
+  return true;
 }
 
-void USBPDController::availableCurrentsHandler(RequestT &req,
-                                               ResponseT &res) {
-  respondJson(res, [&](JsonObject &json) {
-    JsonArray currents = json["currents"].to<JsonArray>();
-    currents.add(0.5);
-    currents.add(1.0);
-    currents.add(1.33);
-    currents.add(1.5);
-    currents.add(1.67);
-    currents.add(2.0);
-    currents.add(2.25);
-    currents.add(2.5);
-    currents.add(3.0);
-  });
+template <typename Chip>
+void BasicUSBPDController<Chip>::serveStaticJson(RequestT &req,
+                                                 ResponseT &res,
+                                                 const char *body,
+                                                 const char *etag) {
+  res.setHeader("Cache-Control", USB_PD_CAPABILITIES_CACHE_CONTROL);
+  if (!notModified(req, res, etag)) {
+    res.setProgmemContent(body, "application/json");
+  }
 }
 
-void USBPDController::pdoProfilesHandler(RequestT &req,
-                                         ResponseT &res) {
-  if (!isPDBoardConnected()) {
+template <typename Chip>
+template <size_t N>
+void BasicUSBPDController<Chip>::serveStateJson(
+    RequestT &req, ResponseT &res, const PdRenderedBody<N> &body) {
+  // Version first: the body read after it is at least as new, so a client
+  // may be sent a newer body under an older tag but never the reverse
+  char etag[USB_PD_STATE_ETAG_LEN];
+  getStateEtag(etag, sizeof(etag));
+  res.setHeader("Cache-Control", "no-cache");
+  if (!notModified(req, res, etag)) {
+    // Copied: the response is sent after the handler returns, by which time
+    // the poller may have published a new body
+    String copy;
+    body.copyTo(copy);
+    res.setContent(copy, "application/json");
+  }
+}
+
+template <typename Chip>
+template <typename Fn>
+void BasicUSBPDController<Chip>::servePortJson(const Port &p, RequestT &req,
+                                               ResponseT &res, size_t len,
+                                               Fn render) {
+  // Same tag order as serveStateJson(); the body is only rendered for a
+  // client whose copy is stale
+  uint32_t version = p.stateVersion.load(std::memory_order_acquire);
+  char etag[USB_PD_STATE_ETAG_LEN];
+  formatStateEtag(etag, sizeof(etag), bootId(), version);
+  res.setHeader("Cache-Control", "no-cache");
+  if (notModified(req, res, etag)) {
+    return;
+  }
+  PdSnapshot snapshot = p.snapshotStore.read();
+  std::lock_guard<std::mutex> lock(portBodyMutex);
+  render(portBody, len, snapshot, version);
+  res.setContent(portBody, "application/json");
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::availableVoltagesHandler(RequestT &req,
+                                                          ResponseT &res) {
+  serveStaticJson(req, res, USB_PD_VOLTAGES_JSON.text,
+                  USB_PD_VOLTAGES_ETAG.text);
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::availableCurrentsHandler(RequestT &req,
+                                                          ResponseT &res) {
+  serveStaticJson(req, res, USB_PD_CURRENTS_JSON.text,
+                  USB_PD_CURRENTS_ETAG.text);
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::capabilitiesHandler(RequestT &req,
+                                                     ResponseT &res) {
+  serveStaticJson(req, res, USB_PD_CAPABILITIES_JSON.text,
+                  USB_PD_CAPABILITIES_ETAG.text);
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::pdoProfilesHandler(RequestT &req,
+                                                    ResponseT &res) {
+  profilesResponse(mainPort, req, res);
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::profilesResponse(Port &p, RequestT &req,
+                                                  ResponseT &res) {
+  if (!p.snapshotStore.read().initialized) {
     res.setStatus(503); // Service unavailable
+    res.setProgmemContent(USB_PD_PROFILES_UNAVAILABLE_JSON,
+                          "application/json");
+    return;
+  }
+
+  // All PDO profiles with the active PDO indicator
+  if (&p == &mainPort) {
+    serveStateJson(req, res, profilesBody);
+    return;
+  }
+  servePortJson(p, req, res, USB_PD_PROFILES_JSON_LEN,
+                [](char *buf, size_t len, const PdSnapshot &snapshot,
+                   uint32_t) { formatProfilesBody(buf, len, snapshot); });
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::eventsHandler(RequestT &req, ResponseT &res) {
+  eventsResponse(mainPort, req, res);
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::eventsResponse(Port &p, RequestT &req,
+                                                ResponseT &res) {
+  // A plain poll: the platform can't hold a response open, so each request
+  // is answered at once with what changed since the client's state
+  res.setHeader("Cache-Control", "no-cache");
+  String since = req.getParam("since");
+  if (&p == &mainPort) {
+    res.setContent(getEventFrame(since.c_str()), "application/json");
+    return;
+  }
+
+  // Extra ports keep no delta: a stale client gets the full state
+  char id[USB_PD_STATE_ETAG_LEN];
+  formatStateId(id, sizeof(id), bootId(),
+                p.stateVersion.load(std::memory_order_acquire));
+  if (stateIdMatches(since.c_str(), id)) {
+    char idle[USB_PD_STATE_ETAG_LEN + 8];
+    formatStateEvent(idle, sizeof(idle), id, nullptr, nullptr);
+    res.setContent(idle, "application/json");
+    return;
+  }
+  PdSnapshot snapshot = p.snapshotStore.read();
+  char status[USB_PD_STATUS_JSON_LEN];
+  char profiles[USB_PD_PROFILES_JSON_LEN];
+  formatStatusJson(status, sizeof(status), snapshot);
+  formatProfilesBody(profiles, sizeof(profiles), snapshot);
+  std::lock_guard<std::mutex> lock(portBodyMutex);
+  formatStateEvent(portBody, USB_PD_EVENT_FRAME_LEN, id, status, profiles);
+  res.setContent(portBody, "application/json");
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::snapshotHandler(RequestT &req,
+                                                 ResponseT &res) {
+  snapshotResponse(mainPort, req, res);
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::snapshotResponse(Port &p, RequestT &req,
+                                                  ResponseT &res) {
+  // Status, profiles and capabilities as of one published sample: one
+  // round trip and no bus traffic for a page load
+  if (&p == &mainPort) {
+    serveStateJson(req, res, snapshotBody);
+    return;
+  }
+  servePortJson(p, req, res, USB_PD_SNAPSHOT_JSON_LEN,
+                [](char *buf, size_t len, const PdSnapshot &snapshot,
+                   uint32_t version) {
+                  char status[USB_PD_STATUS_JSON_LEN];
+                  char profiles[USB_PD_PROFILES_JSON_LEN];
+                  formatStatusJson(status, sizeof(status), snapshot);
+                  formatProfilesBody(profiles, sizeof(profiles), snapshot);
+                  formatSnapshotJson(buf, len, version, status, profiles);
+                });
+}
+
+template <typename Chip>
+size_t BasicUSBPDController<Chip>::queryHistory(PdTelemetryTier tier,
+                                                uint32_t fromMs, uint32_t toMs,
+                                                PdTelemetryPoint *out,
+                                                size_t maxPoints) const {
+  std::lock_guard<std::mutex> lock(telemetryMutex);
+  size_t inWindow = telemetry.countPoints(tier, fromMs, toMs);
+  telemetry.query(tier, fromMs, toMs, out, maxPoints);
+  return inWindow;
+}
+
+template <typename Chip>
+PdTelemetryTier
+BasicUSBPDController<Chip>::pickHistoryTier(uint32_t fromMs,
+                                            uint32_t toMs) const {
+  std::lock_guard<std::mutex> lock(telemetryMutex);
+  return telemetry.pickTier(fromMs, toMs, USB_PD_HISTORY_MAX_POINTS);
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::attachHistoryLog(PdSeriesLog &log) {
+  std::lock_guard<std::mutex> logLock(historyLogMutex);
+  log.begin(bootId());
+  historyLog = &log;
+  std::lock_guard<std::mutex> lock(telemetryMutex);
+  seriesLogged = series.sealedTotal();
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::serviceHistoryLog() {
+  if (!historyLog) {
+    return;
+  }
+  std::lock_guard<std::mutex> logLock(historyLogMutex);
+  PdSeriesBlock block;
+  for (;;) {
+    // Copied out under the lock, written to flash after it
+    {
+      std::lock_guard<std::mutex> lock(telemetryMutex);
+      if (seriesLogged == series.sealedTotal()) {
+        return;
+      }
+      const PdSeriesBlock *sealed = series.sealed(seriesLogged);
+      if (!sealed) {
+        // Overwritten before handle() got to it
+        seriesLogged = series.sealedTotal() - USB_PD_SERIES_RAM_BLOCKS;
+        continue;
+      }
+      block = *sealed;
+    }
+    if (!historyLog->append(block)) {
+      ++historyLogErrors;
+    }
+    // A failed block is dropped rather than retried on every handle()
+    ++seriesLogged;
+  }
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::historyHandler(RequestT &req,
+                                                ResponseT &res) {
+  uint32_t now = millis();
+  uint32_t to = parseHistoryTime(req.getParam("to"), now, now);
+  uint32_t from = parseHistoryTime(req.getParam("from"), now,
+                                   to - USB_PD_HISTORY_DEFAULT_WINDOW_MS);
+  String resolution = req.getParam("resolution");
+  PdTelemetryTier tier = PdTelemetryTier::Raw;
+  if (resolution.length() == 0 || resolution == "auto") {
+    tier = pickHistoryTier(from, to);
+  } else if (!parseTelemetryTier(resolution.c_str(), tier)) {
+    res.setStatus(400);
     respondJson(res, [&](JsonObject &json) {
       json["success"] = false;
-      json["error"] = "PD board not connected";
-      json["pdos"].to<JsonArray>(); // Empty array
+      json["error"] = "Invalid resolution - must be raw, 1s, 1m, 1h or auto";
     });
     return;
   }
 
-  // Return all PDO profiles with active PDO indicator
-  respondJson(res, [&](JsonObject &json) {
-    JsonArray pdos = json.createNestedArray("pdos");
+  // Copied out under the lock, serialized after it
+  std::unique_ptr<PdTelemetryPoint[]> points(
+      new PdTelemetryPoint[USB_PD_HISTORY_MAX_POINTS]);
+  size_t inWindow =
+      queryHistory(tier, from, to, points.get(), USB_PD_HISTORY_MAX_POINTS);
+  size_t count =
+      inWindow < USB_PD_HISTORY_MAX_POINTS ? inWindow : USB_PD_HISTORY_MAX_POINTS;
 
-    // Build PDO profiles directly from chip data
-    for (int i = 1; i <= 3; ++i) {
-      JsonObject pdo = pdos.createNestedObject();
-      float v = pdController.getVoltage(i);
-      float c = pdController.getCurrent(i);
-      bool active = (pdController.getPdoNumber() == i);
-
-      pdo["number"] = i;
-      pdo["voltage"] = v;
-      pdo["current"] = c;
-      pdo["power"] = v * c;
-      pdo["active"] = active;
-
-      if (i == 1) {
-        pdo["fixed"] = true;
-      }
+  String body;
+  {
+    PdStringSink sink(body);
+    PdJsonWriter json(sink);
+    json.beginObject()
+        .member("success", true)
+        .member("resolution", telemetryTierName(tier))
+        .member("now", now)
+        .member("from", from)
+        .member("to", to)
+        .member("truncated", inWindow > count);
+    json.key("columns")
+        .beginArray()
+        .value("t")
+        .value("count")
+        .value("vMin")
+        .value("vMean")
+        .value("vMax")
+        .value("iMin")
+        .value("iMean")
+        .value("iMax")
+        .endArray();
+    json.key("points").beginArray();
+    for (size_t i = 0; i < count; ++i) {
+      const PdTelemetryPoint &p = points[i];
+      json.beginArray()
+          .value(p.ms)
+          .value(p.count)
+          .value(p.minMillivolts / 1000.0f)
+          .value(p.meanMillivolts / 1000.0f)
+          .value(p.maxMillivolts / 1000.0f)
+          .value(p.minMilliamps / 1000.0f)
+          .value(p.meanMilliamps / 1000.0f)
+          .value(p.maxMilliamps / 1000.0f)
+          .endArray();
     }
+    json.endArray().endObject();
+  }
+  res.setContent(body, "application/json");
+}
 
-    json["activePDO"] = pdController.getPdoNumber();
-  });
+template <typename Chip>
+void BasicUSBPDController<Chip>::setPDConfigHandler(RequestT &req,
+                                                    ResponseT &res) {
+  configureResponse(mainPort, req, res);
 }
-void USBPDController::setPDConfigHandler(RequestT &req,
-                                         ResponseT &res) {
-  // Parse JSON from request body
-  DynamicJsonDocument doc(256);
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::configureResponse(Port &p, RequestT &req,
+                                                   ResponseT &res) {
+  // Parse JSON from request body (on the stack, the body is tiny)
+  StaticJsonDocument<256> doc;
   DeserializationError error = deserializeJson(doc, req.getBody());
 
   if (error) {
@@ -380,9 +1914,13 @@ void USBPDController::setPDConfigHandler(RequestT &req,
 
   float voltage = doc["voltage"];
   float current = doc["current"];
+  const char *modeName = doc["mode"] | "persistent";
 
-  // Validate values
-  if (voltage < 5.0 || voltage > 20.0 || current < 0.5 || current > 3.0) {
+  // Validate values against the capability table
+  if (voltage < usb_pd_caps::minVoltage() / 1000.0f ||
+      voltage > usb_pd_caps::maxVoltage() / 1000.0f ||
+      current < usb_pd_caps::minCurrent() / 1000.0f ||
+      current > usb_pd_caps::maxCurrent() / 1000.0f) {
     res.setStatus(400);
     respondJson(res, [&](JsonObject &json) {
       json["success"] = false;
@@ -392,70 +1930,538 @@ void USBPDController::setPDConfigHandler(RequestT &req,
     return;
   }
 
-  // Check if PD board is connected
-  if (!isPDBoardConnected()) {
+  PdWriteMode mode;
+  if (strcmp(modeName, "persistent") == 0) {
+    mode = PdWriteMode::Persistent;
+  } else if (strcmp(modeName, "volatile") == 0) {
+    mode = PdWriteMode::Volatile;
+  } else {
+    res.setStatus(400);
+    respondJson(res, [&](JsonObject &json) {
+      json["success"] = false;
+      json["error"] = "Invalid mode - must be 'persistent' or 'volatile'";
+    });
+    return;
+  }
+
+  // Check if PD board is connected (as of the last sample)
+  if (!p.snapshotStore.read().initialized) {
+    // With the breaker open, say when the board will be tried again
+    uint32_t retryMs = p.breaker.msUntilRetry(millis());
+    if (retryMs > 0) {
+      res.setHeader("Retry-After", String((retryMs + 999) / 1000));
+    }
     res.setStatus(503);
     respondJson(res, [&](JsonObject &json) {
       json["success"] = false;
       json["error"] = "PD board not connected";
+      if (retryMs > 0) {
+        json["retryInMs"] = retryMs;
+      }
     });
     return;
   }
 
-  // Apply configuration
-  bool success = setPDConfig(voltage, current);
+  // Queue the configuration; handle() applies it without blocking this thread
+  uint32_t jobId = submitPDConfig(voltage, current, mode, p.index);
+  if (jobId == 0) {
+    res.setStatus(429);
+    respondJson(res, [&](JsonObject &json) {
+      json["success"] = false;
+      json["error"] = "Configuration queue full";
+    });
+    return;
+  }
 
-  if (success) {
+  res.setStatus(202);
+  respondJson(res, [&](JsonObject &json) {
+    json["success"] = true;
+    json["jobId"] = jobId;
+    json["state"] = pdConfigJobStateName(PdConfigJobState::Pending);
+  });
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::configJobStatusHandler(RequestT &req,
+                                                        ResponseT &res) {
+  configJobStatusResponse(mainPort, req, res);
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::configJobStatusResponse(Port &p,
+                                                         RequestT &req,
+                                                         ResponseT &res) {
+  configJobResponse((uint32_t)req.getRouteParameter("id").toInt(), res,
+                    p.index);
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::configJobResponse(uint32_t id,
+                                                   ResponseT &res,
+                                                   size_t port) {
+  // Ids are shared by every port; each port only answers for its own jobs
+  PdConfigJob job;
+  if (!getConfigJob(id, job) || job.port != port) {
+    res.setStatus(404);
     respondJson(res, [&](JsonObject &json) {
-      json["success"] = true;
-      json["voltage"] = currentVoltage;
-      json["current"] = currentCurrent;
+      json["success"] = false;
+      json["error"] = "Unknown configuration job";
     });
-  } else {
-    res.setStatus(500);
+    return;
+  }
+
+  respondJson(res, [&](JsonObject &json) {
+    json["success"] = job.state == PdConfigJobState::Succeeded;
+    json["jobId"] = job.id;
+    json["state"] = pdConfigJobStateName(job.state);
+    json["kind"] = pdConfigJobKindName(job.kind);
+    json["mode"] =
+        job.mode == PdWriteMode::Volatile ? "volatile" : "persistent";
+    if (job.state == PdConfigJobState::Succeeded) {
+      json["voltage"] = job.resultVoltage;
+      json["current"] = job.resultCurrent;
+      JsonObject contract = json.createNestedObject("contract");
+      contract["established"] = job.negotiation.established;
+      contract["pdo"] = job.negotiation.pdoNumber;
+      contract["negotiationMs"] = job.negotiation.elapsedMs;
+    } else if (job.state == PdConfigJobState::Failed) {
+      json["error"] = job.error;
+    }
+    if (job.isFinished()) {
+      json["elapsedMs"] = job.finishedMs - job.submittedMs;
+    }
+  });
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::diagnosticsHandler(RequestT &req,
+                                                    ResponseT &res) {
+  diagnosticsResponse(mainPort, req, res);
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::diagnosticsResponse(Port &p, RequestT &req,
+                                                     ResponseT &res) {
+  respondJson(res, [&](JsonObject &json) {
+    json["success"] = true;
+    JsonObject nvm = json.createNestedObject("nvm");
+    nvm["writesAvoided"] = p.stats.nvmWritesAvoided();
+    nvm["commitPending"] = p.nvmCommitPending;
+    nvm["commitDelayMs"] = p.settings.nvmCommitDelayMs;
+    JsonObject alert = json.createNestedObject("alert");
+    alert["pin"] = p.settings.alertPin;
+    alert["serviced"] = p.stats.alertsServiced;
+    // History is only kept for port 0
+    if (&p == &mainPort) {
+      JsonObject history = json.createNestedObject("history");
+      {
+        std::lock_guard<std::mutex> lock(telemetryMutex);
+        history["sealedBlocks"] = series.sealedTotal();
+      }
+      history["logged"] = historyLog != nullptr;
+      if (historyLog) {
+        std::lock_guard<std::mutex> lock(historyLogMutex);
+        history["logBlocks"] = historyLog->blockCount();
+        history["logErrors"] = historyLogErrors;
+      }
+    }
+    JsonObject circuit = json.createNestedObject("breaker");
+    uint32_t now = millis();
+    circuit["state"] = pdBreakerStateName(p.breaker.getState());
+    circuit["trips"] = p.breaker.getTrips();
+    circuit["rejected"] = p.breaker.getRejected();
+    circuit["consecutiveFailures"] = p.breaker.getConsecutiveFailures();
+    circuit["backoffMs"] = p.breaker.getBackoffMs();
+    circuit["retryInMs"] = p.breaker.msUntilRetry(now);
+    JsonObject i2c = json.createNestedObject("i2c");
+    i2c["bus"] = p.settings.i2cBus;
+    i2c["clockHz"] = busClockHz(p);
+    i2c["clockMode"] =
+        p.settings.i2cClockHz == USB_PD_I2C_CLOCK_AUTO ? "auto" : "fixed";
+    i2c["clockFallbacks"] = p.stats.i2cClockFallbacks;
+    i2c["clockConflict"] = clockConflict(p);
+    i2c["readUs"] = p.stats.i2cReadUs;
+    JsonObject recovery = i2c.createNestedObject("recovery");
+    recovery["failures"] = p.settings.i2cRecoveryFailures;
+    recovery["attempts"] = p.stats.i2cRecoveryAttempts;
+    recovery["recovered"] = p.stats.i2cRecoveries;
+    recovery["lastMs"] = p.stats.lastRecoveryMs;
+    recovery["meanMs"] = p.stats.meanRecoveryMs();
+    if (PdI2cBus *bus = p.i2cArbiter) {
+      // Every module sharing the bus, not only this one
+      i2c["queueDepth"] = bus->queueDepth();
+      i2c["maxQueueDepth"] = bus->maxQueueDepth();
+      JsonArray clients = i2c.createNestedArray("clients");
+      for (size_t i = 0; i < bus->clientCount(); ++i) {
+        PdI2cClientStats stats = bus->clientStats((int)i);
+        JsonObject client = clients.createNestedObject();
+        client["name"] = stats.name;
+        client["budgetUs"] = stats.budgetUs;
+        client["grants"] = stats.grants;
+        client["joined"] = stats.joined;
+        client["deferred"] = stats.deferred;
+        client["waitUs"] = stats.waitUs;
+        client["maxWaitUs"] = stats.maxWaitUs;
+        client["busyUs"] = stats.busyUs;
+        client["clockHz"] = stats.clockHz;
+      }
+    }
+  });
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::portsHandler(RequestT &req, ResponseT &res) {
+  respondJson(res, [&](JsonObject &json) {
+    json["success"] = true;
+    JsonArray ports = json.createNestedArray("ports");
+    for (size_t i = 0; i < getPortCount(); ++i) {
+      const Port &p = *getPort(i);
+      PdSnapshot snapshot = p.snapshotStore.read();
+      JsonObject entry = ports.createNestedObject();
+      entry["port"] = i;
+      entry["bus"] = p.settings.i2cBus;
+      entry["address"] = p.settings.i2cAddress;
+      entry["connected"] = snapshot.connected;
+      entry["valid"] = snapshot.valid;
+      if (snapshot.valid) {
+        entry["voltage"] = snapshot.voltage;
+        entry["current"] = snapshot.current;
+        entry["activePDO"] = snapshot.activePdo;
+      }
+    }
+  });
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::metricsHandler(RequestT &req,
+                                                ResponseT &res) {
+  // Ops and routes nothing was recorded for are left out to keep the scrape
+  // small; a series that appears later is simply new to Prometheus
+  auto forEachChipOp = [&](auto fn) {
+    char labels[48];
+    for (size_t port = 0; port < getPortCount(); ++port) {
+      const PdChipMetrics *metrics = getPort(port)->chipMetrics;
+      for (size_t op = 0; metrics && op < (size_t)PdChipOp::Count; ++op) {
+        if (metrics->latency[op].count() > 0) {
+          snprintf(labels, sizeof(labels), "port=\"%u\",op=\"%s\"",
+                   (unsigned)port, chipOpName((PdChipOp)op));
+          fn(labels, *metrics, op);
+        }
+      }
+    }
+  };
+
+  String body;
+  body.reserve(4096);
+  {
+    PdStringSink sink(body);
+    PdPrometheusWriter out(sink);
+    char portLabels[24];
+
+    out.family("usb_pd_chip_op_duration_seconds", "histogram",
+               "Time chip operations spent on the I2C bus");
+    forEachChipOp([&](const char *labels, const PdChipMetrics &m, size_t op) {
+      out.histogram("usb_pd_chip_op_duration_seconds", labels, m.latency[op]);
+    });
+    out.family("usb_pd_chip_op_failures_total", "counter",
+               "Chip operations that reported failure");
+    forEachChipOp([&](const char *labels, const PdChipMetrics &m, size_t op) {
+      out.counter("usb_pd_chip_op_failures_total", labels,
+                  m.failures[op].get());
+    });
+
+    out.family("usb_pd_negotiation_duration_seconds", "histogram",
+               "Soft reset to new contract, per completed configure");
+    for (size_t port = 0; port < getPortCount(); ++port) {
+      const PdHistogram &latency = getPort(port)->negotiationMetrics.latency;
+      if (latency.count() > 0) {
+        snprintf(portLabels, sizeof(portLabels), "port=\"%u\"",
+                 (unsigned)port);
+        out.histogram("usb_pd_negotiation_duration_seconds", portLabels,
+                      latency);
+      }
+    }
+    out.family("usb_pd_negotiation_timeouts_total", "counter",
+               "Configures the source did not confirm in time");
+    for (size_t port = 0; port < getPortCount(); ++port) {
+      snprintf(portLabels, sizeof(portLabels), "port=\"%u\"",
+               (unsigned)port);
+      out.counter("usb_pd_negotiation_timeouts_total", portLabels,
+                  getPort(port)->negotiationMetrics.timeouts.get());
+    }
+    out.family("usb_pd_breaker_trips_total", "counter",
+               "Times the chip circuit breaker opened");
+    for (size_t port = 0; port < getPortCount(); ++port) {
+      snprintf(portLabels, sizeof(portLabels), "port=\"%u\"",
+               (unsigned)port);
+      out.counter("usb_pd_breaker_trips_total", portLabels,
+                  getPort(port)->breaker.getTrips());
+    }
+    out.family("usb_pd_breaker_rejected_total", "counter",
+               "Bus transactions skipped while the breaker was open");
+    for (size_t port = 0; port < getPortCount(); ++port) {
+      snprintf(portLabels, sizeof(portLabels), "port=\"%u\"",
+               (unsigned)port);
+      out.counter("usb_pd_breaker_rejected_total", portLabels,
+                  getPort(port)->breaker.getRejected());
+    }
+    out.family("usb_pd_i2c_recovery_attempts_total", "counter",
+               "I2C bus recoveries tried after repeated chip failures");
+    for (size_t port = 0; port < getPortCount(); ++port) {
+      snprintf(portLabels, sizeof(portLabels), "port=\"%u\"",
+               (unsigned)port);
+      out.counter("usb_pd_i2c_recovery_attempts_total", portLabels,
+                  getPort(port)->stats.i2cRecoveryAttempts);
+    }
+    out.family("usb_pd_i2c_recoveries_total", "counter",
+               "I2C bus recoveries that brought the chip back");
+    for (size_t port = 0; port < getPortCount(); ++port) {
+      snprintf(portLabels, sizeof(portLabels), "port=\"%u\"",
+               (unsigned)port);
+      out.counter("usb_pd_i2c_recoveries_total", portLabels,
+                  getPort(port)->stats.i2cRecoveries);
+    }
+
+    // Routes are labelled by their pattern, e.g. /api/ports/{port}/status,
+    // and method
+    char routeLabels[112];
+    size_t routes = routeMetrics ? routeMetrics->size() : 0;
+    out.family("usb_pd_http_request_duration_seconds", "histogram",
+               "Time route handlers took to build their response");
+    for (size_t i = 0; i < routes; ++i) {
+      const PdRouteMetrics::Slot &slot = routeMetrics->at(i);
+      if (slot.latency.count() > 0) {
+        snprintf(routeLabels, sizeof(routeLabels),
+                 "route=\"%s\",method=\"%s\"", slot.route, slot.method);
+        out.histogram("usb_pd_http_request_duration_seconds", routeLabels,
+                      slot.latency);
+      }
+    }
+    out.family("usb_pd_http_request_errors_total", "counter",
+               "Responses with a 4xx or 5xx status");
+    for (size_t i = 0; i < routes; ++i) {
+      const PdRouteMetrics::Slot &slot = routeMetrics->at(i);
+      if (slot.latency.count() > 0) {
+        snprintf(routeLabels, sizeof(routeLabels),
+                 "route=\"%s\",method=\"%s\"", slot.route, slot.method);
+        out.counter("usb_pd_http_request_errors_total", routeLabels,
+                    slot.errors.get());
+      }
+    }
+  }
+  res.setHeader("Cache-Control", "no-cache");
+  res.setContent(body, "text/plain; version=0.0.4; charset=utf-8");
+}
+
+#if USB_PD_TRACE
+template <typename Chip>
+void BasicUSBPDController<Chip>::traceHandler(RequestT &req, ResponseT &res) {
+  String body;
+  body.reserve(USB_PD_TRACE_EVENTS * 96);
+  {
+    PdStringSink sink(body);
+    PdJsonWriter json(sink);
+    pdTrace.writeChromeTrace(json, req.getParam("clear") == "1");
+  }
+  res.setHeader("Cache-Control", "no-store");
+  res.setContent(body, "application/json");
+}
+#endif
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::portResponse(long n, PortHandler handler,
+                                              RequestT &req, ResponseT &res) {
+  Port *target = n >= 0 ? port((size_t)n) : nullptr;
+  if (!target) {
+    res.setStatus(404);
     respondJson(res, [&](JsonObject &json) {
       json["success"] = false;
-      json["error"] = "Failed to set configuration";
+      json["error"] = "Unknown port";
     });
+    return;
   }
+  (this->*handler)(*target, req, res);
 }
 
-void USBPDController::parseConfig(const JsonVariant &config) {
+template <typename Chip>
+void BasicUSBPDController<Chip>::parseConfig(const JsonVariant &config) {
   if (config.isNull()) {
     DEBUG_PRINTLN("USB PD Controller: Using default configuration");
     return;
   }
 
-  // Parse I2C pin configuration
+  parseSettings(mainPort, config);
+  if (config.containsKey("ports")) {
+    parsePorts(config);
+  }
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::parsePorts(const JsonVariant &config) {
+  // Ports cannot change under a running poller
+  if (poller.isRunning()) {
+    DEBUG_PRINTLN("USB PD Controller: Ports cannot change while polling");
+    return;
+  }
+  for (size_t i = 0; i < extraPortCount; ++i) {
+    extraPorts[i].reset();
+  }
+  extraPortCount = 0;
+
+  JsonArray ports = config["ports"].as<JsonArray>();
+  if (ports.size() > USB_PD_MAX_PORTS) {
+    DEBUG_PRINTF("USB PD Controller: Only the first %d ports are used\n",
+                 USB_PD_MAX_PORTS);
+  }
+
+  // Extra ports inherit the top-level settings before port 0 takes on its
+  // own
+  for (size_t n = 1; n < ports.size() && n < USB_PD_MAX_PORTS; ++n) {
+    std::unique_ptr<Chip> chip;
+    if (portChipFactory) {
+      chip = portChipFactory(n);
+    }
+    if (!chip) {
+      DEBUG_PRINTF("USB PD Controller: No chip for port %u\n", (unsigned)n);
+      break;
+    }
+    const PdChipMetrics *metrics =
+        defaultPortChips ? PortChips<Chip>::metrics(*chip) : nullptr;
+    extraPorts[extraPortCount].reset(new Port(std::move(chip), metrics));
+    Port &added = *extraPorts[extraPortCount++];
+    added.index = n;
+    parseSettings(added, config, true);
+    parseSettings(added, ports[n].as<JsonVariant>());
+  }
+  if (ports.size() > 0) {
+    parseSettings(mainPort, ports[0].as<JsonVariant>());
+  }
+  DEBUG_PRINTF("USB PD Controller: Managing %u port(s)\n",
+               (unsigned)getPortCount());
+}
+
+template <typename Chip>
+void BasicUSBPDController<Chip>::parseSettings(Port &p,
+                                               const JsonVariant &config,
+                                               bool shared) {
+  // Parse I2C bus and pin configuration
+  if (config.containsKey("bus")) {
+    p.settings.i2cBus = config["bus"].as<uint8_t>();
+  }
+
   if (config.containsKey("SDA")) {
-    sdaPin = config["SDA"].as<int>();
-    DEBUG_PRINTF("USB PD Controller: Configured SDA pin: %d\n", sdaPin);
+    p.settings.sdaPin = config["SDA"].as<int>();
+    DEBUG_PRINTF("USB PD Controller: Configured SDA pin: %d\n",
+                 p.settings.sdaPin);
   }
 
   if (config.containsKey("SCL")) {
-    sclPin = config["SCL"].as<int>();
-    DEBUG_PRINTF("USB PD Controller: Configured SCL pin: %d\n", sclPin);
+    p.settings.sclPin = config["SCL"].as<int>();
+    DEBUG_PRINTF("USB PD Controller: Configured SCL pin: %d\n",
+                 p.settings.sclPin);
   }
 
   // Parse board type
   if (config.containsKey("board")) {
-    boardType = config["board"].as<const char *>();
+    const char *board = config["board"].as<const char *>();
+    snprintf(p.settings.boardType, sizeof(p.settings.boardType), "%s",
+             board ? board : "");
     DEBUG_PRINTF("USB PD Controller: Configured board type: %s\n",
-                 boardType.c_str());
+                 p.settings.boardType);
 
     // Validate board type
-    if (boardType != "sparkfun") {
+    if (strcmp(p.settings.boardType, "sparkfun") != 0) {
       DEBUG_PRINTF("USB PD Controller: WARNING - Unsupported board type "
                    "'%s', using 'sparkfun'\n",
-                   boardType.c_str());
-      boardType = "sparkfun";
+                   p.settings.boardType);
+      snprintf(p.settings.boardType, sizeof(p.settings.boardType), "%s",
+               "sparkfun");
     }
   }
 
   // Parse I2C address if provided
   if (config.containsKey("i2cAddress")) {
-    i2cAddress = config["i2cAddress"].as<uint8_t>();
+    p.settings.i2cAddress = config["i2cAddress"].as<uint8_t>();
     DEBUG_PRINTF("USB PD Controller: Configured I2C address: 0x%02X\n",
-                 i2cAddress);
+                 p.settings.i2cAddress);
+  }
+
+  // Parse background poll interval (0 disables the poller task)
+  if (config.containsKey("pollIntervalMs")) {
+    p.settings.pollIntervalMs = config["pollIntervalMs"].as<uint32_t>();
+    DEBUG_PRINTF("USB PD Controller: Configured poll interval: %lu ms\n",
+                 (unsigned long)p.settings.pollIntervalMs);
+  }
+
+  // Parse ALERT pin; with interrupts reporting attach/detach, polling is only
+  // a safety net and slows down unless configured explicitly
+  if (!shared && config.containsKey("alertPin")) {
+    p.settings.alertPin = config["alertPin"].as<int>();
+    DEBUG_PRINTF("USB PD Controller: Configured ALERT pin: %d\n",
+                 p.settings.alertPin);
+    if (p.settings.alertPin >= 0 && p.settings.pollIntervalMs > 0 &&
+        !config.containsKey("pollIntervalMs")) {
+      p.settings.pollIntervalMs = USB_PD_ALERT_POLL_INTERVAL_MS;
+    }
+  }
+
+  // Parse adaptive polling: fast interval and how long it lasts after a
+  // connect, disconnect or configure (pollIntervalMs is the backoff ceiling)
+  if (config.containsKey("pollFastMs")) {
+    p.settings.pollFastMs = config["pollFastMs"].as<uint32_t>();
   }
-}
\ No newline at end of file
+  if (config.containsKey("pollBurstMs")) {
+    p.settings.pollBurstMs = config["pollBurstMs"].as<uint32_t>();
+  }
+
+  // Parse I2C clock: 100000, 400000, 1000000 or "auto"
+  if (config.containsKey("i2cClockHz")) {
+    const char *mode = config["i2cClockHz"].as<const char *>();
+    uint32_t hz = config["i2cClockHz"].as<uint32_t>();
+    if (mode && strcmp(mode, "auto") == 0) {
+      p.settings.i2cClockHz = USB_PD_I2C_CLOCK_AUTO;
+    } else if (hz == 100000 || hz == 400000 || hz == 1000000) {
+      p.settings.i2cClockHz = hz;
+    } else {
+      DEBUG_PRINTF("USB PD Controller: WARNING - Unsupported i2cClockHz, "
+                   "using %lu\n",
+                   (unsigned long)p.settings.i2cClockHz);
+    }
+  }
+
+  // Parse consecutive failures that trigger bus recovery (0 disables it)
+  if (config.containsKey("i2cRecoveryFailures")) {
+    p.settings.i2cRecoveryFailures =
+        config["i2cRecoveryFailures"].as<uint32_t>();
+  }
+
+  // Parse bus time per second periodic samples may use on a shared bus
+  if (config.containsKey("i2cBudgetUs")) {
+    p.settings.i2cBudgetUs = config["i2cBudgetUs"].as<uint32_t>();
+    attachI2cBus(p, p.i2cArbiter);
+  }
+
+  // Parse circuit breaker: failures that open it (0 disables it) and the
+  // backoff between trials while open
+  if (config.containsKey("breakerFailures") ||
+      config.containsKey("breakerBackoffMs") ||
+      config.containsKey("breakerMaxBackoffMs")) {
+    std::lock_guard<std::recursive_mutex> lock(p.chipMutex);
+    p.breaker.configure(
+        config["breakerFailures"] | p.breaker.getFailureThreshold(),
+        config["breakerBackoffMs"] | p.breaker.getBaseBackoffMs(),
+        config["breakerMaxBackoffMs"] | p.breaker.getMaxBackoffMs());
+  }
+
+  // Parse quiet period before volatile configures are committed to NVM
+  if (config.containsKey("nvmCommitDelayMs")) {
+    p.settings.nvmCommitDelayMs = config["nvmCommitDelayMs"].as<uint32_t>();
+    DEBUG_PRINTF("USB PD Controller: Configured NVM commit delay: %lu ms\n",
+                 (unsigned long)p.settings.nvmCommitDelayMs);
+  }
+
+  configurePollSchedule(p);
+}
+
+template class BasicUSBPDController<IUsbPdChip>;
+
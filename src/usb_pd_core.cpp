@@ -1,87 +1,50 @@
-#include "../include/usb_pd_core.h"
+#include "../include/usb_pd_core_impl.h"
 
-bool USBPDCore::readConfig(float &voltageOut, float &currentOut,
-                           int &activePdoOut) {
-  chip.read();
-  int pdo = chip.getPdoNumber();
-  float v = chip.getVoltage(pdo);
-  float c = chip.getCurrent(pdo);
-  if (v <= 0 || c <= 0) {
-    return false;
+template class BasicUSBPDCore<IUsbPdChip>;
+
+void writePdoProfilesJson(PdJsonWriter &json, int activePdo,
+                          const float *voltages, const float *currents,
+                          int count) {
+  json.beginObject().key("pdos").beginArray();
+  for (int i = 1; i <= count; ++i) {
+    float v = voltages[i];
+    float c = currents[i];
+    json.beginObject()
+        .member("number", i)
+        .member("voltage", v)
+        .member("current", c)
+        .member("power", v * c)
+        .member("active", activePdo == i);
+    if (i == 1) {
+      json.member("fixed", true); // PDO1 is always 5 V
+    }
+    json.endObject();
   }
-  cachedPdo = pdo;
-  cachedVoltage = v;
-  cachedCurrent = c;
-  voltageOut = v;
-  currentOut = c;
-  activePdoOut = pdo;
-  return true;
+  json.endArray().member("activePDO", activePdo).endObject();
 }
 
-bool USBPDCore::setConfig(float voltage, float current) {
-  // Read current to ensure chip state
-  chip.read();
-
-  if (voltage == 5.0f) {
-    chip.setCurrent(1, current);
-    chip.setPdoNumber(1);
-  } else if (voltage <= 12.0f) {
-    chip.setVoltage(2, voltage);
-    chip.setCurrent(2, current);
-    chip.setCurrent(1, current); // fallback PDO1
-    chip.setPdoNumber(2);
-  } else {
-    chip.setVoltage(3, voltage);
-    chip.setCurrent(3, current);
-    chip.setVoltage(2, 12.0f); // middle fallback
-    chip.setCurrent(2, current);
-    chip.setCurrent(1, current); // final fallback
-    chip.setPdoNumber(3);
+size_t formatPdoProfilesJson(char *buf, size_t len, int activePdo,
+                             const float *voltages, const float *currents) {
+  PdBufferSink sink(buf, len);
+  {
+    PdJsonWriter json(sink);
+    writePdoProfilesJson(json, activePdo, voltages, currents);
   }
-
-  chip.write();
-  chip.softReset();
-
-  // Small settle assumed by caller; read back
-  float v, c;
-  int p;
-  if (!readConfig(v, c, p))
-    return false;
-  return true;
+  return sink.needed();
 }
 
-String USBPDCore::buildPdoProfilesJson() const {
-  // Refactored to minimize synthetic branch inflation from many String +/+= operations.
-  // Using a fixed-size stack buffer and snprintf reduces exception/alloc branches counted by gcov.
-  // Max length estimation (worst case):
-  //   Per PDO object ~70 chars * 3 + wrapper ~30 < 250. Use 256 for safety.
-  char buf[256];
-  int pos = 0;
-  auto append = [&](int written) {
-    if (written < 0 || written >= (int)sizeof(buf) - pos) {
-      // Truncate safely if overflow would occur; ensure valid JSON termination later.
-      pos = (int)sizeof(buf) - 1;
-    } else {
-      pos += written;
-    }
-  };
-
-  append(snprintf(buf + pos, sizeof(buf) - pos, "{\"pdos\":["));
-  int activePdo = chip.getPdoNumber();
-  for (int i = 1; i <= 3; ++i) {
-    if (i > 1) {
-      append(snprintf(buf + pos, sizeof(buf) - pos, ","));
-    }
-    float v = chip.getVoltage(i);
-    float c = chip.getCurrent(i);
-    float pwr = v * c;
-    bool active = (activePdo == i);
-    append(snprintf(buf + pos, sizeof(buf) - pos,
-                   "{\"number\":%d,\"voltage\":%.3g,\"current\":%.3g,\"power\":%.3g,\"active\":%s%s}",
-                   i, v, c, pwr, active ? "true" : "false", i == 1 ? ",\"fixed\":true" : ""));
+String formatPdoProfilesJson(int activePdo, const float *voltages,
+                             const float *currents) {
+  // Rendered on the stack so the String is allocated once at its final size
+  char buf[USB_PD_PROFILES_JSON_LEN];
+  if (formatPdoProfilesJson(buf, sizeof(buf), activePdo, voltages, currents) <
+      sizeof(buf)) {
+    return String(buf);
   }
-  append(snprintf(buf + pos, sizeof(buf) - pos, "],\"activePDO\":%d}", activePdo));
-  // Ensure null termination
-  buf[sizeof(buf) - 1] = '\0';
-  return String(buf);
+  String out;
+  PdStringSink sink(out);
+  PdJsonWriter json(sink);
+  writePdoProfilesJson(json, activePdo, voltages, currents);
+  json.flush();
+  return out;
 }
@@ -0,0 +1,242 @@
+#include "../include/usb_pd_i2c_bus.h"
+#include "../include/usb_pd_poller.h"
+
+#include <string.h>
+
+int PdI2cBus::addClient(const char *name, uint32_t budgetUs) {
+  std::lock_guard<std::mutex> lock(mutex);
+  size_t i = 0;
+  while (i < clientsUsed && strncmp(clients[i].name, name,
+                                    sizeof(clients[i].name) - 1) != 0) {
+    ++i;
+  }
+  if (i == clientsUsed) {
+    if (clientsUsed == USB_PD_I2C_MAX_CLIENTS) {
+      return -1;
+    }
+    Client &c = clients[clientsUsed++];
+    strncpy(c.name, name, sizeof(c.name) - 1);
+    c.stats.name = c.name;
+  }
+  if (budgetUs > 0) {
+    clients[i].stats.budgetUs = budgetUs;
+  }
+  return (int)i;
+}
+
+bool PdI2cBus::admit(int client) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (client < 0 || (size_t)client >= clientsUsed) {
+    return true;
+  }
+  Client &c = clients[client];
+  if (c.stats.budgetUs == 0) {
+    return true;
+  }
+  rollWindow(c, now());
+  if (c.windowUsedUs < c.stats.budgetUs) {
+    return true;
+  }
+  ++c.stats.deferred;
+  return false;
+}
+
+void PdI2cBus::acquire(int client, PdI2cPriority priority) {
+  uintptr_t task = usbPdCurrentTask();
+  std::unique_lock<std::mutex> lock(mutex);
+  bool known = client >= 0 && (size_t)client < clientsUsed;
+  if (held && holderTask == task) {
+    ++depth;
+    if (known) {
+      ++clients[client].stats.joined;
+    }
+    return;
+  }
+
+  size_t p = (size_t)priority;
+  uint32_t ticket = nextTicket[p]++;
+  uint32_t queuedAtUs = now();
+  if (++waiting > maxWaiting) {
+    maxWaiting = waiting;
+  }
+  released.wait(lock, [&]() {
+    return !held && serving[p] == ticket && !queuedAbove(p);
+  });
+  ++serving[p];
+  --waiting;
+
+  held = true;
+  holderTask = task;
+  holderClient = known ? client : -1;
+  depth = 1;
+  grantedAtUs = now();
+  if (known) {
+    PdI2cClientStats &stats = clients[client].stats;
+    uint32_t waitUs = grantedAtUs - queuedAtUs;
+    ++stats.grants;
+    stats.waitUs += waitUs;
+    if (waitUs > stats.maxWaitUs) {
+      stats.maxWaitUs = waitUs;
+    }
+  }
+}
+
+void PdI2cBus::release() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!held || --depth > 0) {
+      return;
+    }
+    uint32_t nowUs = now();
+    if (holderClient >= 0) {
+      Client &c = clients[holderClient];
+      uint32_t busyUs = nowUs - grantedAtUs;
+      c.stats.busyUs += busyUs;
+      rollWindow(c, nowUs);
+      c.windowUsedUs += busyUs;
+    }
+    held = false;
+    holderTask = 0;
+    holderClient = -1;
+  }
+  released.notify_all();
+}
+
+uint32_t PdI2cBus::setClockHz(int client, uint32_t hz) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (client >= 0 && (size_t)client < clientsUsed && hz > 0) {
+    // Modules share a client by name, so it keeps the slowest of its own
+    // requests too
+    uint32_t &clientHz = clients[client].stats.clockHz;
+    if (clientHz == 0 || hz < clientHz) {
+      clientHz = hz;
+    }
+  }
+  return slowestClockHz();
+}
+
+uint32_t PdI2cBus::clockHz() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return slowestClockHz();
+}
+
+uint32_t PdI2cBus::slowestClockHz() const {
+  uint32_t hz = 0;
+  for (size_t i = 0; i < clientsUsed; ++i) {
+    uint32_t clientHz = clients[i].stats.clockHz;
+    if (clientHz > 0 && (hz == 0 || clientHz < hz)) {
+      hz = clientHz;
+    }
+  }
+  return hz;
+}
+
+size_t PdI2cBus::queueDepth() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return waiting;
+}
+
+size_t PdI2cBus::maxQueueDepth() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return maxWaiting;
+}
+
+size_t PdI2cBus::clientCount() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return clientsUsed;
+}
+
+PdI2cClientStats PdI2cBus::clientStats(int client) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (client < 0 || (size_t)client >= clientsUsed) {
+    return PdI2cClientStats();
+  }
+  return clients[client].stats;
+}
+
+bool PdI2cBus::queuedAbove(size_t priority) const {
+  for (size_t q = priority + 1; q < (size_t)PdI2cPriority::Count; ++q) {
+    if (nextTicket[q] != serving[q]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void PdI2cBus::rollWindow(Client &c, uint32_t nowUs) {
+  if (nowUs - c.windowStartUs >= USB_PD_I2C_BUDGET_WINDOW_US) {
+    c.windowStartUs = nowUs;
+    c.windowUsedUs = 0;
+  }
+}
+
+#if defined(ARDUINO) || defined(ESP_PLATFORM)
+#include <Arduino.h>
+#include <Wire.h>
+
+static uint32_t microsClock() { return micros(); }
+
+TwoWire *pdI2cWire(uint8_t bus) {
+  if (bus == 0) {
+    return &Wire;
+  }
+#if SOC_I2C_NUM > 1
+  if (bus == 1) {
+    return &Wire1;
+  }
+#endif
+  return nullptr;
+}
+
+PdI2cBus *pdI2cBus(uint8_t bus) {
+  static PdI2cBus bus0(microsClock);
+  if (bus == 0) {
+    return &bus0;
+  }
+#if SOC_I2C_NUM > 1
+  static PdI2cBus bus1(microsClock);
+  if (bus == 1) {
+    return &bus1;
+  }
+#endif
+  return nullptr;
+}
+
+// Open drain by hand: a released line is pulled up, a driven one is low
+static void releaseLine(int pin) { pinMode(pin, INPUT_PULLUP); }
+static void pullLow(int pin) {
+  pinMode(pin, OUTPUT);
+  digitalWrite(pin, LOW);
+}
+
+bool pdI2cRecoverBus(TwoWire &wire, int sda, int scl) {
+  static const uint32_t HALF_PERIOD_US = 5; // 100 kHz
+  wire.end();
+  releaseLine(sda);
+  releaseLine(scl);
+  delayMicroseconds(HALF_PERIOD_US);
+
+  // A device stuck mid-read lets go of SDA once it has clocked out the rest
+  // of its byte
+  for (int i = 0; i < 9 && digitalRead(sda) == LOW; ++i) {
+    pullLow(scl);
+    delayMicroseconds(HALF_PERIOD_US);
+    releaseLine(scl);
+    delayMicroseconds(HALF_PERIOD_US);
+  }
+
+  // STOP (SDA rising while SCL is high) resets every device's bus logic
+  pullLow(scl);
+  delayMicroseconds(HALF_PERIOD_US);
+  pullLow(sda);
+  delayMicroseconds(HALF_PERIOD_US);
+  releaseLine(scl);
+  delayMicroseconds(HALF_PERIOD_US);
+  releaseLine(sda);
+  delayMicroseconds(HALF_PERIOD_US);
+  bool released = digitalRead(sda) == HIGH && digitalRead(scl) == HIGH;
+
+  wire.begin(sda, scl);
+  return released;
+}
+#endif
@@ -0,0 +1,72 @@
+#include "../include/usb_pd_instrumented_chip.h"
+
+bool InstrumentedUsbPdChip::probe(uint8_t i2cAddress) {
+  return timed(PdChipOp::Probe, [&]() { return inner.probe(i2cAddress); });
+}
+
+bool InstrumentedUsbPdChip::begin() {
+  return timed(PdChipOp::Begin, [&]() { return inner.begin(); });
+}
+
+void InstrumentedUsbPdChip::read() {
+  timed(PdChipOp::Read, [&]() {
+    inner.read();
+    return true;
+  });
+}
+
+bool InstrumentedUsbPdChip::readPdoSet(PdoSet &out) {
+  return timed(PdChipOp::ReadPdoSet, [&]() { return inner.readPdoSet(out); });
+}
+
+void InstrumentedUsbPdChip::write() {
+  timed(PdChipOp::Write, [&]() {
+    inner.write();
+    return true;
+  });
+}
+
+void InstrumentedUsbPdChip::softReset() {
+  timed(PdChipOp::SoftReset, [&]() {
+    inner.softReset();
+    return true;
+  });
+}
+
+void InstrumentedUsbPdChip::writeVolatile() {
+  timed(PdChipOp::WriteVolatile, [&]() {
+    inner.writeVolatile();
+    return true;
+  });
+}
+
+PdContract InstrumentedUsbPdChip::readContract() {
+  PdContract contract;
+  timed(PdChipOp::ReadContract, [&]() {
+    contract = inner.readContract();
+    return contract.state != PdContractState::Unknown;
+  });
+  return contract;
+}
+
+bool InstrumentedUsbPdChip::enableAttachAlert() {
+  return timed(PdChipOp::EnableAttachAlert,
+               [&]() { return inner.enableAttachAlert(); });
+}
+
+void InstrumentedUsbPdChip::clearAlerts() {
+  timed(PdChipOp::ClearAlerts, [&]() {
+    inner.clearAlerts();
+    return true;
+  });
+}
+
+bool InstrumentedUsbPdChip::readRegisterImage(PdRegisterImage &out) {
+  return timed(PdChipOp::ReadRegisterImage,
+               [&]() { return inner.readRegisterImage(out); });
+}
+
+bool InstrumentedUsbPdChip::recoverBus(int sda, int scl) {
+  return timed(PdChipOp::RecoverBus,
+               [&]() { return inner.recoverBus(sda, scl); });
+}
@@ -0,0 +1,272 @@
+#include "../include/usb_pd_json_writer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// Digits of v, most significant first; returns the count (at most 20)
+static size_t formatDigits(char *out, unsigned long long v) {
+  char reversed[20];
+  size_t n = 0;
+  do {
+    reversed[n++] = (char)('0' + v % 10);
+    v /= 10;
+  } while (v > 0);
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = reversed[n - 1 - i];
+  }
+  return n;
+}
+
+// Same text as "%.6g" for floats of 0 and magnitudes in [0.1, 1e6), which
+// covers every voltage, current and power the chip reports, without going
+// through printf. Returns 0 for anything else so the caller can fall back.
+static size_t formatShortDecimal(char *out, double v) {
+  static const double scale[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6};
+  size_t pos = 0;
+  if (v == 0) {
+    out[0] = '0';
+    return 1;
+  }
+  if (v < 0) {
+    out[pos++] = '-';
+    v = -v;
+  }
+  if (v < 0.1 || v >= 1e6) {
+    return 0;
+  }
+  int intDigits = 0;
+  for (double limit = 1; v >= limit && intDigits < 6; limit *= 10) {
+    ++intDigits;
+  }
+  int decimals = 6 - intDigits;
+  // Exact for floats (24-bit mantissa times at most 10^6), so ties can be
+  // rounded to even the way printf does
+  double exact = v * scale[decimals];
+  unsigned long long scaled = (unsigned long long)exact;
+  double rest = exact - (double)scaled;
+  if (rest > 0.5 || (rest == 0.5 && (scaled & 1))) {
+    ++scaled;
+  }
+  if (scaled >= 1000000ULL) {
+    return 0; // Rounded up into another digit; let printf decide
+  }
+  unsigned long long whole = scaled / (unsigned long long)scale[decimals];
+  unsigned long long frac = scaled % (unsigned long long)scale[decimals];
+  pos += formatDigits(out + pos, whole);
+  if (frac == 0) {
+    return pos;
+  }
+  out[pos++] = '.';
+  // Leading zeros of the fraction, then its digits without trailing zeros
+  char digits[8];
+  size_t n = formatDigits(digits, frac);
+  for (int i = (int)n; i < decimals; ++i) {
+    out[pos++] = '0';
+  }
+  while (digits[n - 1] == '0') {
+    --n;
+  }
+  memcpy(out + pos, digits, n);
+  return pos + n;
+}
+
+PdBufferSink::PdBufferSink(char *buf, size_t len) : buf(buf), capacity(len) {
+  if (capacity > 0) {
+    buf[0] = '\0';
+  }
+}
+
+bool PdBufferSink::write(const char *data, size_t len) {
+  total += len;
+  if (overflow || capacity == 0 || len >= capacity - used) {
+    // Keep nothing rather than a JSON prefix
+    overflow = true;
+    used = 0;
+    if (capacity > 0) {
+      buf[0] = '\0';
+    }
+    return false;
+  }
+  memcpy(buf + used, data, len + 1); // Chunks carry their '\0'
+  used += len;
+  return true;
+}
+
+PdJsonWriter &PdJsonWriter::beginObject() {
+  open('{');
+  return *this;
+}
+
+PdJsonWriter &PdJsonWriter::endObject() {
+  close('}');
+  return *this;
+}
+
+PdJsonWriter &PdJsonWriter::beginArray() {
+  open('[');
+  return *this;
+}
+
+PdJsonWriter &PdJsonWriter::endArray() {
+  close(']');
+  return *this;
+}
+
+PdJsonWriter &PdJsonWriter::key(const char *name) {
+  separate();
+  putString(name);
+  put(':');
+  afterKey = true;
+  return *this;
+}
+
+PdJsonWriter &PdJsonWriter::value(bool v) {
+  separate();
+  if (v) {
+    put("true", 4);
+  } else {
+    put("false", 5);
+  }
+  return *this;
+}
+
+PdJsonWriter &PdJsonWriter::value(float v) { return value((double)v); }
+
+PdJsonWriter &PdJsonWriter::value(double v) {
+  if (!isfinite(v)) {
+    return null();
+  }
+  separate();
+  // Six significant digits is all a float holds; at most 13 characters
+  char text[24];
+  size_t len = formatShortDecimal(text, v);
+  if (len == 0) {
+    len = (size_t)snprintf(text, sizeof(text), "%.6g", v);
+  }
+  put(text, len);
+  return *this;
+}
+
+PdJsonWriter &PdJsonWriter::value(const char *v) {
+  if (!v) {
+    return null();
+  }
+  separate();
+  putString(v);
+  return *this;
+}
+
+PdJsonWriter &PdJsonWriter::null() {
+  separate();
+  put("null", 4);
+  return *this;
+}
+
+PdJsonWriter &PdJsonWriter::integer(long long v) {
+  separate();
+  char text[24];
+  size_t len = 0;
+  unsigned long long magnitude = (unsigned long long)v;
+  if (v < 0) {
+    text[len++] = '-';
+    magnitude = 0ULL - magnitude;
+  }
+  len += formatDigits(text + len, magnitude);
+  put(text, len);
+  return *this;
+}
+
+PdJsonWriter &PdJsonWriter::unsignedInteger(unsigned long long v) {
+  separate();
+  char text[24];
+  put(text, formatDigits(text, v));
+  return *this;
+}
+
+bool PdJsonWriter::flush() {
+  if (used > 0 && !failed) {
+    chunk[used] = '\0';
+    failed = !sink.write(chunk, used);
+  }
+  used = 0;
+  return !failed;
+}
+
+void PdJsonWriter::separate() {
+  if (afterKey) {
+    afterKey = false;
+    return;
+  }
+  if (depth == 0) {
+    return;
+  }
+  uint32_t bit = 1u << (depth - 1);
+  if (nonEmpty & bit) {
+    put(',');
+  }
+  nonEmpty |= bit;
+}
+
+void PdJsonWriter::open(char c) {
+  separate();
+  put(c);
+  if (depth < 32) {
+    ++depth;
+    nonEmpty &= ~(1u << (depth - 1));
+  }
+}
+
+void PdJsonWriter::close(char c) {
+  if (depth > 0) {
+    --depth;
+  }
+  afterKey = false;
+  put(c);
+}
+
+void PdJsonWriter::put(char c) {
+  if (used == USB_PD_JSON_CHUNK_LEN) {
+    flush();
+  }
+  chunk[used++] = c;
+  ++produced;
+}
+
+void PdJsonWriter::put(const char *s, size_t len) {
+  while (len > 0) {
+    if (used == USB_PD_JSON_CHUNK_LEN) {
+      flush();
+    }
+    size_t n = USB_PD_JSON_CHUNK_LEN - used;
+    n = n < len ? n : len;
+    memcpy(chunk + used, s, n);
+    used += n;
+    produced += n;
+    s += n;
+    len -= n;
+  }
+}
+
+void PdJsonWriter::putString(const char *s) {
+  put('"');
+  const char *run = s;
+  for (; *s; ++s) {
+    unsigned char c = (unsigned char)*s;
+    if (c != '"' && c != '\\' && c >= 0x20) {
+      continue;
+    }
+    put(run, (size_t)(s - run));
+    run = s + 1;
+    if (c == '"' || c == '\\') {
+      put('\\');
+      put((char)c);
+    } else {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      put(escaped, 6);
+    }
+  }
+  put(run, (size_t)(s - run));
+  put('"');
+}
@@ -0,0 +1,134 @@
+#include "../include/usb_pd_metrics.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+const uint32_t PdHistogram::boundsUs[USB_PD_METRICS_BUCKETS] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000,
+    1000000};
+
+// The same bounds as Prometheus "le" labels, so exporting needs no float
+// formatting
+static const char *const BOUND_LABELS[USB_PD_METRICS_BUCKETS] = {
+    "0.0001", "0.00025", "0.0005", "0.001", "0.0025", "0.005",
+    "0.01",   "0.025",   "0.05",   "0.1",   "0.25",   "1"};
+
+void PdHistogram::observe(uint32_t micros) {
+  size_t i = 0;
+  while (i < USB_PD_METRICS_BUCKETS && micros > boundsUs[i]) {
+    ++i;
+  }
+  buckets[i].fetch_add(1, std::memory_order_relaxed);
+  sumUs.fetch_add(micros, std::memory_order_relaxed);
+}
+
+uint32_t PdHistogram::count() const {
+  uint32_t n = 0;
+  for (size_t i = 0; i <= USB_PD_METRICS_BUCKETS; ++i) {
+    n += bucket(i);
+  }
+  return n;
+}
+
+const char *chipOpName(PdChipOp op) {
+  switch (op) {
+  case PdChipOp::Probe:
+    return "probe";
+  case PdChipOp::Begin:
+    return "begin";
+  case PdChipOp::Read:
+    return "read";
+  case PdChipOp::ReadPdoSet:
+    return "read_pdo_set";
+  case PdChipOp::Write:
+    return "write";
+  case PdChipOp::WriteVolatile:
+    return "write_volatile";
+  case PdChipOp::SoftReset:
+    return "soft_reset";
+  case PdChipOp::ReadContract:
+    return "read_contract";
+  case PdChipOp::EnableAttachAlert:
+    return "enable_attach_alert";
+  case PdChipOp::ClearAlerts:
+    return "clear_alerts";
+  case PdChipOp::ReadRegisterImage:
+    return "read_register_image";
+  case PdChipOp::RecoverBus:
+    return "recover_bus";
+  case PdChipOp::Count:
+    break;
+  }
+  return "unknown";
+}
+
+PdRouteMetrics::Slot *PdRouteMetrics::slot(const char *route,
+                                           const char *method) {
+  size_t n = size();
+  for (size_t i = 0; i < n; ++i) {
+    if (strcmp(slots[i].route, route) == 0 &&
+        strcmp(slots[i].method, method) == 0) {
+      return &slots[i];
+    }
+  }
+  if (n == USB_PD_METRICS_MAX_ROUTES) {
+    return nullptr;
+  }
+  slots[n].route = route;
+  slots[n].method = method;
+  used.store(n + 1, std::memory_order_release);
+  return &slots[n];
+}
+
+void PdPrometheusWriter::line(const char *format, ...) {
+  char buf[192];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if (len < 0) {
+    return;
+  }
+  if ((size_t)len >= sizeof(buf)) {
+    // Cut at the buffer but still end the line
+    len = sizeof(buf) - 1;
+    buf[len - 1] = '\n';
+  }
+  sink.write(buf, (size_t)len);
+}
+
+void PdPrometheusWriter::family(const char *name, const char *type,
+                                const char *help) {
+  line("# HELP %s %s\n", name, help);
+  line("# TYPE %s %s\n", name, type);
+}
+
+void PdPrometheusWriter::histogram(const char *name, const char *labels,
+                                   const PdHistogram &h) {
+  const char *sep = *labels ? "," : "";
+  uint32_t cumulative = 0;
+  for (size_t i = 0; i < USB_PD_METRICS_BUCKETS; ++i) {
+    cumulative += h.bucket(i);
+    line("%s_bucket{%s%sle=\"%s\"} %lu\n", name, labels, sep, BOUND_LABELS[i],
+         (unsigned long)cumulative);
+  }
+  cumulative += h.bucket(USB_PD_METRICS_BUCKETS);
+  line("%s_bucket{%s%sle=\"+Inf\"} %lu\n", name, labels, sep,
+       (unsigned long)cumulative);
+  const char *open = *labels ? "{" : "";
+  const char *close = *labels ? "}" : "";
+  uint32_t sum = h.sumMicros();
+  line("%s_sum%s%s%s %lu.%06lu\n", name, open, labels, close,
+       (unsigned long)(sum / 1000000), (unsigned long)(sum % 1000000));
+  // From the buckets just written, so _count matches the +Inf bucket
+  line("%s_count%s%s%s %lu\n", name, open, labels, close,
+       (unsigned long)cumulative);
+}
+
+void PdPrometheusWriter::counter(const char *name, const char *labels,
+                                 uint32_t value) {
+  const char *open = *labels ? "{" : "";
+  const char *close = *labels ? "}" : "";
+  line("%s%s%s%s %lu\n", name, open, labels, close, (unsigned long)value);
+}
@@ -0,0 +1,32 @@
+#include "../include/usb_pd_poll_scheduler.h"
+
+void PdPollScheduler::configure(uint32_t fast, uint32_t burst,
+                                uint32_t ceiling) {
+  ceilingMs = ceiling > 0 ? ceiling : 1;
+  fastMs = fast > 0 && fast < ceilingMs ? fast : ceilingMs;
+  burstMs = burst;
+  intervalMs = ceilingMs;
+  deadlineMs = ceilingMs;
+  bursting = false;
+}
+
+void PdPollScheduler::burst(uint32_t nowMs) {
+  bursting = true;
+  burstUntilMs = nowMs + burstMs;
+  intervalMs = fastMs;
+  deadlineMs = nowMs + fastMs;
+}
+
+void PdPollScheduler::polled(uint32_t nowMs) {
+  if (inBurst(nowMs)) {
+    intervalMs = fastMs;
+  } else {
+    if (bursting) {
+      // Back off starting from the fast interval
+      bursting = false;
+      intervalMs = fastMs;
+    }
+    intervalMs = intervalMs > ceilingMs / 2 ? ceilingMs : intervalMs * 2;
+  }
+  deadlineMs = nowMs + intervalMs;
+}
@@ -0,0 +1,119 @@
+#include "../include/usb_pd_poller.h"
+
+#if defined(ESP_PLATFORM)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Poller task sizing; sampling only touches the chip and a snapshot copy
+#ifndef USB_PD_POLLER_STACK_SIZE
+#define USB_PD_POLLER_STACK_SIZE 4096
+#endif
+
+#ifndef USB_PD_POLLER_PRIORITY
+#define USB_PD_POLLER_PRIORITY 1
+#endif
+#endif
+
+bool USBPDPoller::start(uint32_t interval, Task fn) {
+  if (running.load() || interval == 0 || !fn) {
+    return false;
+  }
+
+  task = std::move(fn);
+  intervalMs.store(interval);
+  stopRequested.store(false);
+  wakeRequested.store(false);
+  running.store(true);
+
+#if defined(ESP_PLATFORM)
+  TaskHandle_t handle = nullptr;
+  if (xTaskCreate(&USBPDPoller::taskEntry, "usb_pd_poll",
+                  USB_PD_POLLER_STACK_SIZE, this, USB_PD_POLLER_PRIORITY,
+                  &handle) != pdPASS) {
+    running.store(false);
+    return false;
+  }
+  taskHandle = handle;
+#else
+  worker = std::thread([this]() { run(); });
+#endif
+  return true;
+}
+
+void USBPDPoller::stop() {
+#if defined(ESP_PLATFORM)
+  if (!running.load()) {
+    return;
+  }
+  stopRequested.store(true);
+  xTaskNotifyGive(static_cast<TaskHandle_t>(taskHandle));
+  // The task clears running and deletes itself after its current iteration
+  while (running.load()) {
+    vTaskDelay(1);
+  }
+  taskHandle = nullptr;
+#else
+  if (!worker.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    stopRequested.store(true);
+  }
+  wakeSignal.notify_all();
+  worker.join();
+#endif
+}
+
+void USBPDPoller::wake() {
+  if (!running.load()) {
+    return;
+  }
+#if defined(ESP_PLATFORM)
+  wakeRequested.store(true);
+  xTaskNotifyGive(static_cast<TaskHandle_t>(taskHandle));
+#else
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    wakeRequested.store(true);
+  }
+  wakeSignal.notify_all();
+#endif
+}
+
+void USBPDPoller::run() {
+  while (!stopRequested.load()) {
+    task();
+    iterations.fetch_add(1);
+
+#if defined(ESP_PLATFORM)
+    // Sleep for the interval, or until stop() or wake() notifies us
+    if (!wakeRequested.exchange(false)) {
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(intervalMs.load()));
+    }
+#else
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    wakeSignal.wait_for(lock, std::chrono::milliseconds(intervalMs.load()),
+                        [this]() {
+                          return stopRequested.load() || wakeRequested.load();
+                        });
+#endif
+    wakeRequested.store(false);
+  }
+  running.store(false);
+}
+
+#if defined(ESP_PLATFORM)
+void USBPDPoller::taskEntry(void *arg) {
+  static_cast<USBPDPoller *>(arg)->run();
+  vTaskDelete(nullptr);
+}
+#endif
+
+uintptr_t usbPdCurrentTask() {
+#if defined(ESP_PLATFORM)
+  return (uintptr_t)xTaskGetCurrentTaskHandle();
+#else
+  return (uintptr_t)std::hash<std::thread::id>()(std::this_thread::get_id());
+#endif
+}
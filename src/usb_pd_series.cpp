@@ -0,0 +1,290 @@
+#include "../include/usb_pd_series.h"
+
+static const uint32_t PAYLOAD_BITS = sizeof(PdSeriesBlock::data) * 8;
+
+// Small signed values to small unsigned ones: 0, -1, 1, -2, ... -> 0, 1, 2, 3
+static uint32_t zigzag(int32_t v) {
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// Timestamp delta-of-delta codes: prefix bits, then the zigzag value
+//   0                 unchanged interval
+//   10   + 7 bits     within +-63 ms
+//   110  + 9 bits     within +-255 ms
+//   1110 + 12 bits    within +-2047 ms
+//   1111 + 32 bits    anything else
+static uint8_t timeBits(uint32_t zz) {
+  if (zz == 0) {
+    return 1;
+  }
+  if (zz < (1UL << 7)) {
+    return 2 + 7;
+  }
+  if (zz < (1UL << 9)) {
+    return 3 + 9;
+  }
+  if (zz < (1UL << 12)) {
+    return 4 + 12;
+  }
+  return 4 + 32;
+}
+
+// Value delta codes, for mV and mA alike
+//   0                 unchanged
+//   10   + 4 bits     within +-8
+//   110  + 8 bits     within +-128
+//   111  + 17 bits    anything else (a full 16-bit swing)
+static uint8_t valueBits(uint32_t zz) {
+  if (zz == 0) {
+    return 1;
+  }
+  if (zz < (1UL << 4)) {
+    return 2 + 4;
+  }
+  if (zz < (1UL << 8)) {
+    return 3 + 8;
+  }
+  return 3 + 17;
+}
+
+void PdSeriesEncoder::put(uint32_t value, uint8_t bits) {
+  uint8_t *data = target->data;
+  uint32_t pos = target->bits;
+  for (int8_t i = bits - 1; i >= 0; --i, ++pos) {
+    uint8_t mask = 0x80 >> (pos & 7);
+    if ((value >> i) & 1) {
+      data[pos >> 3] |= mask;
+    } else {
+      data[pos >> 3] &= ~mask;
+    }
+  }
+  target->bits = pos;
+}
+
+void PdSeriesEncoder::reset(PdSeriesBlock &block) {
+  block = PdSeriesBlock();
+  block.magic = USB_PD_SERIES_MAGIC;
+  target = &block;
+  prevMs = 0;
+  prevDelta = 0;
+  prevMillivolts = 0;
+  prevMilliamps = 0;
+}
+
+bool PdSeriesEncoder::append(const PdTelemetrySample &sample) {
+  if (!target) {
+    return false;
+  }
+  if (target->count == 0) {
+    if ((uint32_t)target->bits + 32 > PAYLOAD_BITS) {
+      return false;
+    }
+    put(sample.millivolts, 16);
+    put(sample.milliamps, 16);
+    target->firstMs = target->lastMs = sample.ms;
+  } else {
+    int32_t delta = (int32_t)(sample.ms - prevMs);
+    uint32_t dod = zigzag((int32_t)((uint32_t)delta - (uint32_t)prevDelta));
+    uint32_t mv = zigzag((int32_t)sample.millivolts - prevMillivolts);
+    uint32_t ma = zigzag((int32_t)sample.milliamps - prevMilliamps);
+    uint8_t tBits = timeBits(dod);
+    uint8_t vBits = valueBits(mv);
+    uint8_t aBits = valueBits(ma);
+    if ((uint32_t)target->bits + tBits + vBits + aBits > PAYLOAD_BITS ||
+        target->count == UINT16_MAX) {
+      return false;
+    }
+
+    // Prefix of n ones then a zero, or n ones alone for the widest code
+    if (dod == 0) {
+      put(0, 1);
+    } else if (tBits == 36) {
+      put(0xF, 4);
+      put(dod, 32);
+    } else {
+      uint8_t width = tBits == 9 ? 7 : tBits == 12 ? 9 : 12;
+      uint8_t prefix = tBits - width;
+      put(((1U << prefix) - 2), prefix);
+      put(dod, width);
+    }
+    for (int i = 0; i < 2; ++i) {
+      uint32_t zz = i == 0 ? mv : ma;
+      uint8_t bits = i == 0 ? vBits : aBits;
+      if (zz == 0) {
+        put(0, 1);
+      } else if (bits == 20) {
+        put(0x7, 3);
+        put(zz, 17);
+      } else {
+        uint8_t width = bits == 6 ? 4 : 8;
+        uint8_t prefix = bits - width;
+        put(((1U << prefix) - 2), prefix);
+        put(zz, width);
+      }
+    }
+    prevDelta = delta;
+    target->lastMs = sample.ms;
+  }
+  prevMs = sample.ms;
+  prevMillivolts = sample.millivolts;
+  prevMilliamps = sample.milliamps;
+  ++target->count;
+  return true;
+}
+
+uint32_t PdSeriesDecoder::take(uint8_t bits) {
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < bits && pos < block.bits; ++i, ++pos) {
+    value = (value << 1) | ((block.data[pos >> 3] >> (7 - (pos & 7))) & 1);
+  }
+  return value;
+}
+
+bool PdSeriesDecoder::next(PdTelemetrySample &out) {
+  if (decoded >= block.count) {
+    return false;
+  }
+  if (decoded == 0) {
+    prevMs = block.firstMs;
+    prevMillivolts = take(16);
+    prevMilliamps = take(16);
+  } else {
+    // Ones up to the first zero (at most four) select the width
+    static const uint8_t timeWidths[] = {0, 7, 9, 12, 32};
+    uint8_t ones = 0;
+    while (ones < 4 && take(1)) {
+      ++ones;
+    }
+    prevDelta = (int32_t)((uint32_t)prevDelta +
+                          (uint32_t)unzigzag(take(timeWidths[ones])));
+    prevMs += prevDelta;
+
+    static const uint8_t valueWidths[] = {0, 4, 8, 17};
+    for (int i = 0; i < 2; ++i) {
+      ones = 0;
+      while (ones < 3 && take(1)) {
+        ++ones;
+      }
+      int32_t delta = unzigzag(take(valueWidths[ones]));
+      uint16_t &prev = i == 0 ? prevMillivolts : prevMilliamps;
+      prev = (uint16_t)(prev + delta);
+    }
+  }
+  out.ms = prevMs;
+  out.millivolts = prevMillivolts;
+  out.milliamps = prevMilliamps;
+  ++decoded;
+  return true;
+}
+
+PdSeriesRing::PdSeriesRing() { encoder.reset(blocks[openSlot()]); }
+
+void PdSeriesRing::clear() {
+  sealedCount = 0;
+  encoder.reset(blocks[openSlot()]);
+}
+
+void PdSeriesRing::append(const PdTelemetrySample &sample) {
+  PdSeriesBlock &open = blocks[openSlot()];
+  if (open.count > 0 && (int32_t)(sample.ms - open.lastMs) < 0) {
+    return; // Out of order
+  }
+  if (encoder.append(sample)) {
+    return;
+  }
+  // Full: seal it, the next slot (the oldest sealed block) is reused
+  ++sealedCount;
+  encoder.reset(blocks[openSlot()]);
+  encoder.append(sample);
+}
+
+const PdSeriesBlock *PdSeriesRing::sealed(uint32_t seq) const {
+  if (seq >= sealedCount || sealedCount - seq > USB_PD_SERIES_RAM_BLOCKS) {
+    return nullptr;
+  }
+  return &blocks[seq % (USB_PD_SERIES_RAM_BLOCKS + 1)];
+}
+
+bool PdSeriesRing::oldestMs(uint32_t &ms) const {
+  uint32_t oldest = sealedCount > USB_PD_SERIES_RAM_BLOCKS
+                        ? sealedCount - USB_PD_SERIES_RAM_BLOCKS
+                        : 0;
+  const PdSeriesBlock *block =
+      oldest < sealedCount ? sealed(oldest) : &open();
+  if (block->count == 0) {
+    return false;
+  }
+  ms = block->firstMs;
+  return true;
+}
+
+bool PdSeriesLog::readBlock(uint8_t segment, size_t i, PdSeriesBlock &out) {
+  return storage.read(segment, i * sizeof(PdSeriesBlock), &out,
+                      sizeof(PdSeriesBlock)) &&
+         out.valid();
+}
+
+bool PdSeriesLog::scan(uint8_t segment, uint32_t &lastSeq) {
+  size_t bytes = storage.size(segment);
+  size_t whole = bytes / sizeof(PdSeriesBlock);
+  PdSeriesBlock header;
+  uint16_t n = 0;
+  while (n < whole && n < USB_PD_SERIES_SEGMENT_BLOCKS &&
+         storage.read(segment, n * sizeof(PdSeriesBlock), &header,
+                      USB_PD_SERIES_HEADER_LEN) &&
+         header.valid() && (n == 0 || header.seq == lastSeq + 1)) {
+    index[segment][n] = {header.boot, header.firstMs, header.lastMs};
+    lastSeq = header.seq;
+    ++n;
+  }
+  counts[segment] = n;
+  return n * sizeof(PdSeriesBlock) == bytes;
+}
+
+size_t PdSeriesLog::begin(uint32_t bootId) {
+  boot = bootId;
+  uint32_t lastSeq[2] = {0, 0};
+  bool clean[2] = {scan(0, lastSeq[0]), scan(1, lastSeq[1])};
+
+  // The segment with the newest block is the one being appended to
+  active = 0;
+  if (counts[1] > 0 &&
+      (counts[0] == 0 || (int32_t)(lastSeq[1] - lastSeq[0]) > 0)) {
+    active = 1;
+  }
+  seq = counts[active] > 0 ? lastSeq[active] + 1 : 0;
+  // Anything after the last good block means the segment was torn; it
+  // takes no more appends
+  sealedActive = !clean[active];
+  return blockCount();
+}
+
+bool PdSeriesLog::append(const PdSeriesBlock &block) {
+  if (sealedActive || counts[active] >= USB_PD_SERIES_SEGMENT_BLOCKS) {
+    uint8_t next = 1 - active;
+    if (!storage.erase(next)) {
+      return false;
+    }
+    counts[next] = 0;
+    active = next;
+    sealedActive = false;
+  }
+
+  PdSeriesBlock copy = block;
+  copy.magic = USB_PD_SERIES_MAGIC;
+  copy.seq = seq;
+  copy.boot = boot;
+  if (!storage.append(active, &copy, sizeof(copy))) {
+    // Part of it may have landed; start the next segment rather than
+    // append behind a torn block
+    sealedActive = true;
+    return false;
+  }
+  index[active][counts[active]++] = {boot, copy.firstMs, copy.lastMs};
+  ++seq;
+  return true;
+}
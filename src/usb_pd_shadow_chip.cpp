@@ -0,0 +1,255 @@
+#include "../include/usb_pd_shadow_chip.h"
+
+bool ShadowedUsbPdChip::selectBus(uint8_t bus) {
+  // Another bus means another device
+  invalidate();
+  return inner.selectBus(bus);
+}
+
+bool ShadowedUsbPdChip::probe(uint8_t i2cAddress) {
+  bool present = inner.probe(i2cAddress);
+  if (!present) {
+    invalidate();
+  }
+  return present;
+}
+
+bool ShadowedUsbPdChip::begin() {
+  // A (re)attached device may hold anything; reload on next read()
+  invalidate();
+  return inner.begin();
+}
+
+bool ShadowedUsbPdChip::recoverBus(int sda, int scl) {
+  invalidate();
+  return inner.recoverBus(sda, scl);
+}
+
+void ShadowedUsbPdChip::read() { reload(); }
+
+int ShadowedUsbPdChip::getPdoNumber() const {
+  return loaded ? pdoNumber : inner.getPdoNumber();
+}
+
+float ShadowedUsbPdChip::getVoltage(int pdoIndex) const {
+  if (!loaded || !validIndex(pdoIndex)) {
+    return inner.getVoltage(pdoIndex);
+  }
+  return (runtimeDirty & dirtyVoltageBit(pdoIndex)) ? requestedVoltage[pdoIndex]
+                                             : voltage[pdoIndex];
+}
+
+float ShadowedUsbPdChip::getCurrent(int pdoIndex) const {
+  if (!loaded || !validIndex(pdoIndex)) {
+    return inner.getCurrent(pdoIndex);
+  }
+  return (runtimeDirty & dirtyCurrentBit(pdoIndex)) ? requestedCurrent[pdoIndex]
+                                             : current[pdoIndex];
+}
+
+void ShadowedUsbPdChip::setVoltage(int pdoIndex, float volts) {
+  if (!validIndex(pdoIndex)) {
+    return;
+  }
+  ensureLoaded();
+  if (volts == requestedVoltage[pdoIndex]) {
+    return;
+  }
+  requestedVoltage[pdoIndex] = volts;
+  dirty |= dirtyVoltageBit(pdoIndex);
+  runtimeDirty |= dirtyVoltageBit(pdoIndex);
+}
+
+void ShadowedUsbPdChip::setCurrent(int pdoIndex, float amps) {
+  if (!validIndex(pdoIndex)) {
+    return;
+  }
+  ensureLoaded();
+  if (amps == requestedCurrent[pdoIndex]) {
+    return;
+  }
+  requestedCurrent[pdoIndex] = amps;
+  dirty |= dirtyCurrentBit(pdoIndex);
+  runtimeDirty |= dirtyCurrentBit(pdoIndex);
+}
+
+void ShadowedUsbPdChip::setPdoNumber(int pdoIndex) {
+  ensureLoaded();
+  if (pdoIndex == pdoNumber) {
+    return;
+  }
+  pdoNumber = pdoIndex;
+  dirty |= DIRTY_PDO_NUMBER;
+  runtimeDirty |= DIRTY_PDO_NUMBER;
+}
+
+bool ShadowedUsbPdChip::readPdoSet(PdoSet &out) {
+  if (!reload()) {
+    return false;
+  }
+  out.activePdo = getPdoNumber();
+  for (int i = 1; i <= 3; ++i) {
+    out.voltage[i] = getVoltage(i);
+    out.current[i] = getCurrent(i);
+  }
+  return true;
+}
+
+void ShadowedUsbPdChip::writePdoSet(const PdoSet &set) {
+  // Fields a caller left alone come back as the device rounded them, which
+  // can differ from what was requested; only real changes reach the setters
+  ensureLoaded();
+  if (set.activePdo != getPdoNumber()) {
+    setPdoNumber(set.activePdo);
+  }
+  for (int i = 1; i <= 3; ++i) {
+    if (set.voltage[i] != getVoltage(i)) {
+      setVoltage(i, set.voltage[i]);
+    }
+    if (set.current[i] != getCurrent(i)) {
+      setCurrent(i, set.current[i]);
+    }
+  }
+}
+
+void ShadowedUsbPdChip::write() {
+  if (dirty == 0) {
+    ++writesSkipped;
+    return;
+  }
+
+  forwardFields(dirty);
+  inner.write();
+  captureRounding();
+
+  // Committing values already applied by writeVolatile() needs no
+  // renegotiation
+  resetPending = resetPending || runtimeDirty != 0;
+  dirty = 0;
+  runtimeDirty = 0;
+}
+
+void ShadowedUsbPdChip::writeVolatile() {
+  if (runtimeDirty == 0) {
+    ++writesSkipped;
+    return;
+  }
+
+  forwardFields(runtimeDirty);
+  inner.writeVolatile();
+  captureRounding();
+
+  // NVM bits stay set so a later write() still commits these fields
+  runtimeDirty = 0;
+  resetPending = true;
+}
+
+void ShadowedUsbPdChip::softReset() {
+  // Renegotiating an unchanged configuration only drops power briefly
+  if (!resetPending) {
+    ++resetsSkipped;
+    return;
+  }
+  inner.softReset();
+  resetPending = false;
+}
+
+void ShadowedUsbPdChip::invalidate() {
+  loaded = false;
+  dirty = 0;
+  runtimeDirty = 0;
+  resetPending = false;
+}
+
+bool ShadowedUsbPdChip::refresh() {
+  PdoSet set;
+  if (!inner.readPdoSet(set)) {
+    invalidate();
+    return false;
+  }
+  capture(set);
+  return true;
+}
+
+bool ShadowedUsbPdChip::reload() {
+  PdoSet set;
+  if (!inner.readPdoSet(set)) {
+    invalidate();
+    return false;
+  }
+  if (!loaded) {
+    capture(set);
+    return true;
+  }
+
+  // Staged fields keep their requested value; everything else follows the
+  // device. A field changed from outside no longer matches what was staged
+  // for NVM, so its commit bit is dropped; writePdoSet() sets it again
+  if (!(runtimeDirty & DIRTY_PDO_NUMBER)) {
+    if (set.activePdo != pdoNumber) {
+      dirty &= (uint8_t)~DIRTY_PDO_NUMBER;
+    }
+    pdoNumber = set.activePdo;
+  }
+  for (int i = 1; i <= 3; ++i) {
+    if (!(runtimeDirty & dirtyVoltageBit(i))) {
+      if (set.voltage[i] != voltage[i]) {
+        dirty &= (uint8_t)~dirtyVoltageBit(i);
+      }
+      voltage[i] = set.voltage[i];
+      requestedVoltage[i] = set.voltage[i];
+    }
+    if (!(runtimeDirty & dirtyCurrentBit(i))) {
+      if (set.current[i] != current[i]) {
+        dirty &= (uint8_t)~dirtyCurrentBit(i);
+      }
+      current[i] = set.current[i];
+      requestedCurrent[i] = set.current[i];
+    }
+  }
+  return true;
+}
+
+void ShadowedUsbPdChip::ensureLoaded() {
+  if (!loaded) {
+    refresh();
+  }
+}
+
+void ShadowedUsbPdChip::capture(const PdoSet &set) {
+  pdoNumber = set.activePdo;
+  for (int i = 1; i <= 3; ++i) {
+    voltage[i] = set.voltage[i];
+    current[i] = set.current[i];
+    requestedVoltage[i] = voltage[i];
+    requestedCurrent[i] = current[i];
+  }
+  dirty = 0;
+  runtimeDirty = 0;
+  loaded = true;
+}
+
+void ShadowedUsbPdChip::forwardFields(uint8_t fields) {
+  // Forward only the fields that changed; the inner register image already
+  // holds everything else from the last load
+  if (fields & DIRTY_PDO_NUMBER) {
+    inner.setPdoNumber(pdoNumber);
+  }
+  for (int i = 1; i <= 3; ++i) {
+    if (fields & dirtyVoltageBit(i)) {
+      inner.setVoltage(i, requestedVoltage[i]);
+    }
+    if (fields & dirtyCurrentBit(i)) {
+      inner.setCurrent(i, requestedCurrent[i]);
+    }
+  }
+}
+
+void ShadowedUsbPdChip::captureRounding() {
+  // Pick up the device's rounding of what was just written (getters decode
+  // the inner register image, no bus traffic)
+  for (int i = 1; i <= 3; ++i) {
+    voltage[i] = inner.getVoltage(i);
+    current[i] = inner.getCurrent(i);
+  }
+}
@@ -0,0 +1,307 @@
+#include "../include/usb_pd_telemetry.h"
+
+#include <string.h>
+
+// a is at or after b, across a millis() wrap
+static bool atOrAfter(uint32_t a, uint32_t b) { return (int32_t)(a - b) >= 0; }
+
+static uint32_t alignDown(uint32_t ms, uint32_t width) {
+  return ms - ms % width;
+}
+
+// Volts/amps to mV/mA, clamped to what a bucket stores
+static uint16_t toMilli(float v) {
+  if (!(v > 0.0f)) {
+    return 0;
+  }
+  return v >= 65.535f ? 65535 : (uint16_t)(v * 1000.0f + 0.5f);
+}
+
+static PdTelemetryPoint bucketPoint(const PdTelemetryBucket &b) {
+  return {b.startMs,          b.count,           b.minMillivolts,
+          b.meanMillivolts(), b.maxMillivolts,   b.minMilliamps,
+          b.meanMilliamps(),  b.maxMilliamps};
+}
+
+void PdTelemetryBucket::add(uint16_t millivolts, uint16_t milliamps) {
+  if (count == 0) {
+    minMillivolts = maxMillivolts = millivolts;
+    minMilliamps = maxMilliamps = milliamps;
+  } else {
+    minMillivolts = millivolts < minMillivolts ? millivolts : minMillivolts;
+    maxMillivolts = millivolts > maxMillivolts ? millivolts : maxMillivolts;
+    minMilliamps = milliamps < minMilliamps ? milliamps : minMilliamps;
+    maxMilliamps = milliamps > maxMilliamps ? milliamps : maxMilliamps;
+  }
+  ++count;
+  millivoltSum += millivolts;
+  milliampSum += milliamps;
+}
+
+void PdTelemetryBucket::merge(const PdTelemetryBucket &other) {
+  if (other.count == 0) {
+    return;
+  }
+  if (count == 0) {
+    uint32_t start = startMs;
+    *this = other;
+    startMs = start;
+    return;
+  }
+  minMillivolts =
+      other.minMillivolts < minMillivolts ? other.minMillivolts : minMillivolts;
+  maxMillivolts =
+      other.maxMillivolts > maxMillivolts ? other.maxMillivolts : maxMillivolts;
+  minMilliamps =
+      other.minMilliamps < minMilliamps ? other.minMilliamps : minMilliamps;
+  maxMilliamps =
+      other.maxMilliamps > maxMilliamps ? other.maxMilliamps : maxMilliamps;
+  count += other.count;
+  millivoltSum += other.millivoltSum;
+  milliampSum += other.milliampSum;
+}
+
+const char *telemetryTierName(PdTelemetryTier tier) {
+  switch (tier) {
+  case PdTelemetryTier::Raw:
+    return "raw";
+  case PdTelemetryTier::Seconds:
+    return "1s";
+  case PdTelemetryTier::Minutes:
+    return "1m";
+  case PdTelemetryTier::Hours:
+    return "1h";
+  }
+  return "raw";
+}
+
+bool parseTelemetryTier(const char *name, PdTelemetryTier &tier) {
+  static const PdTelemetryTier tiers[] = {
+      PdTelemetryTier::Raw, PdTelemetryTier::Seconds, PdTelemetryTier::Minutes,
+      PdTelemetryTier::Hours};
+  for (PdTelemetryTier t : tiers) {
+    if (strcmp(name, telemetryTierName(t)) == 0) {
+      tier = t;
+      return true;
+    }
+  }
+  return false;
+}
+
+uint32_t PdTelemetryStore::widthMs(PdTelemetryTier tier) {
+  switch (tier) {
+  case PdTelemetryTier::Raw:
+    return 0;
+  case PdTelemetryTier::Seconds:
+    return 1000UL;
+  case PdTelemetryTier::Minutes:
+    return 60000UL;
+  case PdTelemetryTier::Hours:
+    return 3600000UL;
+  }
+  return 0;
+}
+
+const PdTelemetryBucket *PdTelemetryStore::record(uint32_t ms, float voltage,
+                                                  float current) {
+  if (samples > 0 && !atOrAfter(ms, lastMs)) {
+    return nullptr; // Out of order
+  }
+  if (samples == 0) {
+    firstMs = ms;
+  }
+  lastMs = ms;
+  ++samples;
+
+  PdTelemetrySample sample;
+  sample.ms = ms;
+  sample.millivolts = toMilli(voltage);
+  sample.milliamps = toMilli(current);
+  raw.push(sample);
+
+  // A sample in a new second closes the open second, which is folded into
+  // its minute; that minute closes in turn if the sample is in a new one.
+  // So the open buckets always share the newest sample's second/minute/hour.
+  const PdTelemetryBucket *closed = nullptr;
+  if (openSecond.count > 0 && openSecond.startMs != alignDown(ms, 1000UL)) {
+    closeSecond();
+    closed = &seconds.newest(0);
+  }
+  if (openMinute.count > 0 && openMinute.startMs != alignDown(ms, 60000UL)) {
+    closeMinute();
+  }
+  if (openHour.count > 0 && openHour.startMs != alignDown(ms, 3600000UL)) {
+    closeHour();
+  }
+  if (openSecond.count == 0) {
+    openSecond.startMs = alignDown(ms, 1000UL);
+  }
+  openSecond.add(sample.millivolts, sample.milliamps);
+  return closed;
+}
+
+void PdTelemetryStore::clear() {
+  raw.clear();
+  seconds.clear();
+  minutes.clear();
+  hours.clear();
+  openSecond = openMinute = openHour = PdTelemetryBucket();
+  firstMs = lastMs = samples = 0;
+}
+
+void PdTelemetryStore::closeSecond() {
+  seconds.push(openSecond);
+  if (openMinute.count == 0) {
+    openMinute.startMs = alignDown(openSecond.startMs, 60000UL);
+  }
+  openMinute.merge(openSecond);
+  openSecond = PdTelemetryBucket();
+}
+
+void PdTelemetryStore::closeMinute() {
+  minutes.push(openMinute);
+  if (openHour.count == 0) {
+    openHour.startMs = alignDown(openMinute.startMs, 3600000UL);
+  }
+  openHour.merge(openMinute);
+  openMinute = PdTelemetryBucket();
+}
+
+void PdTelemetryStore::closeHour() {
+  hours.push(openHour);
+  openHour = PdTelemetryBucket();
+}
+
+PdTelemetryBucket PdTelemetryStore::openBucket(PdTelemetryTier tier) const {
+  PdTelemetryBucket open;
+  if (samples == 0 || tier == PdTelemetryTier::Raw) {
+    return open;
+  }
+  open.startMs = alignDown(lastMs, widthMs(tier));
+  if (tier == PdTelemetryTier::Hours) {
+    open.merge(openHour);
+  }
+  if (tier != PdTelemetryTier::Seconds) {
+    open.merge(openMinute);
+  }
+  open.merge(openSecond);
+  return open;
+}
+
+size_t PdTelemetryStore::closedCount(PdTelemetryTier tier) const {
+  switch (tier) {
+  case PdTelemetryTier::Raw:
+    return raw.size();
+  case PdTelemetryTier::Seconds:
+    return seconds.size();
+  case PdTelemetryTier::Minutes:
+    return minutes.size();
+  case PdTelemetryTier::Hours:
+    return hours.size();
+  }
+  return 0;
+}
+
+PdTelemetryPoint PdTelemetryStore::closedPoint(PdTelemetryTier tier,
+                                               size_t age) const {
+  switch (tier) {
+  case PdTelemetryTier::Raw:
+    break;
+  case PdTelemetryTier::Seconds:
+    return bucketPoint(seconds.newest(age));
+  case PdTelemetryTier::Minutes:
+    return bucketPoint(minutes.newest(age));
+  case PdTelemetryTier::Hours:
+    return bucketPoint(hours.newest(age));
+  }
+  const PdTelemetrySample &s = raw.newest(age);
+  return {s.ms,         1,           s.millivolts, s.millivolts,
+          s.millivolts, s.milliamps, s.milliamps,  s.milliamps};
+}
+
+bool PdTelemetryStore::reachesBack(PdTelemetryTier tier,
+                                   uint32_t fromMs) const {
+  size_t n = closedCount(tier);
+  bool dropped = false;
+  switch (tier) {
+  case PdTelemetryTier::Raw:
+    dropped = raw.full();
+    break;
+  case PdTelemetryTier::Seconds:
+    dropped = seconds.full();
+    break;
+  case PdTelemetryTier::Minutes:
+    dropped = minutes.full();
+    break;
+  case PdTelemetryTier::Hours:
+    dropped = hours.full();
+    break;
+  }
+  // Nothing dropped yet: the tier holds every sample ever recorded
+  return !dropped || atOrAfter(fromMs, closedPoint(tier, n - 1).ms);
+}
+
+PdTelemetryTier PdTelemetryStore::pickTier(uint32_t fromMs, uint32_t toMs,
+                                           size_t maxPoints) const {
+  if (reachesBack(PdTelemetryTier::Raw, fromMs) &&
+      countPoints(PdTelemetryTier::Raw, fromMs, toMs) <= maxPoints) {
+    return PdTelemetryTier::Raw;
+  }
+  // Bucket tiers: at most one point per width in the window
+  uint32_t span = toMs - fromMs;
+  if (reachesBack(PdTelemetryTier::Seconds, fromMs) &&
+      span / 1000UL + 1 <= maxPoints) {
+    return PdTelemetryTier::Seconds;
+  }
+  if (reachesBack(PdTelemetryTier::Minutes, fromMs) &&
+      span / 60000UL + 1 <= maxPoints) {
+    return PdTelemetryTier::Minutes;
+  }
+  return PdTelemetryTier::Hours;
+}
+
+size_t PdTelemetryStore::query(PdTelemetryTier tier, uint32_t fromMs,
+                               uint32_t toMs, PdTelemetryPoint *out,
+                               size_t maxPoints) const {
+  // Newest first, so a cut keeps the newest points, then reversed
+  uint32_t width = widthMs(tier);
+  size_t found = 0;
+  auto take = [&](const PdTelemetryPoint &p) {
+    // Overlap test: starts by toMs and ends after fromMs
+    if (!atOrAfter(toMs, p.ms)) {
+      return true; // Newer than the window, keep walking
+    }
+    if (width > 0 ? !atOrAfter(p.ms + width - 1, fromMs)
+                  : !atOrAfter(p.ms, fromMs)) {
+      return false; // This and everything older is before the window
+    }
+    if (out) {
+      out[found] = p;
+    }
+    return ++found < maxPoints;
+  };
+
+  bool more = maxPoints > 0;
+  PdTelemetryBucket open = openBucket(tier);
+  if (more && open.count > 0) {
+    more = take(bucketPoint(open));
+  }
+  size_t n = closedCount(tier);
+  for (size_t age = 0; more && age < n; ++age) {
+    more = take(closedPoint(tier, age));
+  }
+
+  if (out) {
+    for (size_t i = 0; i < found / 2; ++i) {
+      PdTelemetryPoint swap = out[i];
+      out[i] = out[found - 1 - i];
+      out[found - 1 - i] = swap;
+    }
+  }
+  return found;
+}
+
+size_t PdTelemetryStore::countPoints(PdTelemetryTier tier, uint32_t fromMs,
+                                     uint32_t toMs) const {
+  return query(tier, fromMs, toMs, nullptr, (size_t)-1);
+}
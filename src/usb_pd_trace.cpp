@@ -0,0 +1,69 @@
+#include "../include/usb_pd_trace.h"
+
+#if USB_PD_TRACE
+#include "../include/usb_pd_poller.h"
+
+PdTraceRecorder pdTrace;
+
+void PdTraceRecorder::record(const char *name, uint32_t startUs,
+                             uint32_t endUs) {
+  uint32_t n = head.fetch_add(1, std::memory_order_relaxed);
+  Slot &slot = slots[n % USB_PD_TRACE_EVENTS];
+  slot.seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.name.store(name, std::memory_order_relaxed);
+  slot.startUs.store(startUs, std::memory_order_relaxed);
+  slot.durUs.store(endUs - startUs, std::memory_order_relaxed);
+  // Chrome draws each tid on its own track, so spans of the poller task and
+  // the loop do not appear nested in each other
+  slot.tid.store((uint32_t)usbPdCurrentTask(), std::memory_order_relaxed);
+  slot.seq.store(n + 1, std::memory_order_release);
+}
+
+void PdTraceRecorder::writeChromeTrace(PdJsonWriter &json,
+                                       bool clearWritten) {
+  uint32_t end = head.load(std::memory_order_acquire);
+  uint32_t first = base.load(std::memory_order_relaxed);
+  if (end - first > USB_PD_TRACE_EVENTS) {
+    first = end - USB_PD_TRACE_EVENTS;
+  }
+
+  json.beginObject();
+  json.key("traceEvents").beginArray();
+  for (uint32_t n = first; n != end; ++n) {
+    const Slot &slot = slots[n % USB_PD_TRACE_EVENTS];
+    if (slot.seq.load(std::memory_order_acquire) != n + 1) {
+      continue; // Being written, or already overwritten by a newer span
+    }
+    const char *name = slot.name.load(std::memory_order_relaxed);
+    uint32_t startUs = slot.startUs.load(std::memory_order_relaxed);
+    uint32_t durUs = slot.durUs.load(std::memory_order_relaxed);
+    uint32_t tid = slot.tid.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) != n + 1) {
+      continue;
+    }
+    json.beginObject()
+        .member("name", name)
+        .member("cat", "usb_pd")
+        .member("ph", "X")
+        .member("ts", startUs)
+        .member("dur", durUs)
+        .member("pid", 1)
+        .member("tid", tid)
+        .endObject();
+  }
+  json.endArray();
+  json.member("displayTimeUnit", "ms");
+  json.key("otherData")
+      .beginObject()
+      .member("recorded", end - base.load(std::memory_order_relaxed))
+      .member("capacity", (uint32_t)USB_PD_TRACE_EVENTS)
+      .endObject();
+  json.endObject();
+  if (clearWritten) {
+    base.store(end, std::memory_order_relaxed);
+  }
+}
+
+#endif // USB_PD_TRACE
@@ -0,0 +1,76 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include "support/alloc_counter.h"
+#include <chrono>
+#include <cstdio>
+#include <stdint.h>
+
+// Shortest timed round; iterations double until a round takes this long
+#ifndef USB_PD_BENCH_MIN_ROUND_NS
+#define USB_PD_BENCH_MIN_ROUND_NS 20000000.0
+#endif
+
+#ifndef USB_PD_BENCH_ROUNDS
+#define USB_PD_BENCH_ROUNDS 5
+#endif
+
+struct BenchResult {
+  const char *name = "";
+  uint64_t iterations = 0; // Per round
+  double nsPerOp = 0;      // Fastest round
+  double allocsPerOp = 0;  // Over all rounds
+  double bytesPerOp = 0;
+  int64_t peakBytes = 0;   // Most heap held at once above the start
+};
+
+template <typename Fn> static double timeRound(uint64_t iterations, Fn &fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < iterations; ++i) {
+    fn();
+  }
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Calibrates the iteration count, then keeps the fastest of
+// USB_PD_BENCH_ROUNDS rounds to keep scheduler noise out. Heap traffic is
+// averaged over every timed iteration; the heap peak is the highest it got.
+template <typename Fn> BenchResult runBench(const char *name, Fn &&fn) {
+  BenchResult result;
+  result.name = name;
+
+  uint64_t iterations = 1;
+  while (timeRound(iterations, fn) < USB_PD_BENCH_MIN_ROUND_NS &&
+         iterations < (1ULL << 30)) {
+    iterations *= 2;
+  }
+  result.iterations = iterations;
+
+  resetAllocPeak();
+  AllocStats before = allocStats();
+  for (int round = 0; round < USB_PD_BENCH_ROUNDS; ++round) {
+    double ns = timeRound(iterations, fn) / (double)iterations;
+    result.nsPerOp = round == 0 || ns < result.nsPerOp ? ns : result.nsPerOp;
+  }
+  AllocStats after = allocStats();
+
+  double ops = (double)iterations * USB_PD_BENCH_ROUNDS;
+  result.allocsPerOp = (after.allocations - before.allocations) / ops;
+  result.bytesPerOp = (after.bytes - before.bytes) / ops;
+  result.peakBytes = after.peakLiveBytes - before.liveBytes;
+  return result;
+}
+
+// One JSON object per line; scripts/bench_compare.py reads these
+inline void printBenchResult(const BenchResult &result) {
+  printf("{\"name\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.1f,"
+         "\"allocs_per_op\":%.2f,\"bytes_per_op\":%.1f,"
+         "\"peak_bytes\":%lld}\n",
+         result.name, (unsigned long long)result.iterations, result.nsPerOp,
+         result.allocsPerOp, result.bytesPerOp, (long long)result.peakBytes);
+  fflush(stdout);
+}
+
+#endif // BENCH_HARNESS_H
@@ -0,0 +1,341 @@
+// Native microbenchmarks for the core and the controller route handlers.
+// Built by the bench_native environment; see README "Benchmarks".
+#ifdef USB_PD_BENCH
+#include "bench_harness.h"
+#include "fakes/fake_usb_pd_chip.h"
+#include <ArduinoFake.h>
+#include <interface/core/web_request_core.h>
+#include <interface/core/web_response_core.h>
+#include <testing/testing_platform_provider.h>
+#include <usb_pd_controller.h>
+#include <usb_pd_core_impl.h>
+#include <usb_pd_instrumented_chip.h>
+#include <usb_pd_json_writer.h>
+#include <usb_pd_series.h>
+#include <usb_pd_telemetry.h>
+using namespace fakeit;
+
+// Keeps results alive so the optimizer cannot drop the work
+static volatile size_t sink;
+
+// Same fake, but final: BasicUSBPDCore<FinalFakeChip> calls it directly
+class FinalFakeChip final : public FakeUsbPdChip {};
+
+template class BasicUSBPDCore<FinalFakeChip>;
+
+static void benchCore() {
+  FakeUsbPdChip chip;
+  USBPDCore core(chip);
+  float v, c;
+  int p;
+
+  printBenchResult(runBench("core.readConfig", [&]() {
+    sink = core.readConfig(v, c, p);
+  }));
+
+  // Alternate targets so every call really changes the PDOs
+  int n = 0;
+  printBenchResult(runBench("core.setConfig", [&]() {
+    sink = core.setConfig(++n % 2 ? 9.0f : 15.0f, 2.0f);
+  }));
+  printBenchResult(runBench("core.setConfig.volatile", [&]() {
+    sink = core.setConfig(++n % 2 ? 9.0f : 15.0f, 2.0f,
+                          PdWriteMode::Volatile);
+  }));
+
+  printBenchResult(runBench("core.buildPdoProfilesJson", [&]() {
+    sink = core.buildPdoProfilesJson().length();
+  }));
+
+  // The same calls bound statically, against the virtual ones above
+  FinalFakeChip finalChip;
+  BasicUSBPDCore<FinalFakeChip> staticCore(finalChip);
+  printBenchResult(runBench("core.readConfig.static", [&]() {
+    sink = staticCore.readConfig(v, c, p);
+  }));
+  printBenchResult(runBench("core.setConfig.volatile.static", [&]() {
+    sink = staticCore.setConfig(++n % 2 ? 9.0f : 15.0f, 2.0f,
+                                PdWriteMode::Volatile);
+  }));
+}
+
+// The two PDO profile serializers replaced by writePdoProfilesJson(), kept
+// here as the reference the streaming writer is measured against
+static String legacySnprintfProfiles(int activePdo, const float *voltages,
+                                     const float *currents) {
+  char buf[256];
+  int pos = 0;
+  auto append = [&](int written) {
+    if (written < 0 || written >= (int)sizeof(buf) - pos) {
+      pos = (int)sizeof(buf) - 1;
+    } else {
+      pos += written;
+    }
+  };
+  append(snprintf(buf + pos, sizeof(buf) - pos, "{\"pdos\":["));
+  for (int i = 1; i <= 3; ++i) {
+    if (i > 1) {
+      append(snprintf(buf + pos, sizeof(buf) - pos, ","));
+    }
+    float v = voltages[i];
+    float c = currents[i];
+    append(snprintf(buf + pos, sizeof(buf) - pos,
+                    "{\"number\":%d,\"voltage\":%.3g,\"current\":%.3g,"
+                    "\"power\":%.3g,\"active\":%s%s}",
+                    i, v, c, v * c, activePdo == i ? "true" : "false",
+                    i == 1 ? ",\"fixed\":true" : ""));
+  }
+  append(snprintf(buf + pos, sizeof(buf) - pos, "],\"activePDO\":%d}",
+                  activePdo));
+  buf[sizeof(buf) - 1] = '\0';
+  return String(buf);
+}
+
+static String legacyDocumentProfiles(int activePdo, const float *voltages,
+                                     const float *currents) {
+  DynamicJsonDocument doc(1024);
+  JsonArray pdos = doc.createNestedArray("pdos");
+  for (int i = 1; i <= 3; ++i) {
+    JsonObject pdo = pdos.createNestedObject();
+    pdo["number"] = i;
+    pdo["voltage"] = voltages[i];
+    pdo["current"] = currents[i];
+    pdo["power"] = voltages[i] * currents[i];
+    pdo["active"] = activePdo == i;
+    if (i == 1) {
+      pdo["fixed"] = true;
+    }
+  }
+  doc["activePDO"] = activePdo;
+  String out;
+  serializeJson(doc, out);
+  return out;
+}
+
+static void benchJson() {
+  const float v[4] = {0.0f, 5.0f, 12.05f, 20.0f};
+  const float c[4] = {0.0f, 3.0f, 2.25f, 5.0f};
+  char buf[USB_PD_PROFILES_JSON_LEN];
+
+  printBenchResult(runBench("json.profiles.writer", [&]() {
+    sink = formatPdoProfilesJson(buf, sizeof(buf), 2, v, c);
+  }));
+  printBenchResult(runBench("json.profiles.writer.string", [&]() {
+    sink = formatPdoProfilesJson(2, v, c).length();
+  }));
+  printBenchResult(runBench("json.profiles.legacy.snprintf", [&]() {
+    sink = legacySnprintfProfiles(2, v, c).length();
+  }));
+  printBenchResult(runBench("json.profiles.legacy.document", [&]() {
+    sink = legacyDocumentProfiles(2, v, c).length();
+  }));
+}
+
+static void benchTelemetry() {
+  // Full tiers, so queries walk the most they ever will
+  static PdTelemetryStore store;
+  uint32_t ms = 0;
+  for (; ms < 3 * 3600000UL; ms += 250) {
+    store.record(ms, 5.0f, 1.0f);
+  }
+  static PdTelemetryPoint points[USB_PD_HISTORY_MAX_POINTS];
+
+  printBenchResult(runBench("telemetry.record", [&]() {
+    store.record(ms += 250, 15.0f, 2.0f);
+  }));
+  printBenchResult(runBench("telemetry.query.minutes", [&]() {
+    sink = store.query(PdTelemetryTier::Minutes, ms - 3600000UL, ms, points,
+                       USB_PD_HISTORY_MAX_POINTS);
+  }));
+  printBenchResult(runBench("telemetry.pickTier", [&]() {
+    sink = (size_t)store.pickTier(ms - 3600000UL, ms,
+                                  USB_PD_HISTORY_MAX_POINTS);
+  }));
+}
+
+// A day of 1 s means, deterministic. "contract" is what the chip reports:
+// the negotiated PDO, renegotiated every 4 h, with a 10 min detach every
+// 6 h. "noisy" is a measured-like worst case: a few mV/mA of noise on
+// every sample, the load stepping every 30 s and the clock jittering by
+// up to 20 ms.
+static bool traceSample(bool noisy, uint32_t i, PdTelemetrySample &s) {
+  static const uint16_t volts[] = {5000, 9000, 15000, 20000};
+  static uint32_t lcg = 1;
+  lcg = lcg * 1664525UL + 1013904223UL;
+  int noise = (int)(lcg >> 29) - 4; // -4..3
+  if (noisy) {
+    s.ms = i * 1000 + (lcg >> 16) % 21;
+    s.millivolts = (uint16_t)(20000 + noise * 3);
+    s.milliamps = (uint16_t)(500 + ((i / 30) * 7919) % 2500 + noise * 2);
+    return true;
+  }
+  s.ms = i * 1000;
+  s.millivolts = volts[(i / 14400) % 4];
+  s.milliamps = 3000;
+  return i % 21600 >= 600; // Detached samples are not recorded
+}
+
+static void benchSeries() {
+  static PdSeriesRing ring;
+  static PdSeriesBlock block;
+  PdSeriesEncoder encoder;
+  PdTelemetrySample s;
+  const uint32_t day = 86400;
+
+  for (int noisy = 0; noisy < 2; ++noisy) {
+    // Compression over the day, against 12 bytes (u32 time, two floats)
+    // per sample; printed without a name so bench_compare.py skips it
+    uint32_t samples = 0;
+    uint32_t blocks = 0;
+    encoder.reset(block);
+    for (uint32_t i = 0; i < day; ++i) {
+      if (!traceSample(noisy, i, s)) {
+        continue;
+      }
+      ++samples;
+      if (!encoder.append(s)) {
+        ++blocks;
+        encoder.reset(block);
+        encoder.append(s);
+      }
+    }
+    double bytes = (double)(blocks + 1) * sizeof(PdSeriesBlock);
+    printf("{\"trace\":\"%s\",\"samples\":%lu,\"bytes\":%.0f,"
+           "\"bits_per_sample\":%.2f,\"ratio\":%.1f}\n",
+           noisy ? "noisy" : "contract", (unsigned long)samples, bytes,
+           bytes * 8 / samples, samples * 12.0 / bytes);
+
+    uint32_t i = 0;
+    ring.clear();
+    printBenchResult(
+        runBench(noisy ? "series.append.noisy" : "series.append", [&]() {
+          if (traceSample(noisy, i++, s)) {
+            ring.append(s);
+          }
+        }));
+  }
+
+  // Decoding a full block of the contract trace, per block
+  encoder.reset(block);
+  for (uint32_t i = 0; !traceSample(false, i, s) || encoder.append(s); ++i) {
+  }
+  printBenchResult(runBench("series.decode.block", [&]() {
+    PdSeriesDecoder decoder(block);
+    while (decoder.next(s)) {
+      sink = s.millivolts;
+    }
+  }));
+}
+
+// Stand-in for micros(): cheap, and every reading differs
+static uint32_t benchUs = 0;
+static uint32_t benchClock() { return benchUs += 7; }
+
+static void benchMetrics() {
+  static PdHistogram h;
+  uint32_t us = 0;
+  printBenchResult(runBench("metrics.observe", [&]() {
+    h.observe(us += 37);
+  }));
+
+  // The decorator's cost is the difference between these two
+  FakeUsbPdChip chip;
+  PdChipMetrics metrics;
+  InstrumentedUsbPdChip timed(chip, metrics, benchClock);
+  printBenchResult(runBench("chip.readContract", [&]() {
+    sink = (size_t)chip.readContract().state;
+  }));
+  printBenchResult(runBench("chip.instrumented.readContract", [&]() {
+    sink = (size_t)timed.readContract().state;
+  }));
+}
+
+static void benchRoutes() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  ctrl.begin();
+  WebRequestCore req;
+
+  auto route = [&](const char *name, USBPDController::RouteHandler handler) {
+    printBenchResult(runBench(name, [&]() {
+      WebResponseCore res;
+      (ctrl.*handler)(req, res);
+      sink = res.getStatus();
+    }));
+  };
+  route("route.mainPage", &USBPDController::mainPageHandler);
+  route("route.status", &USBPDController::pdStatusHandler);
+  route("route.voltages", &USBPDController::availableVoltagesHandler);
+  route("route.currents", &USBPDController::availableCurrentsHandler);
+  route("route.capabilities", &USBPDController::capabilitiesHandler);
+  route("route.profiles", &USBPDController::pdoProfilesHandler);
+  route("route.events", &USBPDController::eventsHandler);
+  route("route.snapshot", &USBPDController::snapshotHandler);
+  route("route.history", &USBPDController::historyHandler);
+  route("route.diagnostics", &USBPDController::diagnosticsHandler);
+  route("route.ports", &USBPDController::portsHandler);
+  route("route.metrics", &USBPDController::metricsHandler);
+
+  printBenchResult(runBench("route.portStatus", [&]() {
+    WebResponseCore res;
+    ctrl.portResponse(0, &USBPDController::statusResponse, req, res);
+    sink = res.getStatus();
+  }));
+
+  // POST /api/configure plus the handle() calls that apply the job
+  WebRequestCore post;
+  post.setBody("{\"voltage\":15.0,\"current\":2.0,\"mode\":\"volatile\"}");
+  printBenchResult(runBench("route.configure", [&]() {
+    WebResponseCore res;
+    ctrl.setPDConfigHandler(post, res);
+    for (int i = 0; i < 16 && ctrl.nextWakeMs() == 0; ++i) {
+      ctrl.handle();
+    }
+    sink = res.getStatus();
+  }));
+
+  // GET /api/configure/{id} for a finished job
+  uint32_t id = ctrl.submitPDConfig(9.0f, 2.0f);
+  for (int i = 0; i < 16 && ctrl.nextWakeMs() == 0; ++i) {
+    ctrl.handle();
+  }
+  printBenchResult(runBench("route.configureStatus", [&]() {
+    WebResponseCore res;
+    ctrl.configJobResponse(id, res);
+    sink = res.getStatus();
+  }));
+
+  printBenchResult(runBench("controller.handle.idle", [&]() {
+    ctrl.handle();
+  }));
+  printBenchResult(runBench("controller.sampleNow", [&]() {
+    ctrl.sampleNow();
+  }));
+  printBenchResult(runBench("controller.getHttpRoutes", [&]() {
+    sink = ctrl.getHttpRoutes().size();
+  }));
+}
+
+int main() {
+  ArduinoFakeReset();
+  When(OverloadedMethod(ArduinoFake(Wire), begin, void())).AlwaysDo([]() {});
+  When(Method(ArduinoFake(), delay)).AlwaysReturn();
+  // Frozen clock: handle() only ever has the work a benchmark gives it
+  When(Method(ArduinoFake(), millis)).AlwaysReturn(0UL);
+  When(Method(ArduinoFake(), micros)).AlwaysReturn(0UL);
+
+  MockWebPlatformProvider provider;
+  IWebPlatformProvider::instance = &provider;
+
+  benchCore();
+  benchJson();
+  benchTelemetry();
+  benchSeries();
+  benchMetrics();
+  benchRoutes();
+
+  IWebPlatformProvider::instance = nullptr;
+  return 0;
+}
+
+#endif // USB_PD_BENCH
@@ -0,0 +1,53 @@
+#ifndef FAKE_SERIES_STORAGE_H
+#define FAKE_SERIES_STORAGE_H
+
+#include <string.h>
+#include <usb_pd_series.h>
+#include <vector>
+
+// Segments held in memory, standing in for LittleFS
+class FakeSeriesStorage : public IPdSeriesStorage {
+public:
+  std::vector<uint8_t> segments[2];
+
+  // Fail the next appends, writing only this many bytes of each (a write
+  // torn by power loss)
+  bool failAppends = false;
+  size_t tornBytes = 0;
+
+  int reads = 0;
+  int appends = 0;
+  int erases = 0;
+
+  size_t size(uint8_t segment) override { return segments[segment].size(); }
+
+  bool read(uint8_t segment, size_t offset, void *buf, size_t len) override {
+    ++reads;
+    const std::vector<uint8_t> &s = segments[segment];
+    if (offset + len > s.size()) {
+      return false;
+    }
+    memcpy(buf, s.data() + offset, len);
+    return true;
+  }
+
+  bool append(uint8_t segment, const void *buf, size_t len) override {
+    ++appends;
+    const uint8_t *bytes = static_cast<const uint8_t *>(buf);
+    if (failAppends) {
+      segments[segment].insert(segments[segment].end(), bytes,
+                               bytes + (tornBytes < len ? tornBytes : len));
+      return false;
+    }
+    segments[segment].insert(segments[segment].end(), bytes, bytes + len);
+    return true;
+  }
+
+  bool erase(uint8_t segment) override {
+    ++erases;
+    segments[segment].clear();
+    return true;
+  }
+};
+
+#endif // FAKE_SERIES_STORAGE_H
@@ -14,28 +14,155 @@ public:
   // Simulate write failure - when true, write() corrupts values to 0
   bool simulateWriteFailure = false;
 
-  bool probe(uint8_t) override { return present; }
-  bool begin() override { return present; }
-  void read() override {}
+  // Bus-touching call counters so tests can assert on I2C traffic
+  int probeCalls = 0;
+  int beginCalls = 0;
+  int readCalls = 0;
+  int volatileWrites = 0;
+  int contractReads = 0;
+  int alertEnables = 0;
+  int alertClears = 0;
+
+  // Last bus, arbiter client and address the controller addressed
+  uint8_t bus = 0;
+  int i2cClient = -1;
+  uint8_t address = 0;
+
+  // Bus clock last set; register images read above maxClockHz come back
+  // with a flipped bit, like a bus too slow to settle at that speed
+  uint32_t busClockHz = 100000;
+  uint32_t maxClockHz = 1000000;
+  int registerImageReads = 0;
+
+  // SDA held low by the device: nothing answers until recoverBus()
+  bool busStuck = false;
+  int busRecoveries = 0;
+  int recoverySda = -1;
+  int recoveryScl = -1;
+
+  // Device answers probes but not register reads (readPdoSet() fails,
+  // readContract() reports Unknown)
+  bool failReads = false;
+
+  // Reported contract; Ready on the active PDO unless a test overrides it
+  PdContractState contractState = PdContractState::Ready;
+  // Report Negotiating for this many reads first (renegotiation in flight)
+  int negotiatingReads = 0;
+  // PDO the source accepted; 0 reports the active PDO. Each soft reset
+  // renegotiates and changes the RDO, unless contractPdo pins the contract
+  // (source still reporting the one from before the reset).
+  int contractPdo = 0;
+  int softResets = 0;
+
+  bool selectBus(uint8_t index) override {
+    bus = index;
+    return true;
+  }
+  void setI2cClient(int client) override { i2cClient = client; }
+  bool probe(uint8_t i2cAddress) override {
+    ++probeCalls;
+    address = i2cAddress;
+    return present && !busStuck;
+  }
+  bool begin() override {
+    ++beginCalls;
+    return present && !busStuck;
+  }
+  void read() override { ++readCalls; }
   int getPdoNumber() const override { return active; }
   float getVoltage(int idx) const override { return volt[idx]; }
   float getCurrent(int idx) const override { return amps[idx]; }
   void setVoltage(int idx, float v) override { volt[idx] = v; }
   void setCurrent(int idx, float a) override { amps[idx] = a; }
   void setPdoNumber(int idx) override { active = idx; }
+  bool readPdoSet(PdoSet &out) override {
+    ++readCalls;
+    if (failReads) {
+      return false;
+    }
+    out.activePdo = active;
+    for (int i = 1; i <= 3; ++i) {
+      out.voltage[i] = volt[i];
+      out.current[i] = amps[i];
+    }
+    return true;
+  }
   void write() override {
     // Simulate a chip that doesn't properly accept the write
     if (simulateWriteFailure) {
-      // Corrupt the values to simulate write failure
-      volt[1] = 0.0f;
-      volt[2] = 0.0f;
-      volt[3] = 0.0f;
-      amps[1] = 0.0f;
-      amps[2] = 0.0f;
-      amps[3] = 0.0f;
+      corruptValues();
+    }
+  }
+  void softReset() override { ++softResets; }
+  void writeVolatile() override {
+    ++volatileWrites;
+    if (simulateWriteFailure) {
+      corruptValues();
+    }
+  }
+  PdContract readContract() override {
+    ++contractReads;
+    PdContract contract;
+    if (failReads) {
+      return contract;
+    }
+    if (negotiatingReads > 0) {
+      --negotiatingReads;
+      contract.state = PdContractState::Negotiating;
+      return contract;
+    }
+    contract.state = contractState;
+    if (contractState == PdContractState::Ready) {
+      contract.pdoNumber = contractPdo ? contractPdo : active;
+      contract.rdo = ((uint32_t)contract.pdoNumber << 28) |
+                     (contractPdo ? 0 : (uint32_t)softResets);
+    }
+    return contract;
+  }
+  bool enableAttachAlert() override {
+    ++alertEnables;
+    return present;
+  }
+  void clearAlerts() override { ++alertClears; }
+  bool setBusClock(uint32_t hz) override {
+    busClockHz = hz;
+    return true;
+  }
+  bool readRegisterImage(PdRegisterImage &out) override {
+    ++registerImageReads;
+    if (!present || busStuck) {
+      return false;
+    }
+    out.length = 7;
+    out.bytes[0] = (uint8_t)active;
+    for (int i = 1; i <= 3; ++i) {
+      out.bytes[i] = (uint8_t)(volt[i] * 10);
+      out.bytes[3 + i] = (uint8_t)(amps[i] * 10);
+    }
+    if (busClockHz > maxClockHz) {
+      out.bytes[0] ^= 0x80;
     }
+    return true;
+  }
+  bool recoverBus(int sda, int scl) override {
+    ++busRecoveries;
+    recoverySda = sda;
+    recoveryScl = scl;
+    busStuck = false;
+    busClockHz = 100000;
+    return true;
+  }
+
+private:
+  // Corrupt the values to simulate write failure
+  void corruptValues() {
+    volt[1] = 0.0f;
+    volt[2] = 0.0f;
+    volt[3] = 0.0f;
+    amps[1] = 0.0f;
+    amps[2] = 0.0f;
+    amps[3] = 0.0f;
   }
-  void softReset() override {}
 };
 
 #endif // FAKE_USB_PD_CHIP_H
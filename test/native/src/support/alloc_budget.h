@@ -0,0 +1,21 @@
+#ifndef ALLOC_BUDGET_H
+#define ALLOC_BUDGET_H
+
+#include "alloc_counter.h"
+#include <stdio.h>
+#include <unity.h>
+
+// Budget mode: fail the test when any single call charged to name by
+// trackAllocs() made more than budget heap allocations
+#define TEST_ASSERT_ALLOC_BUDGET(budget, name)                                 \
+  do {                                                                         \
+    const HandlerAllocStats *stats_ = handlerAllocStats(name);                 \
+    TEST_ASSERT_NOT_NULL_MESSAGE(stats_, "no calls tracked for " name);        \
+    char message_[96];                                                         \
+    snprintf(message_, sizeof(message_), "%s: %llu allocations in one call",   \
+             name, (unsigned long long)stats_->maxAllocations);                \
+    TEST_ASSERT_TRUE_MESSAGE(stats_->maxAllocations <= (uint64_t)(budget),     \
+                             message_);                                        \
+  } while (0)
+
+#endif // ALLOC_BUDGET_H
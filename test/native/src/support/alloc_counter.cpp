@@ -0,0 +1,199 @@
+#ifdef NATIVE_PLATFORM
+#include "alloc_counter.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace {
+std::atomic<uint64_t> allocations{0};
+std::atomic<uint64_t> bytes{0};
+std::atomic<int64_t> liveBytes{0};
+std::atomic<int64_t> peakLiveBytes{0};
+
+void noteAlloc(size_t requested, size_t held) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  bytes.fetch_add(requested, std::memory_order_relaxed);
+  int64_t live =
+      liveBytes.fetch_add((int64_t)held, std::memory_order_relaxed) + held;
+  int64_t peak = peakLiveBytes.load(std::memory_order_relaxed);
+  while (live > peak && !peakLiveBytes.compare_exchange_weak(
+                            peak, live, std::memory_order_relaxed)) {
+  }
+}
+
+void noteFree(size_t held) {
+  liveBytes.fetch_sub((int64_t)held, std::memory_order_relaxed);
+}
+
+// Per-handler counters; only touched from the test thread
+HandlerAllocStats handlers[ALLOC_TRACKER_MAX_HANDLERS];
+size_t handlerCount = 0;
+} // namespace
+
+AllocStats allocStats() {
+  AllocStats stats;
+  stats.allocations = allocations.load();
+  stats.bytes = bytes.load();
+  stats.liveBytes = liveBytes.load();
+  stats.peakLiveBytes = peakLiveBytes.load();
+  return stats;
+}
+
+void resetAllocPeak() { peakLiveBytes.store(liveBytes.load()); }
+
+void chargeAllocs(const char *name, const AllocStats &call) {
+  HandlerAllocStats *entry = nullptr;
+  for (size_t i = 0; i < handlerCount && !entry; ++i) {
+    if (strcmp(handlers[i].name, name) == 0) {
+      entry = &handlers[i];
+    }
+  }
+  if (!entry) {
+    if (handlerCount == ALLOC_TRACKER_MAX_HANDLERS) {
+      return; // Table full; raise ALLOC_TRACKER_MAX_HANDLERS
+    }
+    entry = &handlers[handlerCount++];
+    entry->name = name;
+  }
+  entry->calls++;
+  entry->allocations += call.allocations;
+  entry->bytes += call.bytes;
+  if (call.allocations > entry->maxAllocations) {
+    entry->maxAllocations = call.allocations;
+  }
+}
+
+const HandlerAllocStats *handlerAllocStats(const char *name) {
+  for (size_t i = 0; i < handlerCount; ++i) {
+    if (strcmp(handlers[i].name, name) == 0) {
+      return &handlers[i];
+    }
+  }
+  return nullptr;
+}
+
+void resetHandlerAllocStats() {
+  for (size_t i = 0; i < handlerCount; ++i) {
+    handlers[i] = HandlerAllocStats();
+  }
+  handlerCount = 0;
+}
+
+void printHandlerAllocStats() {
+  for (size_t i = 0; i < handlerCount; ++i) {
+    const HandlerAllocStats &h = handlers[i];
+    printf("[alloc] %-28s calls=%u allocs=%llu bytes=%llu max/call=%llu\n",
+           h.name, (unsigned)h.calls, (unsigned long long)h.allocations,
+           (unsigned long long)h.bytes, (unsigned long long)h.maxAllocations);
+  }
+}
+
+#if defined(__GLIBC__)
+// glibc: interpose the malloc family so C allocations (Arduino String,
+// ArduinoJson's default allocator) are counted along with operator new,
+// which libstdc++ implements on top of malloc. Live bytes are tracked as
+// usable block sizes. Aligned allocation functions are not interposed.
+#include <malloc.h>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size) {
+  void *ptr = __libc_malloc(size);
+  if (ptr) {
+    noteAlloc(size, malloc_usable_size(ptr));
+  }
+  return ptr;
+}
+
+void *calloc(size_t count, size_t size) {
+  void *ptr = __libc_calloc(count, size);
+  if (ptr) {
+    noteAlloc(count * size, malloc_usable_size(ptr));
+  }
+  return ptr;
+}
+
+void *realloc(void *ptr, size_t size) {
+  size_t held = ptr ? malloc_usable_size(ptr) : 0;
+  void *moved = __libc_realloc(ptr, size);
+  if (moved) {
+    noteFree(held);
+    noteAlloc(size, malloc_usable_size(moved));
+  } else if (ptr && size == 0) {
+    noteFree(held); // realloc(ptr, 0) frees
+  }
+  return moved;
+}
+
+void free(void *ptr) {
+  if (ptr) {
+    noteFree(malloc_usable_size(ptr));
+  }
+  __libc_free(ptr);
+}
+}
+
+#else
+namespace {
+// Each block is prefixed with its size so frees can be accounted for
+constexpr size_t kHeader = alignof(std::max_align_t);
+
+void *countedAlloc(size_t size) {
+  void *raw = std::malloc(size + kHeader);
+  if (!raw) {
+    return nullptr;
+  }
+  *static_cast<size_t *>(raw) = size;
+  noteAlloc(size, size);
+  return static_cast<char *>(raw) + kHeader;
+}
+
+void countedFree(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+  void *raw = static_cast<char *>(ptr) - kHeader;
+  noteFree(*static_cast<size_t *>(raw));
+  std::free(raw);
+}
+} // namespace
+
+void *operator new(size_t size) {
+  void *ptr = countedAlloc(size);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return countedAlloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return countedAlloc(size);
+}
+
+void operator delete(void *ptr) noexcept { countedFree(ptr); }
+void operator delete[](void *ptr) noexcept { countedFree(ptr); }
+void operator delete(void *ptr, size_t) noexcept { countedFree(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { countedFree(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+  countedFree(ptr);
+}
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+  countedFree(ptr);
+}
+#endif // __GLIBC__
+
+#endif // NATIVE_PLATFORM
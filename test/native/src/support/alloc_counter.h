@@ -0,0 +1,62 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <stdint.h>
+
+// Heap traffic seen by the native test binary, which replaces the global
+// allocation functions in alloc_counter.cpp (malloc family and operator new
+// on glibc, operator new elsewhere). Take a snapshot before and after the
+// code under test and compare, or let trackAllocs() keep per-handler
+// counters.
+struct AllocStats {
+  uint64_t allocations = 0; // Allocation calls, each realloc included
+  uint64_t bytes = 0;       // Bytes requested by those calls
+  int64_t liveBytes = 0;    // Bytes currently held
+  int64_t peakLiveBytes = 0; // Most bytes held since resetAllocPeak()
+};
+
+AllocStats allocStats();
+
+// Restart the peak watermark at the bytes currently held
+void resetAllocPeak();
+
+// Heap traffic charged to one named handler by trackAllocs()
+struct HandlerAllocStats {
+  const char *name = nullptr;
+  uint32_t calls = 0;
+  uint64_t allocations = 0;    // Over all calls
+  uint64_t bytes = 0;
+  uint64_t maxAllocations = 0; // Worst single call
+};
+
+// Most distinct names trackAllocs() keeps; the table is fixed so tracking
+// never allocates itself
+#ifndef ALLOC_TRACKER_MAX_HANDLERS
+#define ALLOC_TRACKER_MAX_HANDLERS 32
+#endif
+
+// Add one call's heap traffic to name's counters
+void chargeAllocs(const char *name, const AllocStats &call);
+
+// Run fn once and charge the heap traffic it caused to name; returns that
+// call's share
+template <typename Fn> AllocStats trackAllocs(const char *name, Fn &&fn) {
+  AllocStats before = allocStats();
+  fn();
+  AllocStats after = allocStats();
+  AllocStats call;
+  call.allocations = after.allocations - before.allocations;
+  call.bytes = after.bytes - before.bytes;
+  call.liveBytes = after.liveBytes - before.liveBytes;
+  chargeAllocs(name, call);
+  return call;
+}
+
+// Counters for name, or nullptr if nothing was charged to it
+const HandlerAllocStats *handlerAllocStats(const char *name);
+void resetHandlerAllocStats();
+
+// One line per tracked handler, for test logs
+void printHandlerAllocStats();
+
+#endif // ALLOC_COUNTER_H
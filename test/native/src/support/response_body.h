@@ -0,0 +1,14 @@
+#ifndef RESPONSE_BODY_H
+#define RESPONSE_BODY_H
+
+#include <interface/core/web_response_core.h>
+
+// Body of a handled response, whether the handler built it (setContent /
+// createJsonResponse) or pointed it at a static or pre-rendered buffer
+// (setProgmemContent)
+inline String responseBody(const WebResponseCore &res) {
+  return res.hasProgmemContent() ? String(res.getProgmemData())
+                                 : res.getContent();
+}
+
+#endif // RESPONSE_BODY_H
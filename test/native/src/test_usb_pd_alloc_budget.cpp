@@ -0,0 +1,199 @@
+#include <unity.h>
+
+#ifdef NATIVE_PLATFORM
+#include "fakes/fake_usb_pd_chip.h"
+#include "support/alloc_budget.h"
+#include "support/response_body.h"
+#include <ArduinoJson.h>
+#include <atomic>
+#include <interface/core/web_request_core.h>
+#include <interface/core/web_response_core.h>
+#include <thread>
+#include <usb_pd_controller.h>
+
+// Calls made of each handler and each body copy
+static const int STEADY_CALLS = 8;
+
+static void trackHandler(USBPDController &ctrl,
+                         USBPDController::RouteHandler handler) {
+  WebRequestCore req;
+  for (int i = 0; i < STEADY_CALLS; ++i) {
+    WebResponseCore res;
+    (ctrl.*handler)(req, res);
+    TEST_ASSERT_TRUE(responseBody(res).length() > 0);
+  }
+}
+
+static void test_trackAllocs_charges_each_handler() {
+  resetHandlerAllocStats();
+  for (int i = 0; i < 3; ++i) {
+    AllocStats call = trackAllocs("test.string", [&]() {
+      String s;
+      s.reserve(64 * (i + 1));
+    });
+    TEST_ASSERT_TRUE(call.allocations >= 1);
+    TEST_ASSERT_EQUAL(0, call.liveBytes);
+  }
+  trackAllocs("test.none", []() {});
+
+  const HandlerAllocStats *str = handlerAllocStats("test.string");
+  TEST_ASSERT_NOT_NULL(str);
+  TEST_ASSERT_EQUAL(3, str->calls);
+  TEST_ASSERT_TRUE(str->allocations >= 3);
+  TEST_ASSERT_TRUE(str->bytes >= 64 + 128 + 192);
+  TEST_ASSERT_TRUE(str->maxAllocations >= 1);
+
+  const HandlerAllocStats *none = handlerAllocStats("test.none");
+  TEST_ASSERT_NOT_NULL(none);
+  TEST_ASSERT_EQUAL(1, none->calls);
+  TEST_ASSERT_EQUAL(0, none->allocations);
+  TEST_ASSERT_ALLOC_BUDGET(0, "test.none");
+
+  resetHandlerAllocStats();
+  TEST_ASSERT_NULL(handlerAllocStats("test.string"));
+}
+
+static void test_get_handlers_stay_within_allocation_budget() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  ctrl.begin();
+  ctrl.sampleNow();
+
+  // Everything a state handler does with its body is one copy of a body
+  // rendered at publish; the static ones hand out a constant and copy nothing
+  resetHandlerAllocStats();
+  PdRenderedBody<USB_PD_STATUS_JSON_LEN> body;
+  body.publish("{\"success\":true,\"voltage\":15,\"current\":2}");
+  char etag[USB_PD_STATE_ETAG_LEN];
+  ctrl.getStateEtag(etag, sizeof(etag));
+  for (int i = 0; i < STEADY_CALLS; ++i) {
+    trackAllocs("copy rendered body", [&]() {
+      String copy;
+      body.copyTo(copy);
+    });
+    trackAllocs("copy profiles body",
+                [&]() { String copy = ctrl.getAllPDOProfiles(); });
+    trackAllocs("copy event frame",
+                [&]() { String frame = ctrl.getEventFrame(""); });
+    trackAllocs("copy idle frame",
+                [&]() { String frame = ctrl.getEventFrame(etag); });
+  }
+  TEST_ASSERT_ALLOC_BUDGET(1, "copy rendered body");
+  TEST_ASSERT_ALLOC_BUDGET(1, "copy profiles body");
+  TEST_ASSERT_ALLOC_BUDGET(1, "copy event frame");
+  TEST_ASSERT_ALLOC_BUDGET(1, "copy idle frame");
+
+  // Every GET handler still answers after a new sample re-rendered its body
+  trackHandler(ctrl, &USBPDController::pdStatusHandler);
+  TEST_ASSERT_TRUE(ctrl.setPDConfig(15.0f, 2.0f, PdWriteMode::Volatile));
+  trackHandler(ctrl, &USBPDController::pdStatusHandler);
+  trackHandler(ctrl, &USBPDController::pdoProfilesHandler);
+  trackHandler(ctrl, &USBPDController::availableVoltagesHandler);
+  trackHandler(ctrl, &USBPDController::availableCurrentsHandler);
+  trackHandler(ctrl, &USBPDController::capabilitiesHandler);
+  trackHandler(ctrl, &USBPDController::eventsHandler);
+  trackHandler(ctrl, &USBPDController::snapshotHandler);
+}
+
+static void test_rendered_bodies_follow_published_snapshot() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  ctrl.begin();
+  TEST_ASSERT_TRUE(ctrl.setPDConfig(15.0f, 2.0f, PdWriteMode::Volatile));
+
+  WebRequestCore req;
+  WebResponseCore status;
+  ctrl.pdStatusHandler(req, status);
+  TEST_ASSERT_FALSE(status.hasProgmemContent());
+  TEST_ASSERT_EQUAL_STRING("application/json", status.getMimeType().c_str());
+  StaticJsonDocument<256> doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, responseBody(status)));
+  TEST_ASSERT_TRUE(doc["success"].as<bool>());
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 15.0f, doc["voltage"].as<float>());
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 2.0f, doc["current"].as<float>());
+
+  WebResponseCore profiles;
+  ctrl.pdoProfilesHandler(req, profiles);
+  TEST_ASSERT_EQUAL(200, profiles.getStatus());
+  StaticJsonDocument<768> pdos;
+  TEST_ASSERT_FALSE(deserializeJson(pdos, responseBody(profiles)));
+  int active = pdos["activePDO"].as<int>();
+  TEST_ASSERT_TRUE(active >= 1 && active <= 3);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 15.0f,
+                           pdos["pdos"][active - 1]["voltage"].as<float>());
+  TEST_ASSERT_TRUE(pdos["pdos"][active - 1]["active"].as<bool>());
+  TEST_ASSERT_EQUAL_STRING(responseBody(profiles).c_str(),
+                           ctrl.getAllPDOProfiles().c_str());
+}
+
+static void test_rendered_body_keeps_unchanged_slot() {
+  PdRenderedBody<32> body;
+  TEST_ASSERT_EQUAL_STRING("", body.get());
+
+  TEST_ASSERT_TRUE(body.publish("{\"a\":1}"));
+  const char *first = body.get();
+  TEST_ASSERT_EQUAL_STRING("{\"a\":1}", first);
+
+  // Same text: nothing is rewritten
+  TEST_ASSERT_FALSE(body.publish("{\"a\":1}"));
+  TEST_ASSERT_EQUAL_PTR(first, body.get());
+
+  // New text goes to another slot, so the current one is never torn
+  TEST_ASSERT_TRUE(body.publish("{\"a\":2}"));
+  TEST_ASSERT_NOT_EQUAL(first, body.get());
+  TEST_ASSERT_EQUAL_STRING("{\"a\":2}", body.get());
+
+  // Oversized bodies are cut to fit
+  body.publish("0123456789012345678901234567890123456789");
+  TEST_ASSERT_EQUAL(31, strlen(body.get()));
+}
+
+static void test_rendered_body_copy_is_the_response_own() {
+  PdRenderedBody<32> body;
+  body.publish("{\"a\":1}");
+  String sending;
+  body.copyTo(sending);
+
+  // Publishes while that response goes out don't touch what it sends
+  for (int i = 2; i < 8; ++i) {
+    char text[] = "{\"a\":0}";
+    text[5] = (char)('0' + i);
+    TEST_ASSERT_TRUE(body.publish(text));
+    TEST_ASSERT_EQUAL_STRING("{\"a\":1}", sending.c_str());
+    String now;
+    body.copyTo(now);
+    TEST_ASSERT_EQUAL_STRING(text, now.c_str());
+  }
+}
+
+static void test_rendered_body_copies_whole_bodies_under_publish() {
+  PdRenderedBody<64> body;
+  const char *bodies[] = {"{\"a\":\"1111111111111111\"}",
+                          "{\"a\":\"2222222222222222222222222222\"}"};
+  body.publish(bodies[0]);
+  std::atomic<bool> done{false};
+  std::thread writer([&]() {
+    for (int i = 0; i < 20000; ++i) {
+      body.publish(bodies[i & 1]);
+    }
+    done = true;
+  });
+  // A reader racing the writer only ever sees one of the bodies, whole
+  String copy;
+  while (!done) {
+    body.copyTo(copy);
+    TEST_ASSERT_TRUE(copy == bodies[0] || copy == bodies[1]);
+  }
+  writer.join();
+}
+
+void register_usb_pd_alloc_budget_tests() {
+  RUN_TEST(test_trackAllocs_charges_each_handler);
+  RUN_TEST(test_get_handlers_stay_within_allocation_budget);
+  RUN_TEST(test_rendered_bodies_follow_published_snapshot);
+  RUN_TEST(test_rendered_body_keeps_unchanged_slot);
+  RUN_TEST(test_rendered_body_copy_is_the_response_own);
+  RUN_TEST(test_rendered_body_copies_whole_bodies_under_publish);
+}
+
+#endif // NATIVE_PLATFORM
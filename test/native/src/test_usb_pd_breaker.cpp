@@ -0,0 +1,200 @@
+#include <unity.h>
+
+#ifdef NATIVE_PLATFORM
+#include "fakes/fake_usb_pd_chip.h"
+#include "support/response_body.h"
+#include <ArduinoFake.h>
+#include <ArduinoJson.h>
+#include <usb_pd_breaker.h>
+#include <usb_pd_controller.h>
+
+using namespace fakeit;
+
+static void test_breaker_opens_after_consecutive_failures() {
+  PdCircuitBreaker breaker;
+  breaker.configure(3, 1000, 8000);
+  breaker.failed(0);
+  breaker.succeeded(); // Resets the run
+  breaker.failed(0);
+  breaker.failed(0);
+  TEST_ASSERT_TRUE(breaker.allow(0));
+  TEST_ASSERT_EQUAL(PdBreakerState::Closed, breaker.getState());
+
+  breaker.failed(100);
+  TEST_ASSERT_EQUAL(PdBreakerState::Open, breaker.getState());
+  TEST_ASSERT_EQUAL_UINT32(1, breaker.getTrips());
+  TEST_ASSERT_FALSE(breaker.allow(600));
+  TEST_ASSERT_TRUE(breaker.isOpen(600));
+  TEST_ASSERT_EQUAL_UINT32(500, breaker.msUntilRetry(600));
+  TEST_ASSERT_EQUAL_UINT32(1, breaker.getRejected());
+}
+
+static void test_breaker_backs_off_between_trials() {
+  PdCircuitBreaker breaker;
+  breaker.configure(1, 1000, 4000);
+  uint32_t now = 0;
+  breaker.failed(now);
+
+  // Each failed trial doubles the wait, up to the maximum
+  const uint32_t expected[] = {2000, 4000, 4000};
+  for (uint32_t backoff : expected) {
+    now += breaker.getBackoffMs();
+    TEST_ASSERT_TRUE(breaker.allow(now));
+    TEST_ASSERT_EQUAL(PdBreakerState::HalfOpen, breaker.getState());
+    breaker.failed(now);
+    TEST_ASSERT_EQUAL_UINT32(backoff, breaker.getBackoffMs());
+    TEST_ASSERT_FALSE(breaker.allow(now + backoff - 1));
+  }
+  TEST_ASSERT_EQUAL_UINT32(1, breaker.getTrips());
+
+  // A successful trial closes it for good
+  now += breaker.getBackoffMs();
+  TEST_ASSERT_TRUE(breaker.allow(now));
+  breaker.succeeded();
+  TEST_ASSERT_EQUAL(PdBreakerState::Closed, breaker.getState());
+  TEST_ASSERT_EQUAL_UINT32(0, breaker.getBackoffMs());
+  TEST_ASSERT_TRUE(breaker.allow(now));
+
+  // Disabled, it never opens
+  breaker.configure(0, 1000, 4000);
+  for (int i = 0; i < 10; ++i) {
+    breaker.failed(now);
+  }
+  TEST_ASSERT_TRUE(breaker.allow(now));
+}
+
+static void test_breaker_backoff_only_grows_on_failed_trials() {
+  PdCircuitBreaker breaker;
+  breaker.configure(1, 1000, 8000);
+  breaker.failed(0);
+  TEST_ASSERT_EQUAL_UINT32(1000, breaker.getBackoffMs());
+
+  // Failures of work that bypassed the open breaker are counted only
+  breaker.failed(100);
+  breaker.failed(200);
+  TEST_ASSERT_EQUAL(PdBreakerState::Open, breaker.getState());
+  TEST_ASSERT_EQUAL_UINT32(3, breaker.getConsecutiveFailures());
+  TEST_ASSERT_EQUAL_UINT32(1000, breaker.getBackoffMs());
+  TEST_ASSERT_EQUAL_UINT32(800, breaker.msUntilRetry(200));
+
+  TEST_ASSERT_TRUE(breaker.allow(1000));
+  breaker.failed(1000);
+  TEST_ASSERT_EQUAL_UINT32(2000, breaker.getBackoffMs());
+}
+
+static void test_controller_skips_bus_while_breaker_open() {
+  FakeUsbPdChip chip;
+  chip.present = false;
+  USBPDController ctrl(chip);
+  ctrl.begin();     // First failure
+  ctrl.sampleNow(); // Second
+  ctrl.sampleNow(); // Third opens it
+  const PdCircuitBreaker &breaker = ctrl.getBreaker();
+  TEST_ASSERT_EQUAL(PdBreakerState::Open, breaker.getState());
+  TEST_ASSERT_EQUAL_UINT32(1, breaker.getTrips());
+
+  // Open: no probe and no reconnect attempt
+  int probes = chip.probeCalls;
+  int begins = chip.beginCalls;
+  ctrl.sampleNow();
+  TEST_ASSERT_FALSE(ctrl.readPDConfig());
+  TEST_ASSERT_EQUAL(probes, chip.probeCalls);
+  TEST_ASSERT_EQUAL(begins, chip.beginCalls);
+  TEST_ASSERT_EQUAL_UINT32(2, breaker.getRejected());
+
+  // Configures fail fast and say when to come back
+  WebRequestCore req;
+  req.setBody("{\"voltage\":12,\"current\":2}");
+  WebResponseCore res;
+  ctrl.setPDConfigHandler(req, res);
+  TEST_ASSERT_EQUAL(503, res.getStatus());
+  DynamicJsonDocument doc(256);
+  TEST_ASSERT_FALSE(deserializeJson(doc, responseBody(res)));
+  TEST_ASSERT_EQUAL(USB_PD_BREAKER_BACKOFF_MS, doc["retryInMs"].as<uint32_t>());
+
+  // The trial after the backoff fails too: wait twice as long
+  When(Method(ArduinoFake(), millis)).AlwaysReturn(USB_PD_BREAKER_BACKOFF_MS);
+  ctrl.sampleNow();
+  TEST_ASSERT_EQUAL(probes + 1, chip.probeCalls);
+  TEST_ASSERT_EQUAL_UINT32(2 * USB_PD_BREAKER_BACKOFF_MS,
+                           breaker.getBackoffMs());
+
+  // Board back: the next trial closes the breaker
+  chip.present = true;
+  When(Method(ArduinoFake(), millis))
+      .AlwaysReturn(3 * USB_PD_BREAKER_BACKOFF_MS);
+  ctrl.sampleNow();
+  TEST_ASSERT_EQUAL(PdBreakerState::Closed, breaker.getState());
+  TEST_ASSERT_TRUE(ctrl.getSnapshot().connected);
+
+  WebResponseCore diag;
+  ctrl.diagnosticsHandler(req, diag);
+  DynamicJsonDocument diagDoc(2048);
+  TEST_ASSERT_FALSE(deserializeJson(diagDoc, responseBody(diag)));
+  TEST_ASSERT_EQUAL_STRING("closed",
+                           diagDoc["breaker"]["state"].as<const char *>());
+  TEST_ASSERT_EQUAL(1, diagDoc["breaker"]["trips"].as<int>());
+  TEST_ASSERT_EQUAL(2, diagDoc["breaker"]["rejected"].as<int>());
+}
+
+static void test_failed_register_reads_open_breaker() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  ctrl.begin();
+  TEST_ASSERT_TRUE(ctrl.getSnapshot().valid);
+  const PdCircuitBreaker &breaker = ctrl.getBreaker();
+
+  // A configure whose reads fail counts against the chip
+  chip.failReads = true;
+  TEST_ASSERT_FALSE(ctrl.setPDConfig(15.0f, 2.0f, PdWriteMode::Volatile));
+  TEST_ASSERT_EQUAL_UINT32(1, breaker.getConsecutiveFailures());
+
+  // So do samples where the probe answers but the register read does not
+  int probes = chip.probeCalls;
+  ctrl.sampleNow();
+  ctrl.sampleNow();
+  TEST_ASSERT_EQUAL(probes + 2, chip.probeCalls);
+  TEST_ASSERT_EQUAL(PdBreakerState::Open, breaker.getState());
+  TEST_ASSERT_EQUAL_UINT32(1, breaker.getTrips());
+  TEST_ASSERT_FALSE(ctrl.getSnapshot().valid);
+
+  // Reads back: the next trial closes it
+  chip.failReads = false;
+  When(Method(ArduinoFake(), millis)).AlwaysReturn(USB_PD_BREAKER_BACKOFF_MS);
+  ctrl.sampleNow();
+  TEST_ASSERT_EQUAL(PdBreakerState::Closed, breaker.getState());
+  TEST_ASSERT_TRUE(ctrl.getSnapshot().valid);
+}
+
+static void test_alert_sample_while_open_keeps_backoff() {
+  FakeUsbPdChip chip;
+  chip.present = false;
+  USBPDController ctrl(chip);
+  ctrl.begin();
+  ctrl.sampleNow();
+  ctrl.sampleNow();
+  const PdCircuitBreaker &breaker = ctrl.getBreaker();
+  TEST_ASSERT_EQUAL(PdBreakerState::Open, breaker.getState());
+
+  // An ALERT edge still reaches the bus, but its failure is not a trial
+  int probes = chip.probeCalls;
+  When(Method(ArduinoFake(), millis)).AlwaysReturn(100);
+  ctrl.notifyAlert();
+  ctrl.handle();
+  TEST_ASSERT_EQUAL(probes + 1, chip.probeCalls);
+  TEST_ASSERT_EQUAL(PdBreakerState::Open, breaker.getState());
+  TEST_ASSERT_EQUAL_UINT32(USB_PD_BREAKER_BACKOFF_MS, breaker.getBackoffMs());
+  TEST_ASSERT_EQUAL_UINT32(USB_PD_BREAKER_BACKOFF_MS - 100,
+                           breaker.msUntilRetry(100));
+}
+
+void register_usb_pd_breaker_tests() {
+  RUN_TEST(test_breaker_opens_after_consecutive_failures);
+  RUN_TEST(test_breaker_backs_off_between_trials);
+  RUN_TEST(test_breaker_backoff_only_grows_on_failed_trials);
+  RUN_TEST(test_controller_skips_bus_while_breaker_open);
+  RUN_TEST(test_failed_register_reads_open_breaker);
+  RUN_TEST(test_alert_sample_while_open_keeps_backoff);
+}
+
+#endif // NATIVE_PLATFORM
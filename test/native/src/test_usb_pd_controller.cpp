@@ -2,6 +2,7 @@
 
 #ifdef NATIVE_PLATFORM
 #include "fakes/fake_usb_pd_chip.h"
+#include "support/response_body.h"
 #include <ArduinoFake.h>
 #include <ArduinoJson.h>
 #include <interface/core/web_request_core.h>
@@ -9,6 +10,34 @@
 #include <usb_pd_controller.h>
 using namespace fakeit;
 
+// Drive handle() with an advancing clock until job id finishes
+static bool runConfigJob(USBPDController &ctrl, uint32_t id,
+                         unsigned long &now, PdConfigJob &job) {
+  When(Method(ArduinoFake(), millis)).AlwaysDo([&now]() { return now; });
+  for (int i = 0; i < 50; ++i) {
+    now += 20;
+    ctrl.handle();
+    if (ctrl.getConfigJob(id, job) && job.isFinished()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static uint32_t postConfigure(USBPDController &ctrl, const char *body) {
+  WebRequestCore req;
+  WebResponseCore res;
+  req.setBody(body);
+  ctrl.setPDConfigHandler(req, res);
+  TEST_ASSERT_EQUAL(202, res.getStatus());
+  StaticJsonDocument<256> doc;
+  auto err = deserializeJson(doc, responseBody(res));
+  TEST_ASSERT_FALSE(err);
+  TEST_ASSERT_TRUE(doc["success"].as<bool>());
+  TEST_ASSERT_EQUAL_STRING("pending", doc["state"].as<const char *>());
+  return doc["jobId"].as<uint32_t>();
+}
+
 static void test_module_metadata() {
   FakeUsbPdChip chip;
   USBPDController ctrl(chip);
@@ -98,18 +127,29 @@ static void test_setPDConfig_success_updates_cache() {
   TEST_ASSERT_FLOAT_WITHIN(0.001f, 2.0f, ctrl.getCurrentCurrent());
 }
 
-static void test_setPDConfig_calls_delay_on_success() {
+static void test_setPDConfig_waits_for_contract_not_fixed_delay() {
   FakeUsbPdChip chip;
   chip.present = true;
   USBPDController ctrl(chip);
-  
-  When(Method(ArduinoFake(), delay)).AlwaysReturn();
-  
   TEST_ASSERT_TRUE(ctrl.readPDConfig());
+
+  // Contract already in place on the first poll: no sleeping at all
   TEST_ASSERT_TRUE(ctrl.setPDConfig(9.0f, 1.5f));
-  
-  // Verify delay was called (line 227)
-  Verify(Method(ArduinoFake(), delay).Using(100)).Once();
+  Verify(Method(ArduinoFake(), delay)).Never();
+  TEST_ASSERT_TRUE(ctrl.getLastNegotiation().established);
+
+  // Renegotiation in flight: polls until the source accepts. The first
+  // read is the check of the old contract before the soft reset.
+  unsigned long now = 0;
+  When(Method(ArduinoFake(), millis)).AlwaysDo([&now]() { return now += 5; });
+  chip.negotiatingReads = 4;
+  int reads = chip.contractReads;
+  TEST_ASSERT_TRUE(ctrl.setPDConfig(12.0f, 1.5f));
+  TEST_ASSERT_EQUAL(reads + 5, chip.contractReads);
+  Verify(Method(ArduinoFake(), delay).Using(USB_PD_CONTRACT_POLL_MS))
+      .Exactly(3);
+  TEST_ASSERT_TRUE(ctrl.getLastNegotiation().established);
+  TEST_ASSERT_TRUE(ctrl.getLastNegotiation().elapsedMs > 0);
 }
 
 static void test_getAllPDOProfiles_behaviour() {
@@ -145,7 +185,7 @@ static void test_pdStatusHandler_builds_json() {
   WebResponseCore res;
   ctrl.pdStatusHandler(req, res);
   TEST_ASSERT_EQUAL_STRING("application/json", res.getMimeType().c_str());
-  auto content = res.getContent();
+  auto content = responseBody(res);
   StaticJsonDocument<256> doc;
   DeserializationError err = deserializeJson(doc, content);
   TEST_ASSERT_FALSE_MESSAGE(err, "JSON parse error");
@@ -168,7 +208,7 @@ static void test_parseConfig_updates_fields_via_test_helper() {
 
   TEST_ASSERT_EQUAL(21, ctrl.getSdaPin());
   TEST_ASSERT_EQUAL(22, ctrl.getSclPin());
-  TEST_ASSERT_EQUAL_STRING("sparkfun", ctrl.getBoardType().c_str());
+  TEST_ASSERT_EQUAL_STRING("sparkfun", ctrl.getBoardType());
   TEST_ASSERT_EQUAL_UINT8(0x29, ctrl.getI2cAddress());
 }
 
@@ -189,7 +229,7 @@ static void test_availableVoltagesHandler_lists_values() {
   WebResponseCore res;
   ctrl.availableVoltagesHandler(req, res);
   StaticJsonDocument<256> doc;
-  auto err = deserializeJson(doc, res.getContent());
+  auto err = deserializeJson(doc, responseBody(res));
   TEST_ASSERT_FALSE_MESSAGE(err, "Voltages JSON parse error");
   TEST_ASSERT_TRUE(doc.containsKey("voltages"));
   JsonArray arr = doc["voltages"].as<JsonArray>();
@@ -203,13 +243,269 @@ static void test_availableCurrentsHandler_lists_values() {
   WebResponseCore res;
   ctrl.availableCurrentsHandler(req, res);
   StaticJsonDocument<512> doc;
-  auto err = deserializeJson(doc, res.getContent());
+  auto err = deserializeJson(doc, responseBody(res));
   TEST_ASSERT_FALSE_MESSAGE(err, "Currents JSON parse error");
   TEST_ASSERT_TRUE(doc.containsKey("currents"));
   JsonArray arr = doc["currents"].as<JsonArray>();
   TEST_ASSERT_TRUE(arr.size() >= 9);
 }
 
+static void test_capabilitiesHandler_serves_table() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  WebRequestCore req;
+  WebResponseCore res;
+  ctrl.capabilitiesHandler(req, res);
+  TEST_ASSERT_EQUAL(200, res.getStatus());
+  TEST_ASSERT_TRUE(res.hasProgmemContent());
+  TEST_ASSERT_EQUAL_STRING("application/json", res.getMimeType().c_str());
+
+  DynamicJsonDocument doc(1024);
+  TEST_ASSERT_FALSE(deserializeJson(doc, responseBody(res)));
+  JsonArray voltages = doc["voltages"].as<JsonArray>();
+  JsonArray currents = doc["currents"].as<JsonArray>();
+  TEST_ASSERT_EQUAL(USB_PD_VOLTAGE_COUNT, voltages.size());
+  TEST_ASSERT_EQUAL(USB_PD_CURRENT_COUNT, currents.size());
+  for (size_t i = 0; i < USB_PD_VOLTAGE_COUNT; ++i) {
+    const PdVoltageCapability &cap = USB_PD_VOLTAGE_CAPABILITIES[i];
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, cap.millivolts / 1000.0f,
+                             voltages[i]["voltage"].as<float>());
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, cap.maxMilliamps / 1000.0f,
+                             voltages[i]["maxCurrent"].as<float>());
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.33f, currents[2].as<float>());
+}
+
+static void test_capability_bodies_come_from_one_table() {
+  // /api/voltages and /api/currents are the two halves of /api/capabilities
+  static_assert(USB_PD_VOLTAGES_JSON.length > 0, "generated at compile time");
+  TEST_ASSERT_EQUAL_STRING("{\"voltages\":[5,9,12,15,20]}",
+                           USB_PD_VOLTAGES_JSON.text);
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"currents\":[0.5,1,1.33,1.5,1.67,2,2.25,2.5,3]}",
+      USB_PD_CURRENTS_JSON.text);
+  TEST_ASSERT_NOT_NULL(strstr(USB_PD_CAPABILITIES_JSON.text,
+                              USB_PD_CURRENTS_JSON.text + 1));
+
+  // Strong validators: quoted, and different for different bodies
+  TEST_ASSERT_EQUAL(10, strlen(USB_PD_VOLTAGES_ETAG.text));
+  TEST_ASSERT_EQUAL('"', USB_PD_VOLTAGES_ETAG.text[0]);
+  TEST_ASSERT_EQUAL('"', USB_PD_VOLTAGES_ETAG.text[9]);
+  TEST_ASSERT_NOT_EQUAL(0, strcmp(USB_PD_VOLTAGES_ETAG.text,
+                                  USB_PD_CURRENTS_ETAG.text));
+}
+
+static void test_state_version_tracks_reported_state() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  ctrl.begin();
+  uint32_t connected = ctrl.getStateVersion();
+
+  // Samples that find nothing new keep the version (and the ETag)
+  char before[USB_PD_STATE_ETAG_LEN];
+  ctrl.getStateEtag(before, sizeof(before));
+  ctrl.sampleNow();
+  ctrl.sampleNow();
+  TEST_ASSERT_EQUAL(connected, ctrl.getStateVersion());
+  char after[USB_PD_STATE_ETAG_LEN];
+  ctrl.getStateEtag(after, sizeof(after));
+  TEST_ASSERT_EQUAL_STRING(before, after);
+
+  // A configure bumps it, even one that reapplies the same values
+  TEST_ASSERT_TRUE(ctrl.setPDConfig(15.0f, 2.0f, PdWriteMode::Volatile));
+  uint32_t configured = ctrl.getStateVersion();
+  TEST_ASSERT_TRUE(configured > connected);
+  TEST_ASSERT_TRUE(ctrl.setPDConfig(15.0f, 2.0f, PdWriteMode::Volatile));
+  TEST_ASSERT_TRUE(ctrl.getStateVersion() > configured);
+  configured = ctrl.getStateVersion();
+
+  // PDOs changed behind the controller's back
+  chip.volt[2] = 9.0f;
+  ctrl.sampleNow();
+  uint32_t changed = ctrl.getStateVersion();
+  TEST_ASSERT_TRUE(changed > configured);
+
+  // Disconnect and reconnect
+  chip.present = false;
+  ctrl.sampleNow();
+  TEST_ASSERT_TRUE(ctrl.getStateVersion() > changed);
+  uint32_t gone = ctrl.getStateVersion();
+  ctrl.sampleNow();
+  TEST_ASSERT_EQUAL(gone, ctrl.getStateVersion());
+  chip.present = true;
+  ctrl.sampleNow();
+  TEST_ASSERT_TRUE(ctrl.getStateVersion() > gone);
+}
+
+static void test_state_routes_carry_state_etag() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  ctrl.begin();
+
+  // No If-None-Match: full bodies
+  WebRequestCore req;
+  WebResponseCore status;
+  ctrl.pdStatusHandler(req, status);
+  TEST_ASSERT_EQUAL(200, status.getStatus());
+  TEST_ASSERT_TRUE(responseBody(status).length() > 0);
+  WebResponseCore profiles;
+  ctrl.pdoProfilesHandler(req, profiles);
+  TEST_ASSERT_EQUAL(200, profiles.getStatus());
+  TEST_ASSERT_TRUE(responseBody(profiles).length() > 0);
+
+  char etag[USB_PD_STATE_ETAG_LEN];
+  size_t len = ctrl.getStateEtag(etag, sizeof(etag));
+  TEST_ASSERT_EQUAL(strlen(etag), len);
+  TEST_ASSERT_TRUE(len < sizeof(etag));
+  TEST_ASSERT_EQUAL('"', etag[0]);
+  TEST_ASSERT_EQUAL('"', etag[len - 1]);
+}
+
+static void test_etag_matches_if_none_match_lists() {
+  const char *etag = "\"00000000-7\"";
+  TEST_ASSERT_TRUE(etagMatches("\"00000000-7\"", etag));
+  TEST_ASSERT_TRUE(etagMatches("*", etag));
+  TEST_ASSERT_TRUE(etagMatches("W/\"00000000-7\"", etag));
+  TEST_ASSERT_TRUE(etagMatches("\"a,b\", \"00000000-6\" ,\"00000000-7\"", etag));
+  TEST_ASSERT_FALSE(etagMatches("", etag));
+  TEST_ASSERT_FALSE(etagMatches("\"00000000-77\"", etag));
+  TEST_ASSERT_FALSE(etagMatches("\"00000000-6\", \"x\"", etag));
+  TEST_ASSERT_FALSE(etagMatches("00000000-7", etag));
+
+  char buf[USB_PD_STATE_ETAG_LEN];
+  formatStateEtag(buf, sizeof(buf), 0xFFFFFFFFu, 0xFFFFFFFFu);
+  TEST_ASSERT_EQUAL_STRING("\"ffffffff-4294967295\"", buf);
+}
+
+// /api/events body opens with the id of the state etag names (no quotes)
+static bool frameHasId(const char *frame, const char *etag) {
+  size_t len = strlen(etag) - 2;
+  return strncmp(frame, "{\"id\":\"", 7) == 0 &&
+         strncmp(frame + 7, etag + 1, len) == 0 && frame[7 + len] == '"';
+}
+
+// Nothing changed since: the id alone
+static bool frameIsIdle(const String &frame, const char *etag) {
+  return frameHasId(frame.c_str(), etag) &&
+         strcmp(frame.c_str() + strlen(etag) + 5, "\"}") == 0;
+}
+
+static void test_events_send_full_state_then_deltas() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  ctrl.begin();
+
+  // A new client gets the full state
+  char first[USB_PD_STATE_ETAG_LEN];
+  ctrl.getStateEtag(first, sizeof(first));
+  String frame = ctrl.getEventFrame("");
+  const char *full = frame.c_str();
+  TEST_ASSERT_TRUE(frameHasId(full, first));
+  TEST_ASSERT_NOT_NULL(strstr(full, ",\"status\":{"));
+  TEST_ASSERT_NOT_NULL(strstr(full, ",\"profiles\":{"));
+  TEST_ASSERT_EQUAL_STRING("}}", full + strlen(full) - 2);
+
+  // Up to date: the id alone, whether since is the ETag or the bare id
+  TEST_ASSERT_TRUE(frameIsIdle(ctrl.getEventFrame(first), first));
+  ctrl.sampleNow();
+  TEST_ASSERT_TRUE(frameIsIdle(ctrl.getEventFrame(first), first));
+  char bare[USB_PD_STATE_ETAG_LEN];
+  strncpy(bare, first + 1, sizeof(bare));
+  bare[strlen(bare) - 1] = '\0';
+  TEST_ASSERT_TRUE(frameIsIdle(ctrl.getEventFrame(bare), first));
+
+  // One version behind: only what changed
+  TEST_ASSERT_TRUE(ctrl.setPDConfig(15.0f, 2.0f, PdWriteMode::Volatile));
+  char second[USB_PD_STATE_ETAG_LEN];
+  ctrl.getStateEtag(second, sizeof(second));
+  String delta = ctrl.getEventFrame(first);
+  TEST_ASSERT_TRUE(frameHasId(delta.c_str(), second));
+  TEST_ASSERT_NOT_NULL(strstr(delta.c_str(), "\"status\":{"));
+  TEST_ASSERT_NOT_NULL(strstr(delta.c_str(), "\"profiles\":{"));
+
+  // Same values again: the version moves, the delta is the id alone
+  TEST_ASSERT_TRUE(ctrl.setPDConfig(15.0f, 2.0f, PdWriteMode::Volatile));
+  char third[USB_PD_STATE_ETAG_LEN];
+  ctrl.getStateEtag(third, sizeof(third));
+  TEST_ASSERT_TRUE(frameIsIdle(ctrl.getEventFrame(second), third));
+
+  // Further behind, or unknown (e.g. from before a reboot): full state
+  frame = ctrl.getEventFrame("");
+  TEST_ASSERT_EQUAL_STRING(frame.c_str(), ctrl.getEventFrame(first).c_str());
+  TEST_ASSERT_EQUAL_STRING(
+      frame.c_str(), ctrl.getEventFrame("\"ffffffff-1\"").c_str());
+  TEST_ASSERT_TRUE(frameHasId(frame.c_str(), third));
+
+  // A plain JSON poll, answered at once with a copy of the rendered body
+  WebRequestCore req;
+  WebResponseCore res;
+  ctrl.eventsHandler(req, res);
+  TEST_ASSERT_EQUAL(200, res.getStatus());
+  TEST_ASSERT_EQUAL_STRING("application/json", res.getMimeType().c_str());
+  TEST_ASSERT_EQUAL_STRING(frame.c_str(), responseBody(res).c_str());
+}
+
+static void test_snapshot_carries_state_of_one_version() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  ctrl.begin();
+  TEST_ASSERT_TRUE(ctrl.setPDConfig(15.0f, 2.0f, PdWriteMode::Volatile));
+
+  WebRequestCore req;
+  WebResponseCore res;
+  ctrl.snapshotHandler(req, res);
+  TEST_ASSERT_EQUAL(200, res.getStatus());
+  TEST_ASSERT_EQUAL_STRING("application/json", res.getMimeType().c_str());
+
+  // The same bodies /api/status and /api/profiles serve, plus capabilities
+  String body = responseBody(res);
+  WebResponseCore status;
+  ctrl.pdStatusHandler(req, status);
+  WebResponseCore profiles;
+  ctrl.pdoProfilesHandler(req, profiles);
+  TEST_ASSERT_NOT_EQUAL(-1, body.indexOf("\"status\":" + responseBody(status)));
+  TEST_ASSERT_NOT_EQUAL(-1,
+                        body.indexOf("\"profiles\":" + responseBody(profiles)));
+  TEST_ASSERT_NOT_EQUAL(
+      -1, body.indexOf(String("\"capabilities\":") +
+                       USB_PD_CAPABILITIES_JSON.text));
+
+  // version is the counter inside the ETag, which /api/events polls from
+  char etag[USB_PD_STATE_ETAG_LEN];
+  ctrl.getStateEtag(etag, sizeof(etag));
+  char version[24];
+  snprintf(version, sizeof(version), "\"version\":%lu,",
+           (unsigned long)ctrl.getStateVersion());
+  TEST_ASSERT_NOT_EQUAL(-1, body.indexOf(version));
+  TEST_ASSERT_TRUE(frameIsIdle(ctrl.getEventFrame(etag), etag));
+}
+
+static void test_events_report_disconnect() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  ctrl.begin();
+  char connected[USB_PD_STATE_ETAG_LEN];
+  ctrl.getStateEtag(connected, sizeof(connected));
+
+  chip.present = false;
+  ctrl.sampleNow();
+  String delta = ctrl.getEventFrame(connected);
+  TEST_ASSERT_NOT_NULL(strstr(delta.c_str(), "\"connected\":false"));
+  TEST_ASSERT_NOT_NULL(
+      strstr(delta.c_str(), "\"profiles\":{\"success\":false"));
+}
+
+static void test_setPDConfigHandler_accepts_table_limits() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  ctrl.begin();
+  char body[96];
+  snprintf(body, sizeof(body), "{\"voltage\":%g,\"current\":%g}",
+           usb_pd_caps::maxVoltage() / 1000.0,
+           usb_pd_caps::minCurrent() / 1000.0);
+  postConfigure(ctrl, body);
+}
+
 // ============================================================================
 // Additional coverage tests for begin() and initializeHardware()
 // ============================================================================
@@ -380,7 +676,7 @@ static void test_pdStatusHandler_json_fields_when_connected() {
   ctrl.pdStatusHandler(req, res);
   
   StaticJsonDocument<512> doc;
-  deserializeJson(doc, res.getContent());
+  deserializeJson(doc, responseBody(res));
   
   TEST_ASSERT_TRUE(doc.containsKey("success"));
   TEST_ASSERT_TRUE(doc.containsKey("connected"));
@@ -401,12 +697,15 @@ static void test_pdStatusHandler_reconnection_path() {
   
   TEST_ASSERT_FALSE(ctrl.isPdBoardConnected());
   
+  // Reconnection happens in the sampler; the handler reports its result
+  ctrl.sampleNow();
+  
   WebRequestCore req;
   WebResponseCore res;
   ctrl.pdStatusHandler(req, res);
   
   StaticJsonDocument<256> doc;
-  deserializeJson(doc, res.getContent());
+  deserializeJson(doc, responseBody(res));
   
   TEST_ASSERT_TRUE(doc["connected"].as<bool>());
   TEST_ASSERT_TRUE(doc["success"].as<bool>());
@@ -423,7 +722,7 @@ static void test_pdStatusHandler_disconnected_shows_message() {
   ctrl.pdStatusHandler(req, res);
   
   StaticJsonDocument<256> doc;
-  deserializeJson(doc, res.getContent());
+  deserializeJson(doc, responseBody(res));
   
   TEST_ASSERT_FALSE(doc["connected"].as<bool>());
   TEST_ASSERT_FALSE(doc["success"].as<bool>());
@@ -436,13 +735,14 @@ static void test_pdStatusHandler_connected_but_no_values() {
   chip.present = true;
   chip.volt[chip.getPdoNumber()] = 0.0f;
   USBPDController ctrl(chip);
+  ctrl.sampleNow();
   
   WebRequestCore req;
   WebResponseCore res;
   ctrl.pdStatusHandler(req, res);
   
   StaticJsonDocument<256> doc;
-  deserializeJson(doc, res.getContent());
+  deserializeJson(doc, responseBody(res));
   
   TEST_ASSERT_TRUE(doc["connected"].as<bool>());
   TEST_ASSERT_FALSE(doc["success"].as<bool>());
@@ -459,7 +759,7 @@ static void test_pdoProfilesHandler_disconnected_503() {
   ctrl.pdoProfilesHandler(req, res);
   TEST_ASSERT_EQUAL(503, res.getStatus());
   StaticJsonDocument<256> doc;
-  auto err = deserializeJson(doc, res.getContent());
+  auto err = deserializeJson(doc, responseBody(res));
   TEST_ASSERT_FALSE(err);
   TEST_ASSERT_FALSE(doc["success"].as<bool>());
   TEST_ASSERT_TRUE(doc["pdos"].is<JsonArray>());
@@ -474,7 +774,7 @@ static void test_pdoProfilesHandler_connected_lists_pdos() {
   WebResponseCore res;
   ctrl.pdoProfilesHandler(req, res);
   StaticJsonDocument<1024> doc;
-  auto err = deserializeJson(doc, res.getContent());
+  auto err = deserializeJson(doc, responseBody(res));
   TEST_ASSERT_FALSE(err);
   TEST_ASSERT_TRUE(doc.containsKey("pdos"));
   JsonArray pdos = doc["pdos"].as<JsonArray>();
@@ -499,7 +799,7 @@ static void test_pdoProfilesHandler_complete_profile_data() {
   WebResponseCore res;
   ctrl.pdoProfilesHandler(req, res);
   StaticJsonDocument<2048> doc;
-  auto err = deserializeJson(doc, res.getContent());
+  auto err = deserializeJson(doc, responseBody(res));
   TEST_ASSERT_FALSE(err);
   JsonArray pdos = doc["pdos"].as<JsonArray>();
   TEST_ASSERT_EQUAL(3, pdos.size());
@@ -592,21 +892,33 @@ static void test_setPDConfigHandler_not_connected_503() {
   TEST_ASSERT_EQUAL(503, res.getStatus());
 }
 
-static void test_setPDConfigHandler_success_200() {
+static void test_setPDConfigHandler_accepted_then_succeeds() {
   FakeUsbPdChip chip;
   chip.present = true;
   USBPDController ctrl(chip);
   TEST_ASSERT_TRUE(ctrl.readPDConfig());
-  WebRequestCore req;
+  uint32_t id = postConfigure(ctrl, "{\"voltage\":12,\"current\":2}");
+  TEST_ASSERT_TRUE(id > 0);
+
+  // Nothing touches the chip until handle() runs the job
+  TEST_ASSERT_EQUAL(1, chip.active);
+
+  unsigned long now = 0;
+  PdConfigJob job;
+  TEST_ASSERT_TRUE(runConfigJob(ctrl, id, now, job));
+
   WebResponseCore res;
-  req.setBody("{\"voltage\":12,\"current\":2}");
-  ctrl.setPDConfigHandler(req, res);
+  ctrl.configJobResponse(id, res);
   TEST_ASSERT_EQUAL(200, res.getStatus());
-  StaticJsonDocument<256> doc;
-  auto err = deserializeJson(doc, res.getContent());
+  StaticJsonDocument<512> doc;
+  auto err = deserializeJson(doc, responseBody(res));
   TEST_ASSERT_FALSE(err);
   TEST_ASSERT_TRUE(doc["success"].as<bool>());
+  TEST_ASSERT_EQUAL_STRING("succeeded", doc["state"].as<const char *>());
   TEST_ASSERT_EQUAL(12.0, doc["voltage"].as<double>());
+  TEST_ASSERT_TRUE(doc["contract"]["established"].as<bool>());
+  TEST_ASSERT_EQUAL(2, doc["contract"]["pdo"].as<int>());
+  TEST_ASSERT_TRUE(doc.containsKey("elapsedMs"));
 }
 
 static void test_setPDConfigHandler_parse_current_field() {
@@ -615,32 +927,34 @@ static void test_setPDConfigHandler_parse_current_field() {
   USBPDController ctrl(chip);
   TEST_ASSERT_TRUE(ctrl.readPDConfig());
   TEST_ASSERT_TRUE(ctrl.isPdBoardConnected());
-  WebRequestCore req;
-  WebResponseCore res;
-  req.setBody("{\"voltage\":9.0,\"current\":1.5}");
-  ctrl.setPDConfigHandler(req, res);
-  TEST_ASSERT_EQUAL(200, res.getStatus());
-  StaticJsonDocument<256> doc;
-  auto err = deserializeJson(doc, res.getContent());
-  TEST_ASSERT_FALSE(err);
-  TEST_ASSERT_TRUE(doc["success"].as<bool>());
-  TEST_ASSERT_EQUAL(1.5, doc["current"].as<double>());
+  uint32_t id = postConfigure(ctrl, "{\"voltage\":9.0,\"current\":1.5}");
+
+  unsigned long now = 0;
+  PdConfigJob job;
+  TEST_ASSERT_TRUE(runConfigJob(ctrl, id, now, job));
+  TEST_ASSERT_TRUE(job.state == PdConfigJobState::Succeeded);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.5f, job.resultCurrent);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.5f, ctrl.getSnapshot().current);
 }
 
-static void test_setPDConfigHandler_failure_returns_500() {
+static void test_setPDConfigHandler_failed_job_reports_error() {
   FakeUsbPdChip chip;
   chip.present = true;
   USBPDController ctrl(chip);
   TEST_ASSERT_TRUE(ctrl.readPDConfig());
   TEST_ASSERT_TRUE(ctrl.isPdBoardConnected());
   chip.simulateWriteFailure = true;
-  WebRequestCore req;
+  uint32_t id = postConfigure(ctrl, "{\"voltage\":12.0,\"current\":2.0}");
+
+  unsigned long now = 0;
+  PdConfigJob job;
+  TEST_ASSERT_TRUE(runConfigJob(ctrl, id, now, job));
+  TEST_ASSERT_TRUE(job.state == PdConfigJobState::Failed);
+
   WebResponseCore res;
-  req.setBody("{\"voltage\":12.0,\"current\":2.0}");
-  ctrl.setPDConfigHandler(req, res);
-  TEST_ASSERT_EQUAL(500, res.getStatus());
-  StaticJsonDocument<256> doc;
-  auto err = deserializeJson(doc, res.getContent());
+  ctrl.configJobResponse(id, res);
+  StaticJsonDocument<512> doc;
+  auto err = deserializeJson(doc, responseBody(res));
   TEST_ASSERT_FALSE(err);
   TEST_ASSERT_FALSE(doc["success"].as<bool>());
   TEST_ASSERT_TRUE(doc.containsKey("error"));
@@ -664,7 +978,7 @@ static void test_parseConfig_with_null_config() {
 
   TEST_ASSERT_EQUAL(4, ctrl.getSdaPin());
   TEST_ASSERT_EQUAL(5, ctrl.getSclPin());
-  TEST_ASSERT_EQUAL_STRING("sparkfun", ctrl.getBoardType().c_str());
+  TEST_ASSERT_EQUAL_STRING("sparkfun", ctrl.getBoardType());
 }
 
 static void test_parseConfig_with_all_fields() {
@@ -681,7 +995,7 @@ static void test_parseConfig_with_all_fields() {
 
   TEST_ASSERT_EQUAL(21, ctrl.getSdaPin());
   TEST_ASSERT_EQUAL(22, ctrl.getSclPin());
-  TEST_ASSERT_EQUAL_STRING("sparkfun", ctrl.getBoardType().c_str());
+  TEST_ASSERT_EQUAL_STRING("sparkfun", ctrl.getBoardType());
   TEST_ASSERT_EQUAL_UINT8(0x29, ctrl.getI2cAddress());
 }
 
@@ -694,7 +1008,7 @@ static void test_parseConfig_invalid_board_type_fallback() {
 
   ctrl.__test_applyConfig(doc.as<JsonVariant>());
 
-  TEST_ASSERT_EQUAL_STRING("sparkfun", ctrl.getBoardType().c_str());
+  TEST_ASSERT_EQUAL_STRING("sparkfun", ctrl.getBoardType());
 }
 
 static void test_parseConfig_only_SDA_pin() {
@@ -732,7 +1046,7 @@ static void test_parseConfig_only_board_type() {
 
   ctrl.__test_applyConfig(doc.as<JsonVariant>());
 
-  TEST_ASSERT_EQUAL_STRING("sparkfun", ctrl.getBoardType().c_str());
+  TEST_ASSERT_EQUAL_STRING("sparkfun", ctrl.getBoardType());
 }
 
 static void test_parseConfig_only_i2c_address() {
@@ -747,6 +1061,534 @@ static void test_parseConfig_only_i2c_address() {
   TEST_ASSERT_EQUAL_UINT8(0x28, ctrl.getI2cAddress());
 }
 
+// ============================================================================
+// Snapshot-backed GET handlers
+// ============================================================================
+
+static void test_get_handlers_do_not_touch_bus() {
+  FakeUsbPdChip chip;
+  chip.present = true;
+  USBPDController ctrl(chip);
+  ctrl.sampleNow();
+
+  int probes = chip.probeCalls;
+  int reads = chip.readCalls;
+
+  for (int i = 0; i < 5; ++i) {
+    WebRequestCore req;
+    WebResponseCore statusRes;
+    WebResponseCore profilesRes;
+    ctrl.pdStatusHandler(req, statusRes);
+    ctrl.pdoProfilesHandler(req, profilesRes);
+    TEST_ASSERT_EQUAL(200, profilesRes.getStatus());
+  }
+  ctrl.getAllPDOProfiles();
+
+  TEST_ASSERT_EQUAL(probes, chip.probeCalls);
+  TEST_ASSERT_EQUAL(reads, chip.readCalls);
+}
+
+static void test_sampleNow_publishes_new_version() {
+  FakeUsbPdChip chip;
+  chip.present = true;
+  USBPDController ctrl(chip);
+  TEST_ASSERT_EQUAL_UINT32(0, ctrl.getSnapshot().version);
+
+  ctrl.sampleNow();
+  PdSnapshot first = ctrl.getSnapshot();
+  TEST_ASSERT_TRUE(first.connected);
+  TEST_ASSERT_TRUE(first.valid);
+  TEST_ASSERT_EQUAL(chip.active, first.activePdo);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, chip.volt[3], first.pdoVoltage[3]);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, chip.amps[2], first.pdoCurrent[2]);
+
+  ctrl.sampleNow();
+  TEST_ASSERT_TRUE(ctrl.getSnapshot().version > first.version);
+}
+
+static void test_sampleNow_detects_disconnect() {
+  FakeUsbPdChip chip;
+  chip.present = true;
+  USBPDController ctrl(chip);
+  ctrl.sampleNow();
+  TEST_ASSERT_TRUE(ctrl.getSnapshot().connected);
+
+  chip.present = false;
+  ctrl.sampleNow();
+  PdSnapshot snapshot = ctrl.getSnapshot();
+  TEST_ASSERT_FALSE(snapshot.connected);
+  TEST_ASSERT_FALSE(snapshot.valid);
+  TEST_ASSERT_FALSE(ctrl.isPdBoardConnected());
+
+  // Profiles follow the snapshot, not a fresh probe
+  WebRequestCore req;
+  WebResponseCore res;
+  ctrl.pdoProfilesHandler(req, res);
+  TEST_ASSERT_EQUAL(503, res.getStatus());
+}
+
+static void test_parseConfig_poll_interval() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  TEST_ASSERT_EQUAL_UINT32(USB_PD_POLL_INTERVAL_MS, ctrl.getPollIntervalMs());
+
+  DynamicJsonDocument doc(64);
+  doc["pollIntervalMs"] = 250;
+  ctrl.__test_applyConfig(doc.as<JsonVariant>());
+
+  TEST_ASSERT_EQUAL_UINT32(250, ctrl.getPollIntervalMs());
+  TEST_ASSERT_FALSE(ctrl.isPollerRunning());
+}
+
+// ============================================================================
+// Adaptive polling
+// ============================================================================
+
+static void test_handle_polls_fast_after_connect_then_backs_off() {
+  FakeUsbPdChip chip;
+  chip.present = true;
+  USBPDController ctrl(chip);
+  unsigned long now = 0;
+  When(Method(ArduinoFake(), millis)).AlwaysDo([&now]() { return now; });
+  ctrl.begin();
+  TEST_ASSERT_TRUE(ctrl.isPdBoardConnected());
+  TEST_ASSERT_EQUAL_UINT32(USB_PD_POLL_FAST_MS, ctrl.nextWakeMs());
+
+  // Fast polls for the burst window
+  int probes = chip.probeCalls;
+  for (now = 0; now < USB_PD_POLL_BURST_MS; now += 10) {
+    ctrl.handle();
+  }
+  int burstProbes = chip.probeCalls - probes;
+  TEST_ASSERT_TRUE(burstProbes >= (int)(USB_PD_POLL_BURST_MS /
+                                        USB_PD_POLL_FAST_MS) - 1);
+
+  // Then each quiet poll doubles the wait, up to the handle() ceiling
+  uint32_t previous = 0;
+  for (int i = 0; i < 12; ++i) {
+    now += ctrl.nextWakeMs();
+    ctrl.handle();
+    uint32_t wait = ctrl.nextWakeMs();
+    TEST_ASSERT_TRUE(wait >= previous);
+    previous = wait;
+  }
+  TEST_ASSERT_EQUAL_UINT32(USB_PD_HANDLE_INTERVAL_MS, previous);
+
+  // A disconnect starts a new burst
+  chip.present = false;
+  now += previous;
+  ctrl.handle();
+  TEST_ASSERT_FALSE(ctrl.getSnapshot().connected);
+  TEST_ASSERT_EQUAL_UINT32(USB_PD_POLL_FAST_MS, ctrl.nextWakeMs());
+}
+
+static void test_nextWakeMs_reports_pending_work() {
+  FakeUsbPdChip chip;
+  chip.present = true;
+  USBPDController ctrl(chip);
+  DynamicJsonDocument config(64);
+  config["nvmCommitDelayMs"] = 100;
+  ctrl.__test_applyConfig(config.as<JsonVariant>());
+  TEST_ASSERT_TRUE(ctrl.readPDConfig());
+
+  unsigned long now = 0;
+  When(Method(ArduinoFake(), millis)).AlwaysDo([&now]() { return now; });
+  TEST_ASSERT_EQUAL_UINT32(USB_PD_HANDLE_INTERVAL_MS, ctrl.nextWakeMs());
+
+  // Queued job: call handle() straight away
+  uint32_t id = ctrl.submitPDConfig(9.0f, 1.5f, PdWriteMode::Volatile);
+  TEST_ASSERT_EQUAL_UINT32(0, ctrl.nextWakeMs());
+  PdConfigJob job;
+  TEST_ASSERT_TRUE(runConfigJob(ctrl, id, now, job));
+
+  // Pending NVM commit comes due before the next fast poll
+  TEST_ASSERT_TRUE(ctrl.isNvmCommitPending());
+  TEST_ASSERT_EQUAL_UINT32(100, ctrl.nextWakeMs());
+
+  ctrl.notifyAlert();
+  TEST_ASSERT_EQUAL_UINT32(0, ctrl.nextWakeMs());
+}
+
+static void test_parseConfig_poll_burst() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  DynamicJsonDocument doc(64);
+  doc["pollFastMs"] = 100;
+  doc["pollBurstMs"] = 2000;
+  ctrl.__test_applyConfig(doc.as<JsonVariant>());
+  TEST_ASSERT_EQUAL_UINT32(100, ctrl.getPollFastMs());
+  TEST_ASSERT_EQUAL_UINT32(2000, ctrl.getPollBurstMs());
+}
+
+// ============================================================================
+// ALERT pin
+// ============================================================================
+
+static void test_parseConfig_alert_pin() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  TEST_ASSERT_EQUAL(-1, ctrl.getAlertPin());
+
+  DynamicJsonDocument doc(64);
+  doc["alertPin"] = 7;
+  ctrl.__test_applyConfig(doc.as<JsonVariant>());
+  TEST_ASSERT_EQUAL(7, ctrl.getAlertPin());
+
+  // A running poller backs off to a safety net unless configured explicitly
+  USBPDController polled(chip);
+  DynamicJsonDocument config(64);
+  config["pollIntervalMs"] = 1000;
+  polled.__test_applyConfig(config.as<JsonVariant>());
+  doc.clear();
+  doc["alertPin"] = 7;
+  polled.__test_applyConfig(doc.as<JsonVariant>());
+  TEST_ASSERT_EQUAL_UINT32(USB_PD_ALERT_POLL_INTERVAL_MS,
+                           polled.getPollIntervalMs());
+}
+
+static void test_alert_samples_immediately() {
+  FakeUsbPdChip chip;
+  chip.present = true;
+  USBPDController ctrl(chip);
+  DynamicJsonDocument doc(64);
+  doc["alertPin"] = 7;
+  ctrl.__test_applyConfig(doc.as<JsonVariant>());
+  TEST_ASSERT_TRUE(ctrl.readPDConfig());
+  TEST_ASSERT_EQUAL(1, chip.alertEnables);
+
+  // Inside the polling interval nothing touches the bus
+  int probes = chip.probeCalls;
+  ctrl.handle();
+  TEST_ASSERT_EQUAL(probes, chip.probeCalls);
+
+  // Source unplugged: the ALERT edge is serviced on the next handle()
+  chip.present = false;
+  ctrl.notifyAlert();
+  ctrl.handle();
+  TEST_ASSERT_EQUAL(probes + 1, chip.probeCalls);
+  TEST_ASSERT_FALSE(ctrl.getSnapshot().connected);
+  TEST_ASSERT_EQUAL_UINT32(1, ctrl.getAlertsServiced());
+
+  // Plugged back in: re-armed after begin()
+  chip.present = true;
+  ctrl.notifyAlert();
+  ctrl.handle();
+  TEST_ASSERT_TRUE(ctrl.getSnapshot().connected);
+  TEST_ASSERT_EQUAL(2, chip.alertEnables);
+  TEST_ASSERT_TRUE(chip.alertClears >= 2);
+}
+
+static void test_alert_deferred_while_configuring() {
+  FakeUsbPdChip chip;
+  chip.present = true;
+  USBPDController ctrl(chip);
+  TEST_ASSERT_TRUE(ctrl.readPDConfig());
+
+  unsigned long now = 0;
+  When(Method(ArduinoFake(), millis)).AlwaysDo([&now]() { return now; });
+  uint32_t id = ctrl.submitPDConfig(12.0f, 1.5f);
+  ctrl.handle(); // Read
+  ctrl.notifyAlert();
+  ctrl.handle(); // Apply; alert left pending
+  TEST_ASSERT_EQUAL_UINT32(0, ctrl.getAlertsServiced());
+
+  PdConfigJob job;
+  TEST_ASSERT_TRUE(runConfigJob(ctrl, id, now, job));
+  ctrl.handle();
+  TEST_ASSERT_EQUAL_UINT32(1, ctrl.getAlertsServiced());
+}
+
+// ============================================================================
+// Async configure jobs
+// ============================================================================
+
+class CountingChip : public FakeUsbPdChip {
+public:
+  int writeCalls = 0;
+  int resetCalls = 0;
+  void write() override {
+    ++writeCalls;
+    FakeUsbPdChip::write();
+  }
+  void softReset() override {
+    ++resetCalls;
+    FakeUsbPdChip::softReset();
+  }
+};
+
+static void test_config_job_runs_one_step_per_handle() {
+  CountingChip chip;
+  chip.present = true;
+  USBPDController ctrl(chip);
+  TEST_ASSERT_TRUE(ctrl.readPDConfig());
+
+  unsigned long now = 0;
+  When(Method(ArduinoFake(), millis)).AlwaysDo([&now]() { return now; });
+  uint32_t id = ctrl.submitPDConfig(15.0f, 2.0f);
+  TEST_ASSERT_TRUE(id > 0);
+
+  int reads = chip.readCalls;
+  ctrl.handle(); // Read
+  TEST_ASSERT_EQUAL(reads + 1, chip.readCalls);
+  ctrl.handle(); // Apply
+  TEST_ASSERT_EQUAL(0, chip.writeCalls);
+  ctrl.handle(); // Write
+  TEST_ASSERT_EQUAL(1, chip.writeCalls);
+  TEST_ASSERT_EQUAL(0, chip.resetCalls);
+  ctrl.handle(); // Soft reset
+  TEST_ASSERT_EQUAL(1, chip.resetCalls);
+
+  // Each poll is one status read; the job waits for the new contract
+  chip.negotiatingReads = 2;
+  PdConfigJob job;
+  ctrl.handle();
+  ctrl.handle();
+  TEST_ASSERT_TRUE(ctrl.getConfigJob(id, job));
+  TEST_ASSERT_TRUE(job.state == PdConfigJobState::Running);
+  TEST_ASSERT_EQUAL(3, chip.contractReads); // Old contract, then two polls
+
+  ctrl.handle(); // Contract in place
+  ctrl.handle(); // Read back
+  TEST_ASSERT_TRUE(ctrl.getConfigJob(id, job));
+  TEST_ASSERT_TRUE(job.state == PdConfigJobState::Succeeded);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 15.0f, job.resultVoltage);
+  TEST_ASSERT_TRUE(job.negotiation.established);
+  TEST_ASSERT_EQUAL(3, job.negotiation.pdoNumber);
+}
+
+static void test_config_job_contract_timeout_still_reads_back() {
+  FakeUsbPdChip chip;
+  chip.present = true;
+  USBPDController ctrl(chip);
+  TEST_ASSERT_TRUE(ctrl.readPDConfig());
+
+  // Source never completes negotiation (e.g. not PD capable)
+  chip.contractState = PdContractState::Negotiating;
+  uint32_t id = ctrl.submitPDConfig(12.0f, 1.5f);
+  unsigned long now = 0;
+  When(Method(ArduinoFake(), millis)).AlwaysDo([&now]() { return now; });
+  PdConfigJob job;
+  for (int i = 0; i < 4; ++i) {
+    ctrl.handle(); // Read, Apply, Write, SoftReset
+  }
+  ctrl.handle();
+  TEST_ASSERT_TRUE(ctrl.getConfigJob(id, job));
+  TEST_ASSERT_TRUE(job.state == PdConfigJobState::Running);
+
+  now += USB_PD_CONTRACT_TIMEOUT_MS;
+  ctrl.handle(); // Gives up waiting
+  ctrl.handle(); // Read back
+  TEST_ASSERT_TRUE(ctrl.getConfigJob(id, job));
+  TEST_ASSERT_TRUE(job.state == PdConfigJobState::Succeeded);
+  TEST_ASSERT_FALSE(job.negotiation.established);
+  TEST_ASSERT_TRUE(job.negotiation.timedOut);
+}
+
+static void test_config_job_does_not_call_delay() {
+  FakeUsbPdChip chip;
+  chip.present = true;
+  USBPDController ctrl(chip);
+  TEST_ASSERT_TRUE(ctrl.readPDConfig());
+
+  uint32_t id = ctrl.submitPDConfig(9.0f, 1.0f);
+  unsigned long now = 0;
+  PdConfigJob job;
+  TEST_ASSERT_TRUE(runConfigJob(ctrl, id, now, job));
+  Verify(Method(ArduinoFake(), delay)).Never();
+}
+
+static void test_config_job_callback_invoked() {
+  FakeUsbPdChip chip;
+  chip.present = true;
+  USBPDController ctrl(chip);
+  TEST_ASSERT_TRUE(ctrl.readPDConfig());
+
+  uint32_t seen = 0;
+  ctrl.setConfigJobCallback([&seen](const PdConfigJob &job) {
+    if (job.state == PdConfigJobState::Succeeded) {
+      seen = job.id;
+    }
+  });
+  uint32_t id = ctrl.submitPDConfig(12.0f, 1.5f);
+  unsigned long now = 0;
+  PdConfigJob job;
+  TEST_ASSERT_TRUE(runConfigJob(ctrl, id, now, job));
+  TEST_ASSERT_EQUAL_UINT32(id, seen);
+}
+
+static void test_config_job_fails_when_disconnected() {
+  FakeUsbPdChip chip;
+  chip.present = false;
+  USBPDController ctrl(chip);
+
+  uint32_t id = ctrl.submitPDConfig(12.0f, 1.5f);
+  unsigned long now = 0;
+  PdConfigJob job;
+  TEST_ASSERT_TRUE(runConfigJob(ctrl, id, now, job));
+  TEST_ASSERT_TRUE(job.state == PdConfigJobState::Failed);
+  TEST_ASSERT_EQUAL_STRING("PD board not connected", job.error);
+}
+
+static void test_config_job_queue_full_returns_429() {
+  FakeUsbPdChip chip;
+  chip.present = true;
+  USBPDController ctrl(chip);
+  TEST_ASSERT_TRUE(ctrl.readPDConfig());
+
+  for (int i = 0; i < USB_PD_CONFIG_JOB_HISTORY; ++i) {
+    TEST_ASSERT_TRUE(ctrl.submitPDConfig(9.0f, 1.0f) > 0);
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, ctrl.submitPDConfig(9.0f, 1.0f));
+
+  WebRequestCore req;
+  WebResponseCore res;
+  req.setBody("{\"voltage\":9,\"current\":1}");
+  ctrl.setPDConfigHandler(req, res);
+  TEST_ASSERT_EQUAL(429, res.getStatus());
+}
+
+static void test_config_job_unknown_id_404() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  WebResponseCore res;
+  ctrl.configJobResponse(42, res);
+  TEST_ASSERT_EQUAL(404, res.getStatus());
+
+  PdConfigJob job;
+  TEST_ASSERT_FALSE(ctrl.getConfigJob(0, job));
+}
+
+static void test_sampleNow_skipped_while_configuring() {
+  FakeUsbPdChip chip;
+  chip.present = true;
+  USBPDController ctrl(chip);
+  TEST_ASSERT_TRUE(ctrl.readPDConfig());
+
+  unsigned long now = 0;
+  When(Method(ArduinoFake(), millis)).AlwaysDo([&now]() { return now; });
+  ctrl.submitPDConfig(12.0f, 1.5f);
+  ctrl.handle(); // Read
+  ctrl.handle(); // Apply
+
+  int probes = chip.probeCalls;
+  int reads = chip.readCalls;
+  ctrl.sampleNow();
+  TEST_ASSERT_EQUAL(probes, chip.probeCalls);
+  TEST_ASSERT_EQUAL(reads, chip.readCalls);
+}
+
+// ============================================================================
+// Volatile configure and deferred NVM commit
+// ============================================================================
+
+static void test_volatile_job_skips_nvm_write() {
+  CountingChip chip;
+  chip.present = true;
+  USBPDController ctrl(chip);
+  TEST_ASSERT_TRUE(ctrl.readPDConfig());
+
+  uint32_t id =
+      postConfigure(ctrl, "{\"voltage\":15,\"current\":2,\"mode\":\"volatile\"}");
+  unsigned long now = 0;
+  PdConfigJob job;
+  TEST_ASSERT_TRUE(runConfigJob(ctrl, id, now, job));
+  TEST_ASSERT_TRUE(job.state == PdConfigJobState::Succeeded);
+  TEST_ASSERT_TRUE(job.mode == PdWriteMode::Volatile);
+  TEST_ASSERT_EQUAL(1, chip.volatileWrites);
+  TEST_ASSERT_EQUAL(0, chip.writeCalls);
+  TEST_ASSERT_EQUAL(1, chip.resetCalls);
+
+  // No commit delay configured: stays out of NVM
+  TEST_ASSERT_TRUE(ctrl.isNvmCommitPending());
+  TEST_ASSERT_EQUAL_UINT32(1, ctrl.getNvmWritesAvoided());
+}
+
+static void test_volatile_burst_commits_once_after_quiet_period() {
+  CountingChip chip;
+  chip.present = true;
+  USBPDController ctrl(chip);
+  DynamicJsonDocument config(64);
+  config["nvmCommitDelayMs"] = 5000;
+  ctrl.__test_applyConfig(config.as<JsonVariant>());
+  TEST_ASSERT_TRUE(ctrl.readPDConfig());
+
+  unsigned long now = 0;
+  PdConfigJob job;
+  const float voltages[] = {9.0f, 12.0f, 15.0f};
+  for (float v : voltages) {
+    uint32_t id = ctrl.submitPDConfig(v, 1.5f, PdWriteMode::Volatile);
+    TEST_ASSERT_TRUE(runConfigJob(ctrl, id, now, job));
+    TEST_ASSERT_TRUE(job.state == PdConfigJobState::Succeeded);
+  }
+  TEST_ASSERT_EQUAL(0, chip.writeCalls);
+  TEST_ASSERT_EQUAL_UINT32(3, ctrl.getNvmWritesAvoided());
+
+  // Still inside the quiet period
+  now += 4000;
+  ctrl.handle();
+  TEST_ASSERT_EQUAL(0, chip.writeCalls);
+
+  now += 1000;
+  int resets = chip.resetCalls;
+  ctrl.handle();
+  TEST_ASSERT_EQUAL(1, chip.writeCalls);
+  TEST_ASSERT_EQUAL(resets, chip.resetCalls); // No renegotiation
+  TEST_ASSERT_FALSE(ctrl.isNvmCommitPending());
+  TEST_ASSERT_EQUAL_UINT32(2, ctrl.getNvmWritesAvoided());
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 15.0f, chip.getVoltage(chip.getPdoNumber()));
+
+  now += 10000;
+  ctrl.handle();
+  TEST_ASSERT_EQUAL(1, chip.writeCalls);
+}
+
+static void test_persistent_job_clears_pending_commit() {
+  FakeUsbPdChip chip;
+  chip.present = true;
+  USBPDController ctrl(chip);
+  TEST_ASSERT_TRUE(ctrl.readPDConfig());
+
+  unsigned long now = 0;
+  PdConfigJob job;
+  uint32_t id = ctrl.submitPDConfig(9.0f, 1.5f, PdWriteMode::Volatile);
+  TEST_ASSERT_TRUE(runConfigJob(ctrl, id, now, job));
+  TEST_ASSERT_TRUE(ctrl.isNvmCommitPending());
+
+  id = ctrl.submitPDConfig(12.0f, 1.5f);
+  TEST_ASSERT_TRUE(runConfigJob(ctrl, id, now, job));
+  TEST_ASSERT_FALSE(ctrl.isNvmCommitPending());
+}
+
+static void test_setPDConfigHandler_invalid_mode_400() {
+  FakeUsbPdChip chip;
+  chip.present = true;
+  USBPDController ctrl(chip);
+  TEST_ASSERT_TRUE(ctrl.readPDConfig());
+
+  WebRequestCore req;
+  WebResponseCore res;
+  req.setBody("{\"voltage\":9,\"current\":1,\"mode\":\"ram\"}");
+  ctrl.setPDConfigHandler(req, res);
+  TEST_ASSERT_EQUAL(400, res.getStatus());
+}
+
+static void test_diagnosticsHandler_reports_nvm_counters() {
+  FakeUsbPdChip chip;
+  chip.present = true;
+  USBPDController ctrl(chip);
+  TEST_ASSERT_TRUE(ctrl.readPDConfig());
+  TEST_ASSERT_TRUE(ctrl.setPDConfig(9.0f, 1.5f, PdWriteMode::Volatile));
+
+  WebRequestCore req;
+  WebResponseCore res;
+  ctrl.diagnosticsHandler(req, res);
+  StaticJsonDocument<512> doc;
+  auto err = deserializeJson(doc, responseBody(res));
+  TEST_ASSERT_FALSE(err);
+  TEST_ASSERT_EQUAL_UINT32(1, doc["nvm"]["writesAvoided"].as<uint32_t>());
+  TEST_ASSERT_TRUE(doc["nvm"]["commitPending"].as<bool>());
+}
+
 void register_usb_pd_controller_tests() {
   RUN_TEST(test_module_metadata);
   RUN_TEST(test_isPDBoardConnected_reflects_probe);
@@ -756,7 +1598,7 @@ void register_usb_pd_controller_tests() {
   RUN_TEST(test_readPDConfig_reconnects_when_disconnected);
   RUN_TEST(test_setPDConfig_requires_connection);
   RUN_TEST(test_setPDConfig_success_updates_cache);
-  RUN_TEST(test_setPDConfig_calls_delay_on_success);
+  RUN_TEST(test_setPDConfig_waits_for_contract_not_fixed_delay);
   RUN_TEST(test_getAllPDOProfiles_behaviour);
   RUN_TEST(test_routes_built_and_sizes);
   RUN_TEST(test_pdStatusHandler_builds_json);
@@ -764,6 +1606,15 @@ void register_usb_pd_controller_tests() {
   RUN_TEST(test_mainPageHandler_sets_progmem);
   RUN_TEST(test_availableVoltagesHandler_lists_values);
   RUN_TEST(test_availableCurrentsHandler_lists_values);
+  RUN_TEST(test_capabilitiesHandler_serves_table);
+  RUN_TEST(test_capability_bodies_come_from_one_table);
+  RUN_TEST(test_setPDConfigHandler_accepts_table_limits);
+  RUN_TEST(test_state_version_tracks_reported_state);
+  RUN_TEST(test_state_routes_carry_state_etag);
+  RUN_TEST(test_etag_matches_if_none_match_lists);
+  RUN_TEST(test_events_send_full_state_then_deltas);
+  RUN_TEST(test_events_report_disconnect);
+  RUN_TEST(test_snapshot_carries_state_of_one_version);
 
   // Additional coverage tests
   RUN_TEST(test_begin_calls_initializeHardware);
@@ -795,9 +1646,9 @@ void register_usb_pd_controller_tests() {
   RUN_TEST(test_setPDConfigHandler_current_too_low);
   RUN_TEST(test_setPDConfigHandler_current_too_high);
   RUN_TEST(test_setPDConfigHandler_not_connected_503);
-  RUN_TEST(test_setPDConfigHandler_success_200);
+  RUN_TEST(test_setPDConfigHandler_accepted_then_succeeds);
   RUN_TEST(test_setPDConfigHandler_parse_current_field);
-  RUN_TEST(test_setPDConfigHandler_failure_returns_500);
+  RUN_TEST(test_setPDConfigHandler_failed_job_reports_error);
   
   // parseConfig tests
   RUN_TEST(test_readPDConfig_when_disconnected_returns_false);
@@ -808,6 +1659,39 @@ void register_usb_pd_controller_tests() {
   RUN_TEST(test_parseConfig_only_SCL_pin);
   RUN_TEST(test_parseConfig_only_board_type);
   RUN_TEST(test_parseConfig_only_i2c_address);
+
+  // Snapshot-backed GET handlers
+  RUN_TEST(test_get_handlers_do_not_touch_bus);
+  RUN_TEST(test_sampleNow_publishes_new_version);
+  RUN_TEST(test_sampleNow_detects_disconnect);
+  RUN_TEST(test_parseConfig_poll_interval);
+
+  // Adaptive polling
+  RUN_TEST(test_handle_polls_fast_after_connect_then_backs_off);
+  RUN_TEST(test_nextWakeMs_reports_pending_work);
+  RUN_TEST(test_parseConfig_poll_burst);
+
+  // ALERT pin
+  RUN_TEST(test_parseConfig_alert_pin);
+  RUN_TEST(test_alert_samples_immediately);
+  RUN_TEST(test_alert_deferred_while_configuring);
+
+  // Async configure jobs
+  RUN_TEST(test_config_job_runs_one_step_per_handle);
+  RUN_TEST(test_config_job_contract_timeout_still_reads_back);
+  RUN_TEST(test_config_job_does_not_call_delay);
+  RUN_TEST(test_config_job_callback_invoked);
+  RUN_TEST(test_config_job_fails_when_disconnected);
+  RUN_TEST(test_config_job_queue_full_returns_429);
+  RUN_TEST(test_config_job_unknown_id_404);
+  RUN_TEST(test_sampleNow_skipped_while_configuring);
+
+  // Volatile configure and deferred NVM commit
+  RUN_TEST(test_volatile_job_skips_nvm_write);
+  RUN_TEST(test_volatile_burst_commits_once_after_quiet_period);
+  RUN_TEST(test_persistent_job_clears_pending_commit);
+  RUN_TEST(test_setPDConfigHandler_invalid_mode_400);
+  RUN_TEST(test_diagnosticsHandler_reports_nvm_counters);
 }
 
 #endif // NATIVE_PLATFORM
@@ -200,6 +200,7 @@ public:
   void softReset() override {
     // After soft reset, simulate that voltage/current read as zero
     volt[active] = 0.0f;
+    FakeUsbPdChip::softReset();
   }
 };
 
@@ -402,6 +403,201 @@ static void test_readConfig_succeeds_with_valid_values() {
   TEST_ASSERT_EQUAL(2, p);
 }
 
+// One bulk read serves the active PDO and the whole PDO table
+static void test_readConfig_reads_pdo_set_once() {
+  FakeUsbPdChip chip;
+  chip.active = 3;
+  USBPDCore core(chip);
+  float v, c;
+  int p;
+  TEST_ASSERT_TRUE(core.readConfig(v, c, p));
+
+  TEST_ASSERT_EQUAL(1, chip.readCalls);
+  const PdoSet &set = core.pdoSet();
+  TEST_ASSERT_EQUAL(3, set.activePdo);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 5.0f, set.voltage[1]);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 12.0f, set.voltage[2]);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 2.0f, set.current[2]);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 20.0f, v);
+}
+
+static void test_readConfig_fails_on_out_of_range_pdo() {
+  FakeUsbPdChip chip;
+  chip.active = 0;
+  USBPDCore core(chip);
+  float v, c;
+  int p;
+  TEST_ASSERT_FALSE(core.readConfig(v, c, p));
+}
+
+// Volatile mode applies through runtime registers only
+static void test_setConfig_volatile_uses_writeVolatile() {
+  FakeUsbPdChip chip;
+  USBPDCore core(chip);
+  TEST_ASSERT_TRUE(core.setConfig(15.0f, 2.0f, PdWriteMode::Volatile));
+  TEST_ASSERT_EQUAL(1, chip.volatileWrites);
+  TEST_ASSERT_EQUAL(3, chip.getPdoNumber());
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 15.0f, core.currentVoltage());
+
+  TEST_ASSERT_TRUE(core.setConfig(9.0f, 1.0f));
+  TEST_ASSERT_EQUAL(1, chip.volatileWrites);
+}
+
+// A restore writes the given PDOs as they are, strategy aside
+static void test_beginRestore_writes_set_as_given() {
+  FakeUsbPdChip chip;
+  USBPDCore core(chip);
+  PdoSet set;
+  set.activePdo = 2;
+  set.voltage[1] = 5.0f;
+  set.voltage[2] = 9.0f;
+  set.voltage[3] = 15.0f;
+  set.current[1] = 0.5f;
+  set.current[2] = 1.5f;
+  set.current[3] = 2.5f;
+
+  core.beginRestore(set, PdWriteMode::Volatile);
+  while (core.isConfiguring()) {
+    core.stepConfig();
+  }
+  TEST_ASSERT_TRUE(core.configStep() == PdConfigStep::Done);
+  TEST_ASSERT_EQUAL(1, chip.readCalls); // The read back, no read first
+  TEST_ASSERT_EQUAL(1, chip.volatileWrites);
+  TEST_ASSERT_TRUE(core.pdoSet() == set);
+}
+
+static uint32_t fakeClockMs = 0;
+static uint32_t fakeClock() { return fakeClockMs; }
+static void fakeSleep(uint32_t ms) { fakeClockMs += ms; }
+
+// An old contract on another PDO is not mistaken for the new one
+static void test_stepConfig_awaits_renegotiated_contract() {
+  FakeUsbPdChip chip;
+  USBPDCore core(chip);
+  fakeClockMs = 0;
+  core.setClock(fakeClock, fakeSleep);
+  chip.contractPdo = 1; // Contract from before the reset
+
+  core.beginConfig(15.0f, 2.0f);
+  while (core.configStep() != PdConfigStep::AwaitContract) {
+    core.stepConfig();
+  }
+  TEST_ASSERT_TRUE(core.stepConfig() == PdConfigStep::AwaitContract);
+
+  // Reset drops the contract, then the source falls back to PDO2
+  chip.negotiatingReads = 1;
+  chip.contractPdo = 2;
+  fakeClockMs += 30;
+  TEST_ASSERT_TRUE(core.stepConfig() == PdConfigStep::AwaitContract);
+  TEST_ASSERT_TRUE(core.stepConfig() == PdConfigStep::ReadBack);
+  TEST_ASSERT_TRUE(core.negotiation().established);
+  TEST_ASSERT_FALSE(core.negotiation().timedOut);
+  TEST_ASSERT_EQUAL(2, core.negotiation().pdoNumber);
+  TEST_ASSERT_EQUAL_UINT32(30, core.negotiation().elapsedMs);
+}
+
+// 9 V -> 12 V stays on PDO2: the old contract looks the same as the new one
+static void test_stepConfig_same_pdo_waits_for_renegotiation() {
+  FakeUsbPdChip chip;
+  USBPDCore core(chip);
+  fakeClockMs = 0;
+  core.setClock(fakeClock, fakeSleep);
+  chip.contractPdo = 2; // Same contract before and after the reset
+
+  core.beginConfig(12.0f, 1.5f);
+  while (core.configStep() != PdConfigStep::AwaitContract) {
+    core.stepConfig();
+  }
+  TEST_ASSERT_TRUE(core.stepConfig() == PdConfigStep::AwaitContract);
+  fakeClockMs += USB_PD_CONTRACT_SETTLE_MS - 1;
+  TEST_ASSERT_TRUE(core.stepConfig() == PdConfigStep::AwaitContract);
+  TEST_ASSERT_FALSE(core.negotiation().established);
+
+  // Nothing seen to change: taken as the new contract once settled
+  fakeClockMs += 1;
+  TEST_ASSERT_TRUE(core.stepConfig() == PdConfigStep::ReadBack);
+  TEST_ASSERT_TRUE(core.negotiation().established);
+  TEST_ASSERT_EQUAL_UINT32(USB_PD_CONTRACT_SETTLE_MS,
+                           core.negotiation().elapsedMs);
+
+  // A drop seen in between ends the wait as soon as the contract is back
+  core.beginConfig(9.0f, 1.5f);
+  while (core.configStep() != PdConfigStep::AwaitContract) {
+    core.stepConfig();
+  }
+  chip.negotiatingReads = 1;
+  fakeClockMs += 40;
+  TEST_ASSERT_TRUE(core.stepConfig() == PdConfigStep::AwaitContract);
+  TEST_ASSERT_TRUE(core.stepConfig() == PdConfigStep::ReadBack);
+  TEST_ASSERT_TRUE(core.negotiation().established);
+  TEST_ASSERT_EQUAL_UINT32(40, core.negotiation().elapsedMs);
+}
+
+static void test_waitForContract_times_out() {
+  FakeUsbPdChip chip;
+  USBPDCore core(chip);
+  fakeClockMs = 0;
+  core.setClock(fakeClock, fakeSleep);
+  chip.contractState = PdContractState::Detached;
+
+  TEST_ASSERT_FALSE(core.waitForContract(100));
+  TEST_ASSERT_TRUE(core.negotiation().timedOut);
+  TEST_ASSERT_TRUE(fakeClockMs >= 100);
+
+  // Without a clock the wait is a single poll
+  USBPDCore unclocked(chip);
+  int reads = chip.contractReads;
+  TEST_ASSERT_FALSE(unclocked.waitForContract(100));
+  TEST_ASSERT_EQUAL(reads + 1, chip.contractReads);
+}
+
+// Chip with only the required accessors; everything else is the
+// IUsbPdChip default
+class MinimalChip : public IUsbPdChip {
+public:
+  int active = 1;
+  float volt[4] = {0, 5.0f, 12.0f, 20.0f};
+  float amps[4] = {0, 1.0f, 2.0f, 3.0f};
+  int reads = 0;
+
+  bool probe(uint8_t) override { return true; }
+  bool begin() override { return true; }
+  void read() override { ++reads; }
+  int getPdoNumber() const override { return active; }
+  float getVoltage(int idx) const override { return volt[idx]; }
+  float getCurrent(int idx) const override { return amps[idx]; }
+  void setVoltage(int idx, float v) override { volt[idx] = v; }
+  void setCurrent(int idx, float a) override { amps[idx] = a; }
+  void setPdoNumber(int idx) override { active = idx; }
+  void write() override {}
+  void softReset() override {}
+  void writeVolatile() override {}
+  PdContract readContract() override {
+    PdContract contract;
+    contract.state = PdContractState::Ready;
+    contract.pdoNumber = active;
+    return contract;
+  }
+};
+
+static void test_minimal_chip_uses_interface_defaults() {
+  MinimalChip chip;
+  USBPDCore core(chip);
+  TEST_ASSERT_TRUE(core.setConfig(15.0f, 2.0f, PdWriteMode::Volatile));
+  TEST_ASSERT_EQUAL(3, chip.active);
+  TEST_ASSERT_EQUAL_FLOAT(15.0f, chip.volt[3]);
+  TEST_ASSERT_EQUAL_FLOAT(15.0f, core.currentVoltage());
+  TEST_ASSERT_TRUE(chip.reads > 0);
+
+  TEST_ASSERT_TRUE(chip.selectBus(0));
+  TEST_ASSERT_FALSE(chip.selectBus(1));
+  TEST_ASSERT_FALSE(chip.enableAttachAlert());
+  TEST_ASSERT_FALSE(chip.setBusClock(400000));
+  PdRegisterImage image;
+  TEST_ASSERT_FALSE(chip.readRegisterImage(image));
+  TEST_ASSERT_FALSE(chip.recoverBus(21, 22));
+}
+
 void register_usb_pd_core_tests() {
   // Positive path tests - setConfig
   RUN_TEST(test_set_5v_uses_pdo1_only);
@@ -437,6 +633,14 @@ void register_usb_pd_core_tests() {
   RUN_TEST(test_setConfig_voltage_below_5v_uses_pdo2);
   RUN_TEST(test_setConfig_voltage_above_12v_uses_pdo3);
   RUN_TEST(test_readConfig_succeeds_with_valid_values);
+  RUN_TEST(test_readConfig_reads_pdo_set_once);
+  RUN_TEST(test_readConfig_fails_on_out_of_range_pdo);
+  RUN_TEST(test_setConfig_volatile_uses_writeVolatile);
+  RUN_TEST(test_beginRestore_writes_set_as_given);
+  RUN_TEST(test_stepConfig_awaits_renegotiated_contract);
+  RUN_TEST(test_stepConfig_same_pdo_waits_for_renegotiation);
+  RUN_TEST(test_waitForContract_times_out);
+  RUN_TEST(test_minimal_chip_uses_interface_defaults);
 }
 
 #endif // NATIVE_PLATFORM
@@ -0,0 +1,422 @@
+#include <unity.h>
+
+#ifdef NATIVE_PLATFORM
+#include "fakes/fake_usb_pd_chip.h"
+#include "support/response_body.h"
+#include <ArduinoFake.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <usb_pd_controller.h>
+#include <usb_pd_i2c_bus.h>
+#include <vector>
+
+using namespace fakeit;
+
+// Each reading is 100 us after the previous one
+static std::atomic<uint32_t> busUs{0};
+static uint32_t steppingClock() { return busUs += 100; }
+
+static void waitForQueue(PdI2cBus &bus, size_t depth) {
+  while (bus.queueDepth() < depth) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+static void test_i2c_bus_grants_by_priority_then_order() {
+  PdI2cBus bus(steppingClock);
+  int holder = bus.addClient("holder");
+  int status = bus.addClient("status");
+  int alert = bus.addClient("alert");
+  int configure = bus.addClient("configure");
+  TEST_ASSERT_EQUAL(1, bus.addClient("status")); // Same name, same client
+
+  std::mutex orderMutex;
+  std::vector<int> order;
+  auto contend = [&](int client, PdI2cPriority priority) {
+    return std::thread([&, client, priority]() {
+      PdI2cBus::Grant grant(&bus, client, priority);
+      std::lock_guard<std::mutex> lock(orderMutex);
+      order.push_back(client);
+    });
+  };
+
+  bus.acquire(holder, PdI2cPriority::Status);
+  std::thread a = contend(status, PdI2cPriority::Status);
+  waitForQueue(bus, 1);
+  std::thread b = contend(alert, PdI2cPriority::Alert);
+  waitForQueue(bus, 2);
+  std::thread c = contend(configure, PdI2cPriority::Configure);
+  waitForQueue(bus, 3);
+  bus.release();
+  a.join();
+  b.join();
+  c.join();
+
+  TEST_ASSERT_EQUAL(3, order.size());
+  TEST_ASSERT_EQUAL(configure, order[0]);
+  TEST_ASSERT_EQUAL(alert, order[1]);
+  TEST_ASSERT_EQUAL(status, order[2]);
+  TEST_ASSERT_EQUAL(0, bus.queueDepth());
+  TEST_ASSERT_EQUAL(3, bus.maxQueueDepth());
+  // The last one waited for the two others as well
+  PdI2cClientStats last = bus.clientStats(status);
+  TEST_ASSERT_EQUAL(1, last.grants);
+  TEST_ASSERT_TRUE(last.maxWaitUs > bus.clientStats(configure).maxWaitUs);
+}
+
+static void test_i2c_bus_batches_nested_acquires_and_enforces_budget() {
+  PdI2cBus bus(steppingClock);
+  int client = bus.addClient("sampler", 150);
+  TEST_ASSERT_TRUE(bus.admit(client));
+
+  {
+    // One transaction of three operations
+    PdI2cBus::Grant batch(&bus, client, PdI2cPriority::Status);
+    PdI2cBus::Grant probe(&bus, client, PdI2cPriority::Status);
+    PdI2cBus::Grant read(&bus, client, PdI2cPriority::Alert);
+  }
+  PdI2cClientStats stats = bus.clientStats(client);
+  TEST_ASSERT_EQUAL(1, stats.grants);
+  TEST_ASSERT_EQUAL(2, stats.joined);
+  TEST_ASSERT_EQUAL(100, stats.busyUs); // One clock step, held once
+
+  // Under budget until the next transaction
+  TEST_ASSERT_TRUE(bus.admit(client));
+  { PdI2cBus::Grant again(&bus, client, PdI2cPriority::Status); }
+  TEST_ASSERT_FALSE(bus.admit(client));
+  TEST_ASSERT_EQUAL(1, bus.clientStats(client).deferred);
+
+  // Work that is not periodic still gets the bus
+  { PdI2cBus::Grant configure(&bus, client, PdI2cPriority::Configure); }
+  TEST_ASSERT_EQUAL(3, bus.clientStats(client).grants);
+
+  // A new window starts with nothing used
+  busUs += USB_PD_I2C_BUDGET_WINDOW_US;
+  TEST_ASSERT_TRUE(bus.admit(client));
+}
+
+static void test_controller_holds_bus_and_defers_samples_over_budget() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  PdI2cBus bus(steppingClock);
+  int other = bus.addClient("display");
+  ctrl.setI2cBus(&bus);
+  StaticJsonDocument<64> config;
+  config["i2cBudgetUs"] = 150;
+  ctrl.begin(config.as<JsonVariant>());
+
+  int client = bus.addClient("usb_pd.0");
+  TEST_ASSERT_EQUAL(client, chip.i2cClient);
+  TEST_ASSERT_EQUAL(150, bus.clientStats(client).budgetUs);
+  TEST_ASSERT_EQUAL(1, bus.clientStats(client).grants); // Initialization
+  ctrl.sampleNow(); // Not periodic, so not held to the budget
+  TEST_ASSERT_EQUAL(2, bus.clientStats(client).grants);
+
+  // The next periodic sample is skipped rather than exceeding the budget
+  int reads = chip.readCalls;
+  When(Method(ArduinoFake(), millis)).AlwaysReturn(10000000UL);
+  ctrl.handle();
+  TEST_ASSERT_EQUAL(reads, chip.readCalls);
+  TEST_ASSERT_EQUAL(2, bus.clientStats(client).grants);
+  TEST_ASSERT_EQUAL(1, bus.clientStats(client).deferred);
+  TEST_ASSERT_EQUAL(0, bus.clientStats(other).grants);
+
+  WebRequestCore req;
+  WebResponseCore res;
+  ctrl.diagnosticsHandler(req, res);
+  DynamicJsonDocument doc(1024);
+  TEST_ASSERT_FALSE(deserializeJson(doc, responseBody(res)));
+  JsonObject i2c = doc["i2c"];
+  TEST_ASSERT_EQUAL(0, i2c["queueDepth"].as<int>());
+  TEST_ASSERT_EQUAL(2, i2c["clients"].size());
+  TEST_ASSERT_EQUAL_STRING("usb_pd.0",
+                           i2c["clients"][1]["name"].as<const char *>());
+  TEST_ASSERT_EQUAL(1, i2c["clients"][1]["deferred"].as<int>());
+}
+
+static void test_i2c_clock_auto_keeps_fastest_clock_that_reads_back() {
+  FakeUsbPdChip chip;
+  chip.maxClockHz = 400000; // Corrupts reads at 1 MHz
+  USBPDController ctrl(chip);
+  PdI2cBus bus;
+  ctrl.setI2cBus(&bus);
+  ctrl.setI2cClockHz(USB_PD_I2C_CLOCK_AUTO);
+  uint32_t now = 0;
+  When(Method(ArduinoFake(), micros)).AlwaysDo([&]() { return now += 30; });
+  ctrl.begin();
+
+  TEST_ASSERT_EQUAL(400000, chip.busClockHz);
+  TEST_ASSERT_EQUAL(400000, ctrl.getI2cClockHz());
+  TEST_ASSERT_EQUAL(400000, bus.clockHz());
+  TEST_ASSERT_EQUAL(1, ctrl.getI2cClockFallbacks());
+  TEST_ASSERT_EQUAL(30, ctrl.getI2cReadUs());
+  // Reference, the checks at 400 kHz, the first at 1 MHz, the timed read
+  TEST_ASSERT_EQUAL(3 + USB_PD_I2C_CLOCK_CHECKS, chip.registerImageReads);
+
+  // A second chip on the bus could go faster, but not without the first
+  FakeUsbPdChip fastChip;
+  USBPDController fast(fastChip);
+  fast.setI2cBus(&bus);
+  fast.setI2cClockHz(USB_PD_I2C_CLOCK_AUTO);
+  fast.begin();
+  TEST_ASSERT_EQUAL(400000, fastChip.busClockHz);
+  TEST_ASSERT_EQUAL(0, fast.getI2cClockFallbacks());
+
+  WebRequestCore req;
+  WebResponseCore res;
+  ctrl.diagnosticsHandler(req, res);
+  DynamicJsonDocument doc(1024);
+  TEST_ASSERT_FALSE(deserializeJson(doc, responseBody(res)));
+  TEST_ASSERT_EQUAL(400000, doc["i2c"]["clockHz"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_STRING("auto", doc["i2c"]["clockMode"].as<const char *>());
+  TEST_ASSERT_EQUAL(30, doc["i2c"]["readUs"].as<int>());
+}
+
+static void test_i2c_clock_fixed_from_config() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  TEST_ASSERT_EQUAL(USB_PD_I2C_CLOCK_HZ, ctrl.getRequestedI2cClockHz());
+
+  StaticJsonDocument<64> config;
+  config["i2cClockHz"] = "auto";
+  ctrl.__test_applyConfig(config.as<JsonVariant>());
+  TEST_ASSERT_EQUAL(USB_PD_I2C_CLOCK_AUTO, ctrl.getRequestedI2cClockHz());
+  config["i2cClockHz"] = 250000; // Unsupported, ignored
+  ctrl.__test_applyConfig(config.as<JsonVariant>());
+  TEST_ASSERT_EQUAL(USB_PD_I2C_CLOCK_AUTO, ctrl.getRequestedI2cClockHz());
+
+  config["i2cClockHz"] = 1000000;
+  ctrl.begin(config.as<JsonVariant>());
+  TEST_ASSERT_EQUAL(1000000, chip.busClockHz);
+  TEST_ASSERT_EQUAL(1000000, ctrl.getI2cClockHz());
+  // Only the timed read; a fixed clock is not negotiated
+  TEST_ASSERT_EQUAL(1, chip.registerImageReads);
+}
+
+static void test_i2c_clock_fixed_capped_at_shared_bus_clock() {
+  // The bus runs at the slowest clock any client asked for
+  PdI2cBus arbiter;
+  int sensor = arbiter.addClient("sensor");
+  int display = arbiter.addClient("display");
+  TEST_ASSERT_EQUAL(0, arbiter.clockHz());
+  TEST_ASSERT_EQUAL(400000, arbiter.setClockHz(sensor, 400000));
+  TEST_ASSERT_EQUAL(400000, arbiter.setClockHz(display, 1000000));
+  TEST_ASSERT_EQUAL(1000000, arbiter.clientStats(display).clockHz);
+  TEST_ASSERT_EQUAL(100000, arbiter.setClockHz(display, 100000));
+  TEST_ASSERT_EQUAL(100000, arbiter.setClockHz(sensor, 1000000));
+
+  PdI2cBus bus;
+  FakeUsbPdChip slowChip;
+  slowChip.maxClockHz = 400000;
+  USBPDController slow(slowChip);
+  slow.setI2cBus(&bus);
+  slow.setI2cClockHz(USB_PD_I2C_CLOCK_AUTO);
+  slow.begin();
+  TEST_ASSERT_EQUAL(400000, bus.clockHz());
+
+  // A fixed clock above the bus clock is capped, and reported
+  FakeUsbPdChip fixedChip;
+  USBPDController fixed(fixedChip);
+  fixed.setI2cBus(&bus);
+  fixed.setI2cClockHz(1000000);
+  fixed.begin();
+  TEST_ASSERT_EQUAL(400000, fixedChip.busClockHz);
+  TEST_ASSERT_EQUAL(400000, fixed.getI2cClockHz());
+  TEST_ASSERT_EQUAL(400000, bus.clockHz());
+  TEST_ASSERT_TRUE(fixed.hasI2cClockConflict());
+  TEST_ASSERT_FALSE(slow.hasI2cClockConflict());
+
+  // A slower fixed clock brings the whole bus down
+  FakeUsbPdChip oldChip;
+  USBPDController old(oldChip);
+  old.setI2cBus(&bus);
+  old.setI2cClockHz(100000);
+  old.begin();
+  TEST_ASSERT_EQUAL(100000, bus.clockHz());
+  TEST_ASSERT_EQUAL(100000, slow.getI2cClockHz());
+  TEST_ASSERT_FALSE(old.hasI2cClockConflict());
+
+  WebRequestCore req;
+  WebResponseCore res;
+  fixed.diagnosticsHandler(req, res);
+  DynamicJsonDocument doc(1024);
+  TEST_ASSERT_FALSE(deserializeJson(doc, responseBody(res)));
+  TEST_ASSERT_EQUAL(100000, doc["i2c"]["clockHz"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_STRING("fixed",
+                           doc["i2c"]["clockMode"].as<const char *>());
+  TEST_ASSERT_TRUE(doc["i2c"]["clockConflict"].as<bool>());
+}
+
+static void test_stuck_bus_recovered_and_configuration_restored() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  ctrl.setI2cClockHz(400000);
+  ctrl.begin();
+  TEST_ASSERT_TRUE(ctrl.setPDConfig(15.0f, 2.0f, PdWriteMode::Volatile));
+  float voltage = ctrl.getCurrentVoltage();
+  float current = ctrl.getCurrentCurrent();
+  int active = chip.active;
+  std::array<float, 4> volt = chip.volt;
+  std::array<float, 4> amps = chip.amps;
+  int volatileWrites = chip.volatileWrites;
+  PdConfigJob recover;
+  PdConfigJob restore;
+  ctrl.setConfigJobCallback([&](const PdConfigJob &job) {
+    (job.kind == PdConfigJobKind::Recover ? recover : restore) = job;
+  });
+
+  // Brown-out mid transfer: SDA held low, PDOs back to their NVM values
+  chip.busStuck = true;
+  chip.active = 1;
+  chip.volt = {{0, 5.0f, 12.0f, 20.0f}};
+  chip.amps = {{0, 1.0f, 2.0f, 3.0f}};
+  for (unsigned long now = 1000; now < 1750; now += 250) {
+    When(Method(ArduinoFake(), millis)).AlwaysReturn(now);
+    ctrl.sampleNow();
+  }
+
+  // The third failure queues the recovery; no sample clocks the bus itself
+  TEST_ASSERT_EQUAL(0, chip.busRecoveries);
+  TEST_ASSERT_EQUAL_UINT32(0, ctrl.nextWakeMs());
+  When(Method(ArduinoFake(), millis)).AlwaysReturn(1500);
+  ctrl.handle();
+  TEST_ASSERT_EQUAL(1, chip.busRecoveries);
+  TEST_ASSERT_TRUE(recover.state == PdConfigJobState::Succeeded);
+  TEST_ASSERT_EQUAL(4, chip.recoverySda);
+  TEST_ASSERT_EQUAL(5, chip.recoveryScl);
+  TEST_ASSERT_TRUE(ctrl.getSnapshot().connected);
+  TEST_ASSERT_EQUAL(PdBreakerState::Closed, ctrl.getBreaker().getState());
+
+  // Then every PDO last applied goes back, in the mode it was applied in
+  TEST_ASSERT_EQUAL(volatileWrites, chip.volatileWrites);
+  for (unsigned long now = 1520; now < 2520 && restore.id == 0; now += 20) {
+    When(Method(ArduinoFake(), millis)).AlwaysReturn(now);
+    ctrl.handle();
+  }
+  TEST_ASSERT_TRUE(restore.state == PdConfigJobState::Succeeded);
+  TEST_ASSERT_TRUE(restore.mode == PdWriteMode::Volatile);
+  TEST_ASSERT_EQUAL(volatileWrites + 1, chip.volatileWrites);
+  TEST_ASSERT_EQUAL(active, chip.active);
+  for (int i = 1; i <= 3; ++i) {
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, volt[i], chip.volt[i]);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, amps[i], chip.amps[i]);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, voltage, ctrl.getCurrentVoltage());
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, current, ctrl.getCurrentCurrent());
+  // Counted as a volatile apply like any other
+  TEST_ASSERT_EQUAL_UINT32(2, ctrl.getNvmWritesAvoided());
+  TEST_ASSERT_EQUAL(400000, chip.busClockHz); // Restored after Wire.begin
+  TEST_ASSERT_EQUAL(1, ctrl.getI2cRecoveries());
+  TEST_ASSERT_EQUAL(500, ctrl.getLastRecoveryMs()); // First failure to back
+
+  // A board that is really gone is not brought back
+  chip.present = false;
+  ctrl.setI2cRecoveryFailures(1);
+  ctrl.sampleNow();
+  ctrl.handle();
+  TEST_ASSERT_TRUE(recover.state == PdConfigJobState::Failed);
+  TEST_ASSERT_EQUAL(2, ctrl.getI2cRecoveryAttempts());
+  TEST_ASSERT_EQUAL(1, ctrl.getI2cRecoveries());
+  TEST_ASSERT_FALSE(ctrl.getSnapshot().connected);
+
+  WebRequestCore req;
+  WebResponseCore res;
+  ctrl.diagnosticsHandler(req, res);
+  DynamicJsonDocument doc(1024);
+  TEST_ASSERT_FALSE(deserializeJson(doc, responseBody(res)));
+  JsonObject recovery = doc["i2c"]["recovery"];
+  TEST_ASSERT_EQUAL(2, recovery["attempts"].as<int>());
+  TEST_ASSERT_EQUAL(1, recovery["recovered"].as<int>());
+  TEST_ASSERT_EQUAL(500, recovery["meanMs"].as<int>());
+}
+
+static void test_recovery_restarts_shared_bus_at_bus_clock() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  FakeUsbPdChip *slow = nullptr;
+  ctrl.setPortChipFactory([&slow](size_t) {
+    slow = new FakeUsbPdChip();
+    slow->maxClockHz = 400000; // Corrupts reads at 1 MHz
+    return std::unique_ptr<IUsbPdChip>(slow);
+  });
+
+  // Port 0 asks for 1 MHz; port 1 on the same bus only keeps up at 400 kHz
+  DynamicJsonDocument config(512);
+  config["i2cClockHz"] = 1000000;
+  JsonArray ports = config.createNestedArray("ports");
+  ports.createNestedObject();
+  JsonObject second = ports.createNestedObject();
+  second["i2cAddress"] = 0x29;
+  second["i2cClockHz"] = "auto";
+  ctrl.__test_applyConfig(config.as<JsonVariant>());
+  PdI2cBus bus;
+  ctrl.setI2cBus(&bus, 0);
+  ctrl.setI2cBus(&bus, 1);
+  ctrl.begin();
+  TEST_ASSERT_NOT_NULL(slow);
+  TEST_ASSERT_EQUAL(400000, slow->busClockHz);
+  TEST_ASSERT_EQUAL(400000, ctrl.getI2cClockHz());
+
+  // Port 0's recovery restarts Wire at the bus clock, not at its own
+  chip.busStuck = true;
+  for (unsigned long now = 1000; now < 1750; now += 250) {
+    When(Method(ArduinoFake(), millis)).AlwaysReturn(now);
+    ctrl.sampleNow();
+  }
+  ctrl.handle();
+  TEST_ASSERT_EQUAL(1, chip.busRecoveries);
+  TEST_ASSERT_EQUAL(1, ctrl.getI2cRecoveries());
+  TEST_ASSERT_EQUAL(400000, chip.busClockHz);
+}
+
+static void test_ports_on_one_bus_have_their_own_clients() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  FakeUsbPdChip *second = nullptr;
+  ctrl.setPortChipFactory([&second](size_t) {
+    second = new FakeUsbPdChip();
+    return std::unique_ptr<IUsbPdChip>(second);
+  });
+  DynamicJsonDocument config(256);
+  config["i2cBudgetUs"] = 150;
+  JsonArray ports = config.createNestedArray("ports");
+  ports.createNestedObject();
+  ports.createNestedObject()["i2cAddress"] = 0x29;
+  ctrl.__test_applyConfig(config.as<JsonVariant>());
+  PdI2cBus bus;
+  ctrl.setI2cBus(&bus, 0);
+  ctrl.setI2cBus(&bus, 1);
+  ctrl.begin();
+
+  // Names are copied, so a caller may build them on the stack
+  char name[USB_PD_I2C_CLIENT_NAME_LEN];
+  snprintf(name, sizeof(name), "usb_pd.%d", 1);
+  TEST_ASSERT_EQUAL(2, bus.clientCount());
+  TEST_ASSERT_EQUAL(0, bus.addClient("usb_pd.0"));
+  TEST_ASSERT_EQUAL(1, bus.addClient(name));
+  TEST_ASSERT_NOT_NULL(second);
+  TEST_ASSERT_EQUAL(0, chip.i2cClient);
+  TEST_ASSERT_EQUAL(1, second->i2cClient);
+
+  // Each port books its own bus time against its own budget
+  ctrl.sampleNow(1);
+  TEST_ASSERT_EQUAL(150, bus.clientStats(0).budgetUs);
+  TEST_ASSERT_EQUAL(150, bus.clientStats(1).budgetUs);
+  TEST_ASSERT_TRUE(bus.clientStats(1).grants > bus.clientStats(0).grants);
+}
+
+void register_usb_pd_i2c_bus_tests() {
+  RUN_TEST(test_i2c_bus_grants_by_priority_then_order);
+  RUN_TEST(test_i2c_bus_batches_nested_acquires_and_enforces_budget);
+  RUN_TEST(test_controller_holds_bus_and_defers_samples_over_budget);
+  RUN_TEST(test_i2c_clock_auto_keeps_fastest_clock_that_reads_back);
+  RUN_TEST(test_i2c_clock_fixed_from_config);
+  RUN_TEST(test_i2c_clock_fixed_capped_at_shared_bus_clock);
+  RUN_TEST(test_stuck_bus_recovered_and_configuration_restored);
+  RUN_TEST(test_recovery_restarts_shared_bus_at_bus_clock);
+  RUN_TEST(test_ports_on_one_bus_have_their_own_clients);
+}
+
+#endif // NATIVE_PLATFORM
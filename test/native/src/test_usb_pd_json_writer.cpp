@@ -0,0 +1,153 @@
+#include <unity.h>
+
+#ifdef NATIVE_PLATFORM
+#include "support/alloc_counter.h"
+#include <ArduinoJson.h>
+#include <math.h>
+#include <string.h>
+#include <usb_pd_core.h>
+#include <usb_pd_json_writer.h>
+
+// Records every chunk it is handed
+class ChunkSink : public PdJsonSink {
+public:
+  bool write(const char *data, size_t len) override {
+    TEST_ASSERT_EQUAL('\0', data[len]);
+    TEST_ASSERT_TRUE(len <= USB_PD_JSON_CHUNK_LEN);
+    text += data;
+    ++chunks;
+    return true;
+  }
+
+  String text;
+  int chunks = 0;
+};
+
+static void test_writer_places_commas_and_nesting() {
+  ChunkSink sink;
+  {
+    PdJsonWriter json(sink);
+    json.beginObject()
+        .member("a", 1)
+        .key("list")
+        .beginArray()
+        .value(true)
+        .beginObject()
+        .endObject()
+        .beginArray()
+        .endArray()
+        .value(-7L)
+        .endArray()
+        .member("b", 4000000000UL)
+        .key("none")
+        .null()
+        .endObject();
+  }
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"a\":1,\"list\":[true,{},[],-7],\"b\":4000000000,\"none\":null}",
+      sink.text.c_str());
+}
+
+static void test_writer_escapes_strings_and_non_finite_numbers() {
+  ChunkSink sink;
+  {
+    PdJsonWriter json(sink);
+    json.beginArray()
+        .value("say \"hi\"\\\n")
+        .value(NAN)
+        .value(INFINITY)
+        .value(1.33f)
+        .value(20.05f)
+        .endArray();
+  }
+  TEST_ASSERT_EQUAL_STRING("[\"say \\\"hi\\\"\\\\\\u000a\",null,null,1.33,20.05]",
+                           sink.text.c_str());
+}
+
+static void test_writer_streams_in_bounded_chunks() {
+  char longText[300];
+  memset(longText, 'x', sizeof(longText) - 1);
+  longText[sizeof(longText) - 1] = '\0';
+
+  ChunkSink sink;
+  PdJsonWriter json(sink);
+  json.beginObject().member("text", (const char *)longText).endObject();
+  TEST_ASSERT_TRUE(json.flush());
+
+  TEST_ASSERT_EQUAL(sizeof(longText) - 1 + 11, json.length());
+  TEST_ASSERT_EQUAL(json.length(), sink.text.length());
+  TEST_ASSERT_TRUE(sink.chunks >= 5);
+}
+
+static void test_buffer_sink_never_truncates() {
+  float v[4] = {0.0f, 5.0f, 12.0f, 20.0f};
+  float c[4] = {0.0f, 3.0f, 3.0f, 5.0f};
+
+  char big[USB_PD_PROFILES_JSON_LEN];
+  size_t len = formatPdoProfilesJson(big, sizeof(big), 3, v, c);
+  TEST_ASSERT_EQUAL(strlen(big), len);
+
+  // Too small by one: nothing rather than a JSON prefix, and the length
+  // that would have fitted
+  char small[USB_PD_PROFILES_JSON_LEN];
+  TEST_ASSERT_EQUAL(len, formatPdoProfilesJson(small, len, 3, v, c));
+  TEST_ASSERT_EQUAL_STRING("", small);
+  TEST_ASSERT_EQUAL(len, formatPdoProfilesJson(small, len + 1, 3, v, c));
+  TEST_ASSERT_EQUAL_STRING(big, small);
+}
+
+static void test_profiles_json_fits_worst_case_buffer() {
+  // Widest numbers %.6g prints
+  float v[4] = {0.0f, -1.17549e-38f, -3.40282e+38f, -1.23457e-30f};
+  float c[4] = {0.0f, -1.17549e-38f, -1.17549e-38f, -1.17549e-38f};
+  char buf[USB_PD_PROFILES_JSON_LEN];
+  size_t len = formatPdoProfilesJson(buf, sizeof(buf), -2147483647 - 1, v, c);
+  TEST_ASSERT_TRUE(len < sizeof(buf));
+  TEST_ASSERT_EQUAL(len, strlen(buf));
+}
+
+static void test_profiles_writer_scales_past_three_pdos() {
+  // Extended sources advertise up to 7 PDOs; a String sink has no limit
+  float v[8];
+  float c[8];
+  for (int i = 0; i < 8; ++i) {
+    v[i] = 5.0f + 2.5f * i;
+    c[i] = 3.0f;
+  }
+  String out;
+  PdStringSink sink(out);
+  {
+    PdJsonWriter json(sink);
+    writePdoProfilesJson(json, 6, v, c, 7);
+  }
+  TEST_ASSERT_TRUE(out.length() > USB_PD_PROFILES_JSON_LEN);
+
+  DynamicJsonDocument doc(2048);
+  TEST_ASSERT_FALSE(deserializeJson(doc, out));
+  TEST_ASSERT_EQUAL(7, doc["pdos"].size());
+  TEST_ASSERT_EQUAL(6, doc["activePDO"].as<int>());
+  TEST_ASSERT_TRUE(doc["pdos"][5]["active"].as<bool>());
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 20.0f, doc["pdos"][6]["voltage"].as<float>());
+}
+
+static void test_profiles_writer_into_buffer_does_not_allocate() {
+  float v[4] = {0.0f, 5.0f, 12.0f, 20.0f};
+  float c[4] = {0.0f, 3.0f, 3.0f, 5.0f};
+  char buf[USB_PD_PROFILES_JSON_LEN];
+  AllocStats call = trackAllocs("formatPdoProfilesJson(buf)", [&]() {
+    formatPdoProfilesJson(buf, sizeof(buf), 2, v, c);
+  });
+  TEST_ASSERT_EQUAL(0, call.allocations);
+}
+
+void register_usb_pd_json_writer_tests() {
+  RUN_TEST(test_writer_places_commas_and_nesting);
+  RUN_TEST(test_writer_escapes_strings_and_non_finite_numbers);
+  RUN_TEST(test_writer_streams_in_bounded_chunks);
+  RUN_TEST(test_buffer_sink_never_truncates);
+  RUN_TEST(test_profiles_json_fits_worst_case_buffer);
+  RUN_TEST(test_profiles_writer_scales_past_three_pdos);
+  RUN_TEST(test_profiles_writer_into_buffer_does_not_allocate);
+}
+
+#endif // NATIVE_PLATFORM
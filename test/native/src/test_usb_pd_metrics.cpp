@@ -0,0 +1,190 @@
+#include <unity.h>
+
+#ifdef NATIVE_PLATFORM
+#include "fakes/fake_usb_pd_chip.h"
+#include "support/response_body.h"
+#include <ArduinoFake.h>
+#include <string>
+#include <usb_pd_controller.h>
+#include <usb_pd_instrumented_chip.h>
+#include <usb_pd_metrics.h>
+
+using namespace fakeit;
+
+// Every reading is 150 us after the previous one, so each timed operation
+// takes exactly that long
+static uint32_t fakeUs = 0;
+static uint32_t steppingClock() { return fakeUs += 150; }
+
+static std::string exposition(void (*write)(PdPrometheusWriter &)) {
+  String text;
+  PdStringSink sink(text);
+  PdPrometheusWriter out(sink);
+  write(out);
+  return text.c_str();
+}
+
+static bool hasLine(const std::string &text, const std::string &line) {
+  return text.find(line + "\n") != std::string::npos;
+}
+
+static void test_histogram_exports_cumulative_buckets() {
+  static PdHistogram h;
+  h.observe(80);      // First bucket
+  h.observe(100);     // Bounds are inclusive
+  h.observe(3000);    // 5 ms
+  h.observe(2000000); // Past the last bound
+  TEST_ASSERT_EQUAL(4, h.count());
+  TEST_ASSERT_EQUAL(2003180, h.sumMicros());
+
+  std::string text = exposition([](PdPrometheusWriter &out) {
+    out.family("t_seconds", "histogram", "Test");
+    out.histogram("t_seconds", "op=\"x\"", h);
+    out.counter("t_total", "", 7);
+  });
+  TEST_ASSERT_TRUE(hasLine(text, "# HELP t_seconds Test"));
+  TEST_ASSERT_TRUE(hasLine(text, "# TYPE t_seconds histogram"));
+  TEST_ASSERT_TRUE(hasLine(
+      text, "t_seconds_bucket{op=\"x\",le=\"0.0001\"} 2"));
+  TEST_ASSERT_TRUE(hasLine(
+      text, "t_seconds_bucket{op=\"x\",le=\"0.0025\"} 2"));
+  TEST_ASSERT_TRUE(hasLine(
+      text, "t_seconds_bucket{op=\"x\",le=\"0.005\"} 3"));
+  TEST_ASSERT_TRUE(hasLine(
+      text, "t_seconds_bucket{op=\"x\",le=\"1\"} 3"));
+  TEST_ASSERT_TRUE(hasLine(
+      text, "t_seconds_bucket{op=\"x\",le=\"+Inf\"} 4"));
+  TEST_ASSERT_TRUE(hasLine(text, "t_seconds_sum{op=\"x\"} 2.003180"));
+  TEST_ASSERT_TRUE(hasLine(text, "t_seconds_count{op=\"x\"} 4"));
+  TEST_ASSERT_TRUE(hasLine(text, "t_total 7"));
+}
+
+static void test_route_slots_are_shared_by_route_and_method() {
+  PdRouteMetrics routes;
+  PdRouteMetrics::Slot *status = routes.slot("/api/status");
+  TEST_ASSERT_NOT_NULL(status);
+  TEST_ASSERT_EQUAL_PTR(status, routes.slot("/api/status", "GET"));
+  TEST_ASSERT_NOT_EQUAL(status, routes.slot("/api/profiles"));
+  TEST_ASSERT_NOT_EQUAL(status, routes.slot("/api/status", "POST"));
+  TEST_ASSERT_EQUAL(3, routes.size());
+
+  status->record(40, 200);
+  status->record(40, 503);
+  TEST_ASSERT_EQUAL(2, routes.at(0).latency.count());
+  TEST_ASSERT_EQUAL(1, routes.at(0).errors.get());
+}
+
+static void test_instrumented_chip_times_bus_operations() {
+  FakeUsbPdChip chip;
+  PdChipMetrics metrics;
+  InstrumentedUsbPdChip timed(chip, metrics, steppingClock);
+
+  TEST_ASSERT_TRUE(timed.probe(0x28));
+  PdoSet set;
+  TEST_ASSERT_TRUE(timed.readPdoSet(set));
+  TEST_ASSERT_EQUAL_FLOAT(12.0f, set.voltage[2]);
+  timed.softReset();
+
+  // Register image accessors are not bus traffic
+  timed.setVoltage(2, 9.0f);
+  TEST_ASSERT_EQUAL_FLOAT(9.0f, timed.getVoltage(2));
+
+  chip.present = false;
+  TEST_ASSERT_FALSE(timed.probe(0x28));
+  chip.contractState = PdContractState::Unknown;
+  TEST_ASSERT_EQUAL((int)PdContractState::Unknown,
+                    (int)timed.readContract().state);
+
+  TEST_ASSERT_EQUAL(2, metrics.of(PdChipOp::Probe).count());
+  TEST_ASSERT_EQUAL(300, metrics.of(PdChipOp::Probe).sumMicros());
+  TEST_ASSERT_EQUAL(1, metrics.failuresOf(PdChipOp::Probe).get());
+  TEST_ASSERT_EQUAL(1, metrics.of(PdChipOp::ReadPdoSet).count());
+  TEST_ASSERT_EQUAL(0, metrics.failuresOf(PdChipOp::ReadPdoSet).get());
+  TEST_ASSERT_EQUAL(1, metrics.of(PdChipOp::SoftReset).count());
+  TEST_ASSERT_EQUAL(1, metrics.failuresOf(PdChipOp::ReadContract).get());
+  TEST_ASSERT_EQUAL(0, metrics.of(PdChipOp::Write).count());
+  TEST_ASSERT_EQUAL(2, chip.probeCalls);
+}
+
+static void test_metrics_route_exports_chip_and_route_numbers() {
+  FakeUsbPdChip chip;
+  PdChipMetrics chipMetrics;
+  InstrumentedUsbPdChip timed(chip, chipMetrics, steppingClock);
+  USBPDController ctrl(timed, &chipMetrics);
+  ctrl.begin();
+  ctrl.sampleNow();
+  TEST_ASSERT_TRUE(ctrl.setPDConfig(15.0f, 2.0f, PdWriteMode::Volatile));
+
+  // Each route handler call takes 1 ms by micros()
+  uint32_t now = 0;
+  When(Method(ArduinoFake(), micros)).AlwaysDo([&]() { return now += 1000; });
+  WebRequestCore req;
+  auto status = ctrl.instrumentRoute(
+      "/api/status",
+      [&](RequestT &r, ResponseT &res) { ctrl.pdStatusHandler(r, res); });
+  auto missing = ctrl.instrumentRoute(
+      "/api/ports/{port}/status", [&](RequestT &r, ResponseT &res) {
+        ctrl.portResponse(5, &USBPDController::statusResponse, r, res);
+      });
+  for (int i = 0; i < 3; ++i) {
+    WebResponseCore res;
+    status(req, res);
+  }
+  WebResponseCore notFound;
+  missing(req, notFound);
+  TEST_ASSERT_EQUAL(404, notFound.getStatus());
+
+  WebResponseCore res;
+  ctrl.metricsHandler(req, res);
+  TEST_ASSERT_EQUAL(200, res.getStatus());
+  TEST_ASSERT_EQUAL_STRING("text/plain; version=0.0.4; charset=utf-8",
+                           res.getMimeType().c_str());
+  std::string text = responseBody(res).c_str();
+
+  // Bus operations, matching the fake's own call counts
+  char line[128];
+  snprintf(line, sizeof(line),
+           "usb_pd_chip_op_duration_seconds_count{port=\"0\",op=\"probe\"} %d",
+           chip.probeCalls);
+  TEST_ASSERT_TRUE(hasLine(text, line));
+  snprintf(line, sizeof(line),
+           "usb_pd_chip_op_duration_seconds_bucket{port=\"0\",op="
+           "\"read_pdo_set\",le=\"0.00025\"} %d",
+           chip.readCalls);
+  TEST_ASSERT_TRUE(hasLine(text, line));
+  snprintf(line, sizeof(line),
+           "usb_pd_chip_op_duration_seconds_count{port=\"0\",op="
+           "\"write_volatile\"} %d",
+           chip.volatileWrites);
+  TEST_ASSERT_TRUE(hasLine(text, line));
+  TEST_ASSERT_TRUE(hasLine(
+      text, "usb_pd_chip_op_failures_total{port=\"0\",op=\"probe\"} 0"));
+  // Never called, so left out
+  TEST_ASSERT_EQUAL(std::string::npos, text.find("op=\"write\""));
+
+  TEST_ASSERT_TRUE(
+      hasLine(text, "usb_pd_negotiation_duration_seconds_count{port=\"0\"} 1"));
+  TEST_ASSERT_TRUE(
+      hasLine(text, "usb_pd_negotiation_timeouts_total{port=\"0\"} 0"));
+
+  TEST_ASSERT_TRUE(hasLine(text, "usb_pd_http_request_duration_seconds_bucket{"
+                                 "route=\"/api/status\",method=\"GET\","
+                                 "le=\"0.001\"} 3"));
+  TEST_ASSERT_TRUE(hasLine(text, "usb_pd_http_request_duration_seconds_sum{"
+                                 "route=\"/api/status\",method=\"GET\"} "
+                                 "0.003000"));
+  TEST_ASSERT_TRUE(hasLine(text, "usb_pd_http_request_errors_total{"
+                                 "route=\"/api/status\",method=\"GET\"} 0"));
+  TEST_ASSERT_TRUE(hasLine(text, "usb_pd_http_request_errors_total{"
+                                 "route=\"/api/ports/{port}/status\","
+                                 "method=\"GET\"} 1"));
+}
+
+void register_usb_pd_metrics_tests() {
+  RUN_TEST(test_histogram_exports_cumulative_buckets);
+  RUN_TEST(test_route_slots_are_shared_by_route_and_method);
+  RUN_TEST(test_instrumented_chip_times_bus_operations);
+  RUN_TEST(test_metrics_route_exports_chip_and_route_numbers);
+}
+
+#endif // NATIVE_PLATFORM
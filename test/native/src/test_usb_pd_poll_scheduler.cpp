@@ -0,0 +1,78 @@
+#include <unity.h>
+
+#ifdef NATIVE_PLATFORM
+#include <usb_pd_poll_scheduler.h>
+
+static void test_scheduler_starts_at_ceiling() {
+  PdPollScheduler schedule;
+  schedule.configure(250, 5000, 30000);
+  TEST_ASSERT_FALSE(schedule.isDue(0));
+  TEST_ASSERT_FALSE(schedule.isDue(29999));
+  TEST_ASSERT_TRUE(schedule.isDue(30000));
+  TEST_ASSERT_EQUAL_UINT32(1000, schedule.msUntilDue(29000));
+  TEST_ASSERT_EQUAL_UINT32(0, schedule.msUntilDue(31000));
+}
+
+static void test_scheduler_burst_then_backoff() {
+  PdPollScheduler schedule;
+  schedule.configure(250, 1000, 4000);
+
+  uint32_t now = 100;
+  schedule.burst(now);
+  TEST_ASSERT_EQUAL_UINT32(350, schedule.getDeadlineMs());
+
+  // Fast for the burst window
+  for (now = 350; now < 1100; now += 250) {
+    TEST_ASSERT_TRUE(schedule.isDue(now));
+    schedule.polled(now);
+    TEST_ASSERT_EQUAL_UINT32(250, schedule.getIntervalMs());
+  }
+
+  // Then doubling up to the ceiling
+  const uint32_t expected[] = {500, 1000, 2000, 4000, 4000};
+  for (uint32_t interval : expected) {
+    now = schedule.getDeadlineMs();
+    schedule.polled(now);
+    TEST_ASSERT_EQUAL_UINT32(interval, schedule.getIntervalMs());
+  }
+  TEST_ASSERT_FALSE(schedule.inBurst(now));
+}
+
+static void test_scheduler_burst_pulls_deadline_in() {
+  PdPollScheduler schedule;
+  schedule.configure(250, 5000, 60000);
+  schedule.polled(0);
+  TEST_ASSERT_EQUAL_UINT32(60000, schedule.getIntervalMs());
+
+  schedule.burst(10000);
+  TEST_ASSERT_TRUE(schedule.inBurst(10000));
+  TEST_ASSERT_EQUAL_UINT32(250, schedule.msUntilDue(10000));
+}
+
+static void test_scheduler_wraps_millis() {
+  PdPollScheduler schedule;
+  schedule.configure(250, 1000, 4000);
+  uint32_t now = 0xFFFFFF00UL;
+  schedule.burst(now);
+  TEST_ASSERT_FALSE(schedule.isDue(now));
+  TEST_ASSERT_TRUE(schedule.isDue(now + 250)); // Past the wrap
+  TEST_ASSERT_TRUE(schedule.inBurst(now + 500));
+}
+
+static void test_scheduler_clamps_fast_to_ceiling() {
+  PdPollScheduler schedule;
+  schedule.configure(5000, 1000, 1000);
+  TEST_ASSERT_EQUAL_UINT32(1000, schedule.getFastMs());
+  schedule.configure(250, 1000, 0);
+  TEST_ASSERT_EQUAL_UINT32(1, schedule.getCeilingMs());
+}
+
+void register_usb_pd_poll_scheduler_tests() {
+  RUN_TEST(test_scheduler_starts_at_ceiling);
+  RUN_TEST(test_scheduler_burst_then_backoff);
+  RUN_TEST(test_scheduler_burst_pulls_deadline_in);
+  RUN_TEST(test_scheduler_wraps_millis);
+  RUN_TEST(test_scheduler_clamps_fast_to_ceiling);
+}
+
+#endif // NATIVE_PLATFORM
@@ -0,0 +1,147 @@
+#include <unity.h>
+
+#ifdef NATIVE_PLATFORM
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <usb_pd_poller.h>
+#include <usb_pd_snapshot.h>
+
+static void test_snapshot_store_starts_empty() {
+  PdSnapshotStore store;
+  PdSnapshot snapshot = store.read();
+  TEST_ASSERT_EQUAL_UINT32(0, store.version());
+  TEST_ASSERT_EQUAL_UINT32(0, snapshot.version);
+  TEST_ASSERT_FALSE(snapshot.connected);
+}
+
+static void test_snapshot_store_assigns_versions() {
+  PdSnapshotStore store;
+  PdSnapshot snapshot;
+  snapshot.connected = true;
+  snapshot.activePdo = 2;
+  snapshot.pdoVoltage[2] = 12.0f;
+
+  store.publish(snapshot);
+  PdSnapshot first = store.read();
+  TEST_ASSERT_EQUAL_UINT32(1, first.version);
+  TEST_ASSERT_TRUE(first.connected);
+  TEST_ASSERT_EQUAL(2, first.activePdo);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 12.0f, first.pdoVoltage[2]);
+
+  store.publish(snapshot);
+  TEST_ASSERT_EQUAL_UINT32(2, store.read().version);
+  TEST_ASSERT_EQUAL_UINT32(2, store.version());
+}
+
+static void test_snapshot_store_readers_never_see_torn_writes() {
+  PdSnapshotStore store;
+  std::atomic<bool> done{false};
+
+  // Writer keeps every field equal to the iteration number
+  std::thread writer([&]() {
+    PdSnapshot snapshot;
+    for (int i = 1; i <= 20000; ++i) {
+      snapshot.activePdo = i;
+      for (int p = 1; p <= 3; ++p) {
+        snapshot.pdoVoltage[p] = (float)i;
+        snapshot.pdoCurrent[p] = (float)i;
+      }
+      store.publish(snapshot);
+    }
+    done.store(true);
+  });
+
+  int torn = 0;
+  while (!done.load()) {
+    PdSnapshot snapshot = store.read();
+    for (int p = 1; p <= 3; ++p) {
+      if (snapshot.pdoVoltage[p] != (float)snapshot.activePdo ||
+          snapshot.pdoCurrent[p] != (float)snapshot.activePdo) {
+        ++torn;
+      }
+    }
+  }
+  writer.join();
+  TEST_ASSERT_EQUAL(0, torn);
+}
+
+static void test_poller_rejects_zero_interval() {
+  USBPDPoller poller;
+  TEST_ASSERT_FALSE(poller.start(0, []() {}));
+  TEST_ASSERT_FALSE(poller.isRunning());
+}
+
+static void test_poller_runs_task_until_stopped() {
+  USBPDPoller poller;
+  std::atomic<int> calls{0};
+  TEST_ASSERT_TRUE(poller.start(1, [&]() { calls.fetch_add(1); }));
+  TEST_ASSERT_TRUE(poller.isRunning());
+  TEST_ASSERT_EQUAL_UINT32(1, poller.getIntervalMs());
+
+  // Already running: second start is rejected
+  TEST_ASSERT_FALSE(poller.start(1, []() {}));
+
+  for (int i = 0; i < 500 && calls.load() < 3; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  poller.stop();
+
+  TEST_ASSERT_FALSE(poller.isRunning());
+  TEST_ASSERT_TRUE(calls.load() >= 3);
+  TEST_ASSERT_EQUAL_UINT32((uint32_t)calls.load(), poller.getIterations());
+
+  // No further iterations after stop()
+  int stopped = calls.load();
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  TEST_ASSERT_EQUAL(stopped, calls.load());
+}
+
+static void test_poller_stop_wakes_long_interval() {
+  USBPDPoller poller;
+  std::atomic<int> calls{0};
+  TEST_ASSERT_TRUE(poller.start(60000, [&]() { calls.fetch_add(1); }));
+  for (int i = 0; i < 500 && calls.load() < 1; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  auto t0 = std::chrono::steady_clock::now();
+  poller.stop();
+  auto elapsed = std::chrono::steady_clock::now() - t0;
+
+  TEST_ASSERT_TRUE(std::chrono::duration_cast<std::chrono::milliseconds>(
+                       elapsed)
+                       .count() < 1000);
+  TEST_ASSERT_EQUAL(1, calls.load());
+}
+
+static void test_poller_wake_runs_task_early() {
+  USBPDPoller poller;
+  std::atomic<int> calls{0};
+  TEST_ASSERT_TRUE(poller.start(60000, [&]() { calls.fetch_add(1); }));
+  for (int i = 0; i < 500 && calls.load() < 1; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  poller.setIntervalMs(0); // Clamped, never a busy loop
+  TEST_ASSERT_EQUAL_UINT32(1, poller.getIntervalMs());
+  poller.setIntervalMs(60000);
+  poller.wake();
+  for (int i = 0; i < 500 && calls.load() < 2; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  poller.stop();
+  TEST_ASSERT_EQUAL(2, calls.load());
+}
+
+void register_usb_pd_poller_tests() {
+  RUN_TEST(test_snapshot_store_starts_empty);
+  RUN_TEST(test_snapshot_store_assigns_versions);
+  RUN_TEST(test_snapshot_store_readers_never_see_torn_writes);
+  RUN_TEST(test_poller_rejects_zero_interval);
+  RUN_TEST(test_poller_runs_task_until_stopped);
+  RUN_TEST(test_poller_stop_wakes_long_interval);
+  RUN_TEST(test_poller_wake_runs_task_early);
+}
+
+#endif // NATIVE_PLATFORM
@@ -0,0 +1,323 @@
+#include <unity.h>
+
+#ifdef NATIVE_PLATFORM
+#include "fakes/fake_usb_pd_chip.h"
+#include "support/alloc_counter.h"
+#include "support/response_body.h"
+#include <ArduinoFake.h>
+#include <ArduinoJson.h>
+#include <chrono>
+#include <interface/core/web_request_core.h>
+#include <interface/core/web_response_core.h>
+#include <usb_pd_controller.h>
+#include <vector>
+using namespace fakeit;
+
+// Hands out fake chips for extra ports and keeps them reachable for asserts
+static void usePortFakes(USBPDController &ctrl,
+                         std::vector<FakeUsbPdChip *> &chips) {
+  ctrl.setPortChipFactory([&chips](size_t) {
+    FakeUsbPdChip *chip = new FakeUsbPdChip();
+    chips.push_back(chip);
+    return std::unique_ptr<IUsbPdChip>(chip);
+  });
+}
+
+// Ports on two buses, four addresses each
+static void buildPortsConfig(DynamicJsonDocument &doc, size_t count) {
+  JsonArray ports = doc.createNestedArray("ports");
+  for (size_t i = 0; i < count; ++i) {
+    JsonObject port = ports.createNestedObject();
+    port["bus"] = i / 4;
+    port["i2cAddress"] = 0x28 + i % 4;
+  }
+}
+
+static void test_parseConfig_ports_creates_ports() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  std::vector<FakeUsbPdChip *> chips;
+  usePortFakes(ctrl, chips);
+  TEST_ASSERT_EQUAL(1, ctrl.getPortCount());
+
+  DynamicJsonDocument doc(1024);
+  doc["pollFastMs"] = 100;
+  doc["alertPin"] = 7;
+  buildPortsConfig(doc, 6);
+  doc["ports"][5]["alertPin"] = 9;
+  ctrl.__test_applyConfig(doc.as<JsonVariant>());
+
+  TEST_ASSERT_EQUAL(6, ctrl.getPortCount());
+  TEST_ASSERT_EQUAL(5, chips.size());
+  TEST_ASSERT_NOT_NULL(ctrl.getPort(0));
+  TEST_ASSERT_NULL(ctrl.getPort(6));
+
+  // Port 0 takes the first entry; extra ports their own entry on top of the
+  // shared settings, except for the ALERT pin
+  TEST_ASSERT_EQUAL_UINT8(0x28, ctrl.getI2cAddress());
+  TEST_ASSERT_EQUAL(7, ctrl.getAlertPin());
+  const USBPDPort *port5 = ctrl.getPort(5);
+  TEST_ASSERT_NOT_NULL(port5);
+  TEST_ASSERT_EQUAL(5, port5->index);
+  TEST_ASSERT_EQUAL_UINT8(1, port5->settings.i2cBus);
+  TEST_ASSERT_EQUAL_UINT8(0x29, port5->settings.i2cAddress);
+  TEST_ASSERT_EQUAL_UINT32(100, port5->settings.pollFastMs);
+  TEST_ASSERT_EQUAL(9, port5->settings.alertPin);
+  TEST_ASSERT_EQUAL(-1, ctrl.getPort(4)->settings.alertPin);
+}
+
+static void test_ports_capped_at_max() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  std::vector<FakeUsbPdChip *> chips;
+  usePortFakes(ctrl, chips);
+
+  DynamicJsonDocument doc(2048);
+  buildPortsConfig(doc, USB_PD_MAX_PORTS + 2);
+  ctrl.__test_applyConfig(doc.as<JsonVariant>());
+  TEST_ASSERT_EQUAL(USB_PD_MAX_PORTS, ctrl.getPortCount());
+}
+
+static void test_begin_initializes_every_port_on_its_bus() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  std::vector<FakeUsbPdChip *> chips;
+  usePortFakes(ctrl, chips);
+
+  DynamicJsonDocument doc(1024);
+  buildPortsConfig(doc, 5);
+  ctrl.begin(doc.as<JsonVariant>());
+
+  TEST_ASSERT_EQUAL(1, chip.beginCalls);
+  for (size_t i = 0; i < chips.size(); ++i) {
+    size_t port = i + 1;
+    TEST_ASSERT_EQUAL(1, chips[i]->beginCalls);
+    TEST_ASSERT_EQUAL_UINT8(port / 4, chips[i]->bus);
+    TEST_ASSERT_EQUAL_UINT8(0x28 + port % 4, chips[i]->address);
+    TEST_ASSERT_TRUE(ctrl.getPort(port)->snapshotStore.read().valid);
+  }
+}
+
+static void test_handle_services_every_port() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  std::vector<FakeUsbPdChip *> chips;
+  usePortFakes(ctrl, chips);
+
+  DynamicJsonDocument doc(1024);
+  buildPortsConfig(doc, 3);
+  ctrl.begin(doc.as<JsonVariant>());
+
+  // A job on port 2 runs from the one job queue
+  uint32_t id =
+      ctrl.submitPDConfig(9.0f, 1.5f, PdWriteMode::Persistent, 2);
+  TEST_ASSERT_TRUE(id > 0);
+  TEST_ASSERT_EQUAL_UINT32(0, ctrl.submitPDConfig(9.0f, 1.5f,
+                                                  PdWriteMode::Persistent, 3));
+  TEST_ASSERT_EQUAL_UINT32(0, ctrl.nextWakeMs());
+
+  unsigned long now = 0;
+  When(Method(ArduinoFake(), millis)).AlwaysDo([&now]() { return now; });
+  PdConfigJob job;
+  bool finished = false;
+  for (int i = 0; i < 50 && !finished; ++i) {
+    now += 20;
+    ctrl.handle();
+    finished = ctrl.getConfigJob(id, job) && job.isFinished();
+  }
+  TEST_ASSERT_TRUE(finished);
+  TEST_ASSERT_TRUE(job.state == PdConfigJobState::Succeeded);
+  TEST_ASSERT_EQUAL(2, job.port);
+  TEST_ASSERT_EQUAL(2, chips[1]->active);
+  TEST_ASSERT_EQUAL(1, chip.active);
+  TEST_ASSERT_EQUAL(1, chips[0]->active);
+
+  // Every port is sampled once its own schedule comes due
+  int probes0 = chip.probeCalls;
+  int probes1 = chips[0]->probeCalls;
+  now += USB_PD_HANDLE_INTERVAL_MS;
+  ctrl.handle();
+  TEST_ASSERT_TRUE(chip.probeCalls > probes0);
+  TEST_ASSERT_TRUE(chips[0]->probeCalls > probes1);
+}
+
+static void test_ports_handler_lists_every_port() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  std::vector<FakeUsbPdChip *> chips;
+  usePortFakes(ctrl, chips);
+
+  DynamicJsonDocument config(1024);
+  buildPortsConfig(config, 3);
+  ctrl.begin(config.as<JsonVariant>());
+  chips[1]->present = false;
+  ctrl.sampleNow(2);
+
+  WebRequestCore req;
+  WebResponseCore res;
+  ctrl.portsHandler(req, res);
+  TEST_ASSERT_EQUAL(200, res.getStatus());
+  DynamicJsonDocument doc(2048);
+  TEST_ASSERT_FALSE(deserializeJson(doc, responseBody(res)));
+  JsonArray ports = doc["ports"].as<JsonArray>();
+  TEST_ASSERT_EQUAL(3, ports.size());
+  TEST_ASSERT_EQUAL(1, ports[1]["port"].as<int>());
+  TEST_ASSERT_EQUAL(0x29, ports[1]["address"].as<int>());
+  TEST_ASSERT_TRUE(ports[1]["connected"].as<bool>());
+  TEST_ASSERT_EQUAL(1, ports[1]["activePDO"].as<int>());
+  TEST_ASSERT_FALSE(ports[2]["connected"].as<bool>());
+  TEST_ASSERT_FALSE(ports[2].containsKey("voltage"));
+}
+
+static void test_portResponse_routes_to_port() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  std::vector<FakeUsbPdChip *> chips;
+  usePortFakes(ctrl, chips);
+
+  DynamicJsonDocument config(1024);
+  buildPortsConfig(config, 2);
+  ctrl.begin(config.as<JsonVariant>());
+  chip.present = false;
+  ctrl.sampleNow();
+
+  WebRequestCore req;
+  WebResponseCore res;
+  ctrl.portResponse(1, &USBPDController::statusResponse, req, res);
+  StaticJsonDocument<256> doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, responseBody(res)));
+  TEST_ASSERT_TRUE(doc["connected"].as<bool>());
+
+  WebResponseCore missing;
+  ctrl.portResponse(2, &USBPDController::statusResponse, req, missing);
+  TEST_ASSERT_EQUAL(404, missing.getStatus());
+  WebResponseCore negative;
+  ctrl.portResponse(-1, &USBPDController::statusResponse, req, negative);
+  TEST_ASSERT_EQUAL(404, negative.getStatus());
+}
+
+static void test_extra_port_routes_render_from_snapshot() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  std::vector<FakeUsbPdChip *> chips;
+  usePortFakes(ctrl, chips);
+
+  DynamicJsonDocument config(1024);
+  buildPortsConfig(config, 2);
+  ctrl.begin(config.as<JsonVariant>());
+  ctrl.setPDConfig(12.0f, 2.0f, PdWriteMode::Persistent, 1);
+
+  // Same bodies as port 0 serves, rendered from port 1's snapshot
+  WebRequestCore req;
+  WebResponseCore snapshot;
+  ctrl.portResponse(1, &USBPDController::snapshotResponse, req, snapshot);
+  DynamicJsonDocument doc(2048);
+  TEST_ASSERT_FALSE(deserializeJson(doc, responseBody(snapshot)));
+  TEST_ASSERT_EQUAL_FLOAT(12.0f, doc["status"]["voltage"].as<float>());
+  TEST_ASSERT_EQUAL(2, doc["profiles"]["activePDO"].as<int>());
+  TEST_ASSERT_TRUE(doc["capabilities"]["voltages"].size() > 0);
+  TEST_ASSERT_EQUAL(ctrl.getPort(1)->stateVersion.load(),
+                    doc["version"].as<uint32_t>());
+  TEST_ASSERT_EQUAL(1, chip.active); // Port 0 untouched
+
+  WebResponseCore events;
+  ctrl.portResponse(1, &USBPDController::eventsResponse, req, events);
+  TEST_ASSERT_NOT_NULL(strstr(responseBody(events).c_str(),
+                              ",\"status\":{\"success\":true"));
+
+  // A job only answers on the port it configures
+  uint32_t id = ctrl.submitPDConfig(9.0f, 1.5f, PdWriteMode::Persistent, 1);
+  WebResponseCore own;
+  ctrl.configJobResponse(id, own, 1);
+  TEST_ASSERT_EQUAL(200, own.getStatus());
+  WebResponseCore other;
+  ctrl.configJobResponse(id, other, 0);
+  TEST_ASSERT_EQUAL(404, other.getStatus());
+
+  WebResponseCore diag;
+  ctrl.portResponse(1, &USBPDController::diagnosticsResponse, req, diag);
+  TEST_ASSERT_FALSE(deserializeJson(doc, responseBody(diag)));
+  TEST_ASSERT_EQUAL_STRING("closed",
+                           doc["breaker"]["state"].as<const char *>());
+  TEST_ASSERT_TRUE(doc.containsKey("i2c"));
+  TEST_ASSERT_FALSE(doc.containsKey("history"));
+}
+
+// Heap held after configuring the ports, and the mean time of one status
+// request to the last port
+struct PortCost {
+  int64_t liveBytes = 0;
+  double statusNs = 0;
+};
+
+static PortCost measurePorts(size_t count) {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  std::vector<FakeUsbPdChip *> chips;
+  chips.reserve(USB_PD_MAX_PORTS);
+  usePortFakes(ctrl, chips);
+
+  DynamicJsonDocument config(2048);
+  buildPortsConfig(config, count);
+  int64_t before = allocStats().liveBytes;
+  ctrl.__test_applyConfig(config.as<JsonVariant>());
+  PortCost cost;
+  cost.liveBytes = allocStats().liveBytes - before;
+
+  for (size_t i = 0; i < count; ++i) {
+    ctrl.readPDConfig(i);
+  }
+
+  // Best of several rounds to keep scheduler noise out
+  const int calls = 500;
+  WebRequestCore req;
+  double best = 0;
+  for (int round = 0; round < 5; ++round) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; ++i) {
+      WebResponseCore res;
+      ctrl.portResponse((long)count - 1, &USBPDController::statusResponse,
+                        req, res);
+    }
+    double ns = std::chrono::duration<double, std::nano>(
+                    std::chrono::steady_clock::now() - start)
+                    .count() /
+                calls;
+    best = round == 0 || ns < best ? ns : best;
+  }
+  cost.statusNs = best;
+  return cost;
+}
+
+static void test_port_memory_and_latency_stay_flat() {
+  PortCost one = measurePorts(1);
+  PortCost two = measurePorts(2);
+  PortCost four = measurePorts(4);
+  PortCost eight = measurePorts(USB_PD_MAX_PORTS);
+
+  // Every extra port costs the same, however many there are, and is a
+  // fraction of a controller: no bodies, history or job queue of its own
+  int64_t perPort = two.liveBytes - one.liveBytes;
+  TEST_ASSERT_TRUE(perPort > 0);
+  TEST_ASSERT_TRUE(perPort < (int64_t)sizeof(USBPDController) / 4);
+  TEST_ASSERT_EQUAL_INT64(perPort * 3, four.liveBytes - one.liveBytes);
+  TEST_ASSERT_EQUAL_INT64(perPort * (USB_PD_MAX_PORTS - 1),
+                          eight.liveBytes - one.liveBytes);
+
+  // Routing to a port is an array index; generous bound for noisy hosts
+  TEST_ASSERT_TRUE(eight.statusNs < one.statusNs * 2.0 + 1000.0);
+  TEST_ASSERT_TRUE(four.statusNs < one.statusNs * 2.0 + 1000.0);
+}
+
+void register_usb_pd_ports_tests() {
+  RUN_TEST(test_parseConfig_ports_creates_ports);
+  RUN_TEST(test_ports_capped_at_max);
+  RUN_TEST(test_begin_initializes_every_port_on_its_bus);
+  RUN_TEST(test_handle_services_every_port);
+  RUN_TEST(test_ports_handler_lists_every_port);
+  RUN_TEST(test_portResponse_routes_to_port);
+  RUN_TEST(test_extra_port_routes_render_from_snapshot);
+  RUN_TEST(test_port_memory_and_latency_stay_flat);
+}
+
+#endif // NATIVE_PLATFORM
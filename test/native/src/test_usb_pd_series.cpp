@@ -0,0 +1,245 @@
+#include <unity.h>
+
+#ifdef NATIVE_PLATFORM
+#include "fakes/fake_series_storage.h"
+#include "fakes/fake_usb_pd_chip.h"
+#include "support/response_body.h"
+#include <ArduinoFake.h>
+#include <ArduinoJson.h>
+#include <usb_pd_controller.h>
+#include <usb_pd_series.h>
+#include <vector>
+
+using namespace fakeit;
+
+static PdTelemetrySample sample(uint32_t ms, uint16_t mv, uint16_t ma) {
+  PdTelemetrySample s;
+  s.ms = ms;
+  s.millivolts = mv;
+  s.milliamps = ma;
+  return s;
+}
+
+// Fills block with samples from next(i) until it is full; returns them
+template <typename Next>
+static std::vector<PdTelemetrySample> fill(PdSeriesBlock &block, Next next) {
+  PdSeriesEncoder encoder;
+  encoder.reset(block);
+  std::vector<PdTelemetrySample> written;
+  for (uint32_t i = 0;; ++i) {
+    PdTelemetrySample s = next(i);
+    if (!encoder.append(s)) {
+      return written;
+    }
+    written.push_back(s);
+  }
+}
+
+static void assertDecodes(const PdSeriesBlock &block,
+                          const std::vector<PdTelemetrySample> &expected) {
+  PdSeriesDecoder decoder(block);
+  PdTelemetrySample s;
+  for (const PdTelemetrySample &e : expected) {
+    TEST_ASSERT_TRUE(decoder.next(s));
+    TEST_ASSERT_EQUAL_UINT32(e.ms, s.ms);
+    TEST_ASSERT_EQUAL_UINT16(e.millivolts, s.millivolts);
+    TEST_ASSERT_EQUAL_UINT16(e.milliamps, s.milliamps);
+  }
+  TEST_ASSERT_FALSE(decoder.next(s));
+}
+
+static void test_steady_series_costs_three_bits_per_sample() {
+  static PdSeriesBlock block;
+  std::vector<PdTelemetrySample> written = fill(
+      block, [](uint32_t i) { return sample(5000 + i * 1000, 9000, 1500); });
+
+  // 32 bits for the first sample, 16 + 1 + 1 for the first interval
+  TEST_ASSERT_EQUAL(written.size(), block.count);
+  TEST_ASSERT_EQUAL(32 + 18 + 3 * (block.count - 2), block.bits);
+  TEST_ASSERT_TRUE(block.count > 600);
+  TEST_ASSERT_EQUAL_UINT32(5000, block.firstMs);
+  TEST_ASSERT_EQUAL_UINT32(written.back().ms, block.lastMs);
+  assertDecodes(block, written);
+}
+
+static void test_every_code_width_round_trips() {
+  static PdSeriesBlock block;
+  // Jitter, gaps, small and full-scale swings, and a millis() wrap
+  std::vector<PdTelemetrySample> written = fill(block, [](uint32_t i) {
+    static const int32_t jitter[] = {0, 3, -40, 200, -1500, 90000};
+    static const uint16_t mv[] = {5000, 5003, 4900, 20000, 0, 65535};
+    static const uint16_t ma[] = {3000, 2999, 3100, 500, 65535, 0};
+    uint32_t ms = 0xFFFF0000UL + i * 1000 + jitter[i % 6];
+    return sample(ms, mv[(i / 2) % 6], ma[(i / 3) % 6]);
+  });
+  TEST_ASSERT_TRUE(written.size() > 20);
+  assertDecodes(block, written);
+}
+
+static void test_ring_seals_blocks_and_reads_ranges() {
+  static PdSeriesRing ring;
+  ring.clear();
+  uint32_t ms = 0;
+  // Enough 1 s samples to wrap the ring once
+  while (ring.sealedTotal() < USB_PD_SERIES_RAM_BLOCKS + 2) {
+    ring.append(sample(ms, (uint16_t)(5000 + (ms / 1000) % 7), 1000));
+    ms += 1000;
+  }
+  TEST_ASSERT_NULL(ring.sealed(0));
+  TEST_ASSERT_NULL(ring.sealed(1));
+  TEST_ASSERT_NOT_NULL(ring.sealed(2));
+  TEST_ASSERT_NULL(ring.sealed(ring.sealedTotal()));
+
+  uint32_t oldest = 0;
+  TEST_ASSERT_TRUE(ring.oldestMs(oldest));
+  TEST_ASSERT_EQUAL_UINT32(ring.sealed(2)->firstMs, oldest);
+
+  // The newest 100 s, across the open and sealed blocks, in order
+  uint32_t last = ms - 1000;
+  uint32_t expect = last - 99000;
+  size_t n = ring.forEachSample(expect, last, [&](const PdTelemetrySample &s) {
+    TEST_ASSERT_EQUAL_UINT32(expect, s.ms);
+    TEST_ASSERT_EQUAL_UINT16(5000 + (s.ms / 1000) % 7, s.millivolts);
+    expect += 1000;
+  });
+  TEST_ASSERT_EQUAL(100, n);
+
+  // Out-of-order samples are dropped
+  ring.append(sample(last - 5000, 1, 1));
+  n = ring.forEachSample(last - 5000, last, [](const PdTelemetrySample &s) {
+    TEST_ASSERT_NOT_EQUAL(1, s.millivolts);
+  });
+  TEST_ASSERT_EQUAL(6, n);
+}
+
+static PdSeriesBlock makeBlock(uint32_t firstMs) {
+  PdSeriesBlock block;
+  PdSeriesEncoder encoder;
+  encoder.reset(block);
+  for (uint32_t i = 0; i < 10; ++i) {
+    encoder.append(sample(firstMs + i * 1000, 12000, 2000));
+  }
+  return block;
+}
+
+static void test_log_rotates_segments_and_seeks_by_index() {
+  static FakeSeriesStorage storage;
+  storage = FakeSeriesStorage();
+  static PdSeriesLog log(storage);
+  TEST_ASSERT_EQUAL(0, log.begin(7));
+
+  // One more segment and a half: the first segment is rotated out
+  const uint32_t total = USB_PD_SERIES_SEGMENT_BLOCKS * 2 + 5;
+  for (uint32_t i = 0; i < total; ++i) {
+    TEST_ASSERT_TRUE(log.append(makeBlock(i * 10000)));
+  }
+  TEST_ASSERT_EQUAL(2, storage.erases);
+  TEST_ASSERT_EQUAL(USB_PD_SERIES_SEGMENT_BLOCKS + 5, log.blockCount());
+  TEST_ASSERT_EQUAL_UINT32(total, log.nextSeq());
+
+  // Reads only the blocks the index says overlap the range
+  static PdSeriesBlock scratch;
+  uint32_t from = (total - 3) * 10000 + 5000;
+  uint32_t to = (total - 2) * 10000 + 2000;
+  storage.reads = 0;
+  std::vector<uint32_t> seen;
+  size_t n = log.forEachSample(7, from, to, scratch,
+                               [&](const PdTelemetrySample &s) {
+                                 seen.push_back(s.ms);
+                               });
+  TEST_ASSERT_EQUAL(2, storage.reads);
+  TEST_ASSERT_EQUAL(8, n);
+  TEST_ASSERT_EQUAL_UINT32(from, seen.front());
+  TEST_ASSERT_EQUAL_UINT32(to, seen.back());
+
+  // Other boots are skipped; the rotated-out range is gone
+  TEST_ASSERT_EQUAL(0, log.forEachSample(8, from, to, scratch,
+                                         [](const PdTelemetrySample &) {}));
+  TEST_ASSERT_EQUAL(0, log.forEachSample(7, 0, 50000, scratch,
+                                         [](const PdTelemetrySample &) {}));
+
+  // A fresh log over the same storage rebuilds the index and continues
+  static PdSeriesLog reopened(storage);
+  TEST_ASSERT_EQUAL(log.blockCount(), reopened.begin(9));
+  TEST_ASSERT_EQUAL_UINT32(total, reopened.nextSeq());
+  TEST_ASSERT_EQUAL(8, reopened.forEachSample(7, from, to, scratch,
+                                              [](const PdTelemetrySample &) {}));
+}
+
+static void test_log_skips_torn_block_after_power_loss() {
+  static FakeSeriesStorage storage;
+  storage = FakeSeriesStorage();
+  static PdSeriesLog log(storage);
+  log.begin(1);
+  TEST_ASSERT_TRUE(log.append(makeBlock(0)));
+  TEST_ASSERT_TRUE(log.append(makeBlock(10000)));
+
+  storage.failAppends = true;
+  storage.tornBytes = 100;
+  TEST_ASSERT_FALSE(log.append(makeBlock(20000)));
+  storage.failAppends = false;
+
+  // After a reboot the torn tail is ignored and appends move on to the
+  // other segment instead of landing behind it
+  static PdSeriesLog reopened(storage);
+  TEST_ASSERT_EQUAL(2, reopened.begin(2));
+  TEST_ASSERT_TRUE(reopened.append(makeBlock(30000)));
+  TEST_ASSERT_EQUAL(sizeof(PdSeriesBlock), storage.segments[1].size());
+  TEST_ASSERT_EQUAL(3, reopened.blockCount());
+  TEST_ASSERT_EQUAL_UINT32(3, reopened.nextSeq());
+}
+
+static void test_controller_persists_per_second_means() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  uint32_t now = 0;
+  When(Method(ArduinoFake(), millis)).AlwaysDo([&]() { return now; });
+  ctrl.begin();
+
+  static FakeSeriesStorage storage;
+  storage = FakeSeriesStorage();
+  static PdSeriesLog log(storage);
+  ctrl.attachHistoryLog(log);
+
+  // Sampled twice a second until RAM has wrapped past a logged block
+  uint32_t end = 0;
+  while (log.blockCount() < USB_PD_SERIES_RAM_BLOCKS + 2) {
+    now += 500;
+    chip.volt[1] = (now / 1000) % 2 ? 5.0f : 5.02f;
+    ctrl.sampleNow();
+    ctrl.handle();
+    end = now;
+  }
+
+  // Every closed second, once each, from the log then RAM. Second 0 also
+  // holds the sample begin() took, so the check starts at 1 s.
+  uint32_t expect = 1000;
+  size_t n =
+      ctrl.forEachHistorySecond(1000, end, [&](const PdTelemetrySample &s) {
+    TEST_ASSERT_EQUAL_UINT32(expect, s.ms);
+    TEST_ASSERT_EQUAL_UINT16((s.ms / 1000) % 2 ? 5000 : 5020, s.millivolts);
+    TEST_ASSERT_EQUAL_UINT16(1000, s.milliamps);
+    expect += 1000;
+  });
+  TEST_ASSERT_EQUAL(end / 1000 - 1, n);
+
+  WebRequestCore req;
+  WebResponseCore res;
+  ctrl.diagnosticsHandler(req, res);
+  StaticJsonDocument<512> doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, responseBody(res)));
+  TEST_ASSERT_TRUE(doc["history"]["logged"].as<bool>());
+  TEST_ASSERT_EQUAL(log.blockCount(), doc["history"]["logBlocks"].as<size_t>());
+  TEST_ASSERT_EQUAL(0, doc["history"]["logErrors"].as<int>());
+}
+
+void register_usb_pd_series_tests() {
+  RUN_TEST(test_steady_series_costs_three_bits_per_sample);
+  RUN_TEST(test_every_code_width_round_trips);
+  RUN_TEST(test_ring_seals_blocks_and_reads_ranges);
+  RUN_TEST(test_log_rotates_segments_and_seeks_by_index);
+  RUN_TEST(test_log_skips_torn_block_after_power_loss);
+  RUN_TEST(test_controller_persists_per_second_means);
+}
+
+#endif // NATIVE_PLATFORM
@@ -0,0 +1,286 @@
+#include <unity.h>
+
+#ifdef NATIVE_PLATFORM
+#include "fakes/fake_usb_pd_chip.h"
+#include <usb_pd_controller.h>
+#include <usb_pd_core.h>
+#include <usb_pd_shadow_chip.h>
+
+// Fake that records every call that would reach the bus
+class BusCountingChip : public FakeUsbPdChip {
+public:
+  int writeCalls = 0;
+  int resetCalls = 0;
+  int setterCalls = 0;
+
+  void setVoltage(int idx, float v) override {
+    ++setterCalls;
+    FakeUsbPdChip::setVoltage(idx, v);
+  }
+  void setCurrent(int idx, float a) override {
+    ++setterCalls;
+    // Mimic the chip storing current in 0.25 A steps
+    FakeUsbPdChip::setCurrent(idx, (float)(int)(a * 4.0f) / 4.0f);
+  }
+  void setPdoNumber(int idx) override {
+    ++setterCalls;
+    FakeUsbPdChip::setPdoNumber(idx);
+  }
+  void write() override {
+    ++writeCalls;
+    FakeUsbPdChip::write();
+  }
+  void softReset() override {
+    ++resetCalls;
+    FakeUsbPdChip::softReset();
+  }
+};
+
+static void test_shadow_read_always_reaches_device() {
+  BusCountingChip inner;
+  ShadowedUsbPdChip shadow(inner);
+  TEST_ASSERT_FALSE(shadow.isLoaded());
+
+  shadow.read();
+  shadow.read();
+  shadow.read();
+
+  TEST_ASSERT_TRUE(shadow.isLoaded());
+  TEST_ASSERT_EQUAL(3, inner.readCalls);
+  TEST_ASSERT_EQUAL(inner.active, shadow.getPdoNumber());
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, inner.volt[2], shadow.getVoltage(2));
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, inner.amps[3], shadow.getCurrent(3));
+}
+
+static void test_shadow_unchanged_configure_costs_no_bus_traffic() {
+  BusCountingChip inner;
+  ShadowedUsbPdChip shadow(inner);
+  USBPDCore core(shadow);
+
+  TEST_ASSERT_TRUE(core.setConfig(12.0f, 2.0f));
+  int writes = inner.writeCalls;
+  int resets = inner.resetCalls;
+  int setters = inner.setterCalls;
+
+  // Same request again: nothing dirty, so only the reads go to the device
+  TEST_ASSERT_TRUE(core.setConfig(12.0f, 2.0f));
+  TEST_ASSERT_EQUAL(writes, inner.writeCalls);
+  TEST_ASSERT_EQUAL(resets, inner.resetCalls);
+  TEST_ASSERT_EQUAL(setters, inner.setterCalls);
+  TEST_ASSERT_EQUAL_UINT32(1, shadow.getWritesSkipped());
+  TEST_ASSERT_EQUAL_UINT32(1, shadow.getResetsSkipped());
+}
+
+static void test_shadow_forwards_only_dirty_fields() {
+  BusCountingChip inner;
+  inner.active = 2;
+  inner.volt[2] = 12.0f;
+  inner.amps[1] = 2.0f;
+  inner.amps[2] = 2.0f;
+  ShadowedUsbPdChip shadow(inner);
+  USBPDCore core(shadow);
+
+  // 9V/2A only changes PDO2 voltage
+  TEST_ASSERT_TRUE(core.setConfig(9.0f, 2.0f));
+  TEST_ASSERT_EQUAL(1, inner.setterCalls);
+  TEST_ASSERT_EQUAL(1, inner.writeCalls);
+  TEST_ASSERT_EQUAL(1, inner.resetCalls);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 9.0f, inner.volt[2]);
+}
+
+static void test_shadow_repeat_of_rounded_value_is_noop() {
+  BusCountingChip inner;
+  ShadowedUsbPdChip shadow(inner);
+  shadow.read();
+
+  // Device rounds 1.33 A down to 1.25 A
+  shadow.setCurrent(2, 1.33f);
+  shadow.write();
+  TEST_ASSERT_EQUAL(1, inner.writeCalls);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.25f, shadow.getCurrent(2));
+
+  shadow.setCurrent(2, 1.33f);
+  TEST_ASSERT_FALSE(shadow.isDirty());
+  shadow.write();
+  TEST_ASSERT_EQUAL(1, inner.writeCalls);
+}
+
+static void test_shadow_readPdoSet_sees_outside_changes() {
+  BusCountingChip inner;
+  ShadowedUsbPdChip shadow(inner);
+  PdoSet first, second;
+  TEST_ASSERT_TRUE(shadow.readPdoSet(first));
+
+  // Another master (or an NVM reload) changed the device
+  inner.active = 2;
+  inner.volt[3] = 15.0f;
+  inner.amps[2] = 1.5f;
+  TEST_ASSERT_TRUE(shadow.readPdoSet(second));
+
+  TEST_ASSERT_EQUAL(2, inner.readCalls);
+  TEST_ASSERT_EQUAL(2, second.activePdo);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 15.0f, second.voltage[3]);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.5f, second.current[2]);
+
+  // Writing the old value back is a real change again
+  shadow.setVoltage(3, first.voltage[3]);
+  TEST_ASSERT_TRUE(shadow.isDirty());
+}
+
+static void test_shadow_read_keeps_staged_fields() {
+  BusCountingChip inner;
+  ShadowedUsbPdChip shadow(inner);
+  shadow.read();
+  shadow.setVoltage(2, 15.0f);
+  inner.volt[3] = 20.0f;
+
+  PdoSet set;
+  TEST_ASSERT_TRUE(shadow.readPdoSet(set));
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 15.0f, set.voltage[2]);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 20.0f, set.voltage[3]);
+  TEST_ASSERT_TRUE(shadow.isDirty());
+}
+
+static void test_shadow_sample_reports_outside_change() {
+  FakeUsbPdChip inner;
+  ShadowedUsbPdChip shadow(inner);
+  USBPDController ctrl(shadow);
+  ctrl.begin();
+  TEST_ASSERT_TRUE(ctrl.setPDConfig(15.0f, 2.0f, PdWriteMode::Volatile));
+  ctrl.sampleNow();
+  uint32_t before = ctrl.getStateVersion();
+
+  // PDOs changed under the shadow; the next sample must see it
+  inner.active = 2;
+  inner.volt[2] = 9.0f;
+  ctrl.sampleNow();
+
+  PdSnapshot snap = ctrl.getSnapshot();
+  TEST_ASSERT_TRUE(ctrl.getStateVersion() > before);
+  TEST_ASSERT_EQUAL(2, snap.activePdo);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 9.0f, snap.voltage);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 9.0f, snap.pdoVoltage[2]);
+}
+
+static void test_shadow_writePdoSet_marks_only_changed_fields() {
+  BusCountingChip inner;
+  ShadowedUsbPdChip shadow(inner);
+  shadow.setCurrent(2, 1.33f); // Stored as 1.25 A
+  shadow.write();
+  int setters = inner.setterCalls;
+
+  // Writing back what was read is a no-op, rounded fields included
+  PdoSet set;
+  shadow.readPdoSet(set);
+  shadow.writePdoSet(set);
+  TEST_ASSERT_FALSE(shadow.isDirty());
+
+  set.voltage[3] = 15.0f;
+  shadow.writePdoSet(set);
+  shadow.write();
+  TEST_ASSERT_EQUAL(setters + 1, inner.setterCalls);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 15.0f, inner.volt[3]);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.25f, inner.amps[2]);
+}
+
+static void test_shadow_getters_reflect_pending_changes() {
+  BusCountingChip inner;
+  ShadowedUsbPdChip shadow(inner);
+  shadow.read();
+  shadow.setVoltage(3, 15.0f);
+  shadow.setPdoNumber(3);
+
+  TEST_ASSERT_TRUE(shadow.isDirty());
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 15.0f, shadow.getVoltage(3));
+  TEST_ASSERT_EQUAL(3, shadow.getPdoNumber());
+  // Inner untouched until write()
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 20.0f, inner.volt[3]);
+  TEST_ASSERT_EQUAL(1, inner.active);
+}
+
+static void test_shadow_softReset_only_after_real_write() {
+  BusCountingChip inner;
+  ShadowedUsbPdChip shadow(inner);
+  shadow.read();
+
+  shadow.softReset();
+  TEST_ASSERT_EQUAL(0, inner.resetCalls);
+
+  shadow.setPdoNumber(2);
+  shadow.write();
+  shadow.softReset();
+  shadow.softReset();
+  TEST_ASSERT_EQUAL(1, inner.resetCalls);
+  TEST_ASSERT_EQUAL_UINT32(2, shadow.getResetsSkipped());
+}
+
+static void test_shadow_invalidated_by_begin_and_failed_probe() {
+  BusCountingChip inner;
+  ShadowedUsbPdChip shadow(inner);
+  shadow.read();
+  TEST_ASSERT_TRUE(shadow.probe(0x28));
+  TEST_ASSERT_TRUE(shadow.isLoaded());
+
+  inner.present = false;
+  TEST_ASSERT_FALSE(shadow.probe(0x28));
+  TEST_ASSERT_FALSE(shadow.isLoaded());
+
+  inner.present = true;
+  shadow.read();
+  TEST_ASSERT_EQUAL(2, inner.readCalls);
+  TEST_ASSERT_TRUE(shadow.begin());
+  TEST_ASSERT_FALSE(shadow.isLoaded());
+
+  // External change picked up after reload
+  inner.volt[3] = 15.0f;
+  shadow.read();
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 15.0f, shadow.getVoltage(3));
+}
+
+static void test_shadow_refresh_discards_pending_changes() {
+  BusCountingChip inner;
+  ShadowedUsbPdChip shadow(inner);
+  shadow.read();
+  shadow.setVoltage(2, 9.0f);
+  shadow.refresh();
+  TEST_ASSERT_FALSE(shadow.isDirty());
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 12.0f, shadow.getVoltage(2));
+}
+
+static void test_shadow_volatile_then_commit_skips_second_reset() {
+  BusCountingChip inner;
+  ShadowedUsbPdChip shadow(inner);
+  USBPDCore core(shadow);
+
+  TEST_ASSERT_TRUE(core.setConfig(15.0f, 1.5f, PdWriteMode::Volatile));
+  TEST_ASSERT_EQUAL(1, inner.volatileWrites);
+  TEST_ASSERT_EQUAL(0, inner.writeCalls);
+  TEST_ASSERT_EQUAL(1, inner.resetCalls);
+  TEST_ASSERT_TRUE(shadow.hasUncommittedChanges());
+
+  // Committing what is already running writes NVM but does not renegotiate
+  core.commitConfig(15.0f, 1.5f);
+  TEST_ASSERT_EQUAL(1, inner.writeCalls);
+  TEST_ASSERT_FALSE(shadow.hasUncommittedChanges());
+  shadow.softReset();
+  TEST_ASSERT_EQUAL(1, inner.resetCalls);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 15.0f, inner.volt[3]);
+}
+
+void register_usb_pd_shadow_chip_tests() {
+  RUN_TEST(test_shadow_read_always_reaches_device);
+  RUN_TEST(test_shadow_unchanged_configure_costs_no_bus_traffic);
+  RUN_TEST(test_shadow_forwards_only_dirty_fields);
+  RUN_TEST(test_shadow_repeat_of_rounded_value_is_noop);
+  RUN_TEST(test_shadow_readPdoSet_sees_outside_changes);
+  RUN_TEST(test_shadow_read_keeps_staged_fields);
+  RUN_TEST(test_shadow_sample_reports_outside_change);
+  RUN_TEST(test_shadow_writePdoSet_marks_only_changed_fields);
+  RUN_TEST(test_shadow_getters_reflect_pending_changes);
+  RUN_TEST(test_shadow_softReset_only_after_real_write);
+  RUN_TEST(test_shadow_invalidated_by_begin_and_failed_probe);
+  RUN_TEST(test_shadow_refresh_discards_pending_changes);
+  RUN_TEST(test_shadow_volatile_then_commit_skips_second_reset);
+}
+
+#endif // NATIVE_PLATFORM
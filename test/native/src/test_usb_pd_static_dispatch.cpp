@@ -0,0 +1,45 @@
+#include <unity.h>
+
+#ifdef NATIVE_PLATFORM
+#include "fakes/fake_usb_pd_chip.h"
+#include <usb_pd_controller.h>
+#include <usb_pd_core_impl.h>
+
+// Same fake, but final: BasicUSBPDCore<FinalFakeChip> calls it directly
+class FinalFakeChip final : public FakeUsbPdChip {};
+
+template class BasicUSBPDCore<FinalFakeChip>;
+
+static void test_static_core_behaves_like_virtual_core() {
+  FakeUsbPdChip dynamicChip;
+  FinalFakeChip staticChip;
+  USBPDCore dynamicCore(dynamicChip);
+  BasicUSBPDCore<FinalFakeChip> staticCore(staticChip);
+
+  TEST_ASSERT_TRUE(dynamicCore.setConfig(15.0f, 2.0f, PdWriteMode::Volatile));
+  TEST_ASSERT_TRUE(staticCore.setConfig(15.0f, 2.0f, PdWriteMode::Volatile));
+  TEST_ASSERT_EQUAL(dynamicChip.active, staticChip.active);
+  TEST_ASSERT_EQUAL(dynamicChip.readCalls, staticChip.readCalls);
+  TEST_ASSERT_EQUAL(dynamicChip.volatileWrites, staticChip.volatileWrites);
+  TEST_ASSERT_EQUAL(dynamicChip.contractReads, staticChip.contractReads);
+  for (int i = 1; i <= 3; ++i) {
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, dynamicChip.volt[i], staticChip.volt[i]);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, dynamicChip.amps[i], staticChip.amps[i]);
+  }
+}
+
+// Call latency of both bindings is measured by bench_native (core.*.static);
+// flash per variant comes from scripts/size_report.py run over the build
+static void test_static_dispatch_keeps_layout() {
+  // The chip type only changes how calls are made, never the layout
+  TEST_ASSERT_EQUAL(sizeof(USBPDCore), sizeof(BasicUSBPDCore<FinalFakeChip>));
+  TEST_ASSERT_EQUAL(sizeof(USBPDController),
+                    sizeof(BasicUSBPDController<FinalFakeChip>));
+}
+
+void register_usb_pd_static_dispatch_tests() {
+  RUN_TEST(test_static_core_behaves_like_virtual_core);
+  RUN_TEST(test_static_dispatch_keeps_layout);
+}
+
+#endif // NATIVE_PLATFORM
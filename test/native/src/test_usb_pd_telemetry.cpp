@@ -0,0 +1,177 @@
+#include <unity.h>
+
+#ifdef NATIVE_PLATFORM
+#include "fakes/fake_usb_pd_chip.h"
+#include <ArduinoFake.h>
+#include <usb_pd_controller.h>
+#include <usb_pd_telemetry.h>
+
+using namespace fakeit;
+
+static PdTelemetryPoint points[USB_PD_HISTORY_MAX_POINTS];
+
+static void test_raw_ring_keeps_newest_samples() {
+  PdTelemetryStore store;
+  for (uint32_t i = 0; i < USB_PD_TELEMETRY_RAW_SAMPLES + 10; ++i) {
+    store.record(i * 100, 5.0f, 1.0f);
+  }
+  size_t n = store.countPoints(PdTelemetryTier::Raw, 0, UINT32_MAX / 2);
+  TEST_ASSERT_EQUAL(USB_PD_TELEMETRY_RAW_SAMPLES, n);
+
+  // The newest, oldest first
+  size_t got = store.query(PdTelemetryTier::Raw, 0, UINT32_MAX / 2, points, 5);
+  TEST_ASSERT_EQUAL(5, got);
+  TEST_ASSERT_EQUAL(((USB_PD_TELEMETRY_RAW_SAMPLES + 10) - 5) * 100,
+                    points[0].ms);
+  TEST_ASSERT_EQUAL((USB_PD_TELEMETRY_RAW_SAMPLES + 9) * 100, points[4].ms);
+  TEST_ASSERT_EQUAL(5000, points[4].meanMillivolts);
+  TEST_ASSERT_EQUAL(1000, points[4].maxMilliamps);
+}
+
+static void test_rollups_cascade_min_max_mean() {
+  PdTelemetryStore store;
+  // Two samples per second for three minutes: 5 V / 9 V alternating,
+  // current rising by 10 mA per second
+  for (uint32_t ms = 0; ms < 180000; ms += 500) {
+    float volts = (ms / 500) % 2 ? 9.0f : 5.0f;
+    store.record(ms, volts, 0.5f + (ms / 1000) * 0.01f);
+  }
+
+  size_t n = store.query(PdTelemetryTier::Seconds, 60000, 60999, points,
+                         USB_PD_HISTORY_MAX_POINTS);
+  TEST_ASSERT_EQUAL(1, n);
+  TEST_ASSERT_EQUAL(60000, points[0].ms);
+  TEST_ASSERT_EQUAL(2, points[0].count);
+  TEST_ASSERT_EQUAL(5000, points[0].minMillivolts);
+  TEST_ASSERT_EQUAL(7000, points[0].meanMillivolts);
+  TEST_ASSERT_EQUAL(9000, points[0].maxMillivolts);
+  TEST_ASSERT_EQUAL(1100, points[0].meanMilliamps);
+
+  // Minutes: two closed, the third still open and reported last
+  n = store.query(PdTelemetryTier::Minutes, 0, 180000, points,
+                  USB_PD_HISTORY_MAX_POINTS);
+  TEST_ASSERT_EQUAL(3, n);
+  TEST_ASSERT_EQUAL(0, points[0].ms);
+  TEST_ASSERT_EQUAL(60000, points[1].ms);
+  TEST_ASSERT_EQUAL(120000, points[2].ms);
+  TEST_ASSERT_EQUAL(120, points[0].count);
+  TEST_ASSERT_EQUAL(120, points[2].count);
+  TEST_ASSERT_EQUAL(500, points[0].minMilliamps);
+  TEST_ASSERT_EQUAL(1090, points[0].maxMilliamps);
+  TEST_ASSERT_EQUAL(795, points[0].meanMilliamps);
+  TEST_ASSERT_EQUAL(7000, points[1].meanMillivolts);
+
+  // The open hour folds in the open minute and second
+  n = store.query(PdTelemetryTier::Hours, 0, 180000, points,
+                  USB_PD_HISTORY_MAX_POINTS);
+  TEST_ASSERT_EQUAL(1, n);
+  TEST_ASSERT_EQUAL(360, points[0].count);
+  TEST_ASSERT_EQUAL(500, points[0].minMilliamps);
+  TEST_ASSERT_EQUAL(2290, points[0].maxMilliamps);
+  TEST_ASSERT_EQUAL(store.recorded(), points[0].count);
+}
+
+static void test_query_window_and_cut() {
+  PdTelemetryStore store;
+  for (uint32_t ms = 0; ms < 100000; ms += 1000) {
+    store.record(ms, 12.0f, 2.0f);
+  }
+  // Buckets overlapping [10500, 20500]: seconds 10 to 20
+  size_t n = store.query(PdTelemetryTier::Seconds, 10500, 20500, points,
+                         USB_PD_HISTORY_MAX_POINTS);
+  TEST_ASSERT_EQUAL(11, n);
+  TEST_ASSERT_EQUAL(10000, points[0].ms);
+  TEST_ASSERT_EQUAL(20000, points[10].ms);
+
+  // Cut to the newest three
+  TEST_ASSERT_EQUAL(11, store.countPoints(PdTelemetryTier::Seconds, 10500,
+                                          20500));
+  n = store.query(PdTelemetryTier::Seconds, 10500, 20500, points, 3);
+  TEST_ASSERT_EQUAL(3, n);
+  TEST_ASSERT_EQUAL(18000, points[0].ms);
+  TEST_ASSERT_EQUAL(20000, points[2].ms);
+
+  // Out-of-order samples are dropped
+  store.record(50000, 20.0f, 3.0f);
+  TEST_ASSERT_EQUAL(100, store.recorded());
+}
+
+static void test_pick_tier_prefers_finest_that_fits() {
+  // Polled every 250 ms for three hours
+  PdTelemetryStore store;
+  for (uint32_t ms = 0; ms < 3 * 3600000UL; ms += 250) {
+    store.record(ms, 5.0f, 1.0f);
+  }
+  uint32_t now = 3 * 3600000UL - 250;
+
+  // Last 20 s: the raw ring still holds it
+  TEST_ASSERT_EQUAL((int)PdTelemetryTier::Raw,
+                    (int)store.pickTier(now - 20000, now, 120));
+  // Last 100 s: raw does not reach back that far, seconds do
+  TEST_ASSERT_EQUAL((int)PdTelemetryTier::Seconds,
+                    (int)store.pickTier(now - 100000, now, 120));
+  // Last hour: too many seconds, minutes fit
+  TEST_ASSERT_EQUAL((int)PdTelemetryTier::Minutes,
+                    (int)store.pickTier(now - 3600000UL, now, 120));
+  // Older than the minute ring holds
+  TEST_ASSERT_EQUAL((int)PdTelemetryTier::Hours,
+                    (int)store.pickTier(0, now, 120));
+  size_t n = store.query(PdTelemetryTier::Hours, 0, now, points,
+                         USB_PD_HISTORY_MAX_POINTS);
+  TEST_ASSERT_EQUAL(3, n);
+  TEST_ASSERT_EQUAL(4 * 3600, points[0].count);
+}
+
+static void test_tier_names_round_trip() {
+  PdTelemetryTier tier = PdTelemetryTier::Raw;
+  TEST_ASSERT_TRUE(parseTelemetryTier("1m", tier));
+  TEST_ASSERT_EQUAL((int)PdTelemetryTier::Minutes, (int)tier);
+  TEST_ASSERT_EQUAL_STRING("1m", telemetryTierName(tier));
+  TEST_ASSERT_FALSE(parseTelemetryTier("5m", tier));
+  TEST_ASSERT_EQUAL((int)PdTelemetryTier::Minutes, (int)tier);
+}
+
+static void test_controller_records_published_samples() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  uint32_t now = 1000;
+  When(Method(ArduinoFake(), millis)).AlwaysDo([&]() { return now; });
+  ctrl.begin();
+  now = 2000;
+  ctrl.sampleNow();
+  now = 3500;
+  TEST_ASSERT_TRUE(ctrl.setPDConfig(15.0f, 2.0f, PdWriteMode::Volatile));
+
+  size_t n = ctrl.queryHistory(PdTelemetryTier::Raw, 0, now, points,
+                               USB_PD_HISTORY_MAX_POINTS);
+  TEST_ASSERT_TRUE(n >= 3);
+  TEST_ASSERT_EQUAL(5000, points[0].meanMillivolts);
+  TEST_ASSERT_EQUAL(15000, points[n - 1].meanMillivolts);
+  TEST_ASSERT_EQUAL(2000, points[n - 1].meanMilliamps);
+
+  // Disconnected samples leave gaps rather than zeros
+  chip.present = false;
+  now = 4000;
+  ctrl.sampleNow();
+  TEST_ASSERT_EQUAL(n, ctrl.queryHistory(PdTelemetryTier::Raw, 0, now, points,
+                                         USB_PD_HISTORY_MAX_POINTS));
+
+  WebRequestCore req;
+  WebResponseCore res;
+  ctrl.historyHandler(req, res);
+  TEST_ASSERT_EQUAL(200, res.getStatus());
+  TEST_ASSERT_EQUAL_STRING("application/json", res.getMimeType().c_str());
+  TEST_ASSERT_NOT_EQUAL(-1, res.getContent().indexOf("\"resolution\":\"raw\""));
+  TEST_ASSERT_NOT_EQUAL(-1, res.getContent().indexOf("[3500,1,15,15,15,2,2,2]"));
+}
+
+void register_usb_pd_telemetry_tests() {
+  RUN_TEST(test_raw_ring_keeps_newest_samples);
+  RUN_TEST(test_rollups_cascade_min_max_mean);
+  RUN_TEST(test_query_window_and_cut);
+  RUN_TEST(test_pick_tier_prefers_finest_that_fits);
+  RUN_TEST(test_tier_names_round_trip);
+  RUN_TEST(test_controller_records_published_samples);
+}
+
+#endif // NATIVE_PLATFORM
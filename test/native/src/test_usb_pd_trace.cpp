@@ -0,0 +1,116 @@
+#include <unity.h>
+
+#if defined(NATIVE_PLATFORM) && USB_PD_TRACE
+#include "fakes/fake_usb_pd_chip.h"
+#include "support/response_body.h"
+#include <ArduinoFake.h>
+#include <string>
+#include <usb_pd_controller.h>
+#include <usb_pd_trace.h>
+
+using namespace fakeit;
+
+// Each reading is 10 us after the previous one
+static uint32_t fakeUs = 0;
+static uint32_t steppingClock() { return fakeUs += 10; }
+
+static std::string dumpTrace(bool clearWritten = false) {
+  String text;
+  {
+    PdStringSink sink(text);
+    PdJsonWriter json(sink);
+    pdTrace.writeChromeTrace(json, clearWritten);
+  }
+  return text.c_str();
+}
+
+static size_t countOf(const std::string &text, const std::string &part) {
+  size_t n = 0;
+  for (size_t at = text.find(part); at != std::string::npos;
+       at = text.find(part, at + 1)) {
+    ++n;
+  }
+  return n;
+}
+
+static void test_trace_ring_keeps_newest_spans() {
+  static const char *const names[] = {"a", "b", "c", "d"};
+  pdTrace.setClock(steppingClock);
+  pdTrace.clear();
+  for (uint32_t i = 0; i < USB_PD_TRACE_EVENTS + 3; ++i) {
+    pdTrace.record(names[i % 4], i * 100, i * 100 + 40);
+  }
+  TEST_ASSERT_EQUAL(USB_PD_TRACE_EVENTS + 3, pdTrace.recorded());
+
+  std::string text = dumpTrace();
+  TEST_ASSERT_EQUAL(USB_PD_TRACE_EVENTS, countOf(text, "\"ph\":\"X\""));
+  // The first three were overwritten, so the dump starts at the fourth
+  TEST_ASSERT_EQUAL(0, text.find("{\"traceEvents\":[{\"name\":\"d\","
+                                 "\"cat\":\"usb_pd\",\"ph\":\"X\","
+                                 "\"ts\":300,\"dur\":40,"));
+  std::string recorded =
+      "\"recorded\":" + std::to_string(USB_PD_TRACE_EVENTS + 3);
+  TEST_ASSERT_NOT_EQUAL(std::string::npos, text.find(recorded));
+
+  dumpTrace(true);
+  TEST_ASSERT_EQUAL(0, pdTrace.recorded());
+  TEST_ASSERT_EQUAL(0, countOf(dumpTrace(), "\"ph\":\"X\""));
+}
+
+static void test_trace_spans_cover_configure_steps() {
+  FakeUsbPdChip chip;
+  USBPDCore core(chip);
+  pdTrace.setClock(steppingClock);
+  pdTrace.clear();
+  TEST_ASSERT_TRUE(core.setConfig(15.0f, 2.0f, PdWriteMode::Volatile));
+
+  // Spans are written as they end, so nested ones come first
+  std::string text = dumpTrace();
+  const char *order[] = {"core.step.read",       "core.step.apply",
+                         "core.step.write",      "core.step.soft_reset",
+                         "core.wait_contract",   "core.read_config",
+                         "core.step.read_back",  "core.set_config"};
+  size_t last = 0;
+  for (const char *name : order) {
+    size_t at = text.find(std::string("\"name\":\"") + name + "\"");
+    TEST_ASSERT_TRUE_MESSAGE(at != std::string::npos && at >= last, name);
+    last = at;
+  }
+  TEST_ASSERT_EQUAL(0, countOf(text, "\"dur\":0,"));
+}
+
+static void test_trace_route_dumps_controller_spans() {
+  FakeUsbPdChip chip;
+  USBPDController ctrl(chip);
+  uint32_t now = 0;
+  When(Method(ArduinoFake(), micros)).AlwaysDo([&]() { return now += 25; });
+  ctrl.begin();
+  pdTrace.clear();
+
+  ctrl.sampleNow();
+  WebRequestCore req;
+  WebResponseCore statusRes;
+  ctrl.instrumentRoute("/api/status", [&](RequestT &r, ResponseT &res) {
+    ctrl.pdStatusHandler(r, res);
+  })(req, statusRes);
+
+  WebResponseCore res;
+  ctrl.traceHandler(req, res);
+  TEST_ASSERT_EQUAL(200, res.getStatus());
+  TEST_ASSERT_EQUAL_STRING("application/json", res.getMimeType().c_str());
+  std::string text = responseBody(res).c_str();
+  TEST_ASSERT_EQUAL(1, countOf(text, "\"name\":\"controller.sample\""));
+  TEST_ASSERT_EQUAL(1, countOf(text, "\"name\":\"controller.publish\""));
+  TEST_ASSERT_EQUAL(1, countOf(text, "\"name\":\"core.read_config\""));
+  TEST_ASSERT_EQUAL(1, countOf(text, "\"name\":\"/api/status\""));
+}
+
+void register_usb_pd_trace_tests() {
+  RUN_TEST(test_trace_ring_keeps_newest_spans);
+  RUN_TEST(test_trace_spans_cover_configure_steps);
+  RUN_TEST(test_trace_route_dumps_controller_spans);
+}
+
+#else
+void register_usb_pd_trace_tests() {}
+#endif // NATIVE_PLATFORM && USB_PD_TRACE
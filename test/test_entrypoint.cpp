@@ -10,6 +10,19 @@ using namespace fakeit;
 // Forward declarations from included sources
 void register_usb_pd_core_tests();
 void register_usb_pd_controller_tests();
+void register_usb_pd_poller_tests();
+void register_usb_pd_poll_scheduler_tests();
+void register_usb_pd_ports_tests();
+void register_usb_pd_shadow_chip_tests();
+void register_usb_pd_static_dispatch_tests();
+void register_usb_pd_alloc_budget_tests();
+void register_usb_pd_json_writer_tests();
+void register_usb_pd_telemetry_tests();
+void register_usb_pd_series_tests();
+void register_usb_pd_metrics_tests();
+void register_usb_pd_trace_tests();
+void register_usb_pd_i2c_bus_tests();
+void register_usb_pd_breaker_tests();
 
 // Global provider that persists across tests (but gets reset in setUp)
 static MockWebPlatformProvider *globalProvider = nullptr;
@@ -28,6 +41,8 @@ extern "C" void setUp(void) {
   When(Method(ArduinoFake(), delay)).AlwaysReturn();
   // Stub millis for timing-related tests
   When(Method(ArduinoFake(), millis)).AlwaysReturn(0UL);
+  // Stub micros for route timing
+  When(Method(ArduinoFake(), micros)).AlwaysReturn(0UL);
 }
 
 extern "C" void tearDown(void) {
@@ -42,6 +57,19 @@ int main(int argc, char **argv) {
   // Register and run native tests
   register_usb_pd_core_tests();
   register_usb_pd_controller_tests();
+  register_usb_pd_poller_tests();
+  register_usb_pd_poll_scheduler_tests();
+  register_usb_pd_ports_tests();
+  register_usb_pd_shadow_chip_tests();
+  register_usb_pd_static_dispatch_tests();
+  register_usb_pd_alloc_budget_tests();
+  register_usb_pd_json_writer_tests();
+  register_usb_pd_telemetry_tests();
+  register_usb_pd_series_tests();
+  register_usb_pd_metrics_tests();
+  register_usb_pd_trace_tests();
+  register_usb_pd_i2c_bus_tests();
+  register_usb_pd_breaker_tests();
 
   UNITY_END();
 